@@ -0,0 +1,221 @@
+/*
+    auth_check.cpp - known answer check of tpp_Auth, the frame MAC of the hub and sensors
+    created by Bob Glicksman and Jim Schrempp
+    as part of Team Practical Projects (tpp)
+
+    20261018 - first version
+
+    Builds the firmware's own tpp_Auth.cpp (the hub's or the sensor's copy) with
+    host_runtime and checks:
+
+        reference   tpp_Auth::mac() against a separate transcription of Chaskey as in
+                    the reference code (Mouha et al.): whole 32 bit words, subkeys k1 and
+                    k2, 0x01 padding of a short last block.  Every frame length from 0 to
+                    80 bytes, a few keys and addresses, so the block and padding edges
+                    are all crossed.
+        answers     tags of fixed frames with TPP_AUTH_KEY.  The hub and sensor copies
+                    must give the same ones, and so must any change to tpp_Auth that is
+                    meant to keep existing sensors working.  They were recorded from this
+                    code when the reference comparison passed; they are not the published
+                    Chaskey test vectors, which use 128 bit tags of bare messages.
+        sign        sign() then verify(): the counter comes back, a changed byte or tag
+                    is refused (-2), a frame with no field is -1, and the counters go on
+                    from EEPROM after beginCounter().
+
+    It prints each failure and a summary, and exits 1 if anything failed.
+
+    Build, with the hub's copy (the sensor's the same way, with its folder):
+        H=Range_Testing/Range_Test_Hub/LoRaRangeTestHub/src
+        g++ -std=c++17 -O2 -IHost_Tools/host_runtime -I$H -o auth_check Host_Tools/auth_check/auth_check.cpp \
+            $H/tpp_Auth.cpp Host_Tools/host_runtime/host_runtime.cpp -lutil
+
+    Run:
+        ./auth_check
+*/
+
+#include "Particle.h"
+#include "tpp_Auth.h"
+
+static int checks = 0;
+static int failures = 0;
+
+static void expect(bool ok, const String& what) {
+    checks++;
+    if (!ok) {
+        failures++;
+        printf("FAIL %s\n", what.c_str());
+    }
+}
+
+// ---- Chaskey as written in the reference code, kept apart from tpp_Auth on purpose ----
+
+#define REF_ROTL(x, b) (uint32_t) (((x) << (b)) | ((x) >> (32 - (b))))
+
+static void refRound(uint32_t v[4]) {
+    v[0] += v[1]; v[1] = REF_ROTL(v[1], 5); v[1] ^= v[0]; v[0] = REF_ROTL(v[0], 16);
+    v[2] += v[3]; v[3] = REF_ROTL(v[3], 8); v[3] ^= v[2];
+    v[0] += v[3]; v[3] = REF_ROTL(v[3], 13); v[3] ^= v[0];
+    v[2] += v[1]; v[1] = REF_ROTL(v[1], 7); v[1] ^= v[2]; v[2] = REF_ROTL(v[2], 16);
+}
+
+static void refTimesTwo(uint32_t out[4], const uint32_t in[4]) {
+    static const uint32_t C[2] = {0x00, 0x87};
+    out[0] = (in[0] << 1) ^ C[in[3] >> 31];
+    out[1] = (in[1] << 1) | (in[0] >> 31);
+    out[2] = (in[2] << 1) | (in[1] >> 31);
+    out[3] = (in[3] << 1) | (in[2] >> 31);
+}
+
+static uint32_t refLoad(const uint8_t* p) {
+    return (uint32_t) p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+// the first word of the 128 bit tag of m
+static uint32_t refMac(const uint8_t key[16], const uint8_t* m, unsigned int mlen) {
+    uint32_t k[4], k1[4], k2[4], v[4];
+    for (int i = 0; i < 4; i++) {
+        k[i] = refLoad(key + 4 * i);
+        v[i] = k[i];
+    }
+    refTimesTwo(k1, k);
+    refTimesTwo(k2, k1);
+
+    unsigned int blocks = mlen == 0 ? 0 : (mlen - 1) / 16;     // all but the last block
+    for (unsigned int b = 0; b < blocks; b++, m += 16) {
+        for (int i = 0; i < 4; i++) {
+            v[i] ^= refLoad(m + 4 * i);
+        }
+        for (int r = 0; r < TPP_AUTH_ROUNDS; r++) {
+            refRound(v);
+        }
+    }
+    uint8_t lb[16] = {0};
+    unsigned int remain = mlen & 0xF;
+    const uint32_t* l;
+    if (mlen != 0 && remain == 0) {
+        l = k1;
+        memcpy(lb, m, 16);
+    } else {
+        l = k2;
+        memcpy(lb, m, remain);
+        lb[remain] = 0x01;
+    }
+    for (int i = 0; i < 4; i++) {
+        v[i] ^= refLoad(lb + 4 * i) ^ l[i];
+    }
+    for (int r = 0; r < TPP_AUTH_ROUNDS; r++) {
+        refRound(v);
+    }
+    return v[0] ^ l[0];
+}
+
+// ---- the checks ----
+
+static void checkReference() {
+    static const uint8_t keys[3][16] = {
+        TPP_AUTH_KEY,
+        {0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF},
+        {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF},
+    };
+    static const unsigned int addresses[] = {0, 1, 12001, 57248, 65535};
+    uint8_t message[2 + 80];
+    char text[80];
+    for (int n = 0; n < 80; n++) {
+        text[n] = (char) (n * 37 + 11);     // every byte value shows up somewhere
+    }
+    for (const uint8_t* key : keys) {
+        tpp_Auth auth;
+        auth.begin(key);
+        for (unsigned int address : addresses) {
+            message[0] = address >> 8;
+            message[1] = address & 0xFF;
+            for (unsigned int length = 0; length <= 80; length++) {
+                memcpy(message + 2, text, length);
+                uint32_t got = auth.mac(address, text, length);
+                uint32_t want = refMac(key, message, length + 2);
+                expect(got == want, "mac key " + String(key[0], HEX) + " address " + String(address) + " length "
+                    + String(length) + ": " + String(got, HEX) + ", reference " + String(want, HEX));
+            }
+        }
+    }
+}
+
+struct KnownAnswer {
+    unsigned int address;
+    const char* frame;      // up to and including the comma after the counter
+    uint32_t tag;
+};
+
+// TPP_AUTH_KEY; with the address, frames of 14, 30 and 46 bytes are whole blocks
+static const KnownAnswer answers[] = {
+    {12001, "G m: 1 k: 0,", 0x61770455},
+    {12001, "G m: 12 k: 11,", 0x75be6743},
+    {12007, "E m: 3 k: 4096,", 0x12e8623e},
+    {12003, "G m: 5 e: 0,120,26 d: 0 k: 17,", 0x2e314111},
+    {12002, "H m: 77 h: 24 w: 3 a: 1234 k: 80,", 0x185ae7d3},
+    {12004, "G m: 5 e: 0,120,260,300 d: 1 c: 7 k: 42949672,", 0xb8093815},
+    {12004, "G m: 5 e: 0,120,260,300 d: 1 c: 7 k: 4294967295,", 0x3e3146a4},
+    {57248, "B m: 1 n: 100 a: 1 xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx k: 1,", 0x4f44ca1c},
+};
+
+static void checkAnswers() {
+    const uint8_t key[16] = TPP_AUTH_KEY;
+    tpp_Auth auth;
+    auth.begin(key);
+    for (const KnownAnswer& a : answers) {
+        uint32_t got = auth.mac(a.address, a.frame, strlen(a.frame));
+        expect(got == a.tag, String("answer ") + a.frame + ": " + String(got, HEX) + ", recorded " + String(a.tag, HEX));
+    }
+}
+
+static void checkSign() {
+    const uint8_t key[16] = TPP_AUTH_KEY;
+    tpp_Auth sensor, hub;
+    sensor.begin(key);
+    hub.begin(key);
+    EEPROM.clear();
+    sensor.beginCounter();
+
+    uint32_t lastCounter = 0;
+    for (int n = 0; n < 3 * TPP_AUTH_COUNTER_BLOCK; n++) {
+        String frame = "G m: " + String(n + 1);
+        String sent = frame;
+        expect(sensor.sign(12001, sent) == 0, "sign " + frame);
+        String got = sent;
+        uint32_t counter = 0;
+        expect(hub.verify(12001, got, counter) == 0 && got == frame, "verify " + sent);
+        expect(n == 0 || counter == lastCounter + 1, "counter after " + String(lastCounter) + " is " + String(counter));
+        lastCounter = counter;
+
+        String changed = sent;
+        changed.setCharAt(0, 'E');
+        expect(hub.verify(12001, changed, counter) == -2, "changed frame accepted: " + changed);
+        expect(hub.verify(12002, sent, counter) == -2, "frame accepted from another address: " + sent);
+        String badTag = sent;
+        badTag.setCharAt(badTag.length() - 1, badTag.charAt(badTag.length() - 1) == '0' ? '1' : '0');
+        expect(hub.verify(12001, badTag, counter) == -2, "changed tag accepted: " + badTag);
+    }
+    uint32_t counter;
+    String unsigned_ = "G m: 9";
+    expect(hub.verify(12001, unsigned_, counter) == -1, "frame with no auth field");
+
+    // a reset: the sensor goes on past every counter it may have used
+    tpp_Auth restarted;
+    restarted.begin(key);
+    restarted.beginCounter();
+    String sent = "G m: 100";
+    restarted.sign(12001, sent);
+    hub.verify(12001, sent, counter);
+    expect(counter > lastCounter, "counter after a reset " + String(counter) + ", before " + String(lastCounter));
+}
+
+void setup() {
+    checkReference();
+    checkAnswers();
+    checkSign();
+    printf("%d checks, %d failed\n", checks, failures);
+    exit(failures ? 1 : 0);
+}
+
+void loop() {
+}
@@ -0,0 +1,407 @@
+/*
+    battery_model.cpp - battery life of a trip sensor, with Monte Carlo over trips, losses and temperature
+    created by Bob Glicksman and Jim Schrempp
+    as part of Team Practical Projects (tpp)
+
+    20261018 - first version
+
+    Replaces "Low_Power_Testing/Battery power calculations.xlsx".  The spreadsheet's numbers
+    are the defaults; a model file or key=value arguments change them.
+
+    One trip (one wake up of the sensor) is these phases, each drawing the sum of the
+    currents of the parts that are on:
+
+        wake          MCU active, radio on (RX), UART        wake_ms
+        send command  MCU active, radio on, UART             command_ms
+        transmit      MCU active, radio TX at the power      time on air of payload_bytes
+        wait for ack  MCU active, radio RX                   hub_turnaround_ms + time on air of ack_bytes,
+                                                             or ack_timeout_ms if the frame or ack is lost
+        sleep command MCU active, radio on, UART             sleep_ms
+        misc          MCU active, radio on                   misc_ms
+
+    A lost frame is sent again up to "retries" times, each costing a transmit and a wait.
+    Between trips everything is asleep: mcu_sleep + radio_sleep + other_sleep, all day.
+
+    With heartbeat_hours not 0 the watchdog runs all the time (wdt_mA more asleep, and a
+    wdt_wake_ms wake up every 8 s), and a heartbeat_bytes frame with no ack wait is sent
+    whenever that many hours pass without a trip.  Compare with the w: and a: fields of
+    the sensor's heartbeat frames (RangeTestSensor 2.17).
+
+    With -t, a captured current trace of one complete trip (ms,mA per line, from a current
+    logger or the low power test jig) replaces the phase model for the first attempt.
+    Retries are still from the model.
+
+    The Monte Carlo gives every simulated sensor its own trip rate (lognormal around
+    trips_per_day), loss probability (uniform in loss_min - loss_max) and site temperature
+    (normal around temp_mean, plus a yearly swing), then runs it day by day with a Poisson
+    number of trips until the battery is used up.  Capacity is derated by temperature
+    (the derate table, linear between points) and loses self_discharge_pct a year.
+
+    Build:
+        g++ -std=c++17 -O2 -o battery_model battery_model.cpp
+
+    Run:
+        ./battery_model [-f model.txt] [-t trace.csv] [-n trials] [-s seed] [key=value ...]
+
+    e.g. the cost of SF11 with one retry:
+        ./battery_model sf=11 retries=1
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../common/tpp_TimeOnAir.h"
+
+#define MAX_YEARS 25    // a simulated sensor still running after this is reported at MAX_YEARS
+
+// settings and their defaults (mA, ms, per day).  The first group is the spreadsheet's.
+static std::map<std::string, std::string> settings = {
+    {"capacity_mAh", "1500"},       // Energizer 123
+    {"trips_per_day", "3"},
+    {"radio_rx_mA", "17.5"},
+    {"radio_sleep_mA", "0.01"},
+    {"mcu_active_mA", "2"},
+    {"mcu_sleep_mA", "0.002"},
+    {"other_sleep_mA", "0.043"},    // switch pull up 3 uA + reset pulse logic 40 uA
+    {"uart_mA", "0"},               // extra while the UART is busy, if any
+    {"wake_ms", "26"},
+    {"command_ms", "34"},
+    {"sleep_ms", "26"},
+    {"misc_ms", "10"},
+
+    // TX current at each CRFOP; 22 dBm is the data sheet figure, the rest are estimates to replace with measurements
+    {"tx_mA", "22:140,20:120,17:95,14:60,10:40,0:25"},
+    {"power", "22"},
+    {"sf", "9"},
+    {"bw", "7"},
+    {"cr", "1"},
+    {"preamble", "12"},
+    {"payload_bytes", "24"},
+    {"ack_bytes", "12"},            // "TESTOK ..." back from the hub
+    {"hub_turnaround_ms", "40"},
+    {"ack_timeout_ms", "5000"},     // RangeTestSensor waits 5 s for the hub
+    {"retries", "0"},
+
+    {"heartbeat_hours", "0"},       // 0: no watchdog, no heartbeats
+    {"heartbeat_bytes", "30"},      // "H m: 123 h: 24 w: 10800 a: 95"
+    {"wdt_mA", "0.004"},            // ATmega328P power down with the watchdog on, less without (data sheet, 3 V)
+    {"wdt_wake_ms", "0.02"},        // MCU active per watchdog interrupt: start up, count, back to sleep
+
+    {"trip_rate_spread", "0.5"},    // sigma of the log of each sensor's trip rate
+    {"loss_min", "0.0"},
+    {"loss_max", "0.1"},
+    {"temp_mean", "15"},            // C
+    {"temp_site_sd", "5"},
+    {"temp_swing", "10"},           // yearly, +/- C
+    {"derate", "-20:0.6,0:0.85,20:1,60:1"},   // fraction of capacity available at a temperature
+    {"self_discharge_pct", "1"},    // of capacity a year
+};
+
+static double number(const char* key) { return atof(settings[key].c_str()); }
+
+// "x:y,x:y,..." sorted by x
+static std::vector<std::pair<double, double>> table(const char* key) {
+    std::vector<std::pair<double, double>> points;
+    const char* p = settings[key].c_str();
+    while (*p) {
+        double x, y;
+        int used;
+        if (sscanf(p, "%lf:%lf%n", &x, &y, &used) != 2) {
+            break;
+        }
+        points.push_back({x, y});
+        p += used;
+        if (*p == ',') p++;
+    }
+    std::sort(points.begin(), points.end());
+    return points;
+}
+
+static double interpolate(const std::vector<std::pair<double, double>>& points, double x) {
+    if (points.empty()) return 1;
+    if (x <= points.front().first) return points.front().second;
+    if (x >= points.back().first) return points.back().second;
+    for (size_t i = 1; i < points.size(); i++) {
+        if (x <= points[i].first) {
+            const auto& a = points[i - 1];
+            const auto& b = points[i];
+            return a.second + (b.second - a.second) * (x - a.first) / (b.first - a.first);
+        }
+    }
+    return points.back().second;
+}
+
+static bool set(const char* text, const char* where) {
+    std::string line = text;
+    size_t hash = line.find('#');
+    if (hash != std::string::npos) line.erase(hash);
+    size_t equals = line.find('=');
+    auto trim = [](std::string s) {
+        size_t a = s.find_first_not_of(" \t\r\n");
+        size_t b = s.find_last_not_of(" \t\r\n");
+        return a == std::string::npos ? std::string() : s.substr(a, b - a + 1);
+    };
+    if (equals == std::string::npos) {
+        return trim(line).empty();
+    }
+    std::string key = trim(line.substr(0, equals));
+    if (!settings.count(key)) {
+        fprintf(stderr, "%s: unknown setting %s\n", where, key.c_str());
+        return false;
+    }
+    settings[key] = trim(line.substr(equals + 1));
+    return true;
+}
+
+static bool loadModel(const char* path) {
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return false;
+    }
+    char line[512];
+    bool good = true;
+    while (fgets(line, sizeof(line), f)) {
+        good = set(line, path) && good;
+    }
+    fclose(f);
+    return good;
+}
+
+// charge in mA-ms of a trace of ms,mA lines, trapezoid rule
+static bool loadTrace(const char* path, double& charge, double& durationMS) {
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return false;
+    }
+    char line[256];
+    double lastMS = 0, lastMA = 0;
+    bool first = true;
+    charge = 0;
+    double startMS = 0;
+    while (fgets(line, sizeof(line), f)) {
+        double ms, mA;
+        if (sscanf(line, "%lf,%lf", &ms, &mA) != 2) {
+            continue;   // header
+        }
+        if (first) {
+            startMS = ms;
+            first = false;
+        } else {
+            charge += (ms - lastMS) * (mA + lastMA) / 2;
+        }
+        lastMS = ms;
+        lastMA = mA;
+    }
+    fclose(f);
+    durationMS = lastMS - startMS;
+    if (first || durationMS <= 0) {
+        fprintf(stderr, "%s: no ms,mA samples\n", path);
+        return false;
+    }
+    return true;
+}
+
+// the cost of one trip, worked out once from the settings
+struct Cycle {
+    double sleepMA;         // between trips
+    double firstAttempt;    // mA-ms, a trip whose first frame is acked
+    double lostAttempt;     // mA-ms, each transmit that is not acked
+    double resend;          // mA-ms, each retry that is acked
+    double transmitMS;
+    double ackMS;
+    double heartbeat;       // mA-ms, one heartbeat frame
+    double watchdogPerDay;  // mA-h, the watchdog running and its wake ups
+};
+
+static Cycle workOutCycle(bool haveTrace, double traceCharge) {
+    Cycle c;
+    double mcu = number("mcu_active_mA");
+    double rx = number("radio_rx_mA");
+    double uart = number("uart_mA");
+    double tx = interpolate(table("tx_mA"), number("power"));
+    int SF = (int) number("sf"), bw = (int) number("bw"), cr = (int) number("cr"), preamble = (int) number("preamble");
+
+    c.sleepMA = number("mcu_sleep_mA") + number("radio_sleep_mA") + number("other_sleep_mA");
+    c.transmitMS = tpp_timeOnAirUS((unsigned) number("payload_bytes"), SF, bw, cr, preamble) / 1000.0;
+    c.ackMS = number("hub_turnaround_ms") + tpp_timeOnAirUS((unsigned) number("ack_bytes"), SF, bw, cr, preamble) / 1000.0;
+
+    double transmit = c.transmitMS * (mcu + tx);
+    double commands = (number("wake_ms") + number("command_ms") + number("sleep_ms")) * (mcu + rx + uart)
+        + number("misc_ms") * (mcu + rx);
+    c.resend = number("command_ms") * (mcu + rx + uart) + transmit + c.ackMS * (mcu + rx);
+    c.lostAttempt = number("command_ms") * (mcu + rx + uart) + transmit + number("ack_timeout_ms") * (mcu + rx);
+    c.firstAttempt = haveTrace ? traceCharge : commands + transmit + c.ackMS * (mcu + rx);
+
+    c.heartbeat = 0;
+    c.watchdogPerDay = 0;
+    if (number("heartbeat_hours") > 0) {
+        c.heartbeat = commands
+            + tpp_timeOnAirUS((unsigned) number("heartbeat_bytes"), SF, bw, cr, preamble) / 1000.0 * (mcu + tx);
+        c.watchdogPerDay = number("wdt_mA") * 24 + 86400000.0 / 8000 * number("wdt_wake_ms") * mcu / 3600000.0;
+    }
+    return c;
+}
+
+// heartbeats a day at tripsPerDay (Poisson): one each time heartbeat_hours pass with no trip or heartbeat
+static double heartbeatsPerDay(double tripsPerDay) {
+    double hours = number("heartbeat_hours");
+    if (hours <= 0) {
+        return 0;
+    }
+    double perHour = tripsPerDay / 24;
+    if (perHour * hours < 1e-9) {
+        return 24 / hours;
+    }
+    double silent = exp(-perHour * hours);
+    return 24 * perHour * silent / (1 - silent);
+}
+
+// expected mA-ms of one trip with loss probability p per attempt and the allowed retries
+static double expectedTrip(const Cycle& c, double p, int retries) {
+    // the first attempt: acked with 1 - p; otherwise its wait timed out
+    double total = (1 - p) * c.firstAttempt + p * (c.firstAttempt - c.resend + c.lostAttempt);
+    double reach = p;   // probability a retry is needed
+    for (int i = 0; i < retries; i++) {
+        total += reach * ((1 - p) * c.resend + p * c.lostAttempt);
+        reach *= p;
+    }
+    return total;
+}
+
+static double percentile(std::vector<double>& sorted, double fraction) {
+    size_t i = (size_t) (fraction * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(i, sorted.size() - 1)];
+}
+
+int main(int argc, char** argv) {
+    const char* tracePath = nullptr;
+    int trials = 10000;
+    unsigned seed = 1;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+            if (!loadModel(argv[++i])) return 2;
+        } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            tracePath = argv[++i];
+        } else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            trials = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            seed = (unsigned) atol(argv[++i]);
+        } else if (strchr(argv[i], '=') && argv[i][0] != '-') {
+            if (!set(argv[i], "command line")) return 2;
+        } else {
+            fprintf(stderr, "usage: %s [-f model.txt] [-t trace.csv] [-n trials] [-s seed] [key=value ...]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (trials < 1) trials = 1;
+
+    double traceCharge = 0, traceMS = 0;
+    if (tracePath && !loadTrace(tracePath, traceCharge, traceMS)) {
+        return 2;
+    }
+    Cycle c = workOutCycle(tracePath != nullptr, traceCharge);
+    int retries = std::max(0, (int) number("retries"));
+    double capacity = number("capacity_mAh");
+    double tripsPerDay = number("trips_per_day");
+    auto derate = table("derate");
+    double selfDischargePerDay = capacity * number("self_discharge_pct") / 100 / 365.25;
+
+    // ---- at the mean values, as the spreadsheet did ----
+    double meanLoss = (number("loss_min") + number("loss_max")) / 2;
+    double tripCharge = expectedTrip(c, meanLoss, retries);
+    double sleepPerDay = c.sleepMA * 24;                            // mA-h
+    double tripsPerDayMAh = tripsPerDay * tripCharge / 3600000.0;   // mA-ms to mA-h
+    double heartbeatPerDayMAh = c.watchdogPerDay + heartbeatsPerDay(tripsPerDay) * c.heartbeat / 3600000.0;
+    double nominalDays = capacity / (sleepPerDay + tripsPerDayMAh + heartbeatPerDayMAh + selfDischargePerDay);
+
+    printf("time on air: %.1f ms (%s bytes, SF%s BW code %s CR %s preamble %s), ack wait %.1f ms\n", c.transmitMS,
+        settings["payload_bytes"].c_str(), settings["sf"].c_str(), settings["bw"].c_str(), settings["cr"].c_str(),
+        settings["preamble"].c_str(), c.ackMS);
+    if (tracePath) {
+        printf("trace: %.1f ms, %.3f mA-s per trip\n", traceMS, traceCharge / 1000);
+    }
+    printf("per trip: %.3f mA-s (%.3f if the first frame is lost and not retried)\n", tripCharge / 1000,
+        (c.firstAttempt - c.resend + c.lostAttempt) / 1000);
+    printf("per day: sleep %.4f mA-h, trips %.4f mA-h, self discharge %.4f mA-h\n", sleepPerDay, tripsPerDayMAh,
+        selfDischargePerDay);
+    if (c.watchdogPerDay > 0) {
+        printf("heartbeat every %s h: %.2f a day at %.3f mA-s, watchdog %.4f mA-h, total %.4f mA-h a day\n",
+            settings["heartbeat_hours"].c_str(), heartbeatsPerDay(tripsPerDay), c.heartbeat / 1000, c.watchdogPerDay,
+            heartbeatPerDayMAh);
+    }
+    printf("at the mean values, 20 C: %.2f years\n", nominalDays / 365.25);
+
+    // ---- Monte Carlo ----
+    std::mt19937_64 random(seed);
+    std::normal_distribution<double> unitNormal(0, 1);
+    std::uniform_real_distribution<double> unit(0, 1);
+    double spread = number("trip_rate_spread");
+    double tempMean = number("temp_mean"), tempSiteSD = number("temp_site_sd"), tempSwing = number("temp_swing");
+    std::vector<double> years(trials);
+
+    for (int t = 0; t < trials; t++) {
+        // this sensor's site; the lognormal's mean is trips_per_day
+        double rate = tripsPerDay * exp(spread * unitNormal(random) - spread * spread / 2);
+        double loss = number("loss_min") + (number("loss_max") - number("loss_min")) * unit(random);
+        double siteTemp = tempMean + tempSiteSD * unitNormal(random);
+        double phase = 2 * M_PI * unit(random);
+        std::poisson_distribution<int> tripsToday(rate);
+        std::uniform_int_distribution<int> lostAttempts(0, 1 << 30);
+        double heartbeatCharge = c.watchdogPerDay + heartbeatsPerDay(rate) * c.heartbeat / 3600000.0;
+
+        // fraction of capacity used, so temperature derating can change from day to day
+        double used = 0;
+        int day = 0;
+        int lastDay = (int) (MAX_YEARS * 365.25);
+        for (; day < lastDay && used < 1; day++) {
+            double temp = siteTemp + tempSwing * sin(phase + 2 * M_PI * day / 365.25);
+            double available = capacity * interpolate(derate, temp);
+            double charge = sleepPerDay + heartbeatCharge;    // mA-h
+            int trips = tripsToday(random);
+            for (int i = 0; i < trips; i++) {
+                // attempts until one is acked or the retries run out
+                double trip = c.firstAttempt;
+                bool acked = unit(random) >= loss;
+                if (!acked) {
+                    trip += c.lostAttempt - c.resend;
+                }
+                for (int r = 0; r < retries && !acked; r++) {
+                    acked = unit(random) >= loss;
+                    trip += acked ? c.resend : c.lostAttempt;
+                }
+                charge += trip / 3600000.0;
+            }
+            used += (charge + selfDischargePerDay) / available;
+        }
+        years[t] = day / 365.25;
+    }
+
+    std::sort(years.begin(), years.end());
+    double sum = 0;
+    for (double y : years) sum += y;
+    printf("\nMonte Carlo, %d sensors: mean %.2f years\n", trials, sum / trials);
+    printf("  P1 %.2f  P5 %.2f  P10 %.2f  P50 %.2f  P90 %.2f  P99 %.2f\n", percentile(years, 0.01),
+        percentile(years, 0.05), percentile(years, 0.10), percentile(years, 0.50), percentile(years, 0.90),
+        percentile(years, 0.99));
+
+    // histogram, 20 bins over the range
+    double low = years.front(), width = std::max((years.back() - low) / 20, 0.01);
+    std::vector<int> bins(21, 0);
+    for (double y : years) bins[std::min(20, (int) ((y - low) / width))]++;
+    int most = *std::max_element(bins.begin(), bins.end());
+    printf("\n  years     sensors\n");
+    for (size_t i = 0; i < bins.size(); i++) {
+        printf("  %5.2f  %6d  %s\n", low + i * width, bins[i], std::string(bins[i] * 50 / most, '#').c_str());
+    }
+    return 0;
+}
@@ -0,0 +1,400 @@
+/*
+    tpp_ColumnStore.h - append-only, memory mapped, per-column store of hub log records
+    created by Bob Glicksman and Jim Schrempp
+    as part of Team Practical Projects (tpp)
+
+    20261018 - first version
+
+    Layout on disk:
+
+        <root>/<YYYY-MM-DD>/        one partition per UTC day of the record time
+            rows                    uint64 number of committed rows
+            hour.idx                24 x uint64, first row of each UTC hour (UINT64_MAX if none)
+            time.i64                record time, Unix ms
+            published.i64           published_at of the event, Unix ms
+            device.i32              LoRa address of the sender
+            seq.i32                 message number from the payload ("m: N"), -1 if none
+            snr.i16, rssi.i16
+            code.u8                 TPP_HUBLOG_CODE_xxx
+            hub.u16                 index into hub.dict (one coreid per line)
+            payload.end             uint64 end offset of each payload in payload.dat
+            payload.dat             payload bytes
+
+    Column files grow in steps and are memory mapped, so an append is a few
+    stores into mapped memory.  The row count is written last, so a reader (or a
+    restart after a crash) only sees complete rows.  Rows are in arrival order;
+    hour.idx gives where to start scanning for an hour.  There is no row cap.
+
+    Linux only (mmap, mremap).  Header only.
+*/
+
+#ifndef tpp_ColumnStore_h
+#define tpp_ColumnStore_h
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <algorithm>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define TPP_STORE_INITIAL_ROWS 65536
+#define TPP_STORE_NO_ROW UINT64_MAX
+
+// one row as written to the store
+struct tpp_StoreRow {
+    int64_t timeMS = 0;
+    int64_t publishedMS = 0;
+    int32_t deviceNum = 0;
+    int32_t seq = -1;
+    int16_t SNR = 0;
+    int16_t RSSI = 0;
+    char code = 0;
+    std::string hub;        // Particle coreid
+    std::string payload;
+};
+
+// a file mapped into memory that can grow
+class tpp_MappedFile {
+public:
+    ~tpp_MappedFile() { close(); }
+
+    bool open(const std::string& path, bool writable) {
+        close();
+        this->writable = writable;
+        fd = ::open(path.c_str(), writable ? (O_RDWR | O_CREAT) : O_RDONLY, 0644);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat st;
+        fstat(fd, &st);
+        return mapSize((size_t) st.st_size);
+    }
+
+    // make the file at least minBytes long, growing by doubling
+    bool reserve(size_t minBytes) {
+        if (minBytes <= size) {
+            return true;
+        }
+        size_t newSize = size ? size : 4096;
+        while (newSize < minBytes) {
+            newSize *= 2;
+        }
+        if (ftruncate(fd, (off_t) newSize) != 0) {
+            return false;
+        }
+        return mapSize(newSize);
+    }
+
+    void sync() {
+        if (data && writable) {
+            msync(data, size, MS_ASYNC);
+        }
+    }
+
+    void close() {
+        if (data) {
+            munmap(data, size);
+        }
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        data = nullptr;
+        size = 0;
+        fd = -1;
+    }
+
+    uint8_t* data = nullptr;
+    size_t size = 0;
+
+private:
+    bool mapSize(size_t newSize) {
+        if (newSize == 0) {
+            return true;
+        }
+        void* p;
+        if (data) {
+            p = mremap(data, size, newSize, MREMAP_MAYMOVE);
+        } else {
+            p = mmap(nullptr, newSize, writable ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED, fd, 0);
+        }
+        if (p == MAP_FAILED) {
+            data = nullptr;
+            size = 0;
+            return false;
+        }
+        data = (uint8_t*) p;
+        size = newSize;
+        return true;
+    }
+
+    int fd = -1;
+    bool writable = false;
+};
+
+// the columns of one partition (one UTC day)
+class tpp_StorePartition {
+public:
+    enum { TIME, PUBLISHED, DEVICE, SEQ, SNR, RSSI, CODE, HUB, PAYLOAD_END, COLUMN_COUNT };
+
+    static const char* columnName(int column) {
+        static const char* names[COLUMN_COUNT] = {"time.i64", "published.i64", "device.i32", "seq.i32",
+            "snr.i16", "rssi.i16", "code.u8", "hub.u16", "payload.end"};
+        return names[column];
+    }
+
+    static size_t columnWidth(int column) {
+        static const size_t widths[COLUMN_COUNT] = {8, 8, 4, 4, 2, 2, 1, 2, 8};
+        return widths[column];
+    }
+
+    bool open(const std::string& directory, bool writable) {
+        dir = directory;
+        this->writable = writable;
+        if (writable) {
+            mkdir(dir.c_str(), 0755);
+        }
+        if (!rowsFile.open(dir + "/rows", writable) || !hourFile.open(dir + "/hour.idx", writable)) {
+            return false;
+        }
+        if (writable && rowsFile.size == 0) {
+            rowsFile.reserve(sizeof(uint64_t));
+            hourFile.reserve(24 * sizeof(uint64_t));
+            for (int h = 0; h < 24; h++) {
+                ((uint64_t*) hourFile.data)[h] = TPP_STORE_NO_ROW;
+            }
+        }
+        for (int c = 0; c < COLUMN_COUNT; c++) {
+            if (!columns[c].open(dir + "/" + columnName(c), writable)) {
+                return false;
+            }
+        }
+        if (!payloadData.open(dir + "/payload.dat", writable)) {
+            return false;
+        }
+
+        // the hub dictionary is small text; keep it in memory
+        FILE* f = fopen((dir + "/hub.dict").c_str(), "r");
+        if (f) {
+            char line[256];
+            while (fgets(line, sizeof(line), f)) {
+                std::string hub(line);
+                while (!hub.empty() && (hub.back() == '\n' || hub.back() == '\r')) hub.pop_back();
+                hubIndex[hub] = (uint16_t) hubs.size();
+                hubs.push_back(hub);
+            }
+            fclose(f);
+        }
+        if (rowsFile.size < sizeof(uint64_t) || hourFile.size < 24 * sizeof(uint64_t)) {
+            return false;
+        }
+
+        if (!writable) {
+            // the writer may still be appending; read only the rows that were complete and mapped now
+            uint64_t n = *(const uint64_t*) rowsFile.data;
+            for (int c = 0; c < COLUMN_COUNT; c++) {
+                n = std::min<uint64_t>(n, columns[c].size / columnWidth(c));
+            }
+            while (n > 0 && column<uint64_t>(PAYLOAD_END)[n - 1] > payloadData.size) {
+                n--;
+            }
+            snapshotRows = n;
+        }
+        return true;
+    }
+
+    uint64_t rows() const {
+        if (!writable) {
+            return snapshotRows;
+        }
+        return rowsFile.data ? *(const uint64_t*) rowsFile.data : 0;
+    }
+
+    const uint64_t* hourIndex() const { return (const uint64_t*) hourFile.data; }
+
+    template <typename T> const T* column(int c) const { return (const T*) columns[c].data; }
+
+    std::string payload(uint64_t row) const {
+        const uint64_t* ends = column<uint64_t>(PAYLOAD_END);
+        uint64_t start = row ? ends[row - 1] : 0;
+        return std::string((const char*) payloadData.data + start, ends[row] - start);
+    }
+
+    const std::string& hub(uint64_t row) const {
+        static const std::string none;
+        uint16_t i = column<uint16_t>(HUB)[row];
+        return i < hubs.size() ? hubs[i] : none;
+    }
+
+    bool append(const tpp_StoreRow& row, int hourOfDay) {
+        uint64_t n = rows();
+        size_t capacity = columns[TIME].size / columnWidth(TIME);
+        if (n >= capacity) {
+            size_t newRows = capacity ? capacity * 2 : TPP_STORE_INITIAL_ROWS;
+            for (int c = 0; c < COLUMN_COUNT; c++) {
+                if (!columns[c].reserve(newRows * columnWidth(c))) {
+                    return false;
+                }
+            }
+        }
+        uint64_t payloadStart = n ? column<uint64_t>(PAYLOAD_END)[n - 1] : 0;
+        if (!payloadData.reserve(payloadStart + row.payload.size())) {
+            return false;
+        }
+
+        ((int64_t*) columns[TIME].data)[n] = row.timeMS;
+        ((int64_t*) columns[PUBLISHED].data)[n] = row.publishedMS;
+        ((int32_t*) columns[DEVICE].data)[n] = row.deviceNum;
+        ((int32_t*) columns[SEQ].data)[n] = row.seq;
+        ((int16_t*) columns[SNR].data)[n] = row.SNR;
+        ((int16_t*) columns[RSSI].data)[n] = row.RSSI;
+        ((uint8_t*) columns[CODE].data)[n] = (uint8_t) row.code;
+        ((uint16_t*) columns[HUB].data)[n] = hubNumber(row.hub);
+        if (!row.payload.empty()) {
+            memcpy(payloadData.data + payloadStart, row.payload.data(), row.payload.size());
+        }
+        ((uint64_t*) columns[PAYLOAD_END].data)[n] = payloadStart + row.payload.size();
+
+        uint64_t* hours = (uint64_t*) hourFile.data;
+        if (hours[hourOfDay] == TPP_STORE_NO_ROW) {
+            hours[hourOfDay] = n;
+        }
+        // commit last
+        *(uint64_t*) rowsFile.data = n + 1;
+        return true;
+    }
+
+    void sync() {
+        for (int c = 0; c < COLUMN_COUNT; c++) {
+            columns[c].sync();
+        }
+        payloadData.sync();
+        hourFile.sync();
+        rowsFile.sync();
+    }
+
+    std::string dir;
+
+private:
+    uint16_t hubNumber(const std::string& hub) {
+        auto it = hubIndex.find(hub);
+        if (it != hubIndex.end()) {
+            return it->second;
+        }
+        uint16_t i = (uint16_t) hubs.size();
+        hubIndex[hub] = i;
+        hubs.push_back(hub);
+        FILE* f = fopen((dir + "/hub.dict").c_str(), "a");
+        if (f) {
+            fprintf(f, "%s\n", hub.c_str());
+            fclose(f);
+        }
+        return i;
+    }
+
+    bool writable = false;
+    uint64_t snapshotRows = 0;
+    tpp_MappedFile rowsFile, hourFile, payloadData;
+    tpp_MappedFile columns[COLUMN_COUNT];
+    std::vector<std::string> hubs;
+    std::unordered_map<std::string, uint16_t> hubIndex;
+};
+
+// appends rows, opening the partition for each row's day as needed
+class tpp_ColumnStoreWriter {
+public:
+    ~tpp_ColumnStoreWriter() { close(); }
+
+    bool open(const std::string& rootDir) {
+        root = rootDir;
+        mkdir(root.c_str(), 0755);
+        struct stat st;
+        return stat(root.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+    }
+
+    bool append(const tpp_StoreRow& row) {
+        int64_t day = floorDiv(row.timeMS, 86400000LL);
+        int hour = (int) (floorDiv(row.timeMS, 3600000LL) - day * 24);
+        tpp_StorePartition* partition = partitionFor(day);
+        return partition && partition->append(row, hour);
+    }
+
+    void sync() {
+        for (auto& p : partitions) {
+            p.second->sync();
+        }
+    }
+
+    void close() {
+        sync();
+        for (auto& p : partitions) {
+            delete p.second;
+        }
+        partitions.clear();
+    }
+
+private:
+    static int64_t floorDiv(int64_t a, int64_t b) { return a >= 0 ? a / b : -((-a + b - 1) / b); }
+
+    tpp_StorePartition* partitionFor(int64_t day) {
+        auto it = partitions.find(day);
+        if (it != partitions.end()) {
+            return it->second;
+        }
+        // keep only a few days open; late records for old days are rare
+        if (partitions.size() >= 4) {
+            it = partitions.begin();
+            it->second->sync();
+            delete it->second;
+            partitions.erase(it);
+        }
+        tpp_StorePartition* p = new tpp_StorePartition;
+        if (!p->open(root + "/" + dayName(day), true)) {
+            delete p;
+            return nullptr;
+        }
+        partitions[day] = p;
+        return p;
+    }
+
+    std::string root;
+    std::map<int64_t, tpp_StorePartition*> partitions;
+
+public:
+    static std::string dayName(int64_t day) {
+        time_t t = (time_t) (day * 86400);
+        struct tm tmUTC;
+        gmtime_r(&t, &tmUTC);
+        char name[16];
+        strftime(name, sizeof(name), "%Y-%m-%d", &tmUTC);
+        return name;
+    }
+};
+
+// the partition directories in a store, oldest first
+inline std::vector<std::string> tpp_storePartitions(const std::string& root) {
+    std::vector<std::string> names;
+    DIR* d = opendir(root.c_str());
+    if (!d) {
+        return names;
+    }
+    while (struct dirent* e = readdir(d)) {
+        if (strlen(e->d_name) == 10 && e->d_name[4] == '-' && e->d_name[7] == '-') {
+            names.push_back(root + "/" + e->d_name);
+        }
+    }
+    closedir(d);
+    std::sort(names.begin(), names.end());
+    return names;
+}
+
+#endif
@@ -0,0 +1,172 @@
+/*
+    tpp_HubLogDecode.h - decoder for the data of LoRaHubLogging events, for host tools
+    created by Bob Glicksman and Jim Schrempp
+    as part of Team Practical Projects (tpp)
+
+    20261018 - first version
+
+    Decodes both the compact format (version 1, see tpp_HubLogFormat.h in the hub
+    source) and the original "message=...|deviceNum=...|payload=..." text.
+    Header only; standard C++11.
+*/
+
+#ifndef tpp_HubLogDecode_h
+#define tpp_HubLogDecode_h
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <string>
+#include <vector>
+
+#include "../../Range_Testing/Range_Test_Hub/LoRaRangeTestHub/src/tpp_HubLogFormat.h"
+
+struct tpp_HubLogRecord {
+    int64_t timeMS = -1;      // Unix time in milliseconds; -1 if not known
+    char code = 0;            // TPP_HUBLOG_CODE_xxx; 0 if the message name was not recognized
+    std::string message;      // the message name, e.g. "TESTOK"
+    int deviceNum = 0;
+    int SNR = 0;
+    int RSSI = 0;
+    std::string payload;
+};
+
+// "2024-12-18T19:04:22.123Z" (the Particle published_at) to Unix milliseconds; -1 if not valid
+inline int64_t tpp_parseIsoTimeMS(const std::string& text) {
+    int year, month, day, hour, minute;
+    double second;
+    if (sscanf(text.c_str(), "%d-%d-%dT%d:%d:%lf", &year, &month, &day, &hour, &minute, &second) != 6) {
+        return -1;
+    }
+    // days from civil, so there is no dependence on the local time zone
+    int y = year - (month <= 2);
+    int era = (y >= 0 ? y : y - 399) / 400;
+    int yoe = y - era * 400;
+    int doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    int64_t days = (int64_t) era * 146097 + doe - 719468;
+    return ((days * 24 + hour) * 60 + minute) * 60000 + (int64_t) (second * 1000.0 + 0.5);
+}
+
+inline int tpp_hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+// undo the %XX escapes of a version 1 payload
+inline std::string tpp_hubLogUnescape(const char* begin, const char* end) {
+    std::string out;
+    out.reserve(end - begin);
+    for (const char* p = begin; p < end; p++) {
+        if (*p == '%' && end - p >= 3 && tpp_hexValue(p[1]) >= 0 && tpp_hexValue(p[2]) >= 0) {
+            out += (char) (tpp_hexValue(p[1]) * 16 + tpp_hexValue(p[2]));
+            p += 2;
+        } else {
+            out += *p;
+        }
+    }
+    return out;
+}
+
+// the value of "name=" in the original format, which separates fields with '|'
+inline std::string tpp_hubLogLegacyField(const std::string& data, const char* name) {
+    std::string key = std::string(name) + "=";
+    size_t start = 0;
+    while (start < data.size()) {
+        size_t end = data.find('|', start);
+        if (end == std::string::npos) {
+            end = data.size();
+        }
+        if (data.compare(start, key.size(), key) == 0) {
+            return data.substr(start + key.size(), end - start - key.size());
+        }
+        start = end + 1;
+    }
+    return std::string();
+}
+
+// the message number a sensor puts in its payload as "m: N"; -1 if there is none
+inline int tpp_payloadSequence(const std::string& payload) {
+    size_t at = payload.find("m: ");
+    if (at == std::string::npos || at + 3 >= payload.size() || payload[at + 3] < '0' || payload[at + 3] > '9') {
+        return -1;
+    }
+    return atoi(payload.c_str() + at + 3);
+}
+
+// Decode the data of one LoRaHubLogging event and append its records.
+// publishedAtMS (from published_at) is used when the event itself carries no time.
+// Returns the number of records appended; 0 if the data is in neither format.
+inline int tpp_decodeHubLog(const std::string& data, std::vector<tpp_HubLogRecord>& records,
+        int64_t publishedAtMS = -1) {
+
+    if (data.size() > 2 && data[0] == TPP_HUBLOG_VERSION && data[1] == '|') {
+        const char* p = data.c_str() + 2;
+        const char* end = data.c_str() + data.size();
+        int64_t baseTime = strtoll(p, nullptr, 10);
+        while (p < end && *p != '|') p++;
+        if (p >= end) {
+            return 0;
+        }
+        p++;
+
+        size_t first = records.size();
+        int64_t lastDtMS = 0;
+        while (p < end) {
+            const char* recordEnd = p;
+            while (recordEnd < end && *recordEnd != ';') recordEnd++;
+
+            // five numeric/code fields, then the payload
+            const char* fields[5];
+            const char* q = p;
+            int n = 0;
+            for (; n < 5 && q < recordEnd; n++) {
+                fields[n] = q;
+                while (q < recordEnd && *q != ',') q++;
+                if (q < recordEnd) q++;
+            }
+            if (n == 5) {
+                tpp_HubLogRecord record;
+                int64_t dtMS = strtoll(fields[0], nullptr, 10);
+                lastDtMS = dtMS;
+                record.timeMS = baseTime > 0 ? baseTime * 1000 + dtMS : dtMS;   // fixed up below if no base
+                record.code = *fields[1];
+                record.message = tpp_hubLogCodeName(record.code);
+                record.deviceNum = atoi(fields[2]);
+                record.SNR = atoi(fields[3]);
+                record.RSSI = atoi(fields[4]);
+                record.payload = tpp_hubLogUnescape(q, recordEnd);
+                records.push_back(record);
+            }
+            p = recordEnd + 1;
+        }
+
+        if (baseTime <= 0) {
+            // the hub's clock was not set; the batch was published just after its last record
+            for (size_t i = first; i < records.size(); i++) {
+                records[i].timeMS = publishedAtMS >= 0 ? publishedAtMS - lastDtMS + records[i].timeMS : -1;
+            }
+        }
+        return (int) (records.size() - first);
+    }
+
+    if (data.compare(0, 8, "message=") == 0) {
+        tpp_HubLogRecord record;
+        record.timeMS = publishedAtMS;
+        record.message = tpp_hubLogLegacyField(data, "message");
+        record.code = tpp_hubLogCodeFromName(record.message.c_str());
+        record.deviceNum = atoi(tpp_hubLogLegacyField(data, "deviceNum").c_str());
+        record.payload = tpp_hubLogLegacyField(data, "payload");
+        record.SNR = atoi(tpp_hubLogLegacyField(data, "SNRhub1").c_str());
+        record.RSSI = atoi(tpp_hubLogLegacyField(data, "RSSIHub1").c_str());
+        records.push_back(record);
+        return 1;
+    }
+
+    return 0;
+}
+
+#endif
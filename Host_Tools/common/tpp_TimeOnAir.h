@@ -0,0 +1,38 @@
+/*
+    tpp_TimeOnAir.h - LoRa time on air for the RYLR998's AT+PARAMETER settings
+    created by Bob Glicksman and Jim Schrempp
+    as part of Team Practical Projects (tpp)
+
+    20261018 - first version
+
+    The same calculation as tpp_LoRa::timeOnAirUS() in the hub and sensor code (the
+    SX1262 data sheet formula: explicit header, CRC on, low data rate optimization for
+    symbols over 16 ms), for the host tools.  Header only.
+*/
+
+#ifndef tpp_TimeOnAir_h
+#define tpp_TimeOnAir_h
+
+#include <cstdint>
+
+// bandwidth is the AT+PARAMETER code 0 - 9 (7: 125 kHz, 8: 250 kHz, 9: 500 kHz), codingRate 1 - 4
+inline unsigned long tpp_timeOnAirUS(unsigned int payloadLength, int SF, int bandwidth, int codingRate, int preamble) {
+
+    static const unsigned long bandwidthHz[] = {7800, 10400, 15600, 20800, 31250, 41700, 62500,
+        125000, 250000, 500000};
+    if (bandwidth < 0 || bandwidth > 9) {
+        bandwidth = 7;
+    }
+
+    unsigned long symbolUS = (unsigned long) (((uint64_t) 1 << SF) * 1000000UL / bandwidthHz[bandwidth]);
+    int lowDataRate = symbolUS > 16000 ? 1 : 0;
+
+    long bits = 8L * payloadLength - 4L * SF + 28 + 16;
+    long perBlock = 4L * (SF - 2 * lowDataRate);
+    long blocks = bits > 0 ? (bits + perBlock - 1) / perBlock : 0;
+    unsigned long payloadSymbols = 8 + blocks * (codingRate + 4);
+
+    return (4UL * preamble + 17) * symbolUS / 4 + payloadSymbols * symbolUS;
+}
+
+#endif
@@ -0,0 +1,509 @@
+/*
+    Particle.h - the part of the Particle API the hub, sensor and repeater use, for Linux
+    created by Bob Glicksman and Jim Schrempp
+    as part of Team Practical Projects (tpp)
+
+    20261018 - first version
+
+    Put this folder on the include path ahead of nothing else: the firmware's own
+    #include "Particle.h" finds this file, and host_runtime.cpp supplies what is
+    declared here, a main() that calls setup() and loop(), and the virtual clock,
+    serial ports, pins and cloud behind them.  Only the Photon 2 side of the code
+    (PARTICLEPHOTON 1) is supported; the ATmega328 side needs avr-libc.
+
+    The file system of the P2 (HAL_PLATFORM_FILESYSTEM) is not there, so the hub's
+    sensor registry and rules start empty on every run.  TCPServer never gets a client.
+*/
+
+#ifndef host_Particle_h
+#define host_Particle_h
+
+#include <algorithm>
+#include <cmath>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <functional>
+#include <string>
+#include <type_traits>
+
+#define HAL_PLATFORM_FILESYSTEM 0
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+class __FlashStringHelper;
+#define F(x) (x)
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+// ---- String, as in Wiring: numbers convert, indexes out of range give empty results ----
+
+class String
+{
+private:
+    std::string text;
+
+    static std::string number(unsigned long long value, int base, bool negative) {
+        if (base < 2 || base > 16) {
+            base = 10;
+        }
+        char digits[72];
+        int i = sizeof(digits) - 1;
+        digits[i] = 0;
+        do {
+            digits[--i] = "0123456789abcdef"[value % base];
+            value /= base;
+        } while (value);
+        if (negative) {
+            digits[--i] = '-';
+        }
+        return std::string(digits + i);
+    }
+    static std::string signedNumber(long long value, int base) {
+        if (base == 10 && value < 0) {
+            return number(0ULL - (unsigned long long) value, 10, true);
+        }
+        return number((unsigned long long) value, base, false);
+    }
+    static std::string decimal(double value, int places) {
+        char buffer[64];
+        snprintf(buffer, sizeof(buffer), "%.*f", places, value);
+        return buffer;
+    }
+
+public:
+    String() {}
+    String(const char* value) : text(value ? value : "") {}
+    String(const std::string& value) : text(value) {}
+    String(char value) : text(1, value) {}
+    String(unsigned char value, int base = DEC) : text(number(value, base, false)) {}
+    String(int value, int base = DEC) : text(signedNumber(value, base)) {}
+    String(unsigned int value, int base = DEC) : text(number(value, base, false)) {}
+    String(long value, int base = DEC) : text(signedNumber(value, base)) {}
+    String(unsigned long value, int base = DEC) : text(number(value, base, false)) {}
+    String(long long value, int base = DEC) : text(signedNumber(value, base)) {}
+    String(unsigned long long value, int base = DEC) : text(number(value, base, false)) {}
+    String(float value, int places = 2) : text(decimal(value, places)) {}
+    String(double value, int places = 2) : text(decimal(value, places)) {}
+
+    static String format(const char* format, ...) {
+        char buffer[512];
+        va_list args;
+        va_start(args, format);
+        vsnprintf(buffer, sizeof(buffer), format, args);
+        va_end(args);
+        return String(buffer);
+    }
+
+    unsigned int length() const { return text.size(); }
+    const char* c_str() const { return text.c_str(); }
+    bool reserve(unsigned int size) { text.reserve(size); return true; }
+    const std::string& str() const { return text; }
+
+    String& operator+=(const String& value) { text += value.text; return *this; }
+    String& operator+=(const char* value) { text += value ? value : ""; return *this; }
+    String& operator+=(char value) { text += value; return *this; }
+    template<class T> String& operator+=(T value) { text += String(value).text; return *this; }
+    template<class T> bool concat(const T& value) { *this += value; return true; }
+
+    friend String operator+(const String& a, const String& b) { return String(a.text + b.text); }
+    friend String operator+(const String& a, const char* b) { return String(a.text + (b ? b : "")); }
+    friend String operator+(const char* a, const String& b) { return String((a ? a : "") + b.text); }
+    friend String operator+(const String& a, char b) { return String(a.text + b); }
+    template<class T> friend String operator+(const String& a, T b) { return String(a.text + String(b).text); }
+
+    bool operator==(const String& other) const { return text == other.text; }
+    bool operator==(const char* other) const { return text == (other ? other : ""); }
+    bool operator!=(const String& other) const { return text != other.text; }
+    bool operator!=(const char* other) const { return !(*this == other); }
+    bool operator<(const String& other) const { return text < other.text; }
+    bool operator>(const String& other) const { return text > other.text; }
+    bool equals(const String& other) const { return text == other.text; }
+    bool equalsIgnoreCase(const String& other) const {
+        return text.size() == other.text.size() && strncasecmp(text.c_str(), other.text.c_str(), text.size()) == 0;
+    }
+    int compareTo(const String& other) const { return text.compare(other.text); }
+
+    char operator[](unsigned int i) const { return i < text.size() ? text[i] : 0; }
+    char& operator[](unsigned int i) { static char dummy; return i < text.size() ? text[i] : (dummy = 0); }
+    char charAt(unsigned int i) const { return (*this)[i]; }
+    void setCharAt(unsigned int i, char c) { if (i < text.size()) text[i] = c; }
+
+    bool startsWith(const String& prefix) const { return text.compare(0, prefix.text.size(), prefix.text) == 0; }
+    bool startsWith(const String& prefix, unsigned int offset) const {
+        return offset <= text.size() && text.compare(offset, prefix.text.size(), prefix.text) == 0;
+    }
+    bool endsWith(const String& suffix) const {
+        return text.size() >= suffix.text.size()
+            && text.compare(text.size() - suffix.text.size(), suffix.text.size(), suffix.text) == 0;
+    }
+
+    int indexOf(char c, unsigned int from = 0) const { return found(text.find(c, from)); }
+    int indexOf(const String& s, unsigned int from = 0) const { return found(text.find(s.text, from)); }
+    int lastIndexOf(char c) const { return found(text.rfind(c)); }
+    int lastIndexOf(char c, unsigned int from) const { return found(text.rfind(c, from)); }
+    int lastIndexOf(const String& s) const { return found(text.rfind(s.text)); }
+    static int found(size_t position) { return position == std::string::npos ? -1 : (int) position; }
+
+    String substring(unsigned int from) const { return from >= text.size() ? String() : String(text.substr(from)); }
+    String substring(unsigned int from, unsigned int to) const {
+        if (from > to) {
+            std::swap(from, to);
+        }
+        if (from >= text.size()) {
+            return String();
+        }
+        return String(text.substr(from, std::min<size_t>(to, text.size()) - from));
+    }
+
+    void replace(char find, char with) { std::replace(text.begin(), text.end(), find, with); }
+    void replace(const String& find, const String& with) {
+        if (find.text.empty()) {
+            return;
+        }
+        for (size_t at = text.find(find.text); at != std::string::npos; at = text.find(find.text, at + with.text.size())) {
+            text.replace(at, find.text.size(), with.text);
+        }
+    }
+    void remove(unsigned int index) { if (index < text.size()) text.erase(index); }
+    void remove(unsigned int index, unsigned int count) { if (index < text.size()) text.erase(index, count); }
+    void trim() {
+        size_t first = text.find_first_not_of(" \t\r\n\f\v");
+        if (first == std::string::npos) {
+            text.clear();
+            return;
+        }
+        text = text.substr(first, text.find_last_not_of(" \t\r\n\f\v") - first + 1);
+    }
+    void toUpperCase() { for (char& c : text) c = toupper((unsigned char) c); }
+    void toLowerCase() { for (char& c : text) c = tolower((unsigned char) c); }
+
+    long toInt() const { return atol(text.c_str()); }
+    float toFloat() const { return (float) atof(text.c_str()); }
+    double toDouble() const { return atof(text.c_str()); }
+
+    void getBytes(unsigned char* buffer, unsigned int size, unsigned int index = 0) const {
+        toCharArray((char*) buffer, size, index);
+    }
+    void toCharArray(char* buffer, unsigned int size, unsigned int index = 0) const {
+        if (size == 0) {
+            return;
+        }
+        size_t count = index < text.size() ? std::min<size_t>(size - 1, text.size() - index) : 0;
+        memcpy(buffer, text.c_str() + std::min<size_t>(index, text.size()), count);
+        buffer[count] = 0;
+    }
+};
+
+// ---- time: virtual unless a port is on a pseudo-terminal (see host_runtime.cpp) ----
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+bool host_waitFor(const std::function<bool()>& condition, unsigned long timeoutMS);
+#define waitFor(condition, timeout) host_waitFor([&]() { return (bool) condition(); }, (timeout))
+#define waitUntil(condition) host_waitFor([&]() { return (bool) condition(); }, 0xFFFFFFFFUL)
+
+#define SYSTEM_MODE(mode)
+#define SYSTEM_THREAD(state)
+
+// ---- serial ports ----
+
+class Print
+{
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t* buffer, size_t size) {
+        size_t count = 0;
+        while (size--) {
+            count += write(*buffer++);
+        }
+        return count;
+    }
+    size_t write(const char* text) { return write((const uint8_t*) text, strlen(text)); }
+
+    template<class T> size_t print(const T& value) { return print(String(value)); }
+    template<class T> size_t print(const T& value, int baseOrPlaces) { return print(String(value, baseOrPlaces)); }
+    size_t print(const String& text) { return write((const uint8_t*) text.c_str(), text.length()); }
+    size_t println() { return write((const uint8_t*) "\r\n", 2); }
+    template<class T> size_t println(const T& value) { return print(value) + println(); }
+    template<class T> size_t println(const T& value, int baseOrPlaces) { return print(value, baseOrPlaces) + println(); }
+
+    size_t printf(const char* format, ...) {
+        char buffer[512];
+        va_list args;
+        va_start(args, format);
+        vsnprintf(buffer, sizeof(buffer), format, args);
+        va_end(args);
+        return print(String(buffer));
+    }
+    size_t printlnf(const char* format, ...) {
+        char buffer[512];
+        va_list args;
+        va_start(args, format);
+        vsnprintf(buffer, sizeof(buffer), format, args);
+        va_end(args);
+        return println(String(buffer));
+    }
+};
+
+class Stream : public Print
+{
+protected:
+    unsigned long timeoutMS = 1000;
+
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+    virtual void flush() {}
+    void setTimeout(unsigned long ms) { timeoutMS = ms; }
+
+    int timedRead() {
+        unsigned long startMS = millis();
+        while (!available()) {
+            if (millis() - startMS >= timeoutMS) {
+                return -1;
+            }
+            delay(1);
+        }
+        return read();
+    }
+    String readStringUntil(char terminator) {
+        String text;
+        for (int c = timedRead(); c >= 0 && c != terminator; c = timedRead()) {
+            text += (char) c;
+        }
+        return text;
+    }
+    String readString() {
+        String text;
+        for (int c = timedRead(); c >= 0; c = timedRead()) {
+            text += (char) c;
+        }
+        return text;
+    }
+    size_t readBytes(char* buffer, size_t length) {
+        size_t count = 0;
+        for (int c; count < length && (c = timedRead()) >= 0; ) {
+            buffer[count++] = (char) c;
+        }
+        return count;
+    }
+};
+
+// Serial (USB) and Serial1 (TX/RX, the LoRa module); where each goes is chosen in host_runtime.cpp
+class HostSerial : public Stream
+{
+private:
+    int port;
+
+public:
+    explicit HostSerial(int portIndex) : port(portIndex) {}
+    void begin(unsigned long baud);
+    void begin(unsigned long baud, uint32_t config) { begin(baud); }
+    void end();
+    bool isConnected();
+    int available() override;
+    int read() override;
+    int peek() override;
+    size_t write(uint8_t c) override;
+    using Print::write;
+    void flush() override {}
+    explicit operator bool() { return isConnected(); }
+};
+
+extern HostSerial Serial;
+extern HostSerial Serial1;
+
+// ---- pins ----
+
+enum PinMode { INPUT, OUTPUT, INPUT_PULLUP, INPUT_PULLDOWN, PIN_MODE_NONE = 0xFF };
+enum { LOW = 0, HIGH = 1 };
+enum InterruptMode { CHANGE, RISING, FALLING };
+enum {
+    D0, D1, D2, D3, D4, D5, D6, D7, D8, D9, D10, D11, D12, D13, D14, D15, D16, D17, D18, D19,
+    A0, A1, A2, A3, A4, A5, TX, RX, HOST_PIN_COUNT
+};
+
+namespace DriveStrength { enum Enum { DEFAULT = 0, STANDARD = 0, HIGH = 1 }; }
+
+void pinMode(int pin, PinMode mode);
+void digitalWrite(int pin, int level);
+int digitalRead(int pin);
+int analogRead(int pin);
+void analogWrite(int pin, int value);
+void pinSetDriveStrength(int pin, DriveStrength::Enum strength);
+void tone(int pin, unsigned int frequency, unsigned long durationMS = 0);
+void noTone(int pin);
+bool attachInterrupt(int pin, void (*handler)(), InterruptMode mode);
+void detachInterrupt(int pin);
+void noInterrupts();
+void interrupts();
+
+// ---- numbers ----
+
+long random(long max);
+long random(long min, long max);
+void randomSeed(unsigned long seed);
+uint32_t HAL_RNG_GetRandomNumber();
+
+// functions rather than the Arduino macros, which would break the standard headers
+template<class A, class B> typename std::common_type<A, B>::type min(A a, B b) { return a < b ? a : b; }
+template<class A, class B> typename std::common_type<A, B>::type max(A a, B b) { return a > b ? a : b; }
+template<class T> T constrain(T value, T low, T high) { return value < low ? low : (value > high ? high : value); }
+inline long map(long value, long fromLow, long fromHigh, long toLow, long toHigh) {
+    return (value - fromLow) * (toHigh - toLow) / (fromHigh - fromLow) + toLow;
+}
+
+// ---- the cloud: variables and functions called from scenarios, publishes recorded ----
+
+#define PUBLIC 0
+#define PRIVATE 1
+#define NO_ACK 2
+#define WITH_ACK 8
+
+class CloudClass
+{
+private:
+    bool addVariable(const char* name, std::function<String()> value);
+
+public:
+    template<class T> bool variable(const char* name, const T& value) {
+        return addVariable(name, [&value]() { return String(value); });
+    }
+    bool function(const char* name, int (*handler)(String));
+    template<class T> bool function(const char* name, int (T::*handler)(String), T* object) {
+        return function(name, [object, handler](String argument) { return (object->*handler)(argument); });
+    }
+    bool function(const char* name, std::function<int(String)> handler);
+    bool publish(const String& name, const String& data = String(), int flags = PRIVATE);
+    bool connected();
+    void connect() {}
+    void disconnect() {}
+    void process() {}
+    void syncTime() {}
+};
+
+extern CloudClass Particle;
+
+// ---- wall clock time: starts at a fixed moment so runs repeat exactly ----
+
+class TimeClass
+{
+public:
+    time_t now();
+    time_t local();
+    bool isValid();         // false until the cloud has been connected, as after a reboot
+    void zone(float hours);
+    int hour() { return hour(now()); }
+    int hour(time_t t) { return (int) ((t / 3600) % 24); }
+    int minute() { return minute(now()); }
+    int minute(time_t t) { return (int) ((t / 60) % 60); }
+    int second() { return second(now()); }
+    int second(time_t t) { return (int) (t % 60); }
+    int weekday() { return weekday(now()); }
+    int weekday(time_t t) { return (int) (((t / 86400) + 4) % 7) + 1; }   // 1 is Sunday
+    String timeStr() { return timeStr(now()); }
+    String timeStr(time_t t);
+    String format(time_t t, const char* format);
+};
+
+extern TimeClass Time;
+
+// ---- network: present, with nobody on it ----
+
+class IPAddress
+{
+private:
+    uint8_t octets[4] = {0, 0, 0, 0};
+
+public:
+    IPAddress() {}
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : octets{a, b, c, d} {}
+    uint8_t operator[](int i) const { return octets[i & 3]; }
+    String toString() const {
+        return String(octets[0]) + "." + String(octets[1]) + "." + String(octets[2]) + "." + String(octets[3]);
+    }
+};
+
+class TCPClient
+{
+public:
+    bool connected() { return false; }
+    int available() { return 0; }
+    int read() { return -1; }
+    int availableForWrite() { return 0; }
+    size_t write(uint8_t c) { return 0; }
+    size_t write(const uint8_t* buffer, size_t size) { return 0; }
+    size_t write(const uint8_t* buffer, size_t size, unsigned long timeoutMS) { return 0; }
+    void flush() {}
+    void stop() {}
+    int status() { return 0; }
+    IPAddress remoteIP() { return IPAddress(); }
+    explicit operator bool() { return false; }
+};
+
+class TCPServer
+{
+public:
+    explicit TCPServer(uint16_t port) {}
+    bool begin() { return true; }
+    TCPClient available() { return TCPClient(); }
+};
+
+class WiFiClass
+{
+public:
+    bool ready() { return true; }
+    IPAddress localIP() { return IPAddress(127, 0, 0, 1); }
+};
+
+extern WiFiClass WiFi;
+
+// ---- EEPROM: erased (0xFF) at the start, or loaded from the file given with -e ----
+
+#define HOST_EEPROM_SIZE 4096
+
+class EEPROMClass
+{
+public:
+    uint8_t data[HOST_EEPROM_SIZE];
+
+    template<class T> T& get(int address, T& value) {
+        if (address >= 0 && address + sizeof(T) <= sizeof(data)) {
+            memcpy((void*) &value, data + address, sizeof(T));
+        }
+        return value;
+    }
+    template<class T> const T& put(int address, const T& value) {
+        if (address >= 0 && address + sizeof(T) <= sizeof(data)) {
+            memcpy(data + address, (const void*) &value, sizeof(T));
+        }
+        return value;
+    }
+    uint8_t read(int address) { return address >= 0 && address < HOST_EEPROM_SIZE ? data[address] : 0xFF; }
+    void write(int address, uint8_t value) { if (address >= 0 && address < HOST_EEPROM_SIZE) data[address] = value; }
+    void update(int address, uint8_t value) { write(address, value); }
+    size_t length() { return HOST_EEPROM_SIZE; }
+    void clear() { memset(data, 0xFF, sizeof(data)); }
+};
+
+extern EEPROMClass EEPROM;
+
+// ---- the firmware ----
+
+void setup();
+void loop();
+
+#endif
@@ -0,0 +1,1073 @@
+/*
+    host_runtime.cpp - runs the hub, sensor or repeater firmware on Linux with a virtual clock
+    created by Bob Glicksman and Jim Schrempp
+    as part of Team Practical Projects (tpp)
+
+    20261018 - first version
+
+    Supplies what Particle.h in this folder declares, and a main() that calls the
+    firmware's setup() and then loop() over and over.  The firmware source is not
+    changed: the .ino goes through ino2cpp for its prototypes and is compiled with
+    the firmware's .cpp files and this one.
+
+    Time is virtual: delay() moves the clock on instead of sleeping, each millis() or
+    micros() call moves it on by a microsecond (so a loop that polls the clock ends) and
+    each pass through loop() by -l microseconds.  A day of the hub takes seconds.  The
+    same scenario, seed and options give the same output every run.
+
+    Serial (USB) prints to standard output, one line each with the virtual time, and
+    takes its input from the scenario.  Serial1 is wired to a model of a RYLR998: it
+    answers AT commands at its own baud rate (garbage at any other, like the real one),
+    keeps its settings through resets, sleeps on AT+MODE=1, and sends for as long as the
+    frame's time on air (tpp_TimeOnAir.h) before its +OK.  Frames from other devices
+    come from the scenario.  With -p either port is a new pseudo-terminal instead, or a
+    serial device: rylr998_sim's terminal, a real module on a USB serial adapter (its
+    baud rate follows Serial1.begin()), or a person.  The clock is then real time.
+
+    Scenario file, one event per line; # starts a comment:
+
+        <time> [every <period> [until <time>]] <action> <arguments>
+
+    Times are seconds, or a number with ms, s, m, h or d.  In text, {n} is the count of
+    the event, from 1, for message numbers that change.
+
+        rx <from> <rssi> <snr> <payload>   a frame the module hears, to its own address
+        answer <to|*> <ms> <payload|->      from now on, every frame the firmware sends to
+                                            <to> is answered by <to> <ms> after it ends
+                                            (a hub's TESTOK for a sensor); - stops it
+        pin <pin> <0|1>                     drive an input (D0 - D19, A0 - A5); an attached
+                                            interrupt runs on the matching edge
+        serial <text>                       a line typed on the USB serial port
+        call <function> <argument>          a Particle.function, the result printed
+        get <variable>                      a Particle.variable printed
+        cloud on|off                        Particle.connected() and publish() fail while off;
+                                            Time.isValid() is false until the cloud is on
+        module wedge|deaf|ok                the module stops answering, stops hearing,
+                                            or is fine again
+        modulepin reset|power <pin>         the module's RST (low resets it) or power
+                                            switch (low is off) is wired to this pin
+        note <text>                         printed, to mark a place in the output
+        stop                                ends the run
+
+    Output lines: serial, tx (a frame sent, with its time on air), rx, rx lost (why),
+    publish, call, get, pin (outputs the firmware drives, with -g) and note.  A summary
+    goes to standard error at the end, with the speed against real time.
+
+    Not modelled: radio collisions and range (frames arrive as the scenario says), the
+    P2's file system, TCP clients, and the ATmega328 build of the sensor.
+
+    Build, for the hub (the sensor and repeater the same way, with their folders):
+        g++ -std=c++17 -O2 -o ino2cpp Host_Tools/host_runtime/ino2cpp.cpp
+        H=Range_Testing/Range_Test_Hub/LoRaRangeTestHub/src
+        ./ino2cpp $H/LoRaRangeTestHub.ino > hub_ino.cpp
+        g++ -std=c++17 -O2 -IHost_Tools/host_runtime -I$H -o hub_host hub_ino.cpp $(find $H -name '*.cpp') \
+            Host_Tools/host_runtime/host_runtime.cpp -lutil
+
+    Run:
+        ./hub_host [-f scenario] [-t seconds] [-l loopUS] [-b baud] [-e eepromFile]
+            [-s seed] [-u unixTime] [-p serial|serial1[=device]] [-q] [-g]
+
+        -f   the scenario file (none: the firmware runs with nothing arriving)
+        -t   virtual seconds to run (default 60)
+        -l   microseconds each pass through loop() takes (default 1000)
+        -b   the module's baud rate at the start (default 115200)
+        -e   EEPROM contents, read at the start if the file exists and written at the end
+        -s   seed for random() and rand() (default 1)
+        -u   Time.now() at the start (default 1760000000)
+        -p   the port on a pseudo-terminal, or on the device after =; runs in real time
+        -q   no serial output lines
+        -g   print the outputs the firmware drives
+*/
+
+#include "Particle.h"
+#include "../common/tpp_TimeOnAir.h"
+
+#include <deque>
+#include <map>
+#include <queue>
+#include <vector>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pty.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#define HOST_ANSWER_MS 3        // the module's time to parse and answer a command
+#define HOST_FLASH_MS 25        // extra for commands that save a setting
+#define HOST_BOOT_MS 300        // from reset or power on to +READY
+#define HOST_PUBLISH_BURST 4    // the cloud's publish limit: bursts of 4, then 1 a second
+
+enum { PORT_USB, PORT_MODULE, PORT_COUNT };
+
+// ---- the clock and the events of the scenario and the module ----
+
+struct Event {
+    uint64_t atUS;
+    uint64_t sequence;          // events at the same time run in the order they were made
+    std::function<void()> run;
+    bool operator<(const Event& other) const {
+        return atUS != other.atUS ? atUS > other.atUS : sequence > other.sequence;
+    }
+};
+
+static uint64_t nowUS = 0;
+static bool realTime = false;
+static uint64_t realStartUS = 0;
+static std::priority_queue<Event> events;
+static uint64_t eventCount = 0;
+static bool inEvents = false;
+static bool stopped = false;
+static bool quiet = false;
+static bool tracePins = false;
+
+static uint64_t monotonicUS() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t) t.tv_sec * 1000000ULL + t.tv_nsec / 1000;
+}
+
+static void at(uint64_t atUS, std::function<void()> run) {
+    events.push({atUS, eventCount++, run});
+}
+
+static void pollPorts();
+
+// moves the clock on by us, virtually or by sleeping, and runs the events that come due
+// on the way, each with the clock at its time
+static void advance(uint64_t us) {
+    uint64_t until;
+    if (realTime) {
+        if (us >= 1000) {
+            usleep(us);
+        }
+        until = monotonicUS() - realStartUS;
+        pollPorts();
+    } else {
+        until = nowUS + us;
+    }
+    if (inEvents) {
+        return;
+    }
+    inEvents = true;
+    while (!events.empty() && events.top().atUS <= until) {
+        Event event = events.top();
+        events.pop();
+        nowUS = std::max(nowUS, event.atUS);
+        event.run();
+    }
+    nowUS = std::max(nowUS, until);
+    inEvents = false;
+}
+
+static void output(const char* kind, const std::string& text) {
+    printf("%12.3f %s %s\n", nowUS / 1e6, kind, text.c_str());
+}
+
+unsigned long millis() {
+    advance(inEvents ? 0 : 1);
+    return (unsigned long) (nowUS / 1000);
+}
+
+unsigned long micros() {
+    advance(inEvents ? 0 : 1);
+    return (unsigned long) nowUS;
+}
+
+void delay(unsigned long ms) {
+    if (inEvents) {
+        return;             // from an interrupt handler: time does not pass there
+    }
+    if (!realTime) {
+        advance(ms * 1000ULL);
+        return;
+    }
+    uint64_t until = nowUS + ms * 1000ULL;
+    while (nowUS < until) {
+        advance(std::min<uint64_t>(until - nowUS, 1000));
+    }
+}
+
+void delayMicroseconds(unsigned int us) {
+    if (!inEvents) {
+        advance(us);
+    }
+}
+
+bool host_waitFor(const std::function<bool()>& condition, unsigned long timeoutMS) {
+    unsigned long startMS = millis();
+    while (!condition()) {
+        if (millis() - startMS >= timeoutMS) {
+            return false;
+        }
+        delay(1);
+    }
+    return true;
+}
+
+// ---- interrupts and pins ----
+
+struct Pin {
+    int mode = PIN_MODE_NONE;
+    int level = LOW;            // what the firmware drives
+    int driven = -1;            // what the scenario drives; -1 for nothing
+    void (*handler)() = nullptr;
+    InterruptMode edge = CHANGE;
+};
+
+static Pin pins[HOST_PIN_COUNT];
+static bool interruptsOn = true;
+static std::vector<void (*)()> pendingInterrupts;
+static int moduleResetPin = -1;
+static int modulePowerPin = -1;
+
+static std::string pinName(int pin) {
+    if (pin >= D0 && pin <= D19) return "D" + std::to_string(pin - D0);
+    if (pin >= A0 && pin <= A5) return "A" + std::to_string(pin - A0);
+    if (pin == TX) return "TX";
+    if (pin == RX) return "RX";
+    return std::to_string(pin);
+}
+
+static int pinNumber(const std::string& name) {
+    for (int pin = 0; pin < HOST_PIN_COUNT; pin++) {
+        if (pinName(pin) == name) return pin;
+    }
+    return -1;
+}
+
+static bool validPin(int pin) {
+    return pin >= 0 && pin < HOST_PIN_COUNT;
+}
+
+static int pinLevel(int pin) {
+    const Pin& p = pins[pin];
+    if (p.mode == OUTPUT) return p.level;
+    if (p.driven >= 0) return p.driven;
+    return p.mode == INPUT_PULLUP ? HIGH : LOW;
+}
+
+static void interrupt(void (*handler)()) {
+    if (!interruptsOn) {
+        pendingInterrupts.push_back(handler);
+        return;
+    }
+    bool wasInEvents = inEvents;
+    inEvents = true;
+    handler();
+    inEvents = wasInEvents;
+}
+
+static void levelChanged(int pin, int before) {
+    int after = pinLevel(pin);
+    const Pin& p = pins[pin];
+    if (after == before || !p.handler) {
+        return;
+    }
+    if (p.edge == CHANGE || (p.edge == RISING && after == HIGH) || (p.edge == FALLING && after == LOW)) {
+        interrupt(p.handler);
+    }
+}
+
+void noInterrupts() {
+    interruptsOn = false;
+}
+
+void interrupts() {
+    interruptsOn = true;
+    std::vector<void (*)()> pending;
+    pending.swap(pendingInterrupts);
+    for (void (*handler)() : pending) {
+        interrupt(handler);
+    }
+}
+
+bool attachInterrupt(int pin, void (*handler)(), InterruptMode mode) {
+    if (!validPin(pin)) return false;
+    pins[pin].handler = handler;
+    pins[pin].edge = mode;
+    return true;
+}
+
+void detachInterrupt(int pin) {
+    if (validPin(pin)) pins[pin].handler = nullptr;
+}
+
+static void moduleWiring();
+
+void pinMode(int pin, PinMode mode) {
+    if (!validPin(pin)) return;
+    int before = pinLevel(pin);
+    pins[pin].mode = mode;
+    moduleWiring();
+    levelChanged(pin, before);
+}
+
+void digitalWrite(int pin, int level) {
+    if (!validPin(pin)) return;
+    level = level ? HIGH : LOW;
+    int before = pinLevel(pin);
+    pins[pin].level = level;
+    if (pins[pin].mode == OUTPUT && before != level) {
+        if (tracePins) output("pin", pinName(pin) + " " + std::to_string(level));
+        moduleWiring();
+    }
+}
+
+int digitalRead(int pin) {
+    return validPin(pin) ? pinLevel(pin) : LOW;
+}
+
+int analogRead(int pin) {
+    return validPin(pin) && pinLevel(pin) ? 4095 : 0;
+}
+
+void analogWrite(int pin, int value) {
+    if (validPin(pin) && tracePins) output("pin", pinName(pin) + " pwm " + std::to_string(value));
+}
+
+void pinSetDriveStrength(int pin, DriveStrength::Enum strength) {}
+
+void tone(int pin, unsigned int frequency, unsigned long durationMS) {
+    if (tracePins) output("pin", pinName(pin) + " tone " + std::to_string(frequency) + " Hz " + std::to_string(durationMS) + " ms");
+}
+
+void noTone(int pin) {
+    if (tracePins) output("pin", pinName(pin) + " tone off");
+}
+
+// ---- numbers ----
+
+static uint64_t randomState = 1;
+
+static uint32_t nextRandom() {
+    // xorshift64*: the same sequence for the same seed on every host
+    randomState ^= randomState >> 12;
+    randomState ^= randomState << 25;
+    randomState ^= randomState >> 27;
+    return (uint32_t) ((randomState * 2685821657736338717ULL) >> 32);
+}
+
+long random(long max) {
+    return max <= 0 ? 0 : (long) (nextRandom() % (unsigned long) max);
+}
+
+long random(long min, long max) {
+    return max <= min ? min : min + random(max - min);
+}
+
+void randomSeed(unsigned long seed) {
+    randomState = seed ? seed : 1;
+}
+
+uint32_t HAL_RNG_GetRandomNumber() {
+    return nextRandom();
+}
+
+// ---- serial ports ----
+
+struct Port {
+    bool open = false;
+    unsigned long baud = 0;
+    std::deque<std::pair<uint64_t, uint8_t>> in;    // bytes for the firmware, and when they arrive
+    uint64_t wireFreeUS = 0;        // when the last byte the firmware wrote is off the wire
+    int pty = -1;                   // master side, with -p
+    std::string line;               // USB output not yet printed
+};
+
+static Port ports[PORT_COUNT];
+
+static uint64_t byteUS(unsigned long baud) {
+    return baud ? 10000000ULL / baud : 0;
+}
+
+static void moduleByte(uint8_t c, uint64_t atUS);
+
+static void pollPorts() {
+    for (Port& port : ports) {
+        if (port.pty < 0) continue;
+        uint8_t data[256];
+        ssize_t got;
+        while ((got = ::read(port.pty, data, sizeof(data))) > 0) {
+            for (ssize_t i = 0; i < got; i++) port.in.push_back({0, data[i]});
+        }
+    }
+}
+
+HostSerial Serial(PORT_USB);
+HostSerial Serial1(PORT_MODULE);
+
+static speed_t speedFor(unsigned long baud) {
+    switch (baud) {
+        case 4800: return B4800;
+        case 9600: return B9600;
+        case 19200: return B19200;
+        case 38400: return B38400;
+        case 57600: return B57600;
+        case 115200: return B115200;
+        default: return B9600;
+    }
+}
+
+void HostSerial::begin(unsigned long baud) {
+    Port& p = ports[port];
+    p.open = true;
+    p.baud = baud;
+    if (p.pty < 0) {
+        p.in.clear();       // what came at another rate is lost
+        return;
+    }
+    // a module on the device (or rylr998_sim on the other side) sees the rate
+    struct termios t;
+    if (tcgetattr(p.pty, &t) == 0) {
+        cfsetispeed(&t, speedFor(baud));
+        cfsetospeed(&t, speedFor(baud));
+        tcsetattr(p.pty, TCSANOW, &t);
+    }
+}
+
+void HostSerial::end() {
+    ports[port].open = false;
+}
+
+bool HostSerial::isConnected() {
+    return true;
+}
+
+int HostSerial::available() {
+    Port& p = ports[port];
+    millis();
+    int count = 0;
+    for (const auto& b : p.in) {
+        if (b.first > nowUS) break;
+        count++;
+    }
+    return count;
+}
+
+int HostSerial::read() {
+    if (!available()) return -1;
+    uint8_t c = ports[port].in.front().second;
+    ports[port].in.pop_front();
+    return c;
+}
+
+int HostSerial::peek() {
+    return available() ? ports[port].in.front().second : -1;
+}
+
+size_t HostSerial::write(uint8_t c) {
+    Port& p = ports[port];
+    if (!p.open && port == PORT_MODULE) {
+        return 0;
+    }
+    if (p.pty >= 0) {
+        return ::write(p.pty, &c, 1) == 1 ? 1 : 0;
+    }
+    if (port == PORT_USB) {
+        if (c == '\n') {
+            if (!quiet) output("serial", p.line);
+            p.line.clear();
+        } else if (c != '\r') {
+            p.line += (char) c;
+        }
+        return 1;
+    }
+    p.wireFreeUS = std::max(p.wireFreeUS, nowUS) + byteUS(p.baud);
+    moduleByte(c, p.wireFreeUS);
+    return 1;
+}
+
+// ---- the RYLR998 on Serial1 ----
+
+struct Rule {
+    uint64_t delayUS;
+    std::string payload;
+    uint64_t count = 0;
+};
+
+struct Module {
+    unsigned long baud = 115200;
+    int address = 0;
+    int network = 18;
+    int SF = 9, bandwidth = 7, codingRate = 1, preamble = 12;
+    long band = 915000000;
+    int power = 22;
+    std::string UID;
+    bool asleep = false;
+    bool wedged = false;
+    bool deaf = false;
+    bool off = false;
+    std::string line;
+    uint64_t busyUntilUS = 0;       // answering, or sending a frame
+    uint64_t sendingUntilUS = 0;
+    std::map<long, Rule> rules;     // answers to frames the firmware sends, by address; -1 for any other
+
+    unsigned long framesSent = 0;
+    uint64_t airtimeUS = 0;
+    unsigned long framesHeard = 0;
+    unsigned long framesLost = 0;
+    unsigned long commands = 0;
+} module;
+
+// bytes from the module to the firmware, starting at atUS (or once the last answer is out)
+static void moduleSend(const std::string& text, uint64_t atUS) {
+    Port& p = ports[PORT_MODULE];
+    if (p.pty >= 0) {
+        return;             // the module is on the device
+    }
+    uint64_t t = std::max(atUS, module.busyUntilUS);
+    if (!p.open || p.baud != module.baud) {
+        // framing errors: the firmware sees a byte of noise
+        p.in.push_back({t + byteUS(module.baud), 0xF8});
+        return;
+    }
+    for (char c : text + "\r\n") {
+        t += byteUS(module.baud);
+        p.in.push_back({t, (uint8_t) c});
+    }
+    module.busyUntilUS = t;
+}
+
+static void moduleBoot(uint64_t atUS) {
+    module.asleep = false;
+    module.wedged = false;
+    module.deaf = false;
+    module.line.clear();
+    at(atUS + HOST_BOOT_MS * 1000ULL, []() {
+        if (!module.off) moduleSend("+READY", nowUS);
+    });
+}
+
+// held in reset by a low RST, or its supply switched off: it starts again when let go
+static void moduleWiring() {
+    bool held = moduleResetPin >= 0 && pins[moduleResetPin].mode == OUTPUT && pins[moduleResetPin].level == LOW;
+    bool unpowered = modulePowerPin >= 0 && pins[modulePowerPin].mode == OUTPUT && pins[modulePowerPin].level == LOW;
+    if (held || unpowered) {
+        module.off = true;
+    } else if (module.off) {
+        module.off = false;
+        moduleBoot(nowUS);
+    }
+}
+
+static void heard(long from, int rssi, int snr, const std::string& payload) {
+    const char* lost = module.off ? "off" : module.wedged ? "wedged" : module.deaf ? "deaf"
+        : module.asleep ? "asleep" : nowUS < module.sendingUntilUS ? "sending" : nullptr;
+    if (lost) {
+        module.framesLost++;
+        output("rx lost", std::string("(") + lost + ") " + std::to_string(from) + " " + payload);
+        return;
+    }
+    module.framesHeard++;
+    output("rx", std::to_string(from) + " " + payload);
+    moduleSend("+RCV=" + std::to_string(from) + "," + std::to_string(payload.size()) + "," + payload + ","
+        + std::to_string(rssi) + "," + std::to_string(snr), nowUS);
+}
+
+static std::string withCount(const std::string& text, uint64_t count) {
+    std::string out = text;
+    for (size_t at = out.find("{n}"); at != std::string::npos; at = out.find("{n}", at)) {
+        out.replace(at, 3, std::to_string(count));
+    }
+    return out;
+}
+
+// the answer to one command; saves is set for commands that write the module's flash
+static std::string execute(const std::string& command, bool& saves) {
+    saves = false;
+    if (command == "AT") return "+OK";
+    if (command.compare(0, 3, "AT+") != 0) return "+ERR=1";
+    std::string body = command.substr(3);
+    size_t equals = body.find('=');
+    std::string name = body.substr(0, equals == std::string::npos ? body.size() : equals);
+    bool query = !name.empty() && name.back() == '?';
+    if (query) name.pop_back();
+    std::string value = equals == std::string::npos ? "" : body.substr(equals + 1);
+
+    if (query) {
+        if (name == "UID") return "+UID=" + module.UID;
+        if (name == "ADDRESS") return "+ADDRESS=" + std::to_string(module.address);
+        if (name == "NETWORKID") return "+NETWORKID=" + std::to_string(module.network);
+        if (name == "PARAMETER") return "+PARAMETER=" + std::to_string(module.SF) + "," + std::to_string(module.bandwidth)
+            + "," + std::to_string(module.codingRate) + "," + std::to_string(module.preamble);
+        if (name == "BAND") return "+BAND=" + std::to_string(module.band);
+        if (name == "CRFOP") return "+CRFOP=" + std::to_string(module.power);
+        if (name == "IPR") return "+IPR=" + std::to_string(module.baud);
+        if (name == "MODE") return std::string("+MODE=") + (module.asleep ? "1" : "0");
+        if (name == "VER") return "+VER=RYLR998_HOST";
+        return "+ERR=4";
+    }
+    if (name == "RESET") {
+        return "+RESET";
+    }
+    if (equals == std::string::npos || value.empty()) return "+ERR=2";
+    if (name == "SEND") {
+        long to;
+        unsigned int length;
+        int used = 0;
+        if (sscanf(value.c_str(), "%ld,%u,%n", &to, &length, &used) != 2 || used == 0) return "+ERR=2";
+        std::string payload = value.substr(used);
+        if (payload.size() != length || length > 240) return "+ERR=5";
+        uint64_t airUS = tpp_timeOnAirUS(length, module.SF, module.bandwidth, module.codingRate, module.preamble);
+        module.framesSent++;
+        module.airtimeUS += airUS;
+        module.sendingUntilUS = nowUS + airUS;
+        module.busyUntilUS = std::max(module.busyUntilUS, module.sendingUntilUS);
+        char air[32];
+        snprintf(air, sizeof(air), "  (%.1f ms)", airUS / 1000.0);
+        output("tx", std::to_string(to) + " " + payload + air);
+        auto rule = module.rules.find(to);
+        if (rule == module.rules.end()) {
+            rule = module.rules.find(-1);
+        }
+        if (rule != module.rules.end()) {
+            std::string answer = withCount(rule->second.payload, ++rule->second.count);
+            uint64_t answerAirUS = tpp_timeOnAirUS(answer.size(), module.SF, module.bandwidth, module.codingRate, module.preamble);
+            at(module.sendingUntilUS + rule->second.delayUS + answerAirUS, [to, answer]() { heard(to, -60, 10, answer); });
+        }
+        return "+OK";
+    }
+    saves = true;
+    if (name == "ADDRESS") {
+        int a = atoi(value.c_str());
+        if (a < 0 || a > 65535) return "+ERR=4";
+        module.address = a;
+    } else if (name == "NETWORKID") {
+        int n = atoi(value.c_str());
+        if (n != 18 && (n < 3 || n > 15)) return "+ERR=4";
+        module.network = n;
+    } else if (name == "PARAMETER") {
+        int s, b, c, p;
+        if (sscanf(value.c_str(), "%d,%d,%d,%d", &s, &b, &c, &p) != 4) return "+ERR=2";
+        if (s < 5 || s > 11 || b < 7 || b > 9 || c < 1 || c > 4 || p < 4 || p > 24) return "+ERR=5";
+        module.SF = s;
+        module.bandwidth = b;
+        module.codingRate = c;
+        module.preamble = p;
+    } else if (name == "BAND") {
+        long f = atol(value.c_str());
+        if (f < 820000000 || f > 1020000000) return "+ERR=4";
+        module.band = f;
+    } else if (name == "CRFOP") {
+        int c = atoi(value.c_str());
+        if (c < 0 || c > 22) return "+ERR=4";
+        module.power = c;
+    } else if (name == "IPR") {
+        long r = atol(value.c_str());
+        if (r != 4800 && r != 9600 && r != 19200 && r != 38400 && r != 57600 && r != 115200) return "+ERR=4";
+    } else if (name == "MODE") {
+        saves = false;
+        if (value != "0" && value != "1") return "+ERR=4";
+    } else if (name == "CPIN") {
+        saves = false;
+    } else {
+        saves = false;
+        return "+ERR=4";
+    }
+    return "+OK";
+}
+
+// a command line from the firmware, whole at atUS
+static void moduleCommand(const std::string& command, uint64_t atUS) {
+    module.commands++;
+    module.asleep = false;          // any command wakes it
+    bool saves;
+    std::string answer = execute(command, saves);
+    uint64_t answerAtUS = std::max(atUS, module.sendingUntilUS) + (HOST_ANSWER_MS + (saves ? HOST_FLASH_MS : 0)) * 1000ULL;
+    moduleSend(answer, answerAtUS);
+    if (command.compare(0, 9, "AT+MODE=1") == 0 && answer == "+OK") {
+        module.asleep = true;
+    } else if (command.compare(0, 7, "AT+IPR=") == 0 && answer == "+OK") {
+        module.baud = atol(command.c_str() + 7);
+    } else if (answer == "+RESET") {
+        moduleBoot(module.busyUntilUS);
+    }
+}
+
+static void moduleByte(uint8_t c, uint64_t atUS) {
+    if (module.off || module.wedged) {
+        return;
+    }
+    if (ports[PORT_MODULE].baud != module.baud) {
+        if (c == '\n') moduleSend("", atUS);    // noise back
+        return;
+    }
+    if (c == '\r') return;
+    if (c != '\n') {
+        if (module.line.size() < 256) module.line += (char) c;
+        return;
+    }
+    std::string command = module.line;
+    module.line.clear();
+    at(atUS, [command, atUS]() { moduleCommand(command, atUS); });
+}
+
+// ---- the cloud ----
+
+CloudClass Particle;
+
+static std::map<std::string, std::function<String()>> cloudVariables;
+static std::map<std::string, std::function<int(String)>> cloudFunctions;
+static bool cloudOn = true;
+static bool timeSynced = false;     // the device gets its time from the cloud
+static unsigned long publishes = 0;
+static unsigned long publishesOverLimit = 0;
+static unsigned long publishesFailed = 0;
+static double publishTokens = HOST_PUBLISH_BURST;
+static uint64_t publishTokensUS = 0;
+
+bool CloudClass::addVariable(const char* name, std::function<String()> value) {
+    cloudVariables[name] = value;
+    return true;
+}
+
+bool CloudClass::function(const char* name, int (*handler)(String)) {
+    cloudFunctions[name] = handler;
+    return true;
+}
+
+bool CloudClass::function(const char* name, std::function<int(String)> handler) {
+    cloudFunctions[name] = handler;
+    return true;
+}
+
+bool CloudClass::publish(const String& name, const String& data, int flags) {
+    if (!cloudOn) {
+        publishesFailed++;
+        output("publish failed", std::string(name.c_str()) + " " + data.c_str());
+        return false;
+    }
+    publishTokens = std::min<double>(HOST_PUBLISH_BURST, publishTokens + (nowUS - publishTokensUS) / 1e6);
+    publishTokensUS = nowUS;
+    bool over = publishTokens < 1;
+    if (over) {
+        publishesOverLimit++;
+    } else {
+        publishTokens -= 1;
+    }
+    publishes++;
+    output(over ? "publish (over the rate limit)" : "publish", std::string(name.c_str()) + " " + data.c_str());
+    return true;
+}
+
+bool CloudClass::connected() {
+    return cloudOn;
+}
+
+// ---- time, network, EEPROM ----
+
+TimeClass Time;
+
+bool TimeClass::isValid() {
+    timeSynced = timeSynced || cloudOn;
+    return timeSynced;
+}
+WiFiClass WiFi;
+EEPROMClass EEPROM;
+
+static time_t startUnix = 1760000000;
+static float zoneHours = 0;
+
+time_t TimeClass::now() {
+    return startUnix + (time_t) (nowUS / 1000000ULL);
+}
+
+time_t TimeClass::local() {
+    return now() + (time_t) (zoneHours * 3600);
+}
+
+void TimeClass::zone(float hours) {
+    zoneHours = hours;
+}
+
+String TimeClass::timeStr(time_t t) {
+    return format(t, "%a %b %e %H:%M:%S %Y");
+}
+
+String TimeClass::format(time_t t, const char* format) {
+    struct tm parts;
+    gmtime_r(&t, &parts);
+    char text[64];
+    strftime(text, sizeof(text), format, &parts);
+    return String(text);
+}
+
+// ---- the scenario ----
+
+static bool parseTime(const std::string& text, uint64_t& us) {
+    char* end;
+    double value = strtod(text.c_str(), &end);
+    std::string unit = end;
+    double scale = unit == "" || unit == "s" ? 1e6 : unit == "ms" ? 1e3 : unit == "m" ? 60e6
+        : unit == "h" ? 3600e6 : unit == "d" ? 86400e6 : -1;
+    if (end == text.c_str() || scale < 0 || value < 0) return false;
+    us = (uint64_t) (value * scale + 0.5);
+    return true;
+}
+
+static std::vector<std::string> split(const std::string& text, size_t count, std::string& rest) {
+    std::vector<std::string> words;
+    size_t i = 0;
+    while (words.size() < count) {
+        i = text.find_first_not_of(" \t", i);
+        if (i == std::string::npos) break;
+        size_t end = text.find_first_of(" \t", i);
+        words.push_back(text.substr(i, end == std::string::npos ? std::string::npos : end - i));
+        i = end == std::string::npos ? text.size() : end;
+    }
+    i = text.find_first_not_of(" \t", i);
+    rest = i == std::string::npos ? "" : text.substr(i);
+    return words;
+}
+
+// one action; returns false if it is not valid
+static bool perform(const std::string& action, const std::string& arguments, uint64_t count, bool check) {
+    std::string rest;
+    std::vector<std::string> words;
+    if (action == "rx") {
+        words = split(arguments, 3, rest);
+        if (words.size() != 3 || rest.empty()) return false;
+        if (!check) heard(atol(words[0].c_str()), atoi(words[1].c_str()), atoi(words[2].c_str()), withCount(rest, count));
+    } else if (action == "answer") {
+        words = split(arguments, 2, rest);
+        uint64_t delayUS;
+        if (words.size() != 2 || rest.empty() || !parseTime(words[1] + "ms", delayUS)) return false;
+        long to = words[0] == "*" ? -1 : atol(words[0].c_str());
+        if (!check) {
+            if (rest == "-") module.rules.erase(to);
+            else module.rules[to] = {delayUS, rest};
+        }
+    } else if (action == "pin") {
+        words = split(arguments, 2, rest);
+        int pin = words.size() == 2 ? pinNumber(words[0]) : -1;
+        if (pin < 0 || (words[1] != "0" && words[1] != "1")) return false;
+        if (!check) {
+            int before = pinLevel(pin);
+            pins[pin].driven = atoi(words[1].c_str());
+            levelChanged(pin, before);
+        }
+    } else if (action == "serial") {
+        if (!check) {
+            Port& p = ports[PORT_USB];
+            for (char c : withCount(arguments, count) + "\n") p.in.push_back({nowUS, (uint8_t) c});
+        }
+    } else if (action == "call") {
+        words = split(arguments, 1, rest);
+        if (words.size() != 1) return false;
+        if (!check) {
+            auto f = cloudFunctions.find(words[0]);
+            std::string argument = withCount(rest, count);
+            if (f == cloudFunctions.end()) {
+                output("call", words[0] + "(" + argument + "): no such function");
+            } else {
+                bool wasInEvents = inEvents;
+                inEvents = false;       // the function runs as part of the firmware
+                int result = f->second(String(argument));
+                inEvents = wasInEvents;
+                output("call", words[0] + "(" + argument + ") = " + std::to_string(result));
+            }
+        }
+    } else if (action == "get") {
+        if (arguments.empty()) return false;
+        if (!check) {
+            auto v = cloudVariables.find(arguments);
+            output("get", arguments + (v == cloudVariables.end() ? ": no such variable" : " = " + std::string(v->second().c_str())));
+        }
+    } else if (action == "cloud") {
+        if (arguments != "on" && arguments != "off") return false;
+        if (!check) cloudOn = arguments == "on";
+    } else if (action == "module") {
+        if (arguments != "wedge" && arguments != "deaf" && arguments != "ok") return false;
+        if (!check) {
+            module.wedged = arguments == "wedge";
+            module.deaf = arguments == "deaf";
+            if (module.wedged) module.line.clear();
+            output("note", "module " + arguments);
+        }
+    } else if (action == "modulepin") {
+        words = split(arguments, 2, rest);
+        int pin = words.size() == 2 ? pinNumber(words[1]) : -1;
+        if (pin < 0 || (words[0] != "reset" && words[0] != "power")) return false;
+        if (!check) (words[0] == "reset" ? moduleResetPin : modulePowerPin) = pin;
+    } else if (action == "note") {
+        if (!check) output("note", withCount(arguments, count));
+    } else if (action == "stop") {
+        if (!check) stopped = true;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// schedules the next occurrence of a repeating event
+static void schedule(uint64_t atUS, uint64_t periodUS, uint64_t untilUS, uint64_t count,
+        const std::string& action, const std::string& arguments) {
+    at(atUS, [=]() {
+        perform(action, arguments, count, false);
+        if (periodUS && atUS + periodUS <= untilUS) {
+            schedule(atUS + periodUS, periodUS, untilUS, count + 1, action, arguments);
+        }
+    });
+}
+
+static bool loadScenario(const char* path) {
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        perror(path);
+        return false;
+    }
+    char buffer[1024];
+    int lineNumber = 0;
+    bool good = true;
+    while (fgets(buffer, sizeof(buffer), file)) {
+        lineNumber++;
+        std::string line = buffer;
+        while (!line.empty() && (line.back() == '\n' || line.back() == '\r')) line.pop_back();
+        size_t first = line.find_first_not_of(" \t");
+        if (first == std::string::npos || line[first] == '#') continue;
+
+        std::string rest;
+        std::vector<std::string> words = split(line, 1, rest);
+        uint64_t atUS, periodUS = 0, untilUS = UINT64_MAX;
+        bool valid = parseTime(words[0], atUS);
+        if (valid && rest.compare(0, 6, "every ") == 0) {
+            words = split(rest, 2, rest);
+            valid = words.size() == 2 && parseTime(words[1], periodUS) && periodUS > 0;
+            if (valid && rest.compare(0, 6, "until ") == 0) {
+                words = split(rest, 2, rest);
+                valid = words.size() == 2 && parseTime(words[1], untilUS);
+            }
+        }
+        words = split(rest, 1, rest);
+        if (!valid || words.empty() || !perform(words[0], rest, 1, true)) {
+            fprintf(stderr, "%s:%d: not understood: %s\n", path, lineNumber, line.c_str());
+            good = false;
+            continue;
+        }
+        schedule(atUS, periodUS, untilUS, 1, words[0], rest);
+    }
+    fclose(file);
+    return good;
+}
+
+// ---- main ----
+
+// a new pseudo-terminal for the port, or the serial device at path
+static int openPort(Port& port, const std::string& which, const std::string& path) {
+    int fd;
+    if (path.empty()) {
+        int slave;
+        char name[128];
+        if (openpty(&fd, &slave, name, NULL, NULL) != 0) {
+            perror("openpty");
+            return -1;
+        }
+        struct termios t;
+        tcgetattr(slave, &t);
+        cfmakeraw(&t);
+        tcsetattr(slave, TCSANOW, &t);
+        fprintf(stderr, "%s is %s\n", which.c_str(), name);
+    } else {
+        fd = open(path.c_str(), O_RDWR | O_NOCTTY);
+        if (fd < 0) {
+            perror(path.c_str());
+            return -1;
+        }
+        struct termios t;
+        tcgetattr(fd, &t);
+        cfmakeraw(&t);
+        tcsetattr(fd, TCSANOW, &t);
+    }
+    fcntl(fd, F_SETFL, O_NONBLOCK);
+    port.pty = fd;
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    const char* scenarioPath = nullptr;
+    const char* eepromPath = nullptr;
+    double runSeconds = 60;
+    uint64_t loopUS = 1000;
+    unsigned long seed = 1;
+    for (int i = 1; i < argc; i++) {
+        std::string option = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (option == "-f" && hasValue) scenarioPath = argv[++i];
+        else if (option == "-t" && hasValue) runSeconds = atof(argv[++i]);
+        else if (option == "-l" && hasValue) loopUS = strtoull(argv[++i], NULL, 10);
+        else if (option == "-b" && hasValue) module.baud = atol(argv[++i]);
+        else if (option == "-e" && hasValue) eepromPath = argv[++i];
+        else if (option == "-s" && hasValue) seed = strtoul(argv[++i], NULL, 10);
+        else if (option == "-u" && hasValue) startUnix = (time_t) atoll(argv[++i]);
+        else if (option == "-q") quiet = true;
+        else if (option == "-g") tracePins = true;
+        else if (option == "-p" && hasValue) {
+            std::string which = argv[++i];
+            size_t equals = which.find('=');
+            std::string path = equals == std::string::npos ? "" : which.substr(equals + 1);
+            which = which.substr(0, equals);
+            if (which != "serial" && which != "serial1") {
+                fprintf(stderr, "-p takes serial or serial1, and =device if it is not a new pseudo-terminal\n");
+                return 2;
+            }
+            if (openPort(ports[which == "serial" ? PORT_USB : PORT_MODULE], which, path) != 0) return 1;
+            realTime = true;
+        } else {
+            fprintf(stderr, "usage: %s [-f scenario] [-t seconds] [-l loopUS] [-b baud] [-e eepromFile] [-s seed]"
+                " [-u unixTime] [-p serial|serial1[=device]] [-q] [-g]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    randomSeed(seed);
+    srand((unsigned) seed);
+    char uid[25];
+    for (int i = 0; i < 24; i++) uid[i] = "0123456789ABCDEF"[nextRandom() & 15];
+    uid[24] = 0;
+    module.UID = uid;
+
+    EEPROM.clear();
+    if (eepromPath) {
+        FILE* file = fopen(eepromPath, "rb");
+        if (file) {
+            if (fread(EEPROM.data, 1, sizeof(EEPROM.data), file) != sizeof(EEPROM.data)) {
+                fprintf(stderr, "%s is short; the rest is erased\n", eepromPath);
+            }
+            fclose(file);
+        }
+    }
+    if (scenarioPath && !loadScenario(scenarioPath)) return 2;
+
+    realStartUS = monotonicUS();
+    uint64_t endUS = (uint64_t) (runSeconds * 1e6);
+    unsigned long long loops = 0;
+    advance(0);     // events at time 0, such as cloud off, come before setup()
+    setup();
+    while (nowUS < endUS && !stopped) {
+        loop();
+        loops++;
+        advance(loopUS);
+    }
+    double hostSeconds = (monotonicUS() - realStartUS) / 1e6;
+
+    Port& usb = ports[PORT_USB];
+    if (!usb.line.empty() && !quiet) output("serial", usb.line);
+    fflush(stdout);
+    if (eepromPath) {
+        FILE* file = fopen(eepromPath, "wb");
+        if (!file || fwrite(EEPROM.data, 1, sizeof(EEPROM.data), file) != sizeof(EEPROM.data)) {
+            perror(eepromPath);
+        }
+        if (file) fclose(file);
+    }
+
+    fprintf(stderr, "virtual %.3f s in %.3f s (%.0fx real time), %llu loops\n", nowUS / 1e6, hostSeconds,
+        hostSeconds > 0 ? nowUS / 1e6 / hostSeconds : 0, loops);
+    fprintf(stderr, "module: %lu commands, %lu frames sent (%.1f s on air), %lu heard, %lu lost\n", module.commands,
+        module.framesSent, module.airtimeUS / 1e6, module.framesHeard, module.framesLost);
+    fprintf(stderr, "cloud: %lu publishes, %lu over the rate limit, %lu failed\n", publishes, publishesOverLimit,
+        publishesFailed);
+    return 0;
+}
@@ -0,0 +1,205 @@
+/*
+    ino2cpp.cpp - turns a sketch (.ino) into C++ the way the Particle and Arduino builds do
+    created by Bob Glicksman and Jim Schrempp
+    as part of Team Practical Projects (tpp)
+
+    20261018 - first version
+
+    A sketch may call a function above the place it is defined, because the device
+    build adds a prototype for every function.  This does the same for host_runtime:
+    it writes the sketch to standard output with #include "Particle.h" first and a
+    prototype of each top level function just before the first one, each inside the
+    same #if blocks as its definition.  #line directives keep compiler messages
+    pointing at the .ino.  Functions with default arguments get no prototype, since
+    C++ does not allow the defaults twice.
+
+    Build:
+        g++ -std=c++17 -O2 -o ino2cpp ino2cpp.cpp
+
+    Run:
+        ./ino2cpp sketch.ino > sketch_ino.cpp
+*/
+
+#include <cctype>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+struct Prototype {
+    std::string text;
+    std::vector<std::vector<std::string>> conditions;   // the #if chains it sits in
+};
+
+// the source with comments, strings and character constants blanked out, so braces
+// and parentheses in them are not counted; newlines are kept so lines still match
+static std::string codeOnly(const std::string& source) {
+    std::string code = source;
+    size_t i = 0;
+    while (i < code.size()) {
+        if (code.compare(i, 2, "//") == 0) {
+            while (i < code.size() && code[i] != '\n') code[i++] = ' ';
+        } else if (code.compare(i, 2, "/*") == 0) {
+            size_t end = code.find("*/", i + 2);
+            end = end == std::string::npos ? code.size() : end + 2;
+            for (; i < end; i++) if (code[i] != '\n') code[i] = ' ';
+        } else if (code[i] == '"' || code[i] == '\'') {
+            char quote = code[i++];
+            while (i < code.size() && code[i] != quote && code[i] != '\n') {
+                if (code[i] == '\\' && i + 1 < code.size()) code[i++] = ' ';
+                code[i++] = ' ';
+            }
+            i++;
+        } else {
+            i++;
+        }
+    }
+    return code;
+}
+
+static std::string collapse(const std::string& text) {
+    std::string out;
+    for (char c : text) {
+        if (isspace((unsigned char) c)) {
+            if (!out.empty() && out.back() != ' ') out += ' ';
+        } else {
+            out += c;
+        }
+    }
+    while (!out.empty() && out.back() == ' ') out.pop_back();
+    return out;
+}
+
+// "type name(params)" with nothing before it that makes it something else
+static bool isFunctionHeader(const std::string& header, std::string& name) {
+    size_t open = header.find('(');
+    if (open == std::string::npos || header.back() != ')' || header.find('=') < open) return false;
+    size_t end = open;
+    while (end > 0 && header[end - 1] == ' ') end--;
+    size_t start = end;
+    while (start > 0 && (isalnum((unsigned char) header[start - 1]) || header[start - 1] == '_')) start--;
+    name = header.substr(start, end - start);
+    if (name.empty() || start == 0) return false;      // no return type: a macro call
+    static const char* notFunctions[] = {"if", "for", "while", "switch", "return", "sizeof"};
+    for (const char* word : notFunctions) if (name == word) return false;
+    std::string before = " " + header.substr(0, start);
+    static const char* notTypes[] = {" struct ", " class ", " enum ", " union ", " namespace ", " typedef "};
+    for (const char* word : notTypes) if (before.find(word) != std::string::npos) return false;
+    return header.find('=', open) == std::string::npos && header.find("::") == std::string::npos;
+}
+
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s sketch.ino > sketch_ino.cpp\n", argv[0]);
+        return 2;
+    }
+    std::ifstream in(argv[1]);
+    if (!in) {
+        perror(argv[1]);
+        return 1;
+    }
+    std::stringstream buffer;
+    buffer << in.rdbuf();
+    std::string source = buffer.str();
+    std::string code = codeOnly(source);
+
+    std::vector<Prototype> prototypes;
+    std::vector<std::vector<std::string>> conditions;
+    int depth = 0;
+    int parens = 0;
+    size_t firstLine = 0;           // line of the first function, 1 based; 0 for none
+    size_t headerStart = 0;         // where the text before the next '{' at depth 0 starts
+    size_t line = 1;
+    size_t headerLine = 1;
+    bool lineStart = true;
+    for (size_t i = 0; i < code.size(); i++) {
+        char c = code[i];
+        if (lineStart && depth == 0) {
+            size_t first = code.find_first_not_of(" \t", i);
+            if (first != std::string::npos && code[first] == '#') {
+                size_t end = code.find('\n', first);
+                while (end != std::string::npos && end > 0 && code[end - 1] == '\\') end = code.find('\n', end + 1);
+                if (end == std::string::npos) end = code.size();
+                std::string directive = collapse(code.substr(first, end - first));
+                size_t wordStart = directive.find_first_not_of(' ', 1);
+                size_t wordEnd = wordStart;
+                while (wordEnd < directive.size() && isalpha((unsigned char) directive[wordEnd])) wordEnd++;
+                std::string word = wordStart == std::string::npos ? "" : directive.substr(wordStart, wordEnd - wordStart);
+                if (word == "if" || word == "ifdef" || word == "ifndef") {
+                    conditions.push_back({directive});
+                } else if ((word == "elif" || word == "else") && !conditions.empty()) {
+                    conditions.back().push_back(directive);
+                } else if (word == "endif" && !conditions.empty()) {
+                    conditions.pop_back();
+                }
+                for (size_t j = i; j < end; j++) if (code[j] == '\n') line++;
+                i = end;
+                if (i < code.size()) line++;
+                headerStart = i + 1;
+                headerLine = line;
+                lineStart = true;
+                continue;
+            }
+        }
+        lineStart = c == '\n';
+        if (c == '\n') {
+            line++;
+            if (depth == 0 && headerStart == i) {
+                headerStart = i + 1;
+                headerLine = line;
+            }
+            continue;
+        }
+        if (c == '(') parens++;
+        if (c == ')') parens--;
+        if (c == '{') {
+            if (depth == 0 && parens == 0) {
+                std::string header = collapse(code.substr(headerStart, i - headerStart));
+                std::string name;
+                if (isFunctionHeader(header, name)) {
+                    if (firstLine == 0) {
+                        // skip the blank lines before it so the prototypes go right above it
+                        size_t at = headerStart;
+                        size_t atLine = headerLine;
+                        while (at < i && isspace((unsigned char) code[at])) {
+                            if (code[at] == '\n') atLine++;
+                            at++;
+                        }
+                        firstLine = atLine;
+                    }
+                    prototypes.push_back({header + ";", conditions});
+                }
+            }
+            depth++;
+        } else if (c == '}') {
+            depth--;
+            if (depth == 0) {
+                headerStart = i + 1;
+                headerLine = line;
+            }
+        } else if (c == ';' && depth == 0) {
+            headerStart = i + 1;
+            headerLine = line;
+        }
+    }
+
+    // the sketch, with the prototypes spliced in above its first function
+    printf("#include \"Particle.h\"\n#line 1 \"%s\"\n", argv[1]);
+    std::istringstream lines(source);
+    std::string text;
+    for (size_t n = 1; std::getline(lines, text); n++) {
+        if (n == firstLine) {
+            for (const Prototype& p : prototypes) {
+                for (const std::vector<std::string>& chain : p.conditions) {
+                    for (const std::string& directive : chain) printf("%s\n", directive.c_str());
+                }
+                printf("%s\n", p.text.c_str());
+                for (size_t k = 0; k < p.conditions.size(); k++) printf("#endif\n");
+            }
+            printf("#line %zu \"%s\"\n", n, argv[1]);
+        }
+        printf("%s\n", text.c_str());
+    }
+    return 0;
+}
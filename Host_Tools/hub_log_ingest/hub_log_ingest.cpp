@@ -0,0 +1,345 @@
+/*
+    hub_log_ingest.cpp - local replacement for the Google sheet behind the LoRaHubLogging webhook
+    created by Bob Glicksman and Jim Schrempp
+    as part of Team Practical Projects (tpp)
+
+    20261018 - first version
+
+    An HTTP server that accepts the same POST the Particle webhook sends to
+    GoogleAppScript.js: form fields event, data, coreid and published_at.  The data
+    is decoded (compact or original format, see common/tpp_HubLogDecode.h) and each
+    record is appended to a column store (common/tpp_ColumnStore.h).  Unlike the
+    sheet there is no row limit and nothing is deleted.
+
+    Single threaded, epoll, HTTP/1.1 keep-alive.  Column files are memory mapped and
+    msync'ed once a second and on exit (Ctrl-C).
+
+    Build:
+        g++ -std=c++17 -O2 -o hub_log_ingest hub_log_ingest.cpp
+
+    Run:
+        ./hub_log_ingest [-p port] [-d storeDirectory]      defaults: 8080, ./hublog_store
+
+    Stand in for the Particle cloud with curl:
+        curl -d event=LoRaHubLogging -d coreid=0a10aced202194944a0 \
+             -d published_at=2026-10-18T17:00:00.000Z \
+             --data-urlencode "data=1|1792342800|0,A,6,11,-40,G m: 5" http://localhost:8080/
+    or with hub_log_post (many events, several connections) to measure the rate.
+
+    GET /stats returns counts as JSON.
+*/
+
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "../common/tpp_HubLogDecode.h"
+#include "../common/tpp_ColumnStore.h"
+
+#define MAX_REQUEST_BYTES (1 << 20)
+#define SYNC_INTERVAL_MS 1000
+
+static volatile sig_atomic_t stopRequested = 0;
+
+struct Connection {
+    std::string in;
+    std::string out;
+    bool closeAfterWrite = false;
+};
+
+struct Stats {
+    unsigned long long requests = 0;
+    unsigned long long events = 0;
+    unsigned long long records = 0;
+    unsigned long long rejected = 0;
+};
+
+static int64_t nowMS() {
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    return (int64_t) tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+static std::string urlDecode(const char* p, const char* end) {
+    std::string out;
+    out.reserve(end - p);
+    for (; p < end; p++) {
+        if (*p == '+') {
+            out += ' ';
+        } else if (*p == '%' && end - p >= 3 && tpp_hexValue(p[1]) >= 0 && tpp_hexValue(p[2]) >= 0) {
+            out += (char) (tpp_hexValue(p[1]) * 16 + tpp_hexValue(p[2]));
+            p += 2;
+        } else {
+            out += *p;
+        }
+    }
+    return out;
+}
+
+// application/x-www-form-urlencoded body to name -> value
+static std::unordered_map<std::string, std::string> parseForm(const std::string& body) {
+    std::unordered_map<std::string, std::string> fields;
+    const char* p = body.data();
+    const char* end = p + body.size();
+    while (p < end) {
+        const char* amp = (const char*) memchr(p, '&', end - p);
+        if (!amp) amp = end;
+        const char* eq = (const char*) memchr(p, '=', amp - p);
+        if (eq) {
+            fields[urlDecode(p, eq)] = urlDecode(eq + 1, amp);
+        }
+        p = amp + 1;
+    }
+    return fields;
+}
+
+static void respond(Connection& c, int status, const char* reason, const std::string& body,
+        const char* contentType = "text/plain") {
+    char header[256];
+    snprintf(header, sizeof(header), "HTTP/1.1 %d %s\r\nContent-Type: %s\r\nContent-Length: %zu\r\n%s\r\n",
+        status, reason, contentType, body.size(), c.closeAfterWrite ? "Connection: close\r\n" : "");
+    c.out += header;
+    c.out += body;
+}
+
+// store the records of one webhook POST; returns the number stored, -1 if the form is not a hub event
+static int ingest(const std::string& body, tpp_ColumnStoreWriter& store, Stats& stats,
+        std::vector<tpp_HubLogRecord>& records) {
+    auto form = parseForm(body);
+    auto data = form.find("data");
+    if (data == form.end()) {
+        return -1;
+    }
+    int64_t publishedMS = tpp_parseIsoTimeMS(form["published_at"]);
+    if (publishedMS < 0) {
+        publishedMS = nowMS();
+    }
+
+    records.clear();
+    if (tpp_decodeHubLog(data->second, records, publishedMS) == 0) {
+        // keep it anyway, as the sheet did
+        tpp_HubLogRecord raw;
+        raw.timeMS = publishedMS;
+        raw.payload = data->second;
+        records.push_back(raw);
+    }
+
+    tpp_StoreRow row;
+    row.publishedMS = publishedMS;
+    row.hub = form["coreid"];
+    int stored = 0;
+    for (const tpp_HubLogRecord& r : records) {
+        row.timeMS = r.timeMS >= 0 ? r.timeMS : publishedMS;
+        row.deviceNum = r.deviceNum;
+        row.seq = tpp_payloadSequence(r.payload);
+        row.SNR = (int16_t) r.SNR;
+        row.RSSI = (int16_t) r.RSSI;
+        row.code = r.code;
+        row.payload = r.payload;
+        if (store.append(row)) {
+            stored++;
+        }
+    }
+    stats.events++;
+    stats.records += stored;
+    return stored;
+}
+
+// handle every complete request in the connection's input buffer
+static void processInput(Connection& c, tpp_ColumnStoreWriter& store, Stats& stats,
+        std::vector<tpp_HubLogRecord>& records) {
+    while (!c.closeAfterWrite) {
+        size_t headerEnd = c.in.find("\r\n\r\n");
+        if (headerEnd == std::string::npos) {
+            if (c.in.size() > 16384) {
+                c.closeAfterWrite = true;
+                respond(c, 431, "Request Header Fields Too Large", "");
+            }
+            return;
+        }
+
+        // request line and the two headers we care about
+        std::string head = c.in.substr(0, headerEnd);
+        size_t contentLength = 0;
+        bool keepAlive = head.find(" HTTP/1.1") != std::string::npos;
+        for (size_t line = head.find("\r\n"); line != std::string::npos; line = head.find("\r\n", line + 2)) {
+            const char* h = head.c_str() + line + 2;
+            if (strncasecmp(h, "Content-Length:", 15) == 0) {
+                contentLength = strtoul(h + 15, nullptr, 10);
+            } else if (strncasecmp(h, "Connection:", 11) == 0) {
+                keepAlive = strncasecmp(h + 11 + strspn(h + 11, " "), "close", 5) != 0;
+            } else if (strncasecmp(h, "Transfer-Encoding:", 18) == 0) {
+                c.closeAfterWrite = true;
+                respond(c, 411, "Length Required", "");
+                return;
+            }
+        }
+        if (contentLength > MAX_REQUEST_BYTES) {
+            c.closeAfterWrite = true;
+            respond(c, 413, "Payload Too Large", "");
+            return;
+        }
+        if (c.in.size() < headerEnd + 4 + contentLength) {
+            return;   // wait for the rest of the body
+        }
+
+        std::string body = c.in.substr(headerEnd + 4, contentLength);
+        c.in.erase(0, headerEnd + 4 + contentLength);
+        c.closeAfterWrite = !keepAlive;
+        stats.requests++;
+
+        if (head.compare(0, 5, "POST ") == 0) {
+            int stored = ingest(body, store, stats, records);
+            if (stored < 0) {
+                stats.rejected++;
+                respond(c, 400, "Bad Request", "no data field\n");
+            } else {
+                respond(c, 200, "OK", std::to_string(stored) + "\n");
+            }
+        } else if (head.compare(0, 11, "GET /stats ") == 0) {
+            char json[256];
+            snprintf(json, sizeof(json), "{\"requests\":%llu,\"events\":%llu,\"records\":%llu,\"rejected\":%llu}\n",
+                stats.requests, stats.events, stats.records, stats.rejected);
+            respond(c, 200, "OK", json, "application/json");
+        } else {
+            respond(c, 404, "Not Found", "");
+        }
+    }
+}
+
+static void onSignal(int) {
+    stopRequested = 1;
+}
+
+int main(int argc, char** argv) {
+    int port = 8080;
+    std::string storeDirectory = "hublog_store";
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+            port = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+            storeDirectory = argv[++i];
+        } else {
+            fprintf(stderr, "usage: %s [-p port] [-d storeDirectory]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    tpp_ColumnStoreWriter store;
+    if (!store.open(storeDirectory)) {
+        fprintf(stderr, "cannot open store %s\n", storeDirectory.c_str());
+        return 1;
+    }
+
+    int listener = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    int one = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(port);
+    if (bind(listener, (struct sockaddr*) &address, sizeof(address)) != 0 || listen(listener, 128) != 0) {
+        perror("listen");
+        return 1;
+    }
+
+    int epoll = epoll_create1(0);
+    struct epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.fd = listener;
+    epoll_ctl(epoll, EPOLL_CTL_ADD, listener, &ev);
+
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+    signal(SIGPIPE, SIG_IGN);
+
+    printf("hub_log_ingest listening on port %d, store %s\n", port, storeDirectory.c_str());
+    fflush(stdout);
+
+    std::unordered_map<int, Connection> connections;
+    std::vector<tpp_HubLogRecord> records;
+    Stats stats;
+    int64_t lastSyncMS = nowMS();
+    struct epoll_event events[64];
+    char buffer[65536];
+
+    while (!stopRequested) {
+        int n = epoll_wait(epoll, events, 64, SYNC_INTERVAL_MS);
+        for (int i = 0; i < n; i++) {
+            int fd = events[i].data.fd;
+            if (fd == listener) {
+                int client;
+                while ((client = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK)) >= 0) {
+                    setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                    struct epoll_event cev = {};
+                    cev.events = EPOLLIN;
+                    cev.data.fd = client;
+                    epoll_ctl(epoll, EPOLL_CTL_ADD, client, &cev);
+                    connections[client];
+                }
+                continue;
+            }
+
+            Connection& c = connections[fd];
+            bool closeNow = false;
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                while (true) {
+                    ssize_t got = read(fd, buffer, sizeof(buffer));
+                    if (got > 0) {
+                        c.in.append(buffer, got);
+                    } else if (got == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+                        closeNow = true;
+                        break;
+                    } else {
+                        break;
+                    }
+                }
+                processInput(c, store, stats, records);
+            }
+            if (!c.out.empty()) {
+                ssize_t sent = write(fd, c.out.data(), c.out.size());
+                if (sent > 0) {
+                    c.out.erase(0, sent);
+                } else if (sent < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+                    closeNow = true;
+                }
+            }
+            if (c.out.empty() && c.closeAfterWrite) {
+                closeNow = true;
+            }
+            if (closeNow) {
+                epoll_ctl(epoll, EPOLL_CTL_DEL, fd, nullptr);
+                close(fd);
+                connections.erase(fd);
+            } else {
+                // only ask for writable when there is something to write
+                struct epoll_event cev = {};
+                cev.events = EPOLLIN | (c.out.empty() ? 0u : (uint32_t) EPOLLOUT);
+                cev.data.fd = fd;
+                epoll_ctl(epoll, EPOLL_CTL_MOD, fd, &cev);
+            }
+        }
+
+        if (nowMS() - lastSyncMS >= SYNC_INTERVAL_MS) {
+            store.sync();
+            lastSyncMS = nowMS();
+        }
+    }
+
+    store.close();
+    printf("stopped: %llu requests, %llu events, %llu records\n", stats.requests, stats.events, stats.records);
+    return 0;
+}
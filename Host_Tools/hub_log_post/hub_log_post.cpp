@@ -0,0 +1,173 @@
+/*
+    hub_log_post.cpp - stand-in for the Particle cloud: POSTs LoRaHubLogging webhook requests
+    created by Bob Glicksman and Jim Schrempp
+    as part of Team Practical Projects (tpp)
+
+    20261018 - first version
+
+    Sends the same form the Particle webhook sends (event, data, coreid, published_at)
+    to hub_log_ingest, or anything else that accepts it, and reports the rate.  The
+    data is made-up compact format batches (see tpp_HubLogFormat.h) from a number of
+    sensors, each counting its "m: N" message number up.
+
+    Build:
+        g++ -std=c++17 -O2 -pthread -o hub_log_post hub_log_post.cpp
+
+    Run:
+        ./hub_log_post [-h host] [-p port] [-n events] [-c connections] [-r recordsPerEvent] [-s sensors]
+        defaults: 127.0.0.1 8080 10000 4 1 8
+*/
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+struct Options {
+    std::string host = "127.0.0.1";
+    int port = 8080;
+    long events = 10000;
+    int connections = 4;
+    int recordsPerEvent = 1;
+    int sensors = 8;
+};
+
+static std::string urlEncode(const std::string& text) {
+    static const char hex[] = "0123456789ABCDEF";
+    std::string out;
+    for (unsigned char c : text) {
+        if (isalnum(c) || c == '-' || c == '_' || c == '.' || c == '~') {
+            out += (char) c;
+        } else {
+            out += '%';
+            out += hex[c >> 4];
+            out += hex[c & 15];
+        }
+    }
+    return out;
+}
+
+static int connectTo(const Options& options) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    struct sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(options.port);
+    inet_pton(AF_INET, options.host.c_str(), &address.sin_addr);
+    if (connect(fd, (struct sockaddr*) &address, sizeof(address)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// read one HTTP response; returns the status code, -1 if the connection failed
+static int readResponse(int fd, std::string& buffer) {
+    char chunk[4096];
+    while (true) {
+        size_t headerEnd = buffer.find("\r\n\r\n");
+        if (headerEnd != std::string::npos) {
+            size_t length = 0;
+            const char* cl = strcasestr(buffer.c_str(), "Content-Length:");
+            if (cl && (size_t) (cl - buffer.c_str()) < headerEnd) {
+                length = strtoul(cl + 15, nullptr, 10);
+            }
+            if (buffer.size() >= headerEnd + 4 + length) {
+                int status = atoi(buffer.c_str() + 9);
+                buffer.erase(0, headerEnd + 4 + length);
+                return status;
+            }
+        }
+        ssize_t got = read(fd, chunk, sizeof(chunk));
+        if (got <= 0) {
+            return -1;
+        }
+        buffer.append(chunk, got);
+    }
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "-h") == 0) options.host = argv[i + 1];
+        else if (strcmp(argv[i], "-p") == 0) options.port = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-n") == 0) options.events = atol(argv[i + 1]);
+        else if (strcmp(argv[i], "-c") == 0) options.connections = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-r") == 0) options.recordsPerEvent = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-s") == 0) options.sensors = atoi(argv[i + 1]);
+        else {
+            fprintf(stderr, "usage: %s [-h host] [-p port] [-n events] [-c connections] [-r recordsPerEvent] [-s sensors]\n",
+                argv[0]);
+            return 2;
+        }
+    }
+    if (options.connections < 1 || options.sensors < 1 || options.recordsPerEvent < 1) {
+        fprintf(stderr, "connections, sensors and recordsPerEvent must be at least 1\n");
+        return 2;
+    }
+
+    std::atomic<long> nextEvent(0);
+    std::atomic<long> succeeded(0);
+    std::atomic<long> failed(0);
+    auto start = std::chrono::steady_clock::now();
+    long baseTime = (long) time(nullptr);
+
+    std::vector<std::thread> workers;
+    for (int w = 0; w < options.connections; w++) {
+        workers.emplace_back([&, w]() {
+            int fd = connectTo(options);
+            if (fd < 0) {
+                perror("connect");
+                return;
+            }
+            std::string response;
+            std::string request;
+            long event;
+            while ((event = nextEvent++) < options.events) {
+                // one batch: recordsPerEvent records from consecutive sensors
+                std::string data = "1|" + std::to_string(baseTime + event / 100) + "|";
+                for (int r = 0; r < options.recordsPerEvent; r++) {
+                    long n = event * options.recordsPerEvent + r;
+                    int sensor = 5 + (int) (n % options.sensors);
+                    long seq = n / options.sensors + 1;
+                    if (r) data += ';';
+                    data += std::to_string(r * 40) + ",A," + std::to_string(sensor) + "," + std::to_string((int) (n % 21) - 10)
+                        + "," + std::to_string(-40 - (int) (n % 60)) + ",G m: " + std::to_string(seq);
+                }
+                time_t t = baseTime + event / 100;
+                char published[32];
+                strftime(published, sizeof(published), "%Y-%m-%dT%H:%M:%S.000Z", gmtime(&t));
+                std::string body = "event=LoRaHubLogging&data=" + urlEncode(data) + "&coreid=stand_in_" + std::to_string(w)
+                    + "&published_at=" + urlEncode(published);
+                request = "POST / HTTP/1.1\r\nHost: " + options.host + "\r\nContent-Type: application/x-www-form-urlencoded\r\n"
+                    "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+                if (write(fd, request.data(), request.size()) != (ssize_t) request.size() || readResponse(fd, response) != 200) {
+                    failed++;
+                } else {
+                    succeeded++;
+                }
+            }
+            close(fd);
+        });
+    }
+    for (auto& t : workers) {
+        t.join();
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("%ld events (%ld records) in %.2f s: %.0f events/s, %.0f records/s, %ld failed\n",
+        succeeded.load(), succeeded.load() * options.recordsPerEvent, seconds, succeeded / seconds,
+        succeeded * options.recordsPerEvent / seconds, failed.load());
+    return failed ? 1 : 0;
+}
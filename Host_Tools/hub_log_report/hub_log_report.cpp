@@ -0,0 +1,650 @@
+/*
+    hub_log_report.cpp - range and reliability report from hub logs
+    created by Bob Glicksman and Jim Schrempp
+    as part of Team Practical Projects (tpp)
+
+    20261018 - first version
+
+    Reads hub log records, either from a hub_log_ingest column store or from text
+    files with one LoRaHubLogging event per line, and reports for each sensor:
+
+        packet delivery ratio (PDR), from the "m: N" message numbers in the payloads
+        SNR and RSSI distributions (1 dB bins)
+        PDR against SNR
+        received and lost messages by hour of the day
+        a recommended spreading factor and power (CRFOP)
+
+    as JSON on stdout, or as CSV files for plotting.  Device "all" is every sensor together.
+
+    Message numbers start at 1 when a sensor boots, so a number lower than the last
+    one starts a new session.  A repeated number is a duplicate and is not counted.
+    Messages missing from a gap are lost; they are counted in the SNR bin of the
+    message after the gap and spread evenly over the time of the gap for the hours.
+
+    The store is read a column at a time straight from the mapped files.  Each block
+    of rows is first reduced to bin numbers in simple loops over the columns (the
+    compiler vectorizes these), then a second loop updates the per-sensor counts.
+    Payloads are only read for the "p:" message that carries the sensor's settings.
+
+    Build:
+        g++ -std=c++17 -O3 -march=native -o hub_log_report hub_log_report.cpp
+
+    Run:
+        ./hub_log_report [options] [textFile ...]
+            -d dir      column store written by hub_log_ingest
+            -f day      first day to read from the store, YYYY-MM-DD (UTC)
+            -l day      last day to read from the store, YYYY-MM-DD (UTC)
+            -z hours    offset of local time from UTC for the hour of day, e.g. -8; default 0
+            -s SF       spreading factor the sensors use, if their logs do not say; default 9
+            -P power    CRFOP the sensors use; default 22
+            -m dB       SNR margin wanted above the demodulation floor; default 6
+            -c dir      write summary.csv, snr.csv, rssi.csv and hours.csv to dir instead of JSON
+
+        Text files (or - for stdin) have one event's data per line, compact or original
+        format, optionally after the published_at time and a tab or space:
+            2026-10-18T17:00:00.000Z	1|1792342800|0,A,6,11,-40,G m: 5
+*/
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include "../common/tpp_HubLogDecode.h"
+#include "../common/tpp_ColumnStore.h"
+
+#define BLOCK_ROWS 4096
+#define SNR_MIN -32           // RYLR998 reports about -20 to +20
+#define SNR_BINS 64
+#define RSSI_MIN -160
+#define RSSI_BINS 160
+#define MAX_GAP 100000        // a larger jump in message number is taken as a new session
+#define MIN_FOR_ADVICE 20     // received messages needed before recommending settings
+#define DEVICE_COUNT 65536    // LoRa addresses are 0 - 65535
+
+#define SF_LOWEST 7
+#define SF_HIGHEST 11
+#define CRFOP_LOWEST 0
+#define CRFOP_HIGHEST 22
+
+struct Options {
+    std::string storeDir;
+    std::string firstDay;
+    std::string lastDay;
+    std::string csvDir;
+    std::vector<std::string> textFiles;
+    int tzOffsetHours = 0;
+    int SF = 9;
+    int power = 22;
+    double marginDB = 6.0;
+};
+
+struct DeviceStats {
+    int deviceNum = 0;
+    long received = 0;
+    long lost = 0;
+    long duplicates = 0;
+    long sessions = 0;
+    long noSequence = 0;        // frames without a message number
+    int lastSeq = -1;
+    int lastHour = 0;
+    int64_t lastTimeMS = 0;
+    int64_t firstTimeMS = INT64_MAX;
+    int SF = 0;                 // from the sensor's "p:" message; 0 if not seen
+    int bandwidth = 0;
+    uint32_t snrReceived[SNR_BINS] = {};
+    uint32_t snrLost[SNR_BINS] = {};
+    uint32_t rssi[RSSI_BINS] = {};
+    uint32_t hourReceived[24] = {};
+    uint32_t hourLost[24] = {};
+
+    void add(const DeviceStats& d) {
+        received += d.received;
+        lost += d.lost;
+        duplicates += d.duplicates;
+        sessions += d.sessions;
+        noSequence += d.noSequence;
+        firstTimeMS = std::min(firstTimeMS, d.firstTimeMS);
+        lastTimeMS = std::max(lastTimeMS, d.lastTimeMS);
+        for (int i = 0; i < SNR_BINS; i++) {
+            snrReceived[i] += d.snrReceived[i];
+            snrLost[i] += d.snrLost[i];
+        }
+        for (int i = 0; i < RSSI_BINS; i++) {
+            rssi[i] += d.rssi[i];
+        }
+        for (int h = 0; h < 24; h++) {
+            hourReceived[h] += d.hourReceived[h];
+            hourLost[h] += d.hourLost[h];
+        }
+    }
+};
+
+// a block of rows, as pointers into the store or into vectors filled from text
+struct Columns {
+    size_t rows = 0;
+    const int64_t* timeMS;
+    const int32_t* device;
+    const int32_t* seq;
+    const int16_t* SNR;
+    const int16_t* RSSI;
+    const uint8_t* code;
+};
+
+class Report {
+public:
+    explicit Report(const Options& options) : options(options), devices(DEVICE_COUNT, nullptr) {}
+
+    ~Report() {
+        for (DeviceStats* d : devices) {
+            delete d;
+        }
+    }
+
+    // getPayload(i) returns the payload of row i of the block
+    template <typename PayloadFn> void aggregate(const Columns& c, PayloadFn getPayload) {
+        int64_t tzMS = (int64_t) options.tzOffsetHours * 3600000;
+        for (size_t start = 0; start < c.rows; start += BLOCK_ROWS) {
+            size_t n = std::min((size_t) BLOCK_ROWS, c.rows - start);
+
+            // column at a time: bins for the whole block
+            for (size_t i = 0; i < n; i++) {
+                int b = c.SNR[start + i] - SNR_MIN;
+                snrBin[i] = (uint8_t) (b < 0 ? 0 : b >= SNR_BINS ? SNR_BINS - 1 : b);
+            }
+            for (size_t i = 0; i < n; i++) {
+                int b = c.RSSI[start + i] - RSSI_MIN;
+                rssiBin[i] = (uint8_t) (b < 0 ? 0 : b >= RSSI_BINS ? RSSI_BINS - 1 : b);
+            }
+            for (size_t i = 0; i < n; i++) {
+                int64_t hours = (c.timeMS[start + i] + tzMS) / 3600000;
+                hour[i] = (uint8_t) (((hours % 24) + 24) % 24);
+            }
+            for (size_t i = 0; i < n; i++) {
+                usable[i] = c.seq[start + i] >= 0 && tpp_hubLogIsSensorFrame(c.code[start + i]);
+            }
+
+            // then the per-sensor sequence tracking, row by row
+            for (size_t i = 0; i < n; i++) {
+                size_t row = start + i;
+                DeviceStats& d = device(c.device[row]);
+                if (!usable[i]) {
+                    if (tpp_hubLogIsSensorFrame(c.code[row])) {
+                        d.noSequence++;
+                    }
+                    continue;
+                }
+                int seq = c.seq[row];
+                int64_t t = c.timeMS[row];
+                if (seq == d.lastSeq) {
+                    d.duplicates++;
+                    continue;
+                }
+                if (d.lastSeq < 0 || seq < d.lastSeq || seq - d.lastSeq > MAX_GAP) {
+                    d.sessions++;
+                } else if (seq > d.lastSeq + 1) {
+                    long gap = seq - d.lastSeq - 1;
+                    d.lost += gap;
+                    d.snrLost[snrBin[i]] += (uint32_t) gap;
+                    spreadLoss(d, gap, d.lastTimeMS, t, tzMS);
+                }
+                if (seq == 2) {
+                    readSettings(d, getPayload(row));
+                }
+                d.received++;
+                d.snrReceived[snrBin[i]]++;
+                d.rssi[rssiBin[i]]++;
+                d.hourReceived[hour[i]]++;
+                d.lastSeq = seq;
+                d.lastHour = hour[i];
+                d.lastTimeMS = t;
+                d.firstTimeMS = std::min(d.firstTimeMS, t);
+            }
+            rowsRead += n;
+        }
+    }
+
+    bool readStore() {
+        std::string first = options.firstDay.empty() ? "" : options.storeDir + "/" + options.firstDay;
+        std::string last = options.lastDay.empty() ? "" : options.storeDir + "/" + options.lastDay;
+        std::vector<std::string> partitions = tpp_storePartitions(options.storeDir);
+        if (partitions.empty()) {
+            fprintf(stderr, "no partitions in %s\n", options.storeDir.c_str());
+            return false;
+        }
+        for (const std::string& dir : partitions) {
+            if ((!first.empty() && dir < first) || (!last.empty() && dir > last)) {
+                continue;
+            }
+            tpp_StorePartition p;
+            if (!p.open(dir, false)) {
+                fprintf(stderr, "cannot read %s\n", dir.c_str());
+                continue;
+            }
+            Columns c;
+            c.rows = p.rows();
+            if (c.rows == 0) {
+                continue;
+            }
+            c.timeMS = p.column<int64_t>(tpp_StorePartition::TIME);
+            c.device = p.column<int32_t>(tpp_StorePartition::DEVICE);
+            c.seq = p.column<int32_t>(tpp_StorePartition::SEQ);
+            c.SNR = p.column<int16_t>(tpp_StorePartition::SNR);
+            c.RSSI = p.column<int16_t>(tpp_StorePartition::RSSI);
+            c.code = p.column<uint8_t>(tpp_StorePartition::CODE);
+            aggregate(c, [&p](size_t row) { return p.payload(row); });
+        }
+        return true;
+    }
+
+    bool readText(const std::string& path) {
+        FILE* f = path == "-" ? stdin : fopen(path.c_str(), "r");
+        if (!f) {
+            perror(path.c_str());
+            return false;
+        }
+        std::vector<int64_t> timeMS;
+        std::vector<int32_t> device, seq;
+        std::vector<int16_t> SNR, RSSI;
+        std::vector<uint8_t> code;
+        std::vector<std::string> payloads;
+        std::vector<tpp_HubLogRecord> records;
+
+        auto flush = [&]() {
+            Columns c;
+            c.rows = timeMS.size();
+            c.timeMS = timeMS.data();
+            c.device = device.data();
+            c.seq = seq.data();
+            c.SNR = SNR.data();
+            c.RSSI = RSSI.data();
+            c.code = code.data();
+            aggregate(c, [&payloads](size_t row) { return payloads[row]; });
+            timeMS.clear(); device.clear(); seq.clear(); SNR.clear(); RSSI.clear(); code.clear(); payloads.clear();
+        };
+
+        char* line = nullptr;
+        size_t capacity = 0;
+        ssize_t length;
+        while ((length = getline(&line, &capacity, f)) > 0) {
+            std::string text(line, length);
+            while (!text.empty() && (text.back() == '\n' || text.back() == '\r')) text.pop_back();
+
+            // optional published_at in front
+            int64_t publishedMS = -1;
+            size_t split = text.find_first_of("\t ");
+            if (split != std::string::npos && text.size() > 20 && text[4] == '-' && text[10] == 'T') {
+                publishedMS = tpp_parseIsoTimeMS(text.substr(0, split));
+                text.erase(0, split + 1);
+            }
+            records.clear();
+            if (tpp_decodeHubLog(text, records, publishedMS) == 0) {
+                badLines++;
+                continue;
+            }
+            for (const tpp_HubLogRecord& r : records) {
+                timeMS.push_back(r.timeMS >= 0 ? r.timeMS : publishedMS >= 0 ? publishedMS : 0);
+                device.push_back(r.deviceNum);
+                seq.push_back(tpp_payloadSequence(r.payload));
+                SNR.push_back((int16_t) r.SNR);
+                RSSI.push_back((int16_t) r.RSSI);
+                code.push_back((uint8_t) r.code);
+                payloads.push_back(r.payload);
+            }
+            if (timeMS.size() >= BLOCK_ROWS) {
+                flush();
+            }
+        }
+        flush();
+        free(line);
+        if (f != stdin) {
+            fclose(f);
+        }
+        return true;
+    }
+
+    // the sensors seen, lowest address first, then "all"
+    std::vector<const DeviceStats*> summary() {
+        std::vector<const DeviceStats*> list;
+        for (DeviceStats* d : devices) {
+            if (d && (d->received || d->noSequence)) {
+                list.push_back(d);
+                all.add(*d);
+            }
+        }
+        all.deviceNum = -1;
+        list.push_back(&all);
+        return list;
+    }
+
+    unsigned long long rowsRead = 0;
+    long badLines = 0;
+
+private:
+    DeviceStats& device(int deviceNum) {
+        unsigned int i = (unsigned int) deviceNum % DEVICE_COUNT;
+        if (!devices[i]) {
+            devices[i] = new DeviceStats;
+            devices[i]->deviceNum = deviceNum;
+        }
+        return *devices[i];
+    }
+
+    // the hours a gap of lost messages fell in, assuming they were sent evenly across it
+    static void spreadLoss(DeviceStats& d, long gap, int64_t fromMS, int64_t toMS, int64_t tzMS) {
+        int64_t span = toMS - fromMS;
+        if (span <= 0 || span < 3600000) {
+            d.hourLost[d.lastHour] += (uint32_t) gap;    // within the hour; cheap path
+            return;
+        }
+        for (long k = 1; k <= gap; k++) {
+            int64_t t = fromMS + span * k / (gap + 1) + tzMS;
+            d.hourLost[(((t / 3600000) % 24) + 24) % 24]++;
+        }
+    }
+
+    // "G m: 2 p: LoRa parameters = SF:BW:CR:preamble"
+    static void readSettings(DeviceStats& d, const std::string& payload) {
+        size_t at = payload.find("parameters = ");
+        int SF, bandwidth;
+        if (at != std::string::npos && sscanf(payload.c_str() + at + 13, "%d:%d", &SF, &bandwidth) == 2) {
+            d.SF = SF;
+            d.bandwidth = bandwidth;
+        }
+    }
+
+    const Options& options;
+    std::vector<DeviceStats*> devices;
+    DeviceStats all;
+    uint8_t snrBin[BLOCK_ROWS];
+    uint8_t rssiBin[BLOCK_ROWS];
+    uint8_t hour[BLOCK_ROWS];
+    uint8_t usable[BLOCK_ROWS];
+};
+
+// ---------------- results ----------------
+
+struct Advice {
+    bool valid = false;
+    int SF = 0;
+    int power = 0;
+    double snrP10 = 0;
+    double marginDB = 0;       // p10 SNR above the floor of the sensor's current SF
+    int recommendedSF = 0;
+    int recommendedPower = 0;
+    std::string note;
+};
+
+// SNR below which an SF can no longer be received, 125 kHz (Semtech SX1262 data sheet)
+static double snrFloor(int SF) {
+    return -7.5 - 2.5 * (SF - 7);
+}
+
+// the value below which fraction of the counts fall, from a histogram with 1 unit bins
+static double percentile(const uint32_t* bins, int count, int lowest, double fraction) {
+    uint64_t total = 0;
+    for (int i = 0; i < count; i++) total += bins[i];
+    if (total == 0) {
+        return NAN;
+    }
+    uint64_t target = (uint64_t) ceil(total * fraction);
+    uint64_t sum = 0;
+    for (int i = 0; i < count; i++) {
+        sum += bins[i];
+        if (sum >= target && bins[i]) {
+            return lowest + i;
+        }
+    }
+    return lowest + count - 1;
+}
+
+static double mean(const uint32_t* bins, int count, int lowest) {
+    double sum = 0, total = 0;
+    for (int i = 0; i < count; i++) {
+        sum += (double) bins[i] * (lowest + i);
+        total += bins[i];
+    }
+    return total ? sum / total : NAN;
+}
+
+static double pdr(double received, double lost) {
+    return received + lost > 0 ? received / (received + lost) : NAN;
+}
+
+// Lowest SF that keeps the 10th percentile SNR the wanted margin above its floor.
+// SNR is measured before despreading, so it does not change with SF.  If SF 11 is not
+// enough, make up the rest with power; if SF 7 leaves extra margin, give some power back.
+static Advice advise(const DeviceStats& d, const Options& options) {
+    Advice a;
+    a.SF = d.SF ? d.SF : options.SF;
+    a.power = options.power;
+    if (d.received < MIN_FOR_ADVICE) {
+        a.note = "too few messages";
+        return a;
+    }
+    a.valid = true;
+    a.snrP10 = percentile(d.snrReceived, SNR_BINS, SNR_MIN, 0.10);
+    a.marginDB = a.snrP10 - snrFloor(a.SF);
+    double ratio = pdr(d.received, d.lost);
+
+    a.recommendedSF = SF_HIGHEST;
+    for (int SF = SF_LOWEST; SF <= SF_HIGHEST; SF++) {
+        if (a.snrP10 - snrFloor(SF) >= options.marginDB) {
+            a.recommendedSF = SF;
+            break;
+        }
+    }
+    double extra = a.snrP10 - snrFloor(a.recommendedSF) - options.marginDB;
+    a.recommendedPower = a.power;
+    if (extra < 0) {
+        a.recommendedPower = std::min(CRFOP_HIGHEST, a.power + (int) ceil(-extra));
+        if (a.power + ceil(-extra) > CRFOP_HIGHEST) {
+            a.note = "out of range even at SF 11 and full power";
+        }
+    } else if (a.recommendedSF == SF_LOWEST && ratio >= 0.95) {
+        // only received messages have an SNR, so trust the extra margin only when little is lost
+        a.recommendedPower = std::max(CRFOP_LOWEST, a.power - (int) floor(extra));
+    }
+    if (ratio < 0.90 && a.marginDB >= options.marginDB) {
+        a.note = "losses with good SNR: look for collisions or interference, not range";
+    }
+    return a;
+}
+
+static std::string deviceName(const DeviceStats& d) {
+    return d.deviceNum < 0 ? "all" : std::to_string(d.deviceNum);
+}
+
+static std::string number(double value, const char* format = "%.4g") {
+    if (std::isnan(value)) {
+        return "null";
+    }
+    char text[32];
+    snprintf(text, sizeof(text), format, value);
+    return text;
+}
+
+static std::string isoTime(int64_t ms) {
+    if (ms == INT64_MAX || ms <= 0) {
+        return "";
+    }
+    time_t t = (time_t) (ms / 1000);
+    struct tm tmUTC;
+    gmtime_r(&t, &tmUTC);
+    char text[32];
+    strftime(text, sizeof(text), "%Y-%m-%dT%H:%M:%SZ", &tmUTC);
+    return text;
+}
+
+static void writeJSON(const std::vector<const DeviceStats*>& list, const Options& options, FILE* out) {
+    fprintf(out, "{\"marginDB\":%g,\"devices\":[\n", options.marginDB);
+    for (size_t n = 0; n < list.size(); n++) {
+        const DeviceStats& d = *list[n];
+        Advice a = advise(d, options);
+        fprintf(out, "{\"device\":\"%s\",\"first\":\"%s\",\"last\":\"%s\",\"received\":%ld,\"lost\":%ld,"
+            "\"duplicates\":%ld,\"sessions\":%ld,\"noSequence\":%ld,\"pdr\":%s,\n",
+            deviceName(d).c_str(), isoTime(d.firstTimeMS).c_str(), isoTime(d.lastTimeMS).c_str(), d.received, d.lost,
+            d.duplicates, d.sessions, d.noSequence, number(pdr(d.received, d.lost)).c_str());
+        fprintf(out, " \"snrP10\":%s,\"snrMedian\":%s,\"snrMean\":%s,\"rssiP10\":%s,\"rssiMedian\":%s,\"rssiMean\":%s,\n",
+            number(percentile(d.snrReceived, SNR_BINS, SNR_MIN, 0.1)).c_str(),
+            number(percentile(d.snrReceived, SNR_BINS, SNR_MIN, 0.5)).c_str(),
+            number(mean(d.snrReceived, SNR_BINS, SNR_MIN)).c_str(),
+            number(percentile(d.rssi, RSSI_BINS, RSSI_MIN, 0.1)).c_str(),
+            number(percentile(d.rssi, RSSI_BINS, RSSI_MIN, 0.5)).c_str(),
+            number(mean(d.rssi, RSSI_BINS, RSSI_MIN)).c_str());
+        if (d.deviceNum >= 0) {
+            fprintf(out, " \"advice\":{\"valid\":%s,\"SF\":%d,\"power\":%d,\"marginDB\":%s,"
+                "\"recommendedSF\":%d,\"recommendedPower\":%d,\"note\":\"%s\"},\n",
+                a.valid ? "true" : "false", a.SF, a.power, number(a.valid ? a.marginDB : NAN).c_str(),
+                a.recommendedSF, a.recommendedPower, a.note.c_str());
+        }
+
+        // [snr, received, lost, pdr] for the bins with anything in them
+        fprintf(out, " \"snr\":[");
+        bool first = true;
+        for (int i = 0; i < SNR_BINS; i++) {
+            if (d.snrReceived[i] || d.snrLost[i]) {
+                fprintf(out, "%s[%d,%u,%u,%s]", first ? "" : ",", SNR_MIN + i, d.snrReceived[i], d.snrLost[i],
+                    number(pdr(d.snrReceived[i], d.snrLost[i])).c_str());
+                first = false;
+            }
+        }
+        fprintf(out, "],\n \"rssi\":[");
+        first = true;
+        for (int i = 0; i < RSSI_BINS; i++) {
+            if (d.rssi[i]) {
+                fprintf(out, "%s[%d,%u]", first ? "" : ",", RSSI_MIN + i, d.rssi[i]);
+                first = false;
+            }
+        }
+        // [hour, received, lost, pdr], all 24
+        fprintf(out, "],\n \"hours\":[");
+        for (int h = 0; h < 24; h++) {
+            fprintf(out, "%s[%d,%u,%u,%s]", h ? "," : "", h, d.hourReceived[h], d.hourLost[h],
+                number(pdr(d.hourReceived[h], d.hourLost[h])).c_str());
+        }
+        fprintf(out, "]}%s\n", n + 1 < list.size() ? "," : "");
+    }
+    fprintf(out, "]}\n");
+}
+
+static bool writeCSV(const std::vector<const DeviceStats*>& list, const Options& options) {
+    mkdir(options.csvDir.c_str(), 0755);
+    std::string dir = options.csvDir + "/";
+    FILE* summary = fopen((dir + "summary.csv").c_str(), "w");
+    FILE* snr = fopen((dir + "snr.csv").c_str(), "w");
+    FILE* rssi = fopen((dir + "rssi.csv").c_str(), "w");
+    FILE* hours = fopen((dir + "hours.csv").c_str(), "w");
+    if (!summary || !snr || !rssi || !hours) {
+        perror(options.csvDir.c_str());
+        return false;
+    }
+    fprintf(summary, "device,first,last,received,lost,duplicates,sessions,pdr,snrP10,snrMedian,rssiP10,rssiMedian,"
+        "SF,power,marginDB,recommendedSF,recommendedPower,note\n");
+    fprintf(snr, "device,snr,received,lost,pdr\n");
+    fprintf(rssi, "device,rssi,count\n");
+    fprintf(hours, "device,hour,received,lost,pdr\n");
+    for (const DeviceStats* p : list) {
+        const DeviceStats& d = *p;
+        std::string name = deviceName(d);
+        Advice a = advise(d, options);
+        bool show = d.deviceNum >= 0 && a.valid;
+        fprintf(summary, "%s,%s,%s,%ld,%ld,%ld,%ld,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s\n", name.c_str(),
+            isoTime(d.firstTimeMS).c_str(), isoTime(d.lastTimeMS).c_str(), d.received, d.lost, d.duplicates, d.sessions,
+            number(pdr(d.received, d.lost)).c_str(),
+            number(percentile(d.snrReceived, SNR_BINS, SNR_MIN, 0.1)).c_str(),
+            number(percentile(d.snrReceived, SNR_BINS, SNR_MIN, 0.5)).c_str(),
+            number(percentile(d.rssi, RSSI_BINS, RSSI_MIN, 0.1)).c_str(),
+            number(percentile(d.rssi, RSSI_BINS, RSSI_MIN, 0.5)).c_str(),
+            d.deviceNum >= 0 ? std::to_string(a.SF).c_str() : "",
+            d.deviceNum >= 0 ? std::to_string(a.power).c_str() : "",
+            show ? number(a.marginDB).c_str() : "",
+            show ? std::to_string(a.recommendedSF).c_str() : "",
+            show ? std::to_string(a.recommendedPower).c_str() : "",
+            a.note.c_str());
+        for (int i = 0; i < SNR_BINS; i++) {
+            if (d.snrReceived[i] || d.snrLost[i]) {
+                fprintf(snr, "%s,%d,%u,%u,%s\n", name.c_str(), SNR_MIN + i, d.snrReceived[i], d.snrLost[i],
+                    number(pdr(d.snrReceived[i], d.snrLost[i])).c_str());
+            }
+        }
+        for (int i = 0; i < RSSI_BINS; i++) {
+            if (d.rssi[i]) {
+                fprintf(rssi, "%s,%d,%u\n", name.c_str(), RSSI_MIN + i, d.rssi[i]);
+            }
+        }
+        for (int h = 0; h < 24; h++) {
+            fprintf(hours, "%s,%d,%u,%u,%s\n", name.c_str(), h, d.hourReceived[h], d.hourLost[h],
+                number(pdr(d.hourReceived[h], d.hourLost[h])).c_str());
+        }
+    }
+    fclose(summary);
+    fclose(snr);
+    fclose(rssi);
+    fclose(hours);
+    return true;
+}
+
+static void usage(const char* name) {
+    fprintf(stderr, "usage: %s [-d storeDir] [-f firstDay] [-l lastDay] [-z tzHours] [-s SF] [-P power] [-m marginDB]"
+        " [-c csvDir] [textFile ...]\n", name);
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        if (arg[0] == '-' && arg[1] && arg[2] == 0 && i + 1 < argc) {
+            const char* value = argv[++i];
+            switch (arg[1]) {
+                case 'd': options.storeDir = value; break;
+                case 'f': options.firstDay = value; break;
+                case 'l': options.lastDay = value; break;
+                case 'z': options.tzOffsetHours = atoi(value); break;
+                case 's': options.SF = atoi(value); break;
+                case 'P': options.power = atoi(value); break;
+                case 'm': options.marginDB = atof(value); break;
+                case 'c': options.csvDir = value; break;
+                default: usage(argv[0]); return 2;
+            }
+        } else if (arg[0] == '-' && arg[1]) {
+            usage(argv[0]);
+            return 2;
+        } else {
+            options.textFiles.push_back(arg);
+        }
+    }
+    if (options.storeDir.empty() && options.textFiles.empty()) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    Report report(options);
+    if (!options.storeDir.empty() && !report.readStore()) {
+        return 1;
+    }
+    for (const std::string& path : options.textFiles) {
+        if (!report.readText(path)) {
+            return 1;
+        }
+    }
+    std::vector<const DeviceStats*> list = report.summary();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    fprintf(stderr, "%llu records from %zu sensors in %.2f s", report.rowsRead, list.size() - 1, seconds);
+    if (report.badLines) {
+        fprintf(stderr, ", %ld lines not understood", report.badLines);
+    }
+    fprintf(stderr, "\n");
+
+    if (!options.csvDir.empty()) {
+        return writeCSV(list, options) ? 0 : 1;
+    }
+    writeJSON(list, options, stdout);
+    return 0;
+}
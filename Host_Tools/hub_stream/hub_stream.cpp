@@ -0,0 +1,258 @@
+/*
+    hub_stream.cpp - subscribes to the hub's event stream on the local network
+    created by Bob Glicksman and Jim Schrempp
+    as part of Team Practical Projects (tpp)
+
+    20261018 - first version
+
+    Connects to the hub's EVENT_STREAM_PORT (tpp_EventStream) and reads the records of
+    tpp_EventStreamFormat.h.  By default it prints each record as it arrives, with the
+    delay from the hub's record time to now, and reports a jump in the sequence number
+    as missed records.  If the hub drops the connection it connects again.
+
+    With -c it is a benchmark instead: that many subscribers read for -t seconds and the
+    tool reports records per second, missed records, disconnects and the delay
+    percentiles.  The delay is this computer's clock less the hub's, so both clocks
+    should be set by NTP; the hub's ms within a second come from millis() and are good to
+    a few ms.  -w makes every subscriber wait between reads, to see slow subscribers being
+    dropped without holding up the others.
+
+    Build:
+        g++ -std=c++17 -O2 -pthread -o hub_stream hub_stream.cpp
+
+    Run:
+        ./hub_stream [-h host] [-p port] [-c subscribers] [-t seconds] [-w ms]
+        defaults: 192.168.1.50 5030, print records
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "../../Range_Testing/Range_Test_Hub/LoRaRangeTestHub/src/tpp_EventStreamFormat.h"
+
+struct Options {
+    std::string host = "192.168.1.50";
+    int port = 5030;
+    int subscribers = 0;        // 0: print records
+    int seconds = 10;
+    int waitMS = 0;
+};
+
+struct Record {
+    uint32_t seq;
+    uint64_t unixMS;
+    char kind;
+    int deviceNum;
+    int SNR;
+    int RSSI;
+    std::string payload;
+};
+
+struct Stats {
+    long records = 0;
+    long missed = 0;
+    long disconnects = 0;
+    std::vector<double> delayMS;
+};
+
+static std::atomic<bool> running(true);
+
+static uint64_t nowUnixMS() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+static int connectTo(const Options& options) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(options.port);
+    inet_pton(AF_INET, options.host.c_str(), &address.sin_addr);
+    if (connect(fd, (struct sockaddr*) &address, sizeof(address)) != 0) {
+        close(fd);
+        return -1;
+    }
+    // reads time out so the benchmark can stop
+    struct timeval timeout = {0, 200000};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    return fd;
+}
+
+// fills exactly n bytes; false if the connection closed or running was cleared
+static bool readFully(int fd, char* p, size_t n) {
+    while (n > 0) {
+        ssize_t got = read(fd, p, n);
+        if (got > 0) {
+            p += got;
+            n -= got;
+        } else if (got < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) && running) {
+            continue;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool parseRecord(const std::string& body, Record& r) {
+    const char* p = body.c_str();
+    char* end;
+    r.seq = strtoul(p, &end, 10);
+    if (*end != ',') return false;
+    r.unixMS = strtoull(end + 1, &end, 10);
+    if (*end != ',' || !end[1] || end[2] != ',') return false;
+    r.kind = end[1];
+    r.deviceNum = strtol(end + 3, &end, 10);
+    if (*end != ',') return false;
+    r.SNR = strtol(end + 1, &end, 10);
+    if (*end != ',') return false;
+    r.RSSI = strtol(end + 1, &end, 10);
+    if (*end != ',') return false;
+    r.payload = end + 1;
+    return true;
+}
+
+// one subscriber until running is cleared; with print, also until it fails to connect
+static void subscribe(const Options& options, bool print, Stats& stats) {
+    uint32_t lastSeq = 0;
+    bool haveSeq = false;
+    while (running) {
+        int fd = connectTo(options);
+        if (fd < 0) {
+            if (print) {
+                perror("connect");
+                return;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            continue;
+        }
+        unsigned char header[2];
+        std::string body;
+        while (running && readFully(fd, (char*) header, 2)) {
+            size_t length = (header[0] << 8) | header[1];
+            body.resize(length);
+            if (length > TPP_STREAM_MAX_BODY || !readFully(fd, &body[0], length)) {
+                break;
+            }
+            uint64_t arrivedMS = nowUnixMS();
+            Record r;
+            if (!parseRecord(body, r)) {
+                fprintf(stderr, "bad record: %s\n", body.c_str());
+                continue;
+            }
+            if (haveSeq && r.seq > lastSeq + (r.kind == TPP_STREAM_KIND_HELLO ? 0 : 1)) {
+                long gap = r.seq - lastSeq - (r.kind == TPP_STREAM_KIND_HELLO ? 0 : 1);
+                stats.missed += gap;
+                if (print) {
+                    printf("-- missed %ld records\n", gap);
+                }
+            }
+            haveSeq = true;
+            lastSeq = r.seq;
+            if (r.kind == TPP_STREAM_KIND_HELLO) {
+                if (print) {
+                    printf("-- connected to %s, last record %u\n", r.payload.c_str(), r.seq);
+                }
+                continue;
+            }
+            stats.records++;
+            double delay = r.unixMS ? (double) arrivedMS - (double) r.unixMS : 0;
+            if (r.unixMS) {
+                stats.delayMS.push_back(delay);
+            }
+            if (print) {
+                printf("%u %c %d %d %d %+.0f ms %s\n", r.seq, r.kind, r.deviceNum, r.SNR, r.RSSI, delay, r.payload.c_str());
+                fflush(stdout);
+            }
+            if (options.waitMS) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(options.waitMS));
+            }
+        }
+        close(fd);
+        if (running) {
+            stats.disconnects++;
+            if (print) {
+                printf("-- disconnected\n");
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+        }
+    }
+}
+
+static double percentile(const std::vector<double>& sorted, double p) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    return sorted[std::min(sorted.size() - 1, (size_t) (p * sorted.size()))];
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "-h") == 0) options.host = argv[i + 1];
+        else if (strcmp(argv[i], "-p") == 0) options.port = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-c") == 0) options.subscribers = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-t") == 0) options.seconds = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-w") == 0) options.waitMS = atoi(argv[i + 1]);
+        else {
+            fprintf(stderr, "usage: %s [-h host] [-p port] [-c subscribers] [-t seconds] [-w ms]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (argc % 2 == 0) {
+        fprintf(stderr, "usage: %s [-h host] [-p port] [-c subscribers] [-t seconds] [-w ms]\n", argv[0]);
+        return 2;
+    }
+
+    if (options.subscribers <= 0) {
+        Stats stats;
+        subscribe(options, true, stats);
+        return 1;
+    }
+
+    std::vector<Stats> stats(options.subscribers);
+    std::vector<std::thread> workers;
+    auto start = std::chrono::steady_clock::now();
+    for (int s = 0; s < options.subscribers; s++) {
+        workers.emplace_back([&, s]() { subscribe(options, false, stats[s]); });
+    }
+    std::this_thread::sleep_for(std::chrono::seconds(options.seconds));
+    running = false;
+    for (auto& t : workers) {
+        t.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    Stats total;
+    for (int s = 0; s < options.subscribers; s++) {
+        printf("subscriber %d: %ld records, %ld missed, %ld disconnects\n", s, stats[s].records, stats[s].missed,
+            stats[s].disconnects);
+        total.records += stats[s].records;
+        total.missed += stats[s].missed;
+        total.disconnects += stats[s].disconnects;
+        total.delayMS.insert(total.delayMS.end(), stats[s].delayMS.begin(), stats[s].delayMS.end());
+    }
+    std::sort(total.delayMS.begin(), total.delayMS.end());
+    printf("%ld records in %.1f s: %.0f records/s, %ld missed, %ld disconnects\n", total.records, seconds,
+        total.records / seconds, total.missed, total.disconnects);
+    printf("delay ms: p50 %.0f  p90 %.0f  p99 %.0f  max %.0f\n", percentile(total.delayMS, 0.5),
+        percentile(total.delayMS, 0.9), percentile(total.delayMS, 0.99),
+        total.delayMS.empty() ? 0 : total.delayMS.back());
+    return 0;
+}
@@ -0,0 +1,752 @@
+/*
+    lora_netsim.cpp - discrete event simulation of a LoRa network of trip sensors and hubs
+    created by Bob Glicksman and Jim Schrempp
+    as part of Team Practical Projects (tpp)
+
+    20261018 - first version
+
+    How many sensors can one hub take at a given radio profile and trip rate?  This
+    simulates sensors and hubs the way RangeTestSensor and LoRaRangeTestHub behave and
+    reports the fraction of trips delivered and the delay, for one setting or a sweep.
+
+    The model:
+
+        place       hubs on a circle of half the radius (one hub: the centre), sensors
+                    evenly over the disc.  A sensor belongs to the hub it hears best.
+        radio       received power = tx_dbm - path loss (log distance, pl_1m_db and
+                    path_loss_exp) - shadowing (per link, shadowing_sd) + fading (per
+                    frame and receiver, fading_sd).  Below the SX1262's sensitivity for
+                    the SF and bandwidth a frame is not heard.  Time on air is
+                    tpp_TimeOnAir.h, the same as tpp_LoRa::timeOnAirUS().
+        collisions  a receiver locks on the first frame it can hear.  A later frame takes
+                    it over if it is capture_db stronger and arrives during the locked
+                    frame's preamble; the locked frame survives one capture_db weaker;
+                    anything else between the two corrupts the locked frame.  Every frame
+                    is on the one channel, acks included.
+        sensors     a trip is queued (queue_size, as tpp_EventQueue) and sent after
+                    coalesce_ms with any others that came meanwhile.  With ack=1 the
+                    sensor listens for ack_timeout_ms after sending and sends again up to
+                    retries times, retry_jitter_ms apart at most.  Trips during an
+                    exchange go in the next frame.  heartbeat_hours adds unacked frames.
+        hubs        half duplex: a hub acks a frame from its own sensors hub_turnaround_ms
+                    after it ends, one ack at a time, and hears nothing while it sends.
+                    Frames other hubs hear count as delivered too (the cloud takes them
+                    from any hub), but only the sensor's own hub acks.
+        duty cycle  with duty_cycle_pct above 0 every node waits after each frame for its
+                    time on air times (100 / duty_cycle_pct - 1), as the EU 868 MHz rules
+                    ask.  The US 915 MHz band has no such limit; the default is 0.
+
+    A trip is delivered when a frame carrying it reaches any hub; its latency is from the
+    trip to the end of that frame.  Acked trips also have the latency to the ack.
+
+    Build:
+        g++ -std=c++17 -O2 -pthread -o lora_netsim lora_netsim.cpp
+
+    Run:
+        ./lora_netsim [-f model.txt] [-j threads] [-r repeats] [key=value ...]
+
+        A value may be a list, a,b,c, or a range, from:to:step; every combination of
+        them is simulated, on all cores, and printed as one CSV row each, in order.
+        -r runs each combination that many times with different seeds and pools the
+        results.  A summary and the event rate go to stderr.
+
+    e.g. delivery against the number of sensors at SF7 and SF9, with one retry:
+        ./lora_netsim sensors=50:1000:50 sf=7,9 retries=1 trips_per_hour=4
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../common/tpp_TimeOnAir.h"
+
+// settings and their defaults.  The radio ones are tpp_LoRa.h's.
+static std::map<std::string, std::string> settings = {
+    {"sensors", "100"},
+    {"hubs", "1"},
+    {"radius_m", "1500"},
+    {"hours", "24"},                // simulated time
+    {"trips_per_hour", "2"},        // per sensor, Poisson
+    {"sf", "9"},
+    {"bw", "7"},                    // AT+PARAMETER code: 7 125 kHz, 8 250 kHz, 9 500 kHz
+    {"cr", "1"},
+    {"preamble", "12"},
+    {"tx_dbm", "22"},               // LoRa_CRFOP
+    {"pl_1m_db", "32"},             // free space at 1 m, 915 MHz
+    {"path_loss_exp", "2.9"},       // suburban, antennas near the ground
+    {"shadowing_sd", "6"},
+    {"fading_sd", "2"},
+    {"capture_db", "6"},
+    {"payload_bytes", "24"},        // "G m: 123" and the odd longer field
+    {"ack_bytes", "6"},             // "TESTOK"
+    {"heartbeat_bytes", "30"},
+    {"heartbeat_hours", "0"},
+    {"coalesce_ms", "300"},         // EVENT_COALESCE_MS
+    {"queue_size", "8"},            // TPP_EVENT_QUEUE_SIZE
+    {"ack", "1"},
+    {"ack_timeout_ms", "5000"},     // ACK_WAIT_MS
+    {"retries", "0"},               // FRAME_RETRIES
+    {"retry_jitter_ms", "0"},
+    {"hub_turnaround_ms", "40"},
+    {"duty_cycle_pct", "0"},
+    {"seed", "1"},
+};
+
+// one combination of the settings, as numbers
+struct Params {
+    int sensors, hubs, sf, bw, cr, preamble, payloadBytes, ackBytes, heartbeatBytes, queueSize, ack, retries;
+    double radius, hours, tripsPerHour, txDbm, pl1m, plExp, shadowingSD, fadingSD, captureDb, heartbeatHours,
+        coalesceMS, ackTimeoutMS, retryJitterMS, turnaroundMS, dutyPct;
+    uint64_t seed;
+};
+
+static Params toParams(const std::map<std::string, std::string>& s) {
+    auto n = [&](const char* key) { return atof(s.at(key).c_str()); };
+    Params p;
+    p.sensors = (int) n("sensors");
+    p.hubs = std::max(1, (int) n("hubs"));
+    p.sf = (int) n("sf");
+    p.bw = (int) n("bw");
+    p.cr = (int) n("cr");
+    p.preamble = (int) n("preamble");
+    p.payloadBytes = (int) n("payload_bytes");
+    p.ackBytes = (int) n("ack_bytes");
+    p.heartbeatBytes = (int) n("heartbeat_bytes");
+    p.queueSize = std::max(1, (int) n("queue_size"));
+    p.ack = (int) n("ack");
+    p.retries = std::max(0, (int) n("retries"));
+    p.radius = n("radius_m");
+    p.hours = n("hours");
+    p.tripsPerHour = n("trips_per_hour");
+    p.txDbm = n("tx_dbm");
+    p.pl1m = n("pl_1m_db");
+    p.plExp = n("path_loss_exp");
+    p.shadowingSD = n("shadowing_sd");
+    p.fadingSD = n("fading_sd");
+    p.captureDb = n("capture_db");
+    p.heartbeatHours = n("heartbeat_hours");
+    p.coalesceMS = n("coalesce_ms");
+    p.ackTimeoutMS = n("ack_timeout_ms");
+    p.retryJitterMS = n("retry_jitter_ms");
+    p.turnaroundMS = n("hub_turnaround_ms");
+    p.dutyPct = n("duty_cycle_pct");
+    p.seed = (uint64_t) n("seed");
+    return p;
+}
+
+// ---- random numbers: splitmix64, fast and good enough for this ----
+
+static inline uint64_t mix(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+struct Random {
+    uint64_t state;
+    uint64_t next() { return mix(state++); }
+    double unit() { return (next() >> 11) * (1.0 / 9007199254740992.0); }     // [0, 1)
+    double exponential(double mean) { return -mean * log(1 - unit()); }
+};
+
+// a normal value fixed by key, so the same link or frame always gets the same one
+static double hashedNormal(uint64_t key) {
+    uint64_t h = mix(key);
+    double u1 = ((h >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+    double u2 = (mix(h) >> 11) * (1.0 / 9007199254740992.0);
+    return sqrt(-2 * log(u1)) * cos(2 * M_PI * u2);
+}
+
+// SX1262 sensitivity at 125 kHz, dBm; 3 dB less for each doubling of the bandwidth
+static double sensitivityDbm(int sf, int bw) {
+    static const double at125[] = {-124, -127, -130, -133, -135.5, -137};   // SF7 - SF12
+    double s = at125[std::min(std::max(sf, 7), 12) - 7];
+    return s + (bw >= 9 ? 6 : bw == 8 ? 3 : 0);
+}
+
+// ---- the simulation ----
+
+enum EventType : uint8_t { TRIP, SEND, FRAME_END, ACK_TIMEOUT, HUB_SEND, HEARTBEAT };
+enum FrameKind : uint8_t { UPLINK, ACK, HEARTBEAT_FRAME };
+enum LossReason : uint8_t { RECEIVED, WEAK, COLLISION, HALF_DUPLEX };
+
+struct Event {
+    int64_t t;          // us
+    uint32_t order;     // events at the same time in the order they were made
+    EventType type;
+    int node;
+    int arg;
+    bool operator>(const Event& o) const { return t != o.t ? t > o.t : order > o.order; }
+};
+
+struct Frame {
+    uint64_t serial;    // for the fading draw
+    FrameKind kind;
+    int from;
+    int to;             // the hub for uplinks, the sensor for acks
+    int msg;
+    int64_t start, end;
+    LossReason home;    // at the sensor's own hub
+};
+
+struct Receiver {
+    int locked = -1;    // frame index
+    bool corrupt = false;
+    double lockedDbm = 0;
+    bool transmitting = false;
+    bool listening = false;     // sensors: only while waiting for an ack
+};
+
+enum SensorState : uint8_t { IDLE, COALESCING, SENDING, LISTENING, BACKING_OFF };
+
+struct Sensor {
+    int hub;
+    SensorState state = IDLE;
+    std::vector<int64_t> queued;    // trips waiting for the next frame
+    std::vector<int64_t> inFrame;   // trips in the frame being sent
+    int msg = 0;
+    int deliveredMsg = 0;
+    int attemptsLeft = 0;
+    int attempt = 0;                // matches ACK_TIMEOUT events to the attempt they were for
+    int64_t nextAllowed = 0;        // duty cycle
+};
+
+struct Hub {
+    int64_t busyUntil = 0;          // end of the last ack it has lined up
+    int64_t nextAllowed = 0;
+};
+
+struct Result {
+    long trips = 0, delivered = 0, acked = 0, queueDropped = 0;
+    long uplinks = 0, lostWeak = 0, lostCollision = 0, lostHalfDuplex = 0;
+    long acksSent = 0, heartbeats = 0, heartbeatsHeard = 0;
+    double airtimeUS = 0, simulatedUS = 0;
+    long events = 0;
+    double cpuSeconds = 0;
+    std::vector<float> latencyMS, ackLatencyMS;
+
+    void add(const Result& o) {
+        trips += o.trips; delivered += o.delivered; acked += o.acked; queueDropped += o.queueDropped;
+        uplinks += o.uplinks; lostWeak += o.lostWeak; lostCollision += o.lostCollision;
+        lostHalfDuplex += o.lostHalfDuplex; acksSent += o.acksSent; heartbeats += o.heartbeats;
+        heartbeatsHeard += o.heartbeatsHeard; airtimeUS += o.airtimeUS; simulatedUS += o.simulatedUS;
+        events += o.events; cpuSeconds += o.cpuSeconds;
+        latencyMS.insert(latencyMS.end(), o.latencyMS.begin(), o.latencyMS.end());
+        ackLatencyMS.insert(ackLatencyMS.end(), o.ackLatencyMS.begin(), o.ackLatencyMS.end());
+    }
+};
+
+class Network {
+public:
+    Network(const Params& params) : p(params) {
+        random.state = mix(p.seed);
+        nodes = p.hubs + p.sensors;
+        x.resize(nodes);
+        y.resize(nodes);
+        for (int h = 0; h < p.hubs; h++) {
+            double a = 2 * M_PI * h / p.hubs;
+            double r = p.hubs == 1 ? 0 : p.radius / 2;
+            x[h] = r * cos(a);
+            y[h] = r * sin(a);
+        }
+        sensors.resize(p.sensors);
+        hubs.resize(p.hubs);
+        receivers.resize(nodes);
+        for (int s = 0; s < p.sensors; s++) {
+            double r = p.radius * sqrt(random.unit()), a = 2 * M_PI * random.unit();
+            x[p.hubs + s] = r * cos(a);
+            y[p.hubs + s] = r * sin(a);
+            int best = 0;
+            for (int h = 1; h < p.hubs; h++) {
+                if (linkDbm(h, p.hubs + s) > linkDbm(best, p.hubs + s)) best = h;
+            }
+            sensors[s].hub = best;
+        }
+        uplinkUS = tpp_timeOnAirUS(p.payloadBytes, p.sf, p.bw, p.cr, p.preamble);
+        ackUS = tpp_timeOnAirUS(p.ackBytes, p.sf, p.bw, p.cr, p.preamble);
+        heartbeatUS = tpp_timeOnAirUS(p.heartbeatBytes, p.sf, p.bw, p.cr, p.preamble);
+        static const double bandwidthHz[] = {7800, 10400, 15600, 20800, 31250, 41700, 62500, 125000, 250000, 500000};
+        double symbolUS = (double) (1 << p.sf) * 1e6 / bandwidthHz[std::min(std::max(p.bw, 0), 9)];
+        captureWindowUS = (int64_t) ((p.preamble + 4.25) * symbolUS);
+        sensitivity = sensitivityDbm(p.sf, p.bw);
+        endUS = (int64_t) (p.hours * 3600e6);
+    }
+
+    Result run() {
+        auto cpuStart = std::chrono::steady_clock::now();
+        for (int s = 0; s < p.sensors; s++) {
+            if (p.tripsPerHour > 0) {
+                schedule((int64_t) random.exponential(3600e6 / p.tripsPerHour), TRIP, s, 0);
+            }
+            if (p.heartbeatHours > 0) {
+                schedule((int64_t) (random.unit() * p.heartbeatHours * 3600e6), HEARTBEAT, s, 0);
+            }
+        }
+        while (!events.empty()) {
+            Event e = events.top();
+            events.pop();
+            now = e.t;
+            result.events++;
+            switch (e.type) {
+                case TRIP: trip(e.node); break;
+                case SEND: send(e.node); break;
+                case FRAME_END: frameEnd(e.arg); break;
+                case ACK_TIMEOUT: ackTimeout(e.node, e.arg); break;
+                case HUB_SEND: hubSend(e.node, e.arg); break;
+                case HEARTBEAT: heartbeat(e.node); break;
+            }
+        }
+        result.simulatedUS = (double) endUS;
+        result.cpuSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - cpuStart).count();
+        return result;
+    }
+
+private:
+    Params p;
+    Random random;
+    int nodes;
+    std::vector<double> x, y;
+    std::vector<Sensor> sensors;
+    std::vector<Hub> hubs;
+    std::vector<Receiver> receivers;    // hubs first, then sensors
+    std::vector<Frame> frames;
+    std::vector<int> freeFrames;
+    std::vector<int> onAir;             // frame indexes
+    std::vector<int> listeners;         // sensor nodes listening for an ack
+    std::priority_queue<Event, std::vector<Event>, std::greater<Event>> events;
+    uint32_t order = 0;
+    uint64_t frameSerial = 0;
+    int64_t now = 0, endUS = 0;
+    int64_t uplinkUS, ackUS, heartbeatUS, captureWindowUS;
+    double sensitivity;
+    Result result;
+
+    void schedule(int64_t t, EventType type, int node, int arg) {
+        events.push({t, order++, type, node, arg});
+    }
+
+    // mean power of a link, shadowing included; the same both ways
+    double linkDbm(int a, int b) {
+        double d = std::max(1.0, hypot(x[a] - x[b], y[a] - y[b]));
+        uint64_t key = ((uint64_t) std::min(a, b) << 32) | (uint64_t) std::max(a, b);
+        return p.txDbm - p.pl1m - 10 * p.plExp * log10(d) - p.shadowingSD * hashedNormal(key ^ (p.seed << 1));
+    }
+
+    double frameDbm(const Frame& f, int node) {
+        double fade = p.fadingSD > 0 ? p.fadingSD * hashedNormal((f.serial << 20) ^ (uint64_t) node ^ 0xFADE) : 0;
+        return linkDbm(f.from, node) + fade;
+    }
+
+    int newFrame(FrameKind kind, int from, int to, int msg, int64_t airUS) {
+        int index;
+        if (freeFrames.empty()) {
+            index = (int) frames.size();
+            frames.push_back(Frame());
+        } else {
+            index = freeFrames.back();
+            freeFrames.pop_back();
+        }
+        Frame& f = frames[index];
+        f = {frameSerial++, kind, from, to, msg, now, now + airUS, COLLISION};
+        result.airtimeUS += airUS;
+        // every receiver that can take it sees it start
+        for (int h = 0; h < p.hubs; h++) {
+            if (h != from) frameStart(h, index);
+        }
+        for (int node : listeners) {
+            if (node != from) frameStart(node, index);
+        }
+        onAir.push_back(index);
+        schedule(f.end, FRAME_END, from, index);
+        return index;
+    }
+
+    // a receiver tries to lock on a frame; it is busy with it, corrupt or not, until it ends
+    void lock(int node, int index, double dbm) {
+        Receiver& r = receivers[node];
+        Frame& f = frames[index];
+        if (dbm < sensitivity) {
+            r.locked = -1;
+            if (node == f.to) f.home = WEAK;
+            return;
+        }
+        r.locked = index;
+        r.lockedDbm = dbm;
+        r.corrupt = false;
+        for (int other : onAir) {
+            if (other != index && frames[other].from != node && frameDbm(frames[other], node) + p.captureDb > dbm) {
+                r.corrupt = true;
+                break;
+            }
+        }
+    }
+
+    void frameStart(int node, int index) {
+        Receiver& r = receivers[node];
+        Frame& f = frames[index];
+        if (r.transmitting) {
+            if (node == f.to) f.home = HALF_DUPLEX;
+            return;
+        }
+        double dbm = frameDbm(f, node);
+        if (r.locked < 0) {
+            lock(node, index, dbm);
+        } else if (dbm >= r.lockedDbm + p.captureDb && now - frames[r.locked].start < captureWindowUS) {
+            lock(node, index, dbm);     // the stronger frame takes the receiver over
+        } else if (r.lockedDbm < dbm + p.captureDb) {
+            r.corrupt = true;
+        }
+    }
+
+    void frameEnd(int index) {
+        Frame& f = frames[index];
+        onAir.erase(std::find(onAir.begin(), onAir.end(), index));
+        for (int h = 0; h < p.hubs; h++) {
+            Receiver& r = receivers[h];
+            if (r.locked == index) {
+                r.locked = -1;
+                if (!r.corrupt) hubHeard(h, f);
+            }
+        }
+        for (size_t i = 0; i < listeners.size(); i++) {
+            int node = listeners[i];
+            Receiver& r = receivers[node];
+            if (r.locked == index) {
+                r.locked = -1;
+                if (!r.corrupt && f.kind == ACK && f.to == node) {
+                    acked(node - p.hubs);
+                    i--;        // acked() took it off the list
+                }
+            }
+        }
+        if (f.from < p.hubs) {
+            receivers[f.from].transmitting = false;
+            if (p.dutyPct > 0) hubs[f.from].nextAllowed = now + (int64_t) ((f.end - f.start) * (100 / p.dutyPct - 1));
+        } else {
+            sentBySensor(f.from - p.hubs, f);
+        }
+        if (f.kind == UPLINK && f.home != RECEIVED) {
+            if (f.home == WEAK) result.lostWeak++;
+            else if (f.home == HALF_DUPLEX) result.lostHalfDuplex++;
+            else result.lostCollision++;
+        }
+        freeFrames.push_back(index);
+    }
+
+    // ---- sensors ----
+
+    void trip(int s) {
+        Sensor& sensor = sensors[s];
+        result.trips++;
+        if ((int) sensor.queued.size() >= p.queueSize) {
+            result.queueDropped++;
+        } else {
+            sensor.queued.push_back(now);
+            if (sensor.state == IDLE) {
+                sensor.state = COALESCING;
+                schedule(now + (int64_t) (p.coalesceMS * 1000), SEND, s, 0);
+            }
+        }
+        int64_t next = now + (int64_t) random.exponential(3600e6 / p.tripsPerHour);
+        if (next < endUS) schedule(next, TRIP, s, 0);
+    }
+
+    void send(int s) {
+        Sensor& sensor = sensors[s];
+        if (now < sensor.nextAllowed) {
+            schedule(sensor.nextAllowed, SEND, s, 0);
+            return;
+        }
+        if (sensor.state == COALESCING) {
+            sensor.inFrame.swap(sensor.queued);
+            sensor.queued.clear();
+            sensor.msg++;
+            sensor.attemptsLeft = p.ack ? p.retries : 0;
+        }
+        sensor.state = SENDING;
+        result.uplinks++;
+        newFrame(UPLINK, p.hubs + s, sensor.hub, sensor.msg, uplinkUS);
+    }
+
+    void heartbeat(int s) {
+        Sensor& sensor = sensors[s];
+        if (sensor.state == IDLE && now >= sensor.nextAllowed) {
+            sensor.state = SENDING;
+            result.heartbeats++;
+            newFrame(HEARTBEAT_FRAME, p.hubs + s, sensor.hub, 0, heartbeatUS);
+        }
+        int64_t next = now + (int64_t) (p.heartbeatHours * 3600e6);
+        if (next < endUS) schedule(next, HEARTBEAT, s, 0);
+    }
+
+    void sentBySensor(int s, const Frame& f) {
+        Sensor& sensor = sensors[s];
+        if (p.dutyPct > 0) sensor.nextAllowed = now + (int64_t) ((f.end - f.start) * (100 / p.dutyPct - 1));
+        if (f.kind == UPLINK && p.ack) {
+            sensor.state = LISTENING;
+            receivers[p.hubs + s].listening = true;
+            receivers[p.hubs + s].locked = -1;
+            listeners.push_back(p.hubs + s);
+            schedule(now + (int64_t) (p.ackTimeoutMS * 1000), ACK_TIMEOUT, s, ++sensor.attempt);
+        } else {
+            finishExchange(s);
+        }
+    }
+
+    void stopListening(int s) {
+        Receiver& r = receivers[p.hubs + s];
+        r.listening = false;
+        r.locked = -1;
+        listeners.erase(std::find(listeners.begin(), listeners.end(), p.hubs + s));
+    }
+
+    void acked(int s) {
+        Sensor& sensor = sensors[s];
+        stopListening(s);
+        for (int64_t t : sensor.inFrame) {
+            result.acked++;
+            result.ackLatencyMS.push_back((now - t) / 1000.0f);
+        }
+        finishExchange(s);
+    }
+
+    void ackTimeout(int s, int attempt) {
+        Sensor& sensor = sensors[s];
+        if (sensor.state != LISTENING || attempt != sensor.attempt) {
+            return;     // acked in time
+        }
+        stopListening(s);
+        if (sensor.attemptsLeft > 0) {
+            sensor.attemptsLeft--;
+            sensor.state = BACKING_OFF;
+            schedule(now + (int64_t) (random.unit() * p.retryJitterMS * 1000), SEND, s, 0);
+        } else {
+            finishExchange(s);
+        }
+    }
+
+    void finishExchange(int s) {
+        Sensor& sensor = sensors[s];
+        sensor.inFrame.clear();
+        if (sensor.queued.empty()) {
+            sensor.state = IDLE;
+        } else {
+            sensor.state = COALESCING;
+            schedule(std::max(now, sensor.queued.front() + (int64_t) (p.coalesceMS * 1000)), SEND, s, 0);
+        }
+    }
+
+    // ---- hubs ----
+
+    void hubHeard(int h, Frame& f) {
+        if (f.to == h) f.home = RECEIVED;
+        if (f.from < p.hubs) {
+            return;     // another hub's ack
+        }
+        int s = f.from - p.hubs;
+        Sensor& sensor = sensors[s];
+        if (f.kind == HEARTBEAT_FRAME) {
+            if (f.to == h) result.heartbeatsHeard++;
+            return;
+        }
+        if (f.kind != UPLINK) {
+            return;
+        }
+        if (sensor.deliveredMsg != f.msg) {
+            sensor.deliveredMsg = f.msg;
+            for (int64_t t : sensor.inFrame) {
+                result.delivered++;
+                result.latencyMS.push_back((now - t) / 1000.0f);
+            }
+        }
+        if (p.ack && f.to == h) {
+            Hub& hub = hubs[h];
+            int64_t at = std::max(std::max(now + (int64_t) (p.turnaroundMS * 1000), hub.busyUntil), hub.nextAllowed);
+            hub.busyUntil = at + ackUS;
+            schedule(at, HUB_SEND, h, s);
+        }
+    }
+
+    void hubSend(int h, int s) {
+        Receiver& r = receivers[h];
+        if (r.locked >= 0 && frames[r.locked].to == h) {
+            frames[r.locked].home = HALF_DUPLEX;
+        }
+        r.locked = -1;
+        r.transmitting = true;
+        result.acksSent++;
+        newFrame(ACK, h, p.hubs + s, 0, ackUS);
+    }
+};
+
+// ---- settings, sweeps and output ----
+
+static bool set(const char* text, const char* where, std::map<std::string, std::string>& into) {
+    std::string line = text;
+    size_t hash = line.find('#');
+    if (hash != std::string::npos) line.erase(hash);
+    size_t equals = line.find('=');
+    auto trim = [](std::string s) {
+        size_t a = s.find_first_not_of(" \t\r\n");
+        size_t b = s.find_last_not_of(" \t\r\n");
+        return a == std::string::npos ? std::string() : s.substr(a, b - a + 1);
+    };
+    if (equals == std::string::npos) {
+        return trim(line).empty();
+    }
+    std::string key = trim(line.substr(0, equals));
+    if (!into.count(key)) {
+        fprintf(stderr, "%s: unknown setting %s\n", where, key.c_str());
+        return false;
+    }
+    into[key] = trim(line.substr(equals + 1));
+    return true;
+}
+
+static bool loadModel(const char* path) {
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return false;
+    }
+    char line[512];
+    bool good = true;
+    while (fgets(line, sizeof(line), f)) {
+        good = set(line, path, settings) && good;
+    }
+    fclose(f);
+    return good;
+}
+
+// the values of a setting: "a,b,c", "from:to:step" or one value
+static std::vector<std::string> values(const std::string& text) {
+    std::vector<std::string> out;
+    double from, to, step;
+    if (sscanf(text.c_str(), "%lf:%lf:%lf", &from, &to, &step) == 3 && step > 0) {
+        for (double v = from; v <= to + step * 1e-9; v += step) {
+            char number[32];
+            snprintf(number, sizeof(number), "%g", v);
+            out.push_back(number);
+        }
+        return out;
+    }
+    size_t start = 0;
+    while (true) {
+        size_t comma = text.find(',', start);
+        out.push_back(text.substr(start, comma == std::string::npos ? std::string::npos : comma - start));
+        if (comma == std::string::npos) break;
+        start = comma + 1;
+    }
+    return out;
+}
+
+static double percentile(std::vector<float>& v, double fraction) {
+    if (v.empty()) return 0;
+    size_t i = std::min(v.size() - 1, (size_t) (fraction * (v.size() - 1) + 0.5));
+    std::nth_element(v.begin(), v.begin() + i, v.end());
+    return v[i];
+}
+
+int main(int argc, char** argv) {
+    int threads = (int) std::thread::hardware_concurrency();
+    int repeats = 1;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+            if (!loadModel(argv[++i])) return 2;
+        } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            repeats = atoi(argv[++i]);
+        } else if (strchr(argv[i], '=') && argv[i][0] != '-') {
+            if (!set(argv[i], "command line", settings)) return 2;
+        } else {
+            fprintf(stderr, "usage: %s [-f model.txt] [-j threads] [-r repeats] [key=value ...]\n", argv[0]);
+            return 2;
+        }
+    }
+    threads = std::max(1, threads);
+    repeats = std::max(1, repeats);
+
+    // every combination of the swept settings
+    std::vector<std::string> swept;
+    std::vector<std::vector<std::string>> sweptValues;
+    for (const auto& kv : settings) {
+        auto v = values(kv.second);
+        if (v.size() > 1) {
+            swept.push_back(kv.first);
+            sweptValues.push_back(v);
+        }
+    }
+    std::vector<std::map<std::string, std::string>> points(1, settings);
+    for (size_t k = 0; k < swept.size(); k++) {
+        std::vector<std::map<std::string, std::string>> more;
+        for (const auto& point : points) {
+            for (const auto& v : sweptValues[k]) {
+                more.push_back(point);
+                more.back()[swept[k]] = v;
+            }
+        }
+        points.swap(more);
+    }
+
+    // runs are shared out to the threads; each point's results are pooled in order
+    size_t runs = points.size() * repeats;
+    std::vector<Result> results(runs);
+    std::atomic<size_t> next(0);
+    auto wallStart = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&]() {
+            size_t i;
+            while ((i = next++) < runs) {
+                Params params = toParams(points[i / repeats]);
+                params.seed = params.seed * 1000003 + i % repeats;
+                results[i] = Network(params).run();
+            }
+        });
+    }
+    for (auto& w : workers) {
+        w.join();
+    }
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+
+    for (const auto& key : swept) {
+        printf("%s,", key.c_str());
+    }
+    printf("trips,delivered_pct,acked_pct,queue_dropped,uplinks,lost_weak,lost_collision,lost_half_duplex,"
+        "heartbeats_heard_pct,channel_busy_pct,latency_p50_ms,latency_p90_ms,latency_p99_ms,ack_p50_ms,ack_p99_ms\n");
+    long events = 0;
+    double cpu = 0;
+    for (size_t point = 0; point < points.size(); point++) {
+        Result r;
+        for (int k = 0; k < repeats; k++) {
+            r.add(results[point * repeats + k]);
+        }
+        events += r.events;
+        cpu += r.cpuSeconds;
+        for (const auto& key : swept) {
+            printf("%s,", points[point].at(key).c_str());
+        }
+        double trips = std::max(1L, r.trips);
+        printf("%ld,%.2f,%.2f,%ld,%ld,%ld,%ld,%ld,%.2f,%.3f,%.0f,%.0f,%.0f,%.0f,%.0f\n", r.trips,
+            100.0 * r.delivered / trips, 100.0 * r.acked / trips, r.queueDropped, r.uplinks, r.lostWeak,
+            r.lostCollision, r.lostHalfDuplex, r.heartbeats ? 100.0 * r.heartbeatsHeard / r.heartbeats : 0.0,
+            100.0 * r.airtimeUS / std::max(1.0, r.simulatedUS), percentile(r.latencyMS, 0.5),
+            percentile(r.latencyMS, 0.9), percentile(r.latencyMS, 0.99), percentile(r.ackLatencyMS, 0.5),
+            percentile(r.ackLatencyMS, 0.99));
+    }
+    fprintf(stderr, "%zu runs, %ld events in %.2f s on %d threads: %.1f million events/s, %.1f million per core\n",
+        runs, events, wall, threads, events / wall / 1e6, cpu > 0 ? events / cpu / 1e6 : 0.0);
+    return 0;
+}
@@ -0,0 +1,499 @@
+/*
+    lora_provision.cpp - configure many RYLR998 LoRa modules at once over USB serial (FTDI) ports
+    created by Bob Glicksman and Jim Schrempp
+    as part of Team Practical Projects (tpp)
+
+    20261018 - first version
+
+    Replaces typing AT commands by hand or flashing ConfigForRangeTest.ino.  One worker
+    thread per port:
+
+        finds the module's baud rate (AT at each rate until +OK)
+        reads AT+UID? and the current settings
+        writes only the settings that differ from the profile
+        switches the module to the profile's baud rate, if one is given
+        reads every setting back to verify
+        adds a line to the manifest
+
+    Addresses are given out from the profile's range in the order modules finish their
+    UID read.  A module already in the manifest (same UID) keeps its address, so running
+    again over the same modules changes nothing.
+
+    Profile file, one setting per line, # for comments:
+
+        network=18
+        address=100-163          first and last address to give out
+        sf=9
+        bw=7                     7: 125 kHz, 8: 250 kHz, 9: 500 kHz
+        cr=1
+        preamble=12
+        band=915000000
+        power=22                 AT+CRFOP
+        baud=115200              optional; leave the module at its current rate if not given
+
+    Build:
+        g++ -std=c++17 -O2 -pthread -o lora_provision lora_provision.cpp
+
+    Run:
+        ./lora_provision -p profile.txt [-m manifest.csv] [-v] /dev/ttyUSB0 /dev/ttyUSB1 ...
+
+    Test without hardware with rylr998_sim, which makes pseudo-terminals that act like modules.
+*/
+
+#include <atomic>
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+#define PROBE_TIMEOUT_MS 250
+#define COMMAND_TIMEOUT_MS 2000    // writes to the module's flash can take a while
+
+struct Profile {
+    int network = 18;
+    int firstAddress = -1;
+    int lastAddress = -1;
+    int SF = 9;
+    int bandwidth = 7;
+    int codingRate = 1;
+    int preamble = 12;
+    long band = 915000000;
+    int power = 22;
+    long baud = 0;      // 0: leave as found
+};
+
+struct Settings {
+    std::string UID;
+    int network = -1;
+    int address = -1;
+    int SF = -1, bandwidth = -1, codingRate = -1, preamble = -1;
+    long band = -1;
+    int power = -1;
+};
+
+struct Result {
+    std::string port;
+    Settings settings;
+    long baud = 0;
+    std::string status = "not started";
+    int commands = 0;
+    double seconds = 0;
+};
+
+static bool verbose = false;
+static std::mutex outputMutex;
+
+static void logLine(const std::string& port, const char* format, ...) {
+    char text[512];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+    std::lock_guard<std::mutex> lock(outputMutex);
+    fprintf(stderr, "%s: %s\n", port.c_str(), text);
+}
+
+// ---------------- addresses ----------------
+
+// gives out addresses from the profile range; modules already in the manifest keep theirs
+class AddressBook {
+public:
+    void load(const std::string& manifestPath, const Profile& profile) {
+        next = profile.firstAddress;
+        last = profile.lastAddress;
+        FILE* f = fopen(manifestPath.c_str(), "r");
+        if (!f) {
+            return;
+        }
+        char line[512];
+        while (fgets(line, sizeof(line), f)) {
+            char port[256], uid[128];
+            int address;
+            if (sscanf(line, "%255[^,],%127[^,],%d", port, uid, &address) == 3) {
+                known[uid] = address;
+                used.insert(address);
+            }
+        }
+        fclose(f);
+    }
+
+    // the address for this UID; -1 if the range is used up
+    int addressFor(const std::string& UID) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = known.find(UID);
+        if (it != known.end()) {
+            return it->second;
+        }
+        while (next <= last && used.count(next)) {
+            next++;
+        }
+        if (next > last) {
+            return -1;
+        }
+        known[UID] = next;
+        used.insert(next);
+        return next++;
+    }
+
+private:
+    std::mutex mutex;
+    std::map<std::string, int> known;
+    std::set<int> used;
+    int next = 0;
+    int last = -1;
+};
+
+// ---------------- one serial port ----------------
+
+static speed_t speedFor(long baud) {
+    switch (baud) {
+        case 4800: return B4800;
+        case 9600: return B9600;
+        case 19200: return B19200;
+        case 38400: return B38400;
+        case 57600: return B57600;
+        case 115200: return B115200;
+        default: return 0;
+    }
+}
+
+class ModulePort {
+public:
+    explicit ModulePort(const std::string& path) : path(path) {}
+    ~ModulePort() {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+
+    bool open() {
+        fd = ::open(path.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK);
+        return fd >= 0;
+    }
+
+    bool setBaud(long baud) {
+        struct termios t;
+        if (tcgetattr(fd, &t) != 0) {
+            return false;
+        }
+        cfmakeraw(&t);
+        t.c_cflag |= CLOCAL | CREAD;
+        t.c_cflag &= ~CRTSCTS;
+        cfsetispeed(&t, speedFor(baud));
+        cfsetospeed(&t, speedFor(baud));
+        if (tcsetattr(fd, TCSANOW, &t) != 0) {
+            return false;
+        }
+        tcflush(fd, TCIOFLUSH);
+        pending.clear();
+        return true;
+    }
+
+    // send a command and return the first line of the response that starts with '+';
+    // "" if none came in time
+    std::string command(const std::string& text, int timeoutMS = COMMAND_TIMEOUT_MS) {
+        commands++;
+        std::string line = text + "\r\n";
+        if (write(fd, line.data(), line.size()) != (ssize_t) line.size()) {
+            return "";
+        }
+        if (verbose) {
+            logLine(path, "> %s", text.c_str());
+        }
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMS);
+        while (true) {
+            size_t end = pending.find("\r\n");
+            if (end != std::string::npos) {
+                std::string response = pending.substr(0, end);
+                pending.erase(0, end + 2);
+                if (verbose) {
+                    logLine(path, "< %s", response.c_str());
+                }
+                if (!response.empty() && response[0] == '+' && response.compare(0, 5, "+RCV=") != 0) {
+                    return response;
+                }
+                continue;   // noise, a received frame, or a partial line from another baud rate
+            }
+            int remainingMS = (int) std::chrono::duration_cast<std::chrono::milliseconds>(
+                deadline - std::chrono::steady_clock::now()).count();
+            if (remainingMS <= 0) {
+                return "";
+            }
+            struct pollfd p = {fd, POLLIN, 0};
+            if (poll(&p, 1, remainingMS) <= 0) {
+                return "";
+            }
+            char chunk[256];
+            ssize_t got = read(fd, chunk, sizeof(chunk));
+            if (got > 0) {
+                pending.append(chunk, got);
+            }
+        }
+    }
+
+    bool ok(const std::string& text) { return command(text) == "+OK"; }
+
+    std::string path;
+    int commands = 0;
+
+private:
+    int fd = -1;
+    std::string pending;
+};
+
+// ---------------- provisioning one module ----------------
+
+static bool readSettings(ModulePort& port, Settings& s) {
+    std::string r;
+    r = port.command("AT+UID?");
+    if (r.compare(0, 5, "+UID=") != 0) return false;
+    s.UID = r.substr(5);
+    r = port.command("AT+NETWORKID?");
+    if (sscanf(r.c_str(), "+NETWORKID=%d", &s.network) != 1) return false;
+    r = port.command("AT+ADDRESS?");
+    if (sscanf(r.c_str(), "+ADDRESS=%d", &s.address) != 1) return false;
+    r = port.command("AT+PARAMETER?");
+    if (sscanf(r.c_str(), "+PARAMETER=%d,%d,%d,%d", &s.SF, &s.bandwidth, &s.codingRate, &s.preamble) != 4) return false;
+    r = port.command("AT+BAND?");
+    if (sscanf(r.c_str(), "+BAND=%ld", &s.band) != 1) return false;
+    r = port.command("AT+CRFOP?");
+    if (sscanf(r.c_str(), "+CRFOP=%d", &s.power) != 1) return false;
+    return true;
+}
+
+// the profile's rate first, since a module that has been provisioned before will be at it
+static long findBaud(ModulePort& port, long likely) {
+    static const long rates[] = {115200, 57600, 38400, 19200, 9600, 4800};
+    std::vector<long> order;
+    if (likely) {
+        order.push_back(likely);
+    }
+    for (long baud : rates) {
+        if (baud != likely) {
+            order.push_back(baud);
+        }
+    }
+    // a second pass in case the first AT met a partial line or the module was busy
+    for (int pass = 0; pass < 2; pass++) {
+        for (long baud : order) {
+            port.setBaud(baud);
+            if (port.command("AT", PROBE_TIMEOUT_MS) == "+OK") {
+                return baud;
+            }
+        }
+    }
+    return 0;
+}
+
+static void provision(Result& result, const Profile& profile, AddressBook& addresses) {
+    auto start = std::chrono::steady_clock::now();
+    ModulePort port(result.port);
+    auto finish = [&](const char* status) {
+        result.status = status;
+        result.commands = port.commands;
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        logLine(result.port, "%s (%d commands, %.2f s)", status, port.commands, result.seconds);
+    };
+
+    if (!port.open()) {
+        finish("cannot open port");
+        return;
+    }
+    result.baud = findBaud(port, profile.baud);
+    if (!result.baud) {
+        finish("no module found");
+        return;
+    }
+    Settings now;
+    if (!readSettings(port, now)) {
+        finish("could not read settings");
+        return;
+    }
+    int address = addresses.addressFor(now.UID);
+    if (address < 0) {
+        result.settings = now;
+        finish("address range used up");
+        return;
+    }
+    logLine(result.port, "UID %s at %ld baud, address %d", now.UID.c_str(), result.baud, address);
+
+    // write only what differs
+    bool written = true;
+    if (now.network != profile.network) {
+        written = written && port.ok("AT+NETWORKID=" + std::to_string(profile.network));
+    }
+    if (now.address != address) {
+        written = written && port.ok("AT+ADDRESS=" + std::to_string(address));
+    }
+    if (now.SF != profile.SF || now.bandwidth != profile.bandwidth || now.codingRate != profile.codingRate
+            || now.preamble != profile.preamble) {
+        written = written && port.ok("AT+PARAMETER=" + std::to_string(profile.SF) + "," + std::to_string(profile.bandwidth)
+            + "," + std::to_string(profile.codingRate) + "," + std::to_string(profile.preamble));
+    }
+    if (now.band != profile.band) {
+        written = written && port.ok("AT+BAND=" + std::to_string(profile.band));
+    }
+    if (now.power != profile.power) {
+        written = written && port.ok("AT+CRFOP=" + std::to_string(profile.power));
+    }
+    if (!written) {
+        result.settings = now;
+        finish("module refused a setting");
+        return;
+    }
+    if (profile.baud && profile.baud != result.baud) {
+        if (!port.ok("AT+IPR=" + std::to_string(profile.baud))) {
+            finish("module refused the baud rate");
+            return;
+        }
+        port.setBaud(profile.baud);
+        result.baud = profile.baud;
+        if (port.command("AT", PROBE_TIMEOUT_MS) != "+OK" && port.command("AT", PROBE_TIMEOUT_MS) != "+OK") {
+            finish("no answer at the new baud rate");
+            return;
+        }
+    }
+
+    // verify
+    Settings check;
+    if (!readSettings(port, check)) {
+        finish("could not read back settings");
+        return;
+    }
+    result.settings = check;
+    if (check.network != profile.network || check.address != address || check.SF != profile.SF
+            || check.bandwidth != profile.bandwidth || check.codingRate != profile.codingRate
+            || check.preamble != profile.preamble || check.band != profile.band || check.power != profile.power) {
+        finish("read back does not match");
+        return;
+    }
+    finish("ok");
+}
+
+// ---------------- profile and manifest ----------------
+
+static bool loadProfile(const char* path, Profile& p) {
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return false;
+    }
+    char line[256];
+    int lineNumber = 0;
+    bool good = true;
+    while (fgets(line, sizeof(line), f)) {
+        lineNumber++;
+        char* hash = strchr(line, '#');
+        if (hash) *hash = 0;
+        char key[64];
+        char value[128];
+        if (sscanf(line, " %63[^= \t] = %127s", key, value) != 2) {
+            continue;
+        }
+        std::string k = key;
+        if (k == "network") p.network = atoi(value);
+        else if (k == "address") {
+            if (sscanf(value, "%d-%d", &p.firstAddress, &p.lastAddress) == 1) p.lastAddress = p.firstAddress;
+        }
+        else if (k == "sf") p.SF = atoi(value);
+        else if (k == "bw") p.bandwidth = atoi(value);
+        else if (k == "cr") p.codingRate = atoi(value);
+        else if (k == "preamble") p.preamble = atoi(value);
+        else if (k == "band") p.band = atol(value);
+        else if (k == "power") p.power = atoi(value);
+        else if (k == "baud") p.baud = atol(value);
+        else {
+            fprintf(stderr, "%s:%d: unknown setting %s\n", path, lineNumber, key);
+            good = false;
+        }
+    }
+    fclose(f);
+    if (p.firstAddress < 0 || p.lastAddress < p.firstAddress || p.lastAddress > 65535) {
+        fprintf(stderr, "%s: address=first-last is needed, within 0-65535\n", path);
+        good = false;
+    }
+    if (p.baud && !speedFor(p.baud)) {
+        fprintf(stderr, "%s: baud must be 4800, 9600, 19200, 38400, 57600 or 115200\n", path);
+        good = false;
+    }
+    return good;
+}
+
+// manifest lines are appended, so earlier runs stay on record
+static bool writeManifest(const std::string& path, const std::vector<Result>& results) {
+    bool exists = access(path.c_str(), F_OK) == 0;
+    FILE* f = fopen(path.c_str(), "a");
+    if (!f) {
+        perror(path.c_str());
+        return false;
+    }
+    if (!exists) {
+        fprintf(f, "port,uid,address,network,sf,bw,cr,preamble,band,power,baud,status,commands,seconds\n");
+    }
+    for (const Result& r : results) {
+        const Settings& s = r.settings;
+        fprintf(f, "%s,%s,%d,%d,%d,%d,%d,%d,%ld,%d,%ld,%s,%d,%.2f\n", r.port.c_str(), s.UID.c_str(), s.address, s.network,
+            s.SF, s.bandwidth, s.codingRate, s.preamble, s.band, s.power, r.baud, r.status.c_str(), r.commands, r.seconds);
+    }
+    fclose(f);
+    return true;
+}
+
+int main(int argc, char** argv) {
+    const char* profilePath = nullptr;
+    std::string manifestPath = "lora_manifest.csv";
+    std::vector<Result> results;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) profilePath = argv[++i];
+        else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) manifestPath = argv[++i];
+        else if (strcmp(argv[i], "-v") == 0) verbose = true;
+        else if (argv[i][0] == '-') {
+            profilePath = nullptr;
+            break;
+        } else {
+            results.emplace_back();
+            results.back().port = argv[i];
+        }
+    }
+    if (!profilePath || results.empty()) {
+        fprintf(stderr, "usage: %s -p profile.txt [-m manifest.csv] [-v] port ...\n", argv[0]);
+        return 2;
+    }
+    Profile profile;
+    if (!loadProfile(profilePath, profile)) {
+        return 2;
+    }
+    AddressBook addresses;
+    addresses.load(manifestPath, profile);
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (Result& r : results) {
+        workers.emplace_back(provision, std::ref(r), std::cref(profile), std::ref(addresses));
+    }
+    for (auto& t : workers) {
+        t.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    int good = 0;
+    for (const Result& r : results) {
+        good += r.status == "ok";
+    }
+    writeManifest(manifestPath, results);
+    fprintf(stderr, "%d of %zu modules provisioned in %.2f s; manifest %s\n", good, results.size(), seconds,
+        manifestPath.c_str());
+    return good == (int) results.size() ? 0 : 1;
+}
@@ -0,0 +1,262 @@
+/*
+    rylr998_sim.cpp - pseudo-terminals that answer AT commands like RYLR998 LoRa modules
+    created by Bob Glicksman and Jim Schrempp
+    as part of Team Practical Projects (tpp)
+
+    20261018 - first version
+
+    For testing lora_provision (or anything else that talks to the modules over a serial
+    port) without hardware.  Makes one pseudo-terminal per module and prints the names of
+    the terminals, one per line, then runs until stopped.
+
+    Each module has a random UID, factory settings (ADDRESS=0, NETWORKID=18,
+    PARAMETER=9,7,1,12, BAND=915000000, CRFOP=22) and a baud rate.  A command only gets
+    an answer if the terminal is set to the module's baud rate; at any other rate the module
+    sends back a garbage byte, which is what a real one looks like.  AT+IPR changes the
+    rate after its +OK.  Answers come after the time the bytes would take on the wire plus
+    a few milliseconds, longer for commands that write the module's flash.
+
+    Not simulated: radio (AT+SEND gets +OK and goes nowhere), AT+MODE, AT+CPIN, AT+RESET.
+
+    Build:
+        g++ -std=c++17 -O2 -o rylr998_sim rylr998_sim.cpp -lutil
+
+    Run:
+        ./rylr998_sim [-n modules] [-b baud | -r] [-s seed]
+
+        -b   every module starts at this baud rate (default 115200)
+        -r   each module starts at a random baud rate, to exercise baud rate detection
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <pty.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#define ANSWER_MS 3     // module's time to parse and answer a command
+#define FLASH_MS 25     // extra for commands that save a setting
+
+static const long rates[] = {4800, 9600, 19200, 38400, 57600, 115200};
+
+static speed_t speedFor(long baud) {
+    switch (baud) {
+        case 4800: return B4800;
+        case 9600: return B9600;
+        case 19200: return B19200;
+        case 38400: return B38400;
+        case 57600: return B57600;
+        case 115200: return B115200;
+        default: return 0;
+    }
+}
+
+static long nowMS() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000L + t.tv_nsec / 1000000L;
+}
+
+struct Answer {
+    long dueMS;
+    std::string text;
+    long newBaud;   // switch to this rate once the answer is sent; 0 for no change
+};
+
+struct Module {
+    int master = -1;
+    int slave = -1;     // kept open so the master does not hang up between users
+    std::string name;
+    std::string UID;
+    long baud = 115200;
+    int address = 0;
+    int network = 18;
+    int SF = 9, bandwidth = 7, codingRate = 1, preamble = 12;
+    long band = 915000000;
+    int power = 22;
+    std::string line;
+    std::deque<Answer> answers;
+
+    // answer to one command, and whether it saves a setting
+    std::string execute(const std::string& command, bool& saves, long& newBaud) {
+        saves = false;
+        newBaud = 0;
+        if (command == "AT") return "+OK";
+        if (command.compare(0, 3, "AT+") != 0) return "+ERR=1";
+        std::string body = command.substr(3);
+        size_t equals = body.find('=');
+        std::string name = body.substr(0, equals == std::string::npos ? body.size() : equals);
+        bool query = !name.empty() && name.back() == '?';
+        if (query) name.pop_back();
+        std::string value = equals == std::string::npos ? "" : body.substr(equals + 1);
+
+        if (query) {
+            if (name == "UID") return "+UID=" + UID;
+            if (name == "ADDRESS") return "+ADDRESS=" + std::to_string(address);
+            if (name == "NETWORKID") return "+NETWORKID=" + std::to_string(network);
+            if (name == "PARAMETER") return "+PARAMETER=" + std::to_string(SF) + "," + std::to_string(bandwidth) + ","
+                + std::to_string(codingRate) + "," + std::to_string(preamble);
+            if (name == "BAND") return "+BAND=" + std::to_string(band);
+            if (name == "CRFOP") return "+CRFOP=" + std::to_string(power);
+            if (name == "IPR") return "+IPR=" + std::to_string(baud);
+            if (name == "MODE") return "+MODE=0";
+            if (name == "VER") return "+VER=RYLR998_SIM";
+            return "+ERR=4";
+        }
+        if (equals == std::string::npos || value.empty()) return "+ERR=2";
+        saves = true;
+        if (name == "ADDRESS") {
+            int a = atoi(value.c_str());
+            if (a < 0 || a > 65535) return "+ERR=4";
+            address = a;
+        } else if (name == "NETWORKID") {
+            int n = atoi(value.c_str());
+            if (n != 18 && (n < 3 || n > 15)) return "+ERR=4";
+            network = n;
+        } else if (name == "PARAMETER") {
+            int s, b, c, p;
+            if (sscanf(value.c_str(), "%d,%d,%d,%d", &s, &b, &c, &p) != 4) return "+ERR=2";
+            if (s < 5 || s > 11 || b < 7 || b > 9 || c < 1 || c > 4 || p < 4 || p > 24) return "+ERR=5";
+            SF = s; bandwidth = b; codingRate = c; preamble = p;
+        } else if (name == "BAND") {
+            long f = atol(value.c_str());
+            if (f < 820000000 || f > 1020000000) return "+ERR=4";
+            band = f;
+        } else if (name == "CRFOP") {
+            int c = atoi(value.c_str());
+            if (c < 0 || c > 22) return "+ERR=4";
+            power = c;
+        } else if (name == "IPR") {
+            long r = atol(value.c_str());
+            if (!speedFor(r)) return "+ERR=4";
+            newBaud = r;
+        } else if (name == "SEND" || name == "MODE") {
+            saves = false;
+        } else {
+            saves = false;
+            return "+ERR=4";
+        }
+        return "+OK";
+    }
+
+    // bytes from the host
+    void received(const char* data, int length) {
+        struct termios t;
+        bool sameRate = tcgetattr(master, &t) == 0 && cfgetospeed(&t) == speedFor(baud);
+        for (int i = 0; i < length; i++) {
+            if (!sameRate) {
+                // framing errors; the module sees noise and the host sees noise back
+                if (data[i] == '\n') {
+                    answers.push_back({nowMS() + ANSWER_MS, std::string(1, (char) 0xF8), 0});
+                }
+                continue;
+            }
+            if (data[i] == '\r') continue;
+            if (data[i] != '\n') {
+                if (line.size() < 256) line += data[i];
+                continue;
+            }
+            bool saves;
+            long newBaud;
+            std::string answer = execute(line, saves, newBaud);
+            // the command and answer on the wire, 10 bits per byte
+            long wireMS = (long) ((line.size() + 2 + answer.size() + 2) * 10000L / baud);
+            long due = nowMS() + wireMS + ANSWER_MS + (saves ? FLASH_MS : 0);
+            if (!answers.empty() && answers.back().dueMS > due) due = answers.back().dueMS;
+            answers.push_back({due, answer + "\r\n", newBaud});
+            line.clear();
+        }
+    }
+
+    // sends answers that are due; returns ms until the next one, or -1
+    int sendDue() {
+        long now = nowMS();
+        while (!answers.empty() && answers.front().dueMS <= now) {
+            Answer& a = answers.front();
+            if (write(master, a.text.data(), a.text.size()) < 0) {
+                // nobody reading; drop it
+            }
+            if (a.newBaud) baud = a.newBaud;
+            answers.pop_front();
+        }
+        return answers.empty() ? -1 : (int) (answers.front().dueMS - now);
+    }
+};
+
+int main(int argc, char** argv) {
+    int count = 4;
+    long startBaud = 115200;
+    bool randomBaud = false;
+    unsigned seed = (unsigned) time(NULL);
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) count = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) startBaud = atol(argv[++i]);
+        else if (strcmp(argv[i], "-r") == 0) randomBaud = true;
+        else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) seed = (unsigned) atol(argv[++i]);
+        else {
+            fprintf(stderr, "usage: %s [-n modules] [-b baud | -r] [-s seed]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (count < 1 || !speedFor(startBaud)) {
+        fprintf(stderr, "need at least one module, and a baud rate of 4800 - 115200\n");
+        return 2;
+    }
+
+    std::mt19937 random(seed);
+    std::vector<Module> modules(count);
+    for (Module& m : modules) {
+        char name[128];
+        if (openpty(&m.master, &m.slave, name, NULL, NULL) != 0) {
+            perror("openpty");
+            return 1;
+        }
+        fcntl(m.master, F_SETFL, O_NONBLOCK);
+        m.name = name;
+        char uid[25];
+        for (int i = 0; i < 24; i++) uid[i] = "0123456789ABCDEF"[random() & 15];
+        uid[24] = 0;
+        m.UID = uid;
+        m.baud = randomBaud ? rates[random() % (sizeof(rates) / sizeof(rates[0]))] : startBaud;
+        // the slave starts at the module's rate, as an FTDI adapter left from last time might
+        struct termios t;
+        tcgetattr(m.slave, &t);
+        cfmakeraw(&t);
+        cfsetispeed(&t, speedFor(m.baud));
+        cfsetospeed(&t, speedFor(m.baud));
+        tcsetattr(m.slave, TCSANOW, &t);
+        printf("%s\n", name);
+        fprintf(stderr, "%s: UID %s at %ld baud\n", name, uid, m.baud);
+    }
+    fflush(stdout);
+
+    std::vector<struct pollfd> fds(count);
+    while (true) {
+        int wait = -1;
+        for (int i = 0; i < count; i++) {
+            fds[i] = {modules[i].master, POLLIN, 0};
+            int due = modules[i].sendDue();
+            if (due >= 0 && (wait < 0 || due < wait)) wait = due;
+        }
+        if (poll(fds.data(), count, wait) < 0) {
+            perror("poll");
+            return 1;
+        }
+        for (int i = 0; i < count; i++) {
+            if (fds[i].revents & POLLIN) {
+                char data[512];
+                ssize_t got = read(modules[i].master, data, sizeof(data));
+                if (got > 0) modules[i].received(data, (int) got);
+            }
+        }
+    }
+}
@@ -0,0 +1,426 @@
+/*
+    soak_correlate.cpp - matches LoRa_Sensor_Tester stimulus records with hub logs
+    created by Bob Glicksman and Jim Schrempp
+    as part of Team Practical Projects (tpp)
+
+    20261018 - first version
+
+    The tester (Integration_testing/.../LoRa_Sensor_Tester, version 2) closes a relay on
+    each sensor and records every closure:
+
+        S,<run>,<trip number>,<channel>,<Unix time ms>,<on time ms>
+
+    on its serial port and in "LoRaTesterStimulus" events.  This tool reads those records
+    from any text (a serial capture, `particle subscribe` output, a webhook log; every
+    "S," record on a line is read) and the hub's log records from a hub_log_ingest column
+    store or text files, then for each channel:
+
+        matches each record from the channel's sensor to the latest unmatched closure
+        within the window before it.  A frame that carries several trips (" e: " from
+        the sensor's event queue) matches as many closures.
+        stimuli with no match are lost; records with no closure left to match are
+        unexpected (contact bounce, or a trip nobody made); a record repeating the
+        message number of the one before it is a duplicate.
+        trip to hub latency is the hub's record time less the closure time, trip to cloud
+        latency the event's published_at less the closure time.  Both use the Particle
+        cloud clock, so they are good to a few tens of ms.
+
+    The result is JSON on stdout (for comparing runs) and a summary on stderr.
+
+    Build:
+        g++ -std=c++17 -O2 -o soak_correlate soak_correlate.cpp
+
+    Run:
+        ./soak_correlate -t stimulus.txt -a 0=12648,1=11139 [-r run] [-w seconds] [-d store | hubLog.txt ...]
+            -t file     stimulus records; more than one -t is allowed
+            -a map      channel=sensor address for each relay channel used
+            -r run      the run to report; default the latest in the stimulus records
+            -w seconds  how long after a closure its frame may arrive; default 30
+            -d dir      column store written by hub_log_ingest
+
+        Hub text files have one LoRaHubLogging event's data per line, optionally after
+        the published_at time, as hub_log_report reads them.
+*/
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "../common/tpp_HubLogDecode.h"
+#include "../common/tpp_ColumnStore.h"
+
+#define CLOCK_SKEW_MS 2000      // a frame may appear to arrive this long before its closure
+
+struct Stimulus {
+    int trip;
+    int64_t timeMS;
+};
+
+struct HubRecord {
+    int64_t timeMS;
+    int64_t publishedMS;        // -1 if not known
+    int seq;
+    int trips;                  // closures this frame reports
+    int dropped;                // " d: " from the sensor
+};
+
+struct ChannelResult {
+    int channel = 0;
+    int address = 0;
+    int stimuli = 0;
+    int delivered = 0;
+    int lost = 0;
+    int duplicates = 0;
+    int unexpected = 0;
+    int droppedBySensor = 0;
+    std::vector<int64_t> hubLatency;
+    std::vector<int64_t> cloudLatency;
+    std::vector<int> lostTrips;
+};
+
+static std::map<int, std::map<int, std::vector<Stimulus>>> runs;   // run, channel
+static std::map<int, std::vector<HubRecord>> hubRecords;          // sensor address
+static std::map<int, int> addressOf;                               // channel
+
+// every "S,run,trip,channel,ms,on" on the line
+static void readStimulusLine(const char* line) {
+    for (const char* p = strstr(line, "S,"); p; p = strstr(p + 2, "S,")) {
+        long run;
+        int trip, channel;
+        long long ms;
+        if (sscanf(p, "S,%ld,%d,%d,%lld", &run, &trip, &channel, &ms) == 4) {
+            runs[(int) run][channel].push_back({trip, (int64_t) ms});
+        }
+    }
+}
+
+static bool readStimulus(const char* path) {
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return false;
+    }
+    char* line = nullptr;
+    size_t capacity = 0;
+    while (getline(&line, &capacity, f) > 0) {
+        readStimulusLine(line);
+    }
+    free(line);
+    fclose(f);
+    return true;
+}
+
+// the number of entries in " e: a,b,c"; 1 if there is no list
+static int tripsInFrame(const std::string& payload) {
+    size_t at = payload.find(" e: ");
+    if (at == std::string::npos) {
+        return 1;
+    }
+    int trips = 1;
+    for (size_t i = at + 4; i < payload.size() && payload[i] != ' '; i++) {
+        trips += payload[i] == ',';
+    }
+    return trips;
+}
+
+static int field(const std::string& payload, const char* name) {
+    size_t at = payload.find(name);
+    return at == std::string::npos ? 0 : atoi(payload.c_str() + at + strlen(name));
+}
+
+static void addHubRecord(int64_t timeMS, int64_t publishedMS, int device, int seq, char code, const std::string& payload) {
+    // heartbeats are sensor frames but not trips
+    if (seq < 0 || !tpp_hubLogIsSensorFrame(code) || code == TPP_HUBLOG_CODE_HEARTBEAT) {
+        return;
+    }
+    bool wanted = false;
+    for (auto& entry : addressOf) {
+        wanted = wanted || entry.second == device;
+    }
+    if (wanted) {
+        hubRecords[device].push_back({timeMS, publishedMS, seq, tripsInFrame(payload), field(payload, " d: ")});
+    }
+}
+
+static bool readHubText(const char* path) {
+    FILE* f = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return false;
+    }
+    char* line = nullptr;
+    size_t capacity = 0;
+    ssize_t length;
+    std::vector<tpp_HubLogRecord> records;
+    while ((length = getline(&line, &capacity, f)) > 0) {
+        std::string text(line, length);
+        while (!text.empty() && (text.back() == '\n' || text.back() == '\r')) text.pop_back();
+        int64_t publishedMS = -1;
+        size_t split = text.find_first_of("\t ");
+        if (split != std::string::npos && text.size() > 20 && text[4] == '-' && text[10] == 'T') {
+            publishedMS = tpp_parseIsoTimeMS(text.substr(0, split));
+            text.erase(0, split + 1);
+        }
+        records.clear();
+        tpp_decodeHubLog(text, records, publishedMS);
+        for (const tpp_HubLogRecord& r : records) {
+            addHubRecord(r.timeMS >= 0 ? r.timeMS : publishedMS, publishedMS, r.deviceNum, tpp_payloadSequence(r.payload),
+                r.code, r.payload);
+        }
+    }
+    free(line);
+    if (f != stdin) {
+        fclose(f);
+    }
+    return true;
+}
+
+// only the days the run covers are read
+static bool readStore(const std::string& root, int64_t fromMS, int64_t toMS) {
+    std::vector<std::string> partitions = tpp_storePartitions(root);
+    if (partitions.empty()) {
+        fprintf(stderr, "no partitions in %s\n", root.c_str());
+        return false;
+    }
+    auto dayName = [&root](int64_t ms) {
+        time_t seconds = (time_t) (ms / 1000);
+        struct tm t;
+        gmtime_r(&seconds, &t);
+        char text[16];
+        strftime(text, sizeof(text), "%Y-%m-%d", &t);
+        return root + "/" + text;
+    };
+    std::string first = dayName(fromMS), last = dayName(toMS);
+    for (const std::string& dir : partitions) {
+        if (dir < first || dir > last) {
+            continue;
+        }
+        tpp_StorePartition p;
+        if (!p.open(dir, false)) {
+            fprintf(stderr, "cannot read %s\n", dir.c_str());
+            continue;
+        }
+        size_t rows = p.rows();
+        const int64_t* timeMS = p.column<int64_t>(tpp_StorePartition::TIME);
+        const int64_t* publishedMS = p.column<int64_t>(tpp_StorePartition::PUBLISHED);
+        const int32_t* device = p.column<int32_t>(tpp_StorePartition::DEVICE);
+        const int32_t* seq = p.column<int32_t>(tpp_StorePartition::SEQ);
+        const uint8_t* code = p.column<uint8_t>(tpp_StorePartition::CODE);
+        for (size_t row = 0; row < rows; row++) {
+            if (timeMS[row] >= fromMS && timeMS[row] <= toMS && seq[row] >= 0 && addressOf.size()) {
+                addHubRecord(timeMS[row], publishedMS[row], device[row], seq[row], (char) code[row], p.payload(row));
+            }
+        }
+    }
+    return true;
+}
+
+static ChannelResult correlate(int channel, std::vector<Stimulus> stimuli, int64_t windowMS) {
+    ChannelResult result;
+    result.channel = channel;
+    result.address = addressOf[channel];
+    std::sort(stimuli.begin(), stimuli.end(), [](const Stimulus& a, const Stimulus& b) { return a.timeMS < b.timeMS; });
+    // the same record can be in the log twice if the tester's stimulus file was captured twice; keep trips unique
+    stimuli.erase(std::unique(stimuli.begin(), stimuli.end(),
+        [](const Stimulus& a, const Stimulus& b) { return a.trip == b.trip && a.timeMS == b.timeMS; }), stimuli.end());
+    result.stimuli = (int) stimuli.size();
+    if (stimuli.empty()) {
+        return result;
+    }
+
+    // this sensor's frames from the run, in arrival order, without duplicates
+    std::vector<HubRecord> frames;
+    int64_t from = stimuli.front().timeMS - CLOCK_SKEW_MS, to = stimuli.back().timeMS + windowMS;
+    std::vector<HubRecord>& all = hubRecords[result.address];
+    std::stable_sort(all.begin(), all.end(), [](const HubRecord& a, const HubRecord& b) { return a.timeMS < b.timeMS; });
+    for (const HubRecord& r : all) {
+        if (r.timeMS < from || r.timeMS > to) {
+            continue;
+        }
+        if (!frames.empty() && frames.back().seq == r.seq) {
+            result.duplicates++;
+            continue;
+        }
+        frames.push_back(r);
+        result.droppedBySensor += r.dropped;
+    }
+
+    // each frame takes the latest closures before it that are not matched yet, so a lost
+    // frame leaves its own closure unmatched rather than taking the next one's
+    std::vector<bool> matched(stimuli.size(), false);
+    std::vector<int64_t> latencyOf(stimuli.size()), cloudOf(stimuli.size());
+    size_t end = 0;     // stimuli before this are early enough for the current frame
+    for (const HubRecord& f : frames) {
+        while (end < stimuli.size() && stimuli[end].timeMS <= f.timeMS + CLOCK_SKEW_MS) {
+            end++;
+        }
+        int wanted = f.trips;
+        for (size_t i = end; i-- > 0 && wanted > 0;) {
+            if (stimuli[i].timeMS < f.timeMS - windowMS) {
+                break;
+            }
+            if (!matched[i]) {
+                matched[i] = true;
+                latencyOf[i] = f.timeMS - stimuli[i].timeMS;
+                cloudOf[i] = f.publishedMS >= 0 ? f.publishedMS - stimuli[i].timeMS : INT64_MIN;
+                wanted--;
+            }
+        }
+        result.unexpected += wanted;
+    }
+    for (size_t i = 0; i < stimuli.size(); i++) {
+        if (matched[i]) {
+            result.delivered++;
+            result.hubLatency.push_back(latencyOf[i]);
+            if (cloudOf[i] != INT64_MIN) {
+                result.cloudLatency.push_back(cloudOf[i]);
+            }
+        } else {
+            result.lost++;
+            result.lostTrips.push_back(stimuli[i].trip);
+        }
+    }
+    return result;
+}
+
+static int64_t percentile(std::vector<int64_t>& sorted, double fraction) {
+    if (sorted.empty()) return -1;
+    size_t i = (size_t) (fraction * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(i, sorted.size() - 1)];
+}
+
+static void writeLatency(FILE* out, const char* name, std::vector<int64_t> values) {
+    std::sort(values.begin(), values.end());
+    if (values.empty()) {
+        fprintf(out, "\"%s\": null", name);
+        return;
+    }
+    fprintf(out, "\"%s\": {\"count\": %zu, \"p50\": %lld, \"p90\": %lld, \"p99\": %lld, \"max\": %lld}", name, values.size(),
+        (long long) percentile(values, 0.5), (long long) percentile(values, 0.9), (long long) percentile(values, 0.99),
+        (long long) values.back());
+}
+
+static void writeResult(FILE* out, const ChannelResult& r, const char* name) {
+    fprintf(out, "    {\"channel\": %s, \"address\": %d, \"stimuli\": %d, \"delivered\": %d, \"lost\": %d, "
+        "\"lossPercent\": %.2f, \"duplicates\": %d, \"unexpected\": %d, \"droppedBySensor\": %d,\n      ",
+        name, r.address, r.stimuli, r.delivered, r.lost, r.stimuli ? 100.0 * r.lost / r.stimuli : 0.0, r.duplicates,
+        r.unexpected, r.droppedBySensor);
+    writeLatency(out, "tripToHubMS", r.hubLatency);
+    fprintf(out, ",\n      ");
+    writeLatency(out, "tripToCloudMS", r.cloudLatency);
+    fprintf(out, ",\n      \"lostTrips\": [");
+    for (size_t i = 0; i < r.lostTrips.size(); i++) {
+        fprintf(out, "%s%d", i ? ", " : "", r.lostTrips[i]);
+    }
+    fprintf(out, "]}");
+}
+
+static void usage(const char* name) {
+    fprintf(stderr, "usage: %s -t stimulus.txt -a channel=address[,...] [-r run] [-w seconds] [-d store | hubLog.txt ...]\n",
+        name);
+}
+
+int main(int argc, char** argv) {
+    std::vector<const char*> stimulusFiles, hubFiles;
+    std::string storeDir;
+    int run = -1;
+    int64_t windowMS = 30000;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) stimulusFiles.push_back(argv[++i]);
+        else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) storeDir = argv[++i];
+        else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) run = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc) windowMS = (int64_t) (atof(argv[++i]) * 1000);
+        else if (strcmp(argv[i], "-a") == 0 && i + 1 < argc) {
+            const char* p = argv[++i];
+            int channel, address, used;
+            while (sscanf(p, "%d=%d%n", &channel, &address, &used) == 2) {
+                addressOf[channel] = address;
+                p += used;
+                if (*p == ',') p++;
+            }
+        }
+        else if (argv[i][0] == '-' && argv[i][1]) {
+            usage(argv[0]);
+            return 2;
+        }
+        else hubFiles.push_back(argv[i]);
+    }
+    if (stimulusFiles.empty() || addressOf.empty() || (storeDir.empty() && hubFiles.empty())) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    for (const char* path : stimulusFiles) {
+        if (!readStimulus(path)) return 1;
+    }
+    if (runs.empty()) {
+        fprintf(stderr, "no stimulus records found\n");
+        return 1;
+    }
+    if (run < 0) {
+        run = runs.rbegin()->first;
+    }
+    if (!runs.count(run)) {
+        fprintf(stderr, "no records of run %d\n", run);
+        return 1;
+    }
+    auto& channels = runs[run];
+
+    int64_t firstMS = INT64_MAX, lastMS = INT64_MIN;
+    for (auto& entry : channels) {
+        for (const Stimulus& s : entry.second) {
+            firstMS = std::min(firstMS, s.timeMS);
+            lastMS = std::max(lastMS, s.timeMS);
+        }
+    }
+    if (!storeDir.empty() && !readStore(storeDir, firstMS - CLOCK_SKEW_MS, lastMS + windowMS)) {
+        return 1;
+    }
+    for (const char* path : hubFiles) {
+        if (!readHubText(path)) return 1;
+    }
+
+    std::vector<ChannelResult> results;
+    ChannelResult total;
+    for (auto& entry : channels) {
+        if (!addressOf.count(entry.first)) {
+            fprintf(stderr, "channel %d has no sensor address (-a); skipped\n", entry.first);
+            continue;
+        }
+        ChannelResult r = correlate(entry.first, entry.second, windowMS);
+        total.stimuli += r.stimuli;
+        total.delivered += r.delivered;
+        total.lost += r.lost;
+        total.duplicates += r.duplicates;
+        total.unexpected += r.unexpected;
+        total.droppedBySensor += r.droppedBySensor;
+        total.hubLatency.insert(total.hubLatency.end(), r.hubLatency.begin(), r.hubLatency.end());
+        total.cloudLatency.insert(total.cloudLatency.end(), r.cloudLatency.begin(), r.cloudLatency.end());
+        results.push_back(r);
+        fprintf(stderr, "channel %d (sensor %d): %d of %d delivered, %d lost, %d duplicates, %d unexpected\n", r.channel,
+            r.address, r.delivered, r.stimuli, r.lost, r.duplicates, r.unexpected);
+    }
+    std::vector<int64_t> sortedCloud = total.cloudLatency;
+    std::sort(sortedCloud.begin(), sortedCloud.end());
+    fprintf(stderr, "run %d: loss %.2f%%, trip to cloud p50 %lld ms p99 %lld ms\n", run,
+        total.stimuli ? 100.0 * total.lost / total.stimuli : 0.0, (long long) percentile(sortedCloud, 0.5),
+        (long long) percentile(sortedCloud, 0.99));
+
+    printf("{\n  \"run\": %d,\n  \"windowMS\": %lld,\n  \"channels\": [\n", run, (long long) windowMS);
+    for (size_t i = 0; i < results.size(); i++) {
+        char name[16];
+        snprintf(name, sizeof(name), "%d", results[i].channel);
+        writeResult(stdout, results[i], name);
+        printf("%s\n", i + 1 < results.size() ? "," : "");
+    }
+    printf("  ],\n  \"total\":\n");
+    total.address = -1;
+    writeResult(stdout, total, "\"all\"");
+    printf("\n}\n");
+    return 0;
+}
@@ -9,6 +9,22 @@
  *  The results of the sensor tests can be seen in the Google spreadsheet logs.
  * 
  * Version 1.00 - Initial release.
+ * Version 2.00 - soak test.  Up to four relay channels, each wired to its own sensor and each
+ *  with its own schedule: NUMBER_OF_SENSOR_TRIPS closures of SENSOR_ON_TIME ms, with an off
+ *  time between SENSOR_OFF_TIME_MIN and SENSOR_OFF_TIME_MAX ms (random when they differ).
+ *  Every closure is a stimulus record:
+ * 
+ *      S,<run>,<trip number>,<channel>,<Unix time of the closure in ms>,<on time ms>
+ * 
+ *  printed on the USB serial port and published as "LoRaTesterStimulus" events (several
+ *  records in one event, separated by ';', so the publish rate limit is never hit).  <run>
+ *  is the Unix time the run started, so the records of different runs can not be mixed up.
+ *  Host_Tools/soak_correlate matches the records with the hub logs and reports loss,
+ *  duplicates and trip to hub and trip to cloud latency.
+ *  The run starts once the cloud has set the clock; the D7 LED is on until then.
+ * Version 2.01 - while the cloud is away, stimulus events wait in a queue of up to
+ *  PUBLISH_QUEUE_EVENTS; when it is full the oldest event is dropped and its records counted
+ *  (they are still in the serial log), instead of one ever longer event that never publishes.
  * 
  *  (c) 2024, by Bob Glicksman, Jim Schrempp, Team Practical Projects
  */
@@ -22,41 +38,167 @@ SYSTEM_MODE(AUTOMATIC);
 // Run the application and system concurrently in separate threads
 SYSTEM_THREAD(ENABLED);
 
-#define NUMBER_OF_SENSOR_TRIPS 300
+#define NUMBER_OF_SENSOR_TRIPS 300    // per channel
 #define SENSOR_ON_TIME 2000
-#define SENSOR_OFF_TIME 58000
+#define SENSOR_OFF_TIME_MIN 58000
+#define SENSOR_OFF_TIME_MAX 58000     // set higher than SENSOR_OFF_TIME_MIN for random off times
+#define RANDOM_SEED 0                 // 0: a different sequence each run; otherwise repeatable
 
-#define RELAY_PIN D0
-#define LED_PIN D5
+#define NUMBER_OF_CHANNELS 1          // 1 - 4; relay pins below
+const int relayPins[] = {D0, D1, D2, D3};
+#define LED_PIN D5                    // on while any relay is closed
 #define INTERNAL_LED_PIN D7
 
+#define PUBLISH_INTERVAL 1100         // ms between stimulus events (the cloud allows about one a second)
+#define PUBLISH_MAX_LENGTH 600        // a new event is started before the event data gets longer than this
+#define PUBLISH_QUEUE_EVENTS 16       // events waiting to be published; the oldest is dropped when full
+
+struct Channel {
+  int trips;                          // closures so far
+  bool closed;
+  unsigned long nextChangeMS;         // millis() of the next close or open
+};
+Channel channels[NUMBER_OF_CHANNELS];
+
+unsigned long runID = 0;
+String queued[PUBLISH_QUEUE_EVENTS];  // events waiting, oldest at queueFirst; the newest is still filling
+int queuedRecords[PUBLISH_QUEUE_EVENTS];
+int queueFirst = 0;
+int queueCount = 0;
+unsigned long recordsDropped = 0;
+unsigned long lastPublishMS = 0;
+
+// Unix time in ms: the cloud clock's seconds, and millis() since the second last changed
+time_t lastSecond = 0;
+unsigned long secondStartMS = 0;
+
+void trackClock() {
+  time_t now = Time.now();
+  if (now != lastSecond) {
+    lastSecond = now;
+    secondStartMS = millis();
+  }
+}
+
+String unixMS() {
+  unsigned long intoSecond = millis() - secondStartMS;
+  if (intoSecond > 999) {
+    intoSecond = 999;
+  }
+  char text[24];
+  snprintf(text, sizeof(text), "%lu%03lu", (unsigned long) lastSecond, intoSecond);
+  return String(text);
+}
+
+unsigned long offTime() {
+  if (SENSOR_OFF_TIME_MAX > SENSOR_OFF_TIME_MIN) {
+    return random(SENSOR_OFF_TIME_MIN, SENSOR_OFF_TIME_MAX + 1);
+  }
+  return SENSOR_OFF_TIME_MIN;
+}
+
+void recordStimulus(int channel, int trip) {
+  String record = "S," + String(runID) + "," + String(trip) + "," + String(channel) + "," + unixMS()
+    + "," + String(SENSOR_ON_TIME);
+  Serial.println(record);
+  int last = (queueFirst + queueCount - 1) % PUBLISH_QUEUE_EVENTS;
+  if (queueCount == 0 || queued[last].length() + record.length() + 1 > PUBLISH_MAX_LENGTH) {
+    if (queueCount == PUBLISH_QUEUE_EVENTS) {
+      // the cloud has been away a long time: make room
+      recordsDropped += queuedRecords[queueFirst];
+      queued[queueFirst] = "";
+      queueFirst = (queueFirst + 1) % PUBLISH_QUEUE_EVENTS;
+      queueCount--;
+    }
+    last = (queueFirst + queueCount) % PUBLISH_QUEUE_EVENTS;
+    queued[last] = "";
+    queuedRecords[last] = 0;
+    queueCount++;
+  } else {
+    queued[last] += ";";
+  }
+  queued[last] += record;
+  queuedRecords[last]++;
+}
+
+// the oldest event; it stays queued if the publish fails
+void publishRecords() {
+  if (queueCount == 0) {
+    return;
+  }
+  if (Particle.publish("LoRaTesterStimulus", queued[queueFirst], PRIVATE)) {
+    queued[queueFirst] = "";
+    queueFirst = (queueFirst + 1) % PUBLISH_QUEUE_EVENTS;
+    queueCount--;
+  }
+  lastPublishMS = millis();
+}
 
 void setup() {
-  pinMode(RELAY_PIN, OUTPUT);
+  Serial.begin(115200);
   pinMode(LED_PIN, OUTPUT);
   pinMode(INTERNAL_LED_PIN, OUTPUT);
+  for (int i = 0; i < NUMBER_OF_CHANNELS; i++) {
+    pinMode(relayPins[i], OUTPUT);
+    digitalWrite(relayPins[i], LOW);
+  }
 
-  // signal that the Photon is reset and getting ready to test
+  // signal that the Photon is reset and getting ready to test; the run needs the cloud's clock
   digitalWrite(INTERNAL_LED_PIN, HIGH);
   delay(5000); 
+  waitUntil(Time.isValid);
   digitalWrite(INTERNAL_LED_PIN, LOW);
 
-  // loop through NUMBER_OF_SENSOR_TRIPS times, closing and opening the relay
-  for(int i = 0; i < NUMBER_OF_SENSOR_TRIPS; i++) {
-    digitalWrite(RELAY_PIN, HIGH);
-    digitalWrite(LED_PIN, HIGH);
-    delay(SENSOR_ON_TIME);
-    digitalWrite(RELAY_PIN, LOW);
-    digitalWrite(LED_PIN, LOW);
-    delay(SENSOR_OFF_TIME);
-  }
-
+  randomSeed(RANDOM_SEED ? RANDOM_SEED : HAL_RNG_GetRandomNumber());
+  trackClock();
+  runID = Time.now();
+  Serial.println("soak run " + String(runID) + ", " + String(NUMBER_OF_CHANNELS) + " channels");
 
+  // spread the channels' first closures over the first off time
+  for (int i = 0; i < NUMBER_OF_CHANNELS; i++) {
+    channels[i].trips = 0;
+    channels[i].closed = false;
+    channels[i].nextChangeMS = millis() + 1000 + (unsigned long) i * SENSOR_OFF_TIME_MIN / NUMBER_OF_CHANNELS;
+  }
 }
 
 
 void loop() {
 
-  // Nothing here!
+  trackClock();
+
+  bool anyClosed = false;
+  bool allDone = true;
+  for (int i = 0; i < NUMBER_OF_CHANNELS; i++) {
+    Channel& c = channels[i];
+    if (c.closed || c.trips < NUMBER_OF_SENSOR_TRIPS) {
+      allDone = false;
+    }
+    if ((long) (millis() - c.nextChangeMS) >= 0 && (c.closed || c.trips < NUMBER_OF_SENSOR_TRIPS)) {
+      if (!c.closed) {
+        digitalWrite(relayPins[i], HIGH);
+        c.closed = true;
+        c.trips++;
+        recordStimulus(i, c.trips);
+        c.nextChangeMS = millis() + SENSOR_ON_TIME;
+      } else {
+        digitalWrite(relayPins[i], LOW);
+        c.closed = false;
+        c.nextChangeMS = millis() + offTime();
+      }
+    }
+    anyClosed = anyClosed || c.closed;
+  }
+  digitalWrite(LED_PIN, anyClosed ? HIGH : LOW);
+
+  if (queueCount && millis() - lastPublishMS > PUBLISH_INTERVAL) {
+    publishRecords();
+  }
+
+  static bool reported = false;
+  if (allDone && queueCount == 0 && !reported) {
+    reported = true;
+    Serial.println("soak run " + String(runID) + " done, " + String(recordsDropped) + " records not published");
+  }
 
 }
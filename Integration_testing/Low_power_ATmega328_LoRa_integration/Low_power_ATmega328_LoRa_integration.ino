@@ -83,12 +83,26 @@
  *      This version of the code also uses the F() macro for all string literals which avoids them being copied 
  *      from program memory to RAM an extra time.
  *      
+ *    Version 1.50, 10/18/26
+ *      waitForOK() no longer blocks forever.  It idle sleeps the microcontroller while waiting for the LoRa
+ *      module (the UART receive interrupt wakes it), assembles the response a character at a time up to the
+ *      end of line, and returns -1 if no complete line arrives within LORA_RESPONSE_TIMEOUT_MS.
+ *      
+ *    Version 1.60, 10/18/26
+ *      heartbeat.  With HEARTBEAT_HOURS not 0 the watchdog timer runs in interrupt mode (about 8 seconds, no reset)
+ *      and its interrupt only counts; no Arduino timer runs while asleep.  A watchdog wake up that is not a contact
+ *      closure goes straight back to sleep unless HEARTBEAT_HOURS have passed with nothing sent, when the message
+ *      "H m: <n> h: <hours> w: <watchdog wake ups>" goes to the hub.  A contact closure message starts the interval
+ *      again.  The first heartbeat after reset is offset within the interval by an amount taken from the device
+ *      address, so sensors reset together by a power cut do not all send together.
+ *      
  *    (c) 2024, Bob Glicksman, Jim Schrempp, Team Practical Projects.  All rights reserved.
  */
 
 #include <avr/sleep.h>  // the official avr sleep library
+#include <avr/wdt.h>    // the watchdog timer, for heartbeats
 
-#define VERSION 1.40
+#define VERSION 1.60
 
 #define DEBUG
 
@@ -96,6 +110,11 @@
 
 #define BASE_DEVICE_ADDRESS 12000 // the base address for this class of sensor.  Jumpers will modify the actual device address. 
 
+#define LORA_RESPONSE_TIMEOUT_MS 5000 // give up on a LoRa response after this long
+
+#define HEARTBEAT_HOURS 0 // send a heartbeat when nothing has been sent for this many hours (1 - 145); 0 for none
+#define WATCHDOG_PERIOD_MS 8000UL // the watchdog interrupt period (WDP3 | WDP0)
+
 // CONSTANTS
 const int BUTTON_PIN = 2; // the pushbutton is on digital pin 2 which is chip pin 4
 const int GRN_LED_PIN = 9;  // the Green LED is on digital pin 9 which is chip pin 15
@@ -108,6 +127,10 @@ const int ADR4_PIN = 12;  // the device address = BASE_DEVICE_ADDRESS + (ADR4 +
 // Globals
 String messageBuffer;
 uint8_t msgNum = 0; // one up message number
+volatile bool tripped = false; // set by the contact closure interrupt
+volatile uint16_t watchdogPeriods = 0; // watchdog interrupts since the last message; counted while asleep
+uint16_t heartbeatAt = 0; // watchdogPeriods count at which a heartbeat is due
+unsigned long watchdogWakeups = 0; // watchdog wake ups since the last heartbeat
 
 void setup() {
 
@@ -144,7 +167,7 @@ void setup() {
   Serial.setTimeout(10);  // a full string is received after 10 ms of no new data from the LoRa device
 
   // reserve space in a message buffer string for message assembly
-  messageBuffer.reserve(32);  // this is larger than the sensor trip message will ever be
+  messageBuffer.reserve(48);  // this is larger than the sensor trip or heartbeat message will ever be
 
   // initial comms with the LoRa module
   Serial.println(F("AT"));
@@ -169,6 +192,20 @@ void setup() {
     #endif
   }
 
+  // start the watchdog heartbeat; the first one at an offset in the interval taken from the address
+  #if HEARTBEAT_HOURS
+  heartbeatAt = (uint16_t) ((deviceAddress * 40503UL) % heartbeatPeriods());
+  if(heartbeatAt == 0) {
+    heartbeatAt = heartbeatPeriods();
+  }
+  noInterrupts();
+  wdt_reset();
+  MCUSR &= ~bit(WDRF);
+  WDTCSR = bit(WDCE) | bit(WDE);  // timed sequence to change the prescaler
+  WDTCSR = bit(WDIE) | bit(WDP3) | bit(WDP0); // interrupt only, no reset, 8 seconds
+  interrupts();
+  #endif
+
   // blink the LEDs to show that setup() is complete
   blinkLed(GRN_LED_PIN, 2);
   blinkLed(RED_LED_PIN, 2);
@@ -202,7 +239,18 @@ void loop() {
   sleep_cpu();
 
   //  everything should now be in deep sleep.
-  // Interrupt 0 wakes up the ATmega328 - send the message and go back to sleep
+  // Interrupt 0 wakes up the ATmega328 - send the message and go back to sleep.
+  // The watchdog also wakes it; go back to sleep unless a heartbeat is due.
+
+  noInterrupts();
+  bool sendTrip = tripped;
+  tripped = false;
+  uint16_t periods = watchdogPeriods;
+  interrupts();
+  bool sendHeartbeat = HEARTBEAT_HOURS && periods >= heartbeatAt;
+  if(!sendTrip && !sendHeartbeat) {
+    return;
+  }
 
   #ifdef DEBUG
   pinMode(GRN_LED_PIN, OUTPUT);
@@ -220,11 +268,32 @@ void loop() {
     #endif
   }
 
-  // assemble the sensor trip message in the message buffer
+  // assemble the sensor trip message, or the heartbeat, in the message buffer
+  String payload;
+  if(sendTrip) {
+    payload = F("G m: ");
+    payload += (msgNum++)%10;
+  } else {
+    payload = F("H m: ");
+    payload += (msgNum++)%10;
+    payload += F(" h: ");
+    payload += HEARTBEAT_HOURS;
+    payload += F(" w: ");
+    payload += watchdogWakeups + periods;
+  }
   messageBuffer = F("AT+SEND="); // the message preamble
   messageBuffer += HUB_ADDRESS;
-  messageBuffer += ",6,G m: ";
-  messageBuffer += (msgNum++)%10;
+  messageBuffer += ',';
+  messageBuffer += payload.length();
+  messageBuffer += ',';
+  messageBuffer += payload;
+
+  // any message starts the heartbeat interval again; the wake ups are reported with the next heartbeat
+  noInterrupts();
+  watchdogWakeups = sendTrip ? watchdogWakeups + watchdogPeriods : 0;
+  watchdogPeriods = 0;
+  interrupts();
+  heartbeatAt = heartbeatPeriods();
    
   // send out the contact closed message
   Serial.println(messageBuffer);
@@ -270,21 +339,70 @@ void blinkLed(int ledpin, int times) {
 // the interrupt service routine that wakes up the microcontroller
 
 void isr () {
+  tripped = true;
   sleep_disable();  // cancel sleep mode for now
   detachInterrupt(digitalPinToInterrupt(BUTTON_PIN));  // preclude more interrupts due to bounce, or other
   
 } // end of isr()
 
+// the watchdog interrupt: counts the periods while asleep, nothing more
+
+ISR(WDT_vect) {
+  watchdogPeriods++;
+  sleep_disable();
+} // end of watchdog ISR
+
+// heartbeatPeriods(): the number of watchdog periods in HEARTBEAT_HOURS
+
+uint16_t heartbeatPeriods() {
+  return (uint16_t) (HEARTBEAT_HOURS * 3600000UL / WATCHDOG_PERIOD_MS);
+} // end of heartbeatPeriods()
+
+// waitForData(): idle sleeps until the LoRa module sends something or timeoutMS passes.  Idle sleep stops the
+//  CPU but not the UART or timer 0, so the receive interrupt or the next millis() tick (every 1.024 ms) wakes it.
+//  returns true if there is data to read.
+
+bool waitForData(unsigned long timeoutMS) {
+  unsigned long startTime = millis();
+  while(Serial.available() <= 0) {
+    if(millis() - startTime >= timeoutMS) {
+      return false;
+    }
+    set_sleep_mode(SLEEP_MODE_IDLE);
+    noInterrupts();
+    if(Serial.available() <= 0) {
+      sleep_enable();
+      interrupts();  // the instruction after sei always runs, so the interrupt cannot be missed
+      sleep_cpu();
+      sleep_disable();
+    }
+    interrupts();
+  }
+  return true;
+} // end of waitForData()
+
 // waitForOK():  processes the response from the LoRa module.  It shoudl always be "+OK"
-//  returns 0 if response was correct.  Otherwise, returns -1.  Note: blocks waiting for some (any) response
-//  from the LoRa module.  A non-blocking timeout should be implemented for production.
+//  returns 0 if response was correct.  Otherwise, returns -1, including when no complete line arrives within
+//  LORA_RESPONSE_TIMEOUT_MS.
 
 int waitForOK() {
-  // wait for data in the serial buffer
-  while(Serial.available() <=0) {}  // loop until data in the buffer
-
-  // read out the whole string (note: setTimeout(10) ensures that the whole string is read
-  String receivedData = Serial.readString();
+  String receivedData;
+  unsigned long startTime = millis();
+
+  // assemble the response a character at a time up to the end of line
+  while(true) {
+    unsigned long elapsed = millis() - startTime;
+    if(elapsed >= LORA_RESPONSE_TIMEOUT_MS || !waitForData(LORA_RESPONSE_TIMEOUT_MS - elapsed)) {
+      return -1;  // the LoRa module is silent
+    }
+    char c = Serial.read();
+    if(c == '\n') {
+      break;
+    }
+    if(receivedData.length() < 32) {
+      receivedData += c;
+    }
+  }
 
   // test for "+OK"
   if(receivedData.indexOf(F("+OK")) >= 0) { // got an +OK
@@ -10,6 +10,9 @@
  * 
  *    When the D& LED blinks rapidly, the LoRa module has been configured.
  * 
+ *    To configure many modules at once from a laptop with USB serial adapters, see
+ *    Host_Tools/lora_provision.
+ * 
  * Description:  
  *  This is code for a configuration jig for LoRa.  The jig is based upon
  *  a Particle Photon (any Arduino can be used in its place).
@@ -33,8 +33,19 @@ function test() {
       var timeParticle = e.parameter.published_at;
       var hubData = e.parameter.data;
       
-      // add a row to the sheet
-      sheet.appendRow([timePST, coreid, timeParticle, hubData] );
+      var records = decodeHubLog(hubData);
+      if (records.length == 0) {
+        // not a format we know; keep the raw text
+        sheet.appendRow([timePST, coreid, timeParticle, hubData] );
+      } else {
+        // one row per record, written in one call. Column 4 keeps the original text layout
+        var rows = records.map(function(r) {
+          var text = "message=" + r.message + "|deviceNum=" + r.deviceNum + "|payload=" + r.payload
+            + "|SNRhub1=" + r.SNR + "|RSSIHub1=" + r.RSSI;
+          return [timePST, coreid, timeParticle, text, r.time, r.message, r.deviceNum, r.payload, r.SNR, r.RSSI];
+        });
+        sheet.getRange(sheet.getLastRow() + 1, 1, rows.length, rows[0].length).setValues(rows);
+      }
   
     } catch(error) {  
       sheet.appendRow(["Error in GApp: " + error, "PostData: " + JSON.stringify(e.postData)]);
@@ -46,6 +57,67 @@ function test() {
     return 0;
   }
   
+  // message codes of the compact format; see tpp_HubLogFormat.h in the hub source
+  var HUBLOG_CODE_NAMES = {
+    "A": "TESTOK",
+    "N": "NOPE",
+    "F": "Send of TESTOK failed",
+    "S": "Simulated_Sensor",
+    "M": "Sensor_Missing",
+    "R": "Sensor_Back",
+    "H": "Heartbeat",
+    "E": "Help_Button",
+    "X": "Auth_Failed",
+    "C": "Config_Applied",
+    "L": "LoRa_Recovery"
+  };
+  
+  // decodeHubLog(): the records in the data of a LoRaHubLogging event.  Handles the compact
+  //  format, version 1 ("1|<baseTime>|<record>;<record>..."), and the original
+  //  "message=...|deviceNum=..." text.  Returns [] for anything else.
+  function decodeHubLog(data) {
+    var records = [];
+    if (data.indexOf("1|") == 0) {
+      var header = data.split("|", 2);
+      var baseTime = parseInt(header[1], 10);
+      var body = data.substring(header[0].length + header[1].length + 2);
+      body.split(";").forEach(function(rec) {
+        var f = [];
+        var rest = rec;
+        for (var i = 0; i < 5; i++) {
+          var comma = rest.indexOf(",");
+          if (comma < 0) { return; }
+          f.push(rest.substring(0, comma));
+          rest = rest.substring(comma + 1);
+        }
+        var dtMS = parseInt(f[0], 10);
+        records.push({
+          time: baseTime > 0 ? new Date(baseTime * 1000 + dtMS).toISOString() : "+" + dtMS + "ms",
+          message: HUBLOG_CODE_NAMES[f[1]] || f[1],
+          deviceNum: parseInt(f[2], 10),
+          SNR: parseInt(f[3], 10),
+          RSSI: parseInt(f[4], 10),
+          payload: decodeURIComponent(rest.replace(/%(?![0-9A-Fa-f]{2})/g, "%25"))
+        });
+      });
+    } else if (data.indexOf("message=") == 0) {
+      var fields = {};
+      data.split("|").forEach(function(pair) {
+        var eq = pair.indexOf("=");
+        if (eq > 0) { fields[pair.substring(0, eq)] = pair.substring(eq + 1); }
+      });
+      records.push({
+        time: "",
+        message: fields["message"],
+        deviceNum: parseInt(fields["deviceNum"], 10),
+        SNR: parseInt(fields["SNRhub1"], 10),
+        RSSI: parseInt(fields["RSSIHub1"], 10),
+        payload: fields["payload"]
+      });
+    }
+    return records;
+  }
+  
   function cleanUpSheet(sheet) {
     
     const MAX_ROWS = 3000;  // delete some rows if sheet has more than this
@@ -19,10 +19,10 @@
  * 
  * The sensor is assigned any device number and the hub is assigned device number 57248 (an arbitrary
  *  choice in the range  0 - 65535). See the tpp_LoRa.h file.  The network
- *  number used for testing is 18 and the baud rate to/from the LoRa modem is 38400.  Otherwise,
+ *  number used for testing is 18.  Otherwise,
  *  the default LoRa module values are used.  NOTE: the hub code will set up these
- *  values in the LoRa module when it boots - with the exception of baud rate.  The LoRa modules 
- *  baud rate are set up using a laptop and an FTDI USB-serial board.
+ *  values in the LoRa module when it boots.  The baud rate is found at boot and the module is
+ *  switched to 115200 (TPP_LORA_MAX_BAUD in tpp_LoRaGlobals.h).
  * 
  * 
  * version 1.0; 4/25/24
@@ -39,30 +39,162 @@
  *          Particle Console or from an app that uses the Particle REST API.  The app can be
  *          used to generated administrative messages, in addition to the Hub processing the
  *          LoRa sensor messages.
+ * ver 3.1  10/18/2026
+ *      - LoRa module is configured with configIfNeeded(). A fingerprint of the settings is kept
+ *          in EEPROM so a reboot only reads back the module UID instead of rewriting and
+ *          reading back every setting. Set FORCE_LORA_REPROGRAM to 1, or call the 
+ *          "LoRaReprogram" cloud function, to rewrite every setting.
+ * ver 3.2  10/18/2026
+ *      - cloud log events use the compact, versioned record format in tpp_HubLogFormat.h and
+ *          several records are batched into one publish (tpp_HubLog).  LOG_FORMAT_COMPACT 0
+ *          goes back to one "message=...|deviceNum=..." event per message.
+ * ver 3.3  10/18/2026
+ *      - airtime meter (tpp_AirtimeMeter): channel use, time the hub is deaf while it replies,
+ *          and sensor frames probably lost while it was transmitting, over the last 1, 10 
+ *          and 60 minutes. Printed every minute and in the "Airtime" cloud variable.
+ * ver 3.4  10/18/2026
+ *      - answers the sensor's BENCHMARK_MODE messages (tpp_HubBenchmark) and prints a summary
+ *          of each run. BENCHMARK_PROFILE selects the radio profile; it must match the sensor's.
+ * ver 3.5  10/18/2026
+ *      - ACK_AGGREGATION 1 holds acks for up to TPP_ACK_HOLD_MS and sends them in one broadcast
+ *          frame of (address, message number) pairs (tpp_AckAggregator) instead of a TESTOK to
+ *          each sensor. Needs sensors at version 2.16 or later. Messages without a message
+ *          number still get TESTOK at once.
+ * ver 3.6  10/18/2026
+ *      - sensor registry (tpp_SensorRegistry): every address heard, with the interval it should
+ *          be heard in (the " h: " heartbeat hours in its frames, the "SensorInterval" cloud
+ *          function, or SENSOR_WATCH_DEFAULT_HOURS).  A sensor silent for two intervals is
+ *          logged as Sensor_Missing, and as Sensor_Back when it is heard again.  The registry
+ *          is saved to the file system and survives a reboot. "Sensors" cloud variable.
+ * ver 3.7  10/18/2026
+ *      - heartbeat frames (TPP_LORA_MSG_HEARTBEAT, sensor version 2.17) are logged as Heartbeat
+ *          and not answered; the registry takes the interval from their " h: ".
+ * ver 3.8  10/18/2026
+ *      - frames are sent to a handler by their first byte (tpp_MessageRouter) instead of looking
+ *          for a "G" anywhere in the payload.  The type byte must be followed by a space, so a
+ *          payload that merely contains a G is now unknown (NOPE).  Handlers for gate/door (G),
+ *          help button (E, logged as Help_Button and acked), heartbeat (H) and benchmark (B)
+ *          frames. "MessageCounts" cloud variable with the frames of each type.
+ * ver 3.9  10/18/2026
+ *      - AUTH_MODE: checks the " k: <counter>,<tag>" field of signed frames (tpp_Auth, sensor
+ *          AUTH_FRAMES) and refuses a frame whose tag is wrong or whose counter the registry
+ *          has already seen, logging it as Auth_Failed and not answering.  With AUTH_MODE 2
+ *          unsigned frames are refused too.  The field is taken off before the frame is used.
+ * ver 4.0  10/18/2026
+ *      - local rules (tpp_Rules): a frame from a given address range, of a given type, in a
+ *          given time window drives a pin, plays a buzzer pattern or prints on the USB serial
+ *          port as soon as it is received, before any cloud work, and with no internet.  Set
+ *          with the "Rules" cloud function, kept in the file system.  HUB_TIME_ZONE is the
+ *          local time for the rules' windows.
+ * ver 4.1  10/18/2026
+ *      - event stream (tpp_EventStream): with EVENT_STREAM_PORT set, subscribers on the local
+ *          network (Clip Play App, Host_Tools/hub_stream) connect over TCP and are sent every
+ *          frame as soon as it is received, and the records the hub makes itself (missing,
+ *          refused ...), without going through the cloud.  See tpp_EventStreamFormat.h.
+ * ver 4.2  10/18/2026
+ *      - downlink settings (tpp_DownlinkQueue): the "Downlink" cloud function queues settings for
+ *          a sensor (heartbeat hours, retries, ack wait, LEDs; see tpp_LoRaConfigKeys),
+ *          which go in the TESTOK of its next frame.  The sensor (version 2.19) confirms them in
+ *          its following frame, logged as Config_Applied.  A sensor with settings waiting gets a
+ *          TESTOK of its own even with ACK_AGGREGATION.  With AUTH_MODE the settings carry a tag.
+ *          "Downlinks" cloud variable.
+ * ver 4.3  10/18/2026
+ *      - repeaters (Range_Test_Repeater, tpp_Relay): a sensor's frame passed on by one or more
+ *          repeaters is handled as if it came from the sensor, and logged with the path it took
+ *          (" r: " repeater:SNR:RSSI/...).  Its TESTOK or NOPE goes back through the same
+ *          repeaters, never in a broadcast ack frame.  A copy of a frame already heard another
+ *          way within TPP_RELAY_DUPLICATE_MS is dropped; if the first copy was acked, a
+ *          relayed copy gets the TESTOK again through its own path.  "Relays" cloud variable.
+ * ver 4.4  10/18/2026
+ *      - LoRa supervisor (tpp_LoRaSupervisor): a module that stops answering commands, or that
+ *          answers but hears nothing while every watched sensor goes missing (or for
+ *          LORA_SILENCE_MINUTES), is brought back in stages: AT again, every setting written
+ *          again, then a reset or power cycle through LORA_RESET_PIN / LORA_POWER_PIN if they
+ *          are wired.  A module that does not start at boot is handled the same way instead of
+ *          blinking forever.  Each episode is logged as LoRa_Recovery with the time to detect
+ *          and to recover.  "LoRaHealth" cloud variable.
  */
 
 #include "Particle.h"
 #include "tpp_LoRa.h"
+#include "tpp_HubLog.h"
+#include "tpp_AirtimeMeter.h"
+#include "tpp_HubBenchmark.h"
+#include "tpp_AckAggregator.h"
+#include "tpp_SensorRegistry.h"
+#include "tpp_MessageRouter.h"
+#include "tpp_Auth.h"
+#include "tpp_Rules.h"
+#include "tpp_EventStream.h"
+#include "tpp_DownlinkQueue.h"
+#include "tpp_Relay.h"
+#include "tpp_LoRaSupervisor.h"
 
 #define LOG_TO_CLOUD 1 // set to 1 to log to the cloud; 0 to not log to the cloud
+#define LOG_FORMAT_COMPACT 1 // 1: batched records as in tpp_HubLogFormat.h; 0: one "message=..." event per message
+#define FORCE_LORA_REPROGRAM 0 // set to 1 to write every LoRa setting at boot, ignoring the EEPROM fingerprint
+#define ACK_AGGREGATION 0 // 1: acks go out together in broadcast frames; 0: a TESTOK to each sensor at once
+#define SENSOR_WATCH_DEFAULT_HOURS 0 // expected interval for sensors that send no heartbeat; 0: only watch those that do
+#define AUTH_MODE 0 // 0: no checks; 1: refuse frames with a bad tag or a replayed counter; 2: also refuse unsigned frames
+#define EVENT_STREAM_PORT 0 // TCP port for subscribers on the local network (tpp_EventStream), e.g. 5030; 0 for none
+#define HUB_TIME_ZONE -8 // hours from UTC for the time windows of rules (standard time; no daylight saving)
+#define BENCHMARK_PROFILE 0 // radio profile for sensor benchmarks, see tpp_LoRaProfiles in tpp_LoRa.h; 0 is normal
+#define LORA_RESET_PIN -1 // pin wired to the LoRa module's RST, e.g. D3; -1 if not wired
+#define LORA_POWER_PIN -1 // pin switching the LoRa module's supply, HIGH is on; -1 if not wired
+#define LORA_SILENCE_MINUTES 0 // the module is suspected deaf after this long with no frame; 0: only when every watched sensor is missing
 
 // The following system directives are for Particle devices.  Not needed for Arduino.
 SYSTEM_THREAD(ENABLED);
 //SerialLogHandler logHandler(LOG_LEVEL_TRACE);
 
-String VERSION = "3.0";
+String VERSION = "4.4";
 
 const int DEBUG_LED_PIN = D7;
 const int LORA_ADDRESS_PIN = D0;   // Ground this pin to set the LoRa module address for a sensor at boot
                                    // Used to configure a LoRa module.
 
 String NODATA = "NODATA";
+String LOG_SCHEMA = TPP_HUBLOG_SCHEMA;
 tpp_LoRa LoRa;
+tpp_HubLog hubLog;
+tpp_AirtimeMeter airtime;
+tpp_HubBenchmark benchmark;
+tpp_AckAggregator acks;
+tpp_SensorRegistry sensorRegistry;
+String sensorSummary = "";
+tpp_MessageRouter router;
+tpp_Auth auth;
+tpp_Rules rules;
+tpp_EventStream stream;
+tpp_DownlinkQueue downlink;
+String downlinkSummary = "";
+tpp_Relay relay;
+String relaySummary = "";
+unsigned long relayedFrames = 0;
+String lastRelayed = "none";
+tpp_LoRaSupervisor supervisor;
+
+// the frame being handled came through repeaters: what is sent to its sensor goes back the same way
+long relaySensor = -1;
+long relayVia = 0;
+String relayRoute = "";
+String messageCounts = "";
+
+int hubLoRaAddress = TPP_LORA_HUB_ADDRESS;
+bool reprogramRequested = false;  // set by the LoRaReprogram cloud function, handled in loop()
+
+
+void logToParticle(char code, int deviceNum, String payload, int SNRhub1, int RSSIHub1) {   
+    if (!tpp_hubLogIsSensorFrame(code)) {
+        stream.add(code, deviceNum, payload, SNRhub1, RSSIHub1);  // frames were streamed when received
+    }
+    if (LOG_FORMAT_COMPACT) {
+        hubLog.add(code, deviceNum, payload, SNRhub1, RSSIHub1);
+        return;
+    }
 
-
-void logToParticle(String message, int deviceNum, String payload, int SNRhub1, int RSSIHub1) {   
     // create a JSON string to send to the cloud
-    String data = "message=" + message
+    String data = "message=" + String(tpp_hubLogCodeName(code))
         + "|deviceNum=" + String(deviceNum) + "|payload=" + payload 
         + "|SNRhub1=" + String(SNRhub1) + "|RSSIHub1=" + String(RSSIHub1);
 
@@ -71,57 +203,307 @@ void logToParticle(String message, int deviceNum, String payload, int SNRhub1, i
     DEBUG_SERIAL.println("cloudLogging return: " + String(rtn));
 }
 
+// send a message to a sensor, through the repeaters its frame came through if it was
+// relayed, and count its airtime; returns as LoRa.transmitMessage()
+int sendToSensor(long int deviceNum, const String& message) {
+    if (deviceNum == relaySensor) {
+        String frame;
+        if (!tpp_Relay::wrapDown(deviceNum, relayRoute, message, frame)) {
+            return 1;
+        }
+        int errRtn = LoRa.transmitMessage(relayVia, frame);
+        supervisor.commandResult(errRtn);
+        if (errRtn == 0) {
+            airtime.addTransmitted(deviceNum, LoRa.timeOnAirUS(frame.length()));   // the sensor waits for it
+        }
+        return errRtn;
+    }
+    int errRtn = LoRa.transmitMessage(deviceNum, message);
+    supervisor.commandResult(errRtn);
+    if (errRtn == 0) {
+        airtime.addTransmitted(deviceNum, LoRa.timeOnAirUS(message.length()));
+    }
+    return errRtn;
+}
+
+// acknowledge a sensor message: held for the next broadcast ack frame if aggregating
+// and the message has a number, otherwise TESTOK now.  Settings waiting for the sensor
+// (tpp_DownlinkQueue) go in the TESTOK, so it is never aggregated then, nor when the
+// sensor's frame was relayed, since the repeater passes on only what is sent to it.
+// Returns as LoRa.transmitMessage()
+int ackSensor(long int deviceNum, const String& payload) {
+    String settings = downlink.fieldFor(deviceNum);
+    int seq = tpp_AirtimeMeter::sequenceOf(payload);
+    if (ACK_AGGREGATION && seq >= 0 && settings.length() == 0 && deviceNum != relaySensor) {
+        acks.add(deviceNum, seq);
+        return 0;
+    }
+    if (settings.length() && AUTH_MODE) {
+        // so only the hub can change a sensor's settings
+        uint32_t tag = auth.mac(deviceNum, settings.c_str(), settings.length());
+        settings += ' ';
+        for (int shift = 28; shift >= 0; shift -= 4) {
+            settings += "0123456789abcdef"[(tag >> shift) & 0xF];
+        }
+    }
+    downlinkSummary = downlink.summary();
+    return sendToSensor(deviceNum, "TESTOK" + settings);
+}
+
+// ---- frame handlers, one for each message type (see tpp_MessageRouter.h) ----
+
+// gate/door sensor trip: acknowledge it
+tpp_FrameResult handleGateSensor(const tpp_Frame& frame) {
+    tpp_FrameResult result = {TPP_HUBLOG_CODE_ACK, true, ""};
+    return result;
+}
+
+// help button: acknowledge it; logged under its own code so the sheet can pick it out
+tpp_FrameResult handleHelpButton(const tpp_Frame& frame) {
+    DEBUG_SERIAL.println("HELP button on sensor " + String(frame.address));
+    tpp_FrameResult result = {TPP_HUBLOG_CODE_HELP, true, ""};
+    return result;
+}
+
+// heartbeat: the sensor does not wait for an answer; the registry has already noted it
+tpp_FrameResult handleHeartbeat(const tpp_Frame& frame) {
+    tpp_FrameResult result = {TPP_HUBLOG_CODE_HEARTBEAT, false, ""};
+    return result;
+}
+
+// benchmark: no printing or cloud logging per message, so the hub keeps up.  The
+// benchmark needs to know whether each ack went out, so this one acks for itself
+tpp_FrameResult handleBenchmark(const tpp_Frame& frame) {
+    if (benchmark.add(frame.address, frame.payload, frame.SNR, frame.RSSI)) {
+        benchmark.ackSent(frame.address, ackSensor(frame.address, frame.payload));
+    }
+    tpp_FrameResult result = {0, false, ""};
+    return result;
+}
+
+tpp_FrameResult handleUnknown(const tpp_Frame& frame) {
+    DEBUG_SERIAL.println("received data does not start with a known message type (see tpp_LoRa.h)");
+    tpp_FrameResult result = {TPP_HUBLOG_CODE_NOPE, false, "NOPE"};
+    return result;
+}
+
+// checks and removes the auth field of a frame (AUTH_MODE).  A frame that fails is
+// logged as Auth_Failed, with the field, and should be ignored; returns false then
+bool authentic(long int deviceNum, String& payload) {
+    String received = payload;
+    uint32_t counter;
+    int rtn = auth.verify(deviceNum, payload, counter);
+    if (rtn == -1 && AUTH_MODE == 1) {
+        return true;    // unsigned frames are still allowed
+    }
+    if (rtn == 0) {
+        rtn = sensorRegistry.acceptCounter(deviceNum, counter) < 0 ? -3 : 0;
+    }
+    if (rtn == 0) {
+        return true;
+    }
+    const char* why = rtn == -1 ? "not signed" : rtn == -2 ? "bad tag" : "replayed counter";
+    DEBUG_SERIAL.println("refused frame from " + String(deviceNum) + " (" + why + "): " + received);
+    if (LOG_TO_CLOUD) {
+        logToParticle(TPP_HUBLOG_CODE_AUTH_FAILED, deviceNum, received, LoRa.SNR, LoRa.RSSI);
+    }
+    return false;
+}
+
+// takes apart a frame a repeater passed on (tpp_Relay): deviceNum and LoRa.payload become the
+// sensor's, and path the repeaters it came through.  Returns false if it is not valid
+bool unrelay(long int& deviceNum, String& path) {
+    long sensor;
+    int hops;
+    String payload;
+    if (!tpp_Relay::unwrapUp(LoRa.payload, sensor, hops, path, payload)
+            || !tpp_Relay::routeBack(path, relayVia, relayRoute) || relayVia != deviceNum) {
+        DEBUG_SERIAL.println("bad relayed frame from " + String(deviceNum) + ": " + LoRa.payload);
+        return false;
+    }
+    deviceNum = sensor;
+    LoRa.payload = payload;
+    relaySensor = sensor;
+    relayedFrames++;
+    lastRelayed = String(sensor) + " via " + path;
+    return true;
+}
+
+// the "Relays" cloud variable
+void summarizeRelays() {
+    relaySummary = "relayed " + String(relayedFrames) + ", duplicates " + String(relay.duplicates)
+        + ", last " + lastRelayed;
+}
+
+// Cloud function to replace the local rules; see tpp_Rules.h for the format. "" removes them all.
+// Returns the number of rules, or -n if rule n is bad (the old rules are kept)
+int setRules(String text) {
+    int rtn = rules.set(text);
+    DEBUG_SERIAL.println("rules set: " + String(rtn));
+    return rtn;
+}   // end of setRules()
+
+// Cloud function to queue settings for a sensor: "<address> <key>=<value>,...", see
+// tpp_LoRaConfigKeys; "<address> -" forgets them.  Returns the id the sensor will confirm,
+// 0 if cancelled, -1 if not valid, -2 if too many sensors are waiting
+int downlinkSettings(String args) {
+    int space = args.indexOf(' ');
+    if (space < 0) {
+        return -1;
+    }
+    long address = args.substring(0, space).toInt();
+    String settings = args.substring(space + 1);
+    settings.trim();
+    if (address <= 0 || address > 65535) {
+        return -1;
+    }
+    int rtn;
+    if (settings == "-") {
+        rtn = downlink.cancel(address) ? 0 : -1;
+    } else {
+        rtn = downlink.add(address, settings);
+    }
+    downlinkSummary = downlink.summary();
+    DEBUG_SERIAL.println("downlink " + args + ": " + String(rtn));
+    return rtn;
+}   // end of downlinkSettings()
+
+// the registry's report of a sensor going missing or being heard again
+void reportSensor(int address, bool missing, unsigned long silentSeconds) {
+    String text = (missing ? "silent for " : "back after ") + String(silentSeconds) + " s";
+    DEBUG_SERIAL.println("sensor " + String(address) + " " + text);
+    if (LOG_TO_CLOUD) {
+        logToParticle(missing ? TPP_HUBLOG_CODE_MISSING : TPP_HUBLOG_CODE_BACK, address, text, 0, 0);
+    }
+    sensorSummary = sensorRegistry.summary();
+    if (missing && sensorRegistry.missingCount > 1 && sensorRegistry.missingCount == sensorRegistry.watchedCount()) {
+        supervisor.deaf();  // one sensor gone is likely the sensor; all of several at once, the hub
+    }
+}
+
+// the supervisor's report of the LoRa module stopping and being recovered, or not
+void reportLoRa(bool recovered, const String& text) {
+    DEBUG_SERIAL.println(String("LoRa module ") + (recovered ? "recovered: " : "not recovered: ") + text);
+    if (LOG_TO_CLOUD) {
+        logToParticle(TPP_HUBLOG_CODE_LORA_RECOVERY, hubLoRaAddress, text, 0, 0);
+    }
+}
+
+// Cloud function to set how often a sensor should be heard: "<address>,<hours>"; hours 0 stops watching it
+int sensorInterval(String args) {
+    int comma = args.indexOf(',');
+    if (comma < 0) {
+        return -1;
+    }
+    int address = args.substring(0, comma).toInt();
+    float hours = args.substring(comma + 1).toFloat();
+    if (address < 0 || address > 65535 || hours < 0) {
+        return -1;
+    }
+    int rtn = sensorRegistry.setInterval(address, (unsigned long) (hours * 3600));
+    sensorSummary = sensorRegistry.summary();
+    return rtn;
+}   // end of sensorInterval()
+
 // Cloud function to generate a "simulated sensor" received message event to the Particle cloud
 int simulatedSensor(String sensorNum) {
     int _deviceID = sensorNum.toInt();
-    String msg = "Simulated_Sensor";
-
-    logToParticle(msg, _deviceID, "dummyPayload", 0, 0);
+    logToParticle(TPP_HUBLOG_CODE_SIMULATED, _deviceID, "dummyPayload", 0, 0);
 
     return 0;
 
 }   // end of simulatedSensor()
 
+// Cloud function to rewrite every setting in the LoRa module on the next pass through loop()
+int reprogramLoRa(String unused) {
+    reprogramRequested = true;
+    return 0;
+}   // end of reprogramLoRa()
+
 void setup() {
 
     pinMode(DEBUG_LED_PIN, OUTPUT); // control the onboard LED
     pinMode(LORA_ADDRESS_PIN, INPUT_PULLUP); // used to set LoRa address on boot
 
     Particle.variable("Version", VERSION);
+    Particle.variable("LogSchema", LOG_SCHEMA);
+    Particle.variable("Airtime", airtime.report);
+    Particle.variable("Sensors", sensorSummary);
+    Particle.variable("MessageCounts", messageCounts);
+    Particle.variable("Rules", rules.source);
+    Particle.variable("Downlinks", downlinkSummary);
+    Particle.variable("Relays", relaySummary);
+    Particle.variable("LoRaHealth", supervisor.status);
     Particle.function("SimSensor", simulatedSensor);
+    Particle.function("LoRaReprogram", reprogramLoRa);
+    Particle.function("SensorInterval", sensorInterval);
+    Particle.function("Rules", setRules);
+    Particle.function("Downlink", downlinkSettings);
+
+    router.add(TPP_LORA_MSG_GATE_SENSOR[0], handleGateSensor);
+    router.add(TPP_LORA_MSG_HELP[0], handleHelpButton);
+    router.add(TPP_LORA_MSG_HEARTBEAT[0], handleHeartbeat);
+    router.add(TPP_LORA_MSG_BENCHMARK[0], handleBenchmark);
+    router.setUnknown(handleUnknown);
+    messageCounts = router.counters();
+    summarizeRelays();
+
+    // the local rules work without the cloud, so they start first; the pins the hub uses are not theirs
+    Time.zone(HUB_TIME_ZONE);
+    uint32_t hubPins = (1UL << DEBUG_LED_PIN) | (1UL << LORA_ADDRESS_PIN) | (1UL << TX) | (1UL << RX);
+    if (LORA_RESET_PIN >= 0) {
+        hubPins |= 1UL << (LORA_RESET_PIN & 31);    // the LoRa supervisor's
+    }
+    if (LORA_POWER_PIN >= 0) {
+        hubPins |= 1UL << (LORA_POWER_PIN & 31);
+    }
+    rules.begin(hubPins);
 
     digitalWrite(D7, HIGH);
     DEBUG_SERIAL.begin(9600); // the USB serial port 
     waitFor(DEBUG_SERIAL.isConnected, 15000);
 
-    waitUntil(Particle.connected);  // wait for the cloud to connect
+    // no waiting for the cloud (SYSTEM_THREAD connects it meanwhile): the rules, the event
+    // stream and the LoRa module work without it, and the log batches wait for it
     DEBUG_SERIAL.println("Hub version: " + String(VERSION));
 
-    int addressForLoRa = TPP_LORA_HUB_ADDRESS;
+    if (EVENT_STREAM_PORT != 0) {
+        stream.begin(EVENT_STREAM_PORT, "hub " + VERSION);
+    }
+
     int setAddressForHub = digitalRead(LORA_ADDRESS_PIN);
     if (setAddressForHub == LOW) {
-        addressForLoRa = (rand() % 10) + 1;  // D0 is low, so set the address to 1
+        hubLoRaAddress = (rand() % 10) + 1;  // D0 is low, so set the address to 1
     } 
 
+    supervisor.begin(&LoRa, hubLoRaAddress, BENCHMARK_PROFILE, LORA_RESET_PIN, LORA_POWER_PIN,
+        LORA_SILENCE_MINUTES * 60000UL, reportLoRa);
+
+    // a module that does not start is recovered by the supervisor from loop()
     if (LoRa.begin() != 0) {
         DEBUG_SERIAL.println("Error initializing LoRa device");
-        while(1) {blinkTimes(50);};
-        return;
-    }
-
-    if (LoRa.configDevice(addressForLoRa) != 0) {  // initialize the LoRa device 
+        blinkTimes(5);
+        supervisor.failed();
+    } else if (LoRa.configIfNeeded(hubLoRaAddress, FORCE_LORA_REPROGRAM, BENCHMARK_PROFILE) != 0) {  // initialize the LoRa device 
         DEBUG_SERIAL.println("Error configuring LoRa device");
-        while(1) {blinkTimes(50);};
-        return;
-    }
-    
-    if (LoRa.readSettings() != 0) {
-        DEBUG_SERIAL.println("Error reading LoRa settings");
-        blinkTimes(50);
-        while(1) {blinkTimes(50);};
-        return;
+        blinkTimes(5);
+        supervisor.failed();
+    } else {
+        DEBUG_SERIAL.println("LoRa configuration commands sent: " + String(LoRa.configCommandCount));
+        if (BENCHMARK_PROFILE != 0) {
+            DEBUG_SERIAL.println("LoRa benchmark profile " + String(BENCHMARK_PROFILE));
+        }
     }
 
+    const uint8_t authKey[16] = TPP_AUTH_KEY;
+    auth.begin(authKey);
+
+    hubLog.begin("LoRaHubLogging");
+    airtime.begin();
+    benchmark.begin();
+    sensorRegistry.begin(reportSensor, SENSOR_WATCH_DEFAULT_HOURS * 3600UL);
+    sensorSummary = sensorRegistry.summary();
+
     DEBUG_SERIAL.println("Hub ready for testing ...");
     DEBUG_SERIAL.print("waiting for data ...\n");
 
@@ -135,53 +517,135 @@ void loop() {
     
     static String receivedData = "";  // string to hold the received LoRa dat
 
+    rules.process();  // outputs the rules have started
+    stream.process();  // new subscribers, and what is queued for them
+    hubLog.process();  // publish the log batch when it is due
+    airtime.process();  // airtime report every minute
+    benchmark.process();  // summary of benchmark runs that have gone quiet
+    sensorRegistry.process();  // sensors that have gone silent
+    supervisor.process();  // checks the LoRa module, and recovers it if it has stopped working
+    if (!supervisor.working()) {
+        return;
+    }
+
+    if (acks.due()) {
+        String frame = acks.take();
+        if (sendToSensor(TPP_LORA_BROADCAST_ADDRESS, frame) != 0) {
+            DEBUG_SERIAL.println("error sending acks: " + frame);
+        } else {
+            DEBUG_SERIAL.println("sent " + String(acks.lastCount) + " acks: " + frame);
+        }
+    }
+
+    if (reprogramRequested) {
+        reprogramRequested = false;
+        int rtn = LoRa.configIfNeeded(hubLoRaAddress, true, BENCHMARK_PROFILE);
+        supervisor.commandResult(rtn);
+        if (rtn != 0) {
+            DEBUG_SERIAL.println("Error reprogramming LoRa device");
+        } else {
+            DEBUG_SERIAL.println("LoRa reprogrammed, commands sent: " + String(LoRa.configCommandCount));
+        }
+    }
+
     // wait for a message from the tester
     LoRa.checkForReceivedMessage();
     switch (LoRa.receivedMessageState) {
         case -1: // error
+            supervisor.commandResult(-1);
             DEBUG_SERIAL.println("Error reading data from LoRa module");
             DEBUG_SERIAL.println("Waiting for messages");
             break;
         case 0: // no message
             break;
         case 1: // message received
-            String logMessage = "";
+            char logCode = TPP_HUBLOG_CODE_NOPE;
             String messageSent = "";
             long int deviceNum = LoRa.ReceivedDeviceAddress;
+            String path = "";  // the repeaters a relayed frame came through
+            relaySensor = -1;
+            supervisor.heard();
             digitalWrite(DEBUG_LED_PIN, HIGH);
+            airtime.addReceived(LoRa.timeOnAirUS(LoRa.payload.length()));
+            if (tpp_MessageRouter::typeOf(LoRa.payload) == TPP_LORA_MSG_RELAY[0] && !unrelay(deviceNum, path)) {
+                digitalWrite(DEBUG_LED_PIN, LOW);
+                break;
+            }
+            if (relay.duplicate(deviceNum, LoRa.payload, path.length() > 0)) {
+                DEBUG_SERIAL.println("copy of a frame from " + String(deviceNum) + " already heard, dropped");
+                if (path.length() && relay.answered(deviceNum, LoRa.payload)) {
+                    // the sensor may not have heard the ack the first copy got: again, the way this copy came
+                    if (ackSensor(deviceNum, LoRa.payload) != 0) {
+                        DEBUG_SERIAL.println("error sending TESTOK to sensor");
+                    }
+                }
+                relaySensor = -1;
+                summarizeRelays();
+                digitalWrite(DEBUG_LED_PIN, LOW);
+                break;
+            }
+            airtime.addSequence(deviceNum, LoRa.payload, LoRa.timeOnAirUS(LoRa.payload.length()));
+            String heard = LoRa.payload;  // as the duplicate check saw it, before the auth field is removed
+            if (AUTH_MODE && !authentic(deviceNum, LoRa.payload)) {
+                digitalWrite(DEBUG_LED_PIN, LOW);
+                break;
+            }
+            if (path.length()) {
+                summarizeRelays();
+            }
+            String logged = path.length() ? LoRa.payload + TPP_RELAY_PATH_FIELD + path : LoRa.payload;
+            rules.apply(deviceNum, tpp_MessageRouter::typeOf(LoRa.payload), LoRa.payload);  // before any cloud work
+            stream.add(TPP_STREAM_KIND_FRAME, deviceNum, logged, LoRa.SNR, LoRa.RSSI);
+            stream.process();  // out to subscribers now, not after the ack
+            String applied = downlink.confirm(deviceNum, LoRa.payload);
+            if (applied.length()) {
+                downlinkSummary = downlink.summary();
+                DEBUG_SERIAL.println("sensor " + String(deviceNum) + " applied " + applied);
+                if (LOG_TO_CLOUD) {
+                    logToParticle(TPP_HUBLOG_CODE_CONFIGURED, deviceNum, applied, LoRa.SNR, LoRa.RSSI);
+                }
+            }
+            int knownSensors = sensorRegistry.count;
+            sensorRegistry.heard(deviceNum, LoRa.payload);
+            if (sensorRegistry.count != knownSensors) {
+                sensorSummary = sensorRegistry.summary();
+            }
+
+            tpp_FrameResult result = router.route(deviceNum, LoRa.payload, LoRa.SNR, LoRa.RSSI);
+            messageCounts = router.counters();
+            if (result.logCode == 0) {
+                digitalWrite(DEBUG_LED_PIN, LOW);
+                break;
+            }
+            logCode = result.logCode;
 
             String debugMessage = "From device: " + String(deviceNum);
-            debugMessage += " payload: " + LoRa.payload;
+            debugMessage += " payload: " + logged;
             DEBUG_SERIAL.println(debugMessage);
 
-            int helloIndex = LoRa.payload.indexOf(TPP_LORA_MSG_GATE_SENSOR);
-            if(helloIndex >= 0) { // will be -1 if "HELLO" not in the string
-
-                // HELLO is the message from our sensors
+            if (result.ack) {
                 // send a message back to the sensor
-                if (LoRa.transmitMessage(deviceNum, "TESTOK") == 0) {
-                    logMessage = "TESTOK";
-                    messageSent = "TESTOK";
+                if (ackSensor(deviceNum, LoRa.payload) == 0) {
+                    messageSent = ACK_AGGREGATION ? "ack held for broadcast" : "TESTOK";
+                    relay.markAnswered(deviceNum, heard);
                 } else {
                     DEBUG_SERIAL.println("error sending TESTOK to sensor");
-                    logMessage = "Send of TESTOK failed";
-                };
-
-            } else {
-
-                DEBUG_SERIAL.println("received data does not start with a known character (see tpp_LoRa.h)");
-                LoRa.transmitMessage(deviceNum, "NOPE");
-                logMessage = "NOPE";
-                messageSent = "NOPE";
-
-            } // end of if(receivedData.indexOf("HELLO") > 0)
-
+                    logCode = TPP_HUBLOG_CODE_ACK_FAILED;
+                }
+            }
+            if (result.reply.length() > 0) {
+                if (sendToSensor(deviceNum, result.reply) == 0) {
+                    messageSent = result.reply;
+                } else {
+                    DEBUG_SERIAL.println("error sending " + result.reply + " to sensor");
+                }
+            }
 
-            DEBUG_SERIAL.println("sent message: " + messageSent);
+            DEBUG_SERIAL.println("sent message: " + (messageSent.length() ? messageSent : String("none")));
 
             if (LOG_TO_CLOUD){
                 // log the data to the cloud
-                logToParticle(logMessage, LoRa.ReceivedDeviceAddress, LoRa.payload, LoRa.SNR, LoRa.RSSI);
+                logToParticle(logCode, deviceNum, logged, LoRa.SNR, LoRa.RSSI);
             }
 
             digitalWrite(DEBUG_LED_PIN, LOW);
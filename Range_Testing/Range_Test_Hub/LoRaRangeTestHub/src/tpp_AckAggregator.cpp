@@ -0,0 +1,46 @@
+/*
+    tpp_AckAggregator.cpp - holds the hub's acks briefly and sends them in one broadcast frame
+    created by Bob Glicksman and Jim Schrempp
+    as part of Team Practical Projects (tpp)
+
+    20261018 - first version
+*/
+
+#include "tpp_AckAggregator.h"
+#include "tpp_LoRa.h"
+
+void tpp_AckAggregator::add(int deviceNum, int seq) {
+    // a repeat from the same sensor replaces its entry
+    for (int i = 0; i < count; i++) {
+        if (entries[i].deviceNum == deviceNum) {
+            entries[i].seq = seq;
+            return;
+        }
+    }
+    if (count == 0) {
+        firstMS = millis();
+    }
+    if (count < TPP_ACK_MAX_ENTRIES) {
+        entries[count].deviceNum = deviceNum;
+        entries[count].seq = seq;
+        count++;
+    }
+}
+
+bool tpp_AckAggregator::due() {
+    return count > 0 && (count >= TPP_ACK_MAX_ENTRIES || millis() - firstMS >= TPP_ACK_HOLD_MS);
+}
+
+String tpp_AckAggregator::take() {
+    String frame = TPP_LORA_MSG_ACKS;
+    frame.reserve(1 + count * 12);
+    for (int i = 0; i < count; i++) {
+        frame += ',';
+        frame += entries[i].deviceNum;
+        frame += ':';
+        frame += entries[i].seq;
+    }
+    lastCount = count;
+    count = 0;
+    return frame;
+}
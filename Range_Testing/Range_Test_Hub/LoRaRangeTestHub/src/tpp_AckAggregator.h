@@ -0,0 +1,53 @@
+/*
+    tpp_AckAggregator.h - holds the hub's acks briefly and sends them in one broadcast frame
+    created by Bob Glicksman and Jim Schrempp
+    as part of Team Practical Projects (tpp)
+
+    20261018 - first version
+
+    Each "TESTOK" reply costs a full preamble and leaves the hub deaf for its time
+    on air.  In ack aggregation mode the hub keeps the (address, message number) of
+    each message to acknowledge for up to TPP_ACK_HOLD_MS, then sends one frame to
+    the broadcast address:
+
+        A,<address>:<message number>,<address>:<message number>,...
+
+    A sensor that finds its own address and the number of the message it sent
+    treats the frame as TESTOK.  The frame is sent sooner if TPP_ACK_MAX_ENTRIES
+    are waiting.  Messages without a number are still answered with TESTOK at once.
+*/
+
+#ifndef tpp_AckAggregator_h
+#define tpp_AckAggregator_h
+
+#include "tpp_LoRaGlobals.h"
+
+#define TPP_ACK_HOLD_MS 150        // longest an ack waits for others to share its frame
+#define TPP_ACK_MAX_ENTRIES 16     // ",65535:65535" is 12 bytes; 16 fit the 240 byte LoRa payload
+
+class tpp_AckAggregator
+{
+private:
+    struct Entry {
+        int deviceNum;
+        int seq;
+    };
+    Entry entries[TPP_ACK_MAX_ENTRIES];
+    int count = 0;
+    unsigned long firstMS = 0;
+
+public:
+    // hold an ack for this message
+    void add(int deviceNum, int seq);
+
+    // true when the held acks should be sent
+    bool due();
+
+    // the broadcast frame for the held acks, which are then forgotten
+    String take();
+
+    // number of acks in the last frame taken
+    int lastCount = 0;
+};
+
+#endif
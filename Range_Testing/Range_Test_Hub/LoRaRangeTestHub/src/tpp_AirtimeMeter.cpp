@@ -0,0 +1,169 @@
+/*
+    tpp_AirtimeMeter.cpp - channel airtime and half-duplex deaf time of the hub
+    created by Bob Glicksman and Jim Schrempp
+    as part of Team Practical Projects (tpp)
+
+    20261018 - first version
+*/
+
+#include "tpp_AirtimeMeter.h"
+
+#define NO_MINUTE 0xFFFFFFFFUL
+
+void tpp_AirtimeMeter::begin() {
+    for (int i = 0; i < TPP_AIRTIME_BUCKETS; i++) {
+        buckets[i] = Bucket();
+        buckets[i].minute = NO_MINUTE;
+    }
+    for (int i = 0; i < TPP_AIRTIME_MAX_SENSORS; i++) {
+        sensors[i] = Sensor();
+    }
+    deafUS = 0;
+    txCount = 0;
+    lastReportMS = millis();
+    report.reserve(160);
+    report = "no data yet";
+}
+
+// the bucket for this minute, emptied if it still holds an hour ago
+tpp_AirtimeMeter::Bucket& tpp_AirtimeMeter::currentBucket() {
+    unsigned long minute = millis() / TPP_AIRTIME_BUCKET_MS;
+    Bucket& b = buckets[minute % TPP_AIRTIME_BUCKETS];
+    if (b.minute != minute) {
+        b = Bucket();
+        b.minute = minute;
+    }
+    return b;
+}
+
+tpp_AirtimeMeter::Sensor* tpp_AirtimeMeter::findSensor(int deviceNum, bool add) {
+    Sensor* oldest = &sensors[0];
+    for (int i = 0; i < TPP_AIRTIME_MAX_SENSORS; i++) {
+        Sensor& s = sensors[i];
+        if (s.lastSeq > 0 && s.deviceNum == deviceNum) {
+            return &s;
+        }
+        if (s.lastSeq == 0) {
+            oldest = &s;   // an empty slot beats the oldest one
+        } else if (oldest->lastSeq > 0 && (long) (s.lastMS - oldest->lastMS) < 0) {
+            oldest = &s;
+        }
+    }
+    if (!add) {
+        return NULL;
+    }
+    *oldest = Sensor();
+    oldest->deviceNum = deviceNum;
+    return oldest;
+}
+
+void tpp_AirtimeMeter::addReceived(unsigned long airtimeUS) {
+
+    Bucket& b = currentBucket();
+    b.rxUS += airtimeUS;
+    b.rxFrames++;
+}
+
+void tpp_AirtimeMeter::addSequence(int deviceNum, const String& payload, unsigned long airtimeUS) {
+
+    int seq = sequenceOf(payload);
+    if (seq <= 0) {
+        return;
+    }
+    Bucket& b = currentBucket();
+    unsigned long now = millis();
+    Sensor* s = findSensor(deviceNum, true);
+
+    if (s->lastSeq > 0 && seq > s->lastSeq + 1 && seq - s->lastSeq <= TPP_AIRTIME_MAX_GAP) {
+        unsigned int gap = seq - s->lastSeq - 1;
+        b.lost += gap;
+
+        // fraction of the gap in which a frame of this length would have overlapped a transmission
+        float spanUS = (float) (now - s->lastMS) * 1000.0f;
+        float vulnerableUS = (float) (deafUS - s->deafUSAtLast) + (float) (txCount - s->txAtLast) * airtimeUS;
+        float fraction = spanUS > 0 ? vulnerableUS / spanUS : 1.0f;
+        if (fraction > 1.0f) {
+            fraction = 1.0f;
+        }
+        b.lostInTX += gap * fraction;
+    }
+
+    s->lastSeq = seq;
+    s->lastMS = now;
+    s->deafUSAtLast = deafUS;
+    s->txAtLast = txCount;
+}
+
+void tpp_AirtimeMeter::addTransmitted(int toAddress, unsigned long airtimeUS) {
+
+    Bucket& b = currentBucket();
+    b.txUS += airtimeUS;
+    b.txFrames++;
+    deafUS += airtimeUS;
+    txCount++;
+
+    // the sensor being answered is not sending, so this transmission cannot cost it a frame
+    Sensor* s = findSensor(toAddress, false);
+    if (s) {
+        s->deafUSAtLast += airtimeUS;
+        s->txAtLast++;
+    }
+}
+
+// totals of the last few whole minutes; the one under way is not counted yet
+String tpp_AirtimeMeter::window(int minutes) {
+
+    unsigned long nowMinute = millis() / TPP_AIRTIME_BUCKET_MS;
+    unsigned long rxUS = 0, txUS = 0;
+    unsigned int rxFrames = 0, txFrames = 0, lost = 0;
+    float lostInTX = 0;
+
+    unsigned long whole = (unsigned long) minutes < nowMinute ? minutes : nowMinute;   // not up that long yet
+    for (unsigned long k = 1; k <= whole; k++) {
+        const Bucket& b = buckets[(nowMinute - k) % TPP_AIRTIME_BUCKETS];
+        if (b.minute != nowMinute - k) {
+            continue;   // nothing heard or sent that minute
+        }
+        rxUS += b.rxUS;
+        txUS += b.txUS;
+        rxFrames += b.rxFrames;
+        txFrames += b.txFrames;
+        lost += b.lost;
+        lostInTX += b.lostInTX;
+    }
+
+    // microseconds / (ms * 1000) * 100.  Times on air are estimates, and a frame heard
+    // while the hub sent one can not really be, so no more than 100%
+    float toPercent = whole ? 1.0f / (whole * TPP_AIRTIME_BUCKET_MS * 10.0f) : 0;
+    float util = (rxUS + txUS) * toPercent;
+    float deaf = txUS * toPercent;
+
+    String text = String(minutes) + "m: util " + String(util > 100.0f ? 100.0f : util, 1)
+        + "% deaf " + String(deaf > 100.0f ? 100.0f : deaf, 1)
+        + "% rx " + String(rxFrames) + " tx " + String(txFrames)
+        + " lost " + String(lost) + " inTX " + String(lostInTX, 1);
+    return text;
+}
+
+void tpp_AirtimeMeter::process() {
+
+    if (millis() - lastReportMS < TPP_AIRTIME_REPORT_MS) {
+        return;
+    }
+    lastReportMS = millis();
+
+    report = window(1) + " | " + window(10) + " | " + window(60);
+    DEBUG_SERIAL.println("airtime " + report);
+}
+
+int tpp_AirtimeMeter::sequenceOf(const String& payload) {
+    int at = payload.indexOf("m: ");
+    if (at < 0) {
+        return -1;
+    }
+    char c = payload.charAt(at + 3);
+    if (c < '0' || c > '9') {
+        return -1;
+    }
+    return payload.substring(at + 3).toInt();
+}
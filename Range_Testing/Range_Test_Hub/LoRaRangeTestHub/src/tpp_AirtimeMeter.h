@@ -0,0 +1,99 @@
+/*
+    tpp_AirtimeMeter.h - channel airtime and half-duplex deaf time of the hub
+    created by Bob Glicksman and Jim Schrempp
+    as part of Team Practical Projects (tpp)
+
+    20261018 - first version
+    20261018 - airtime and message numbers are added separately, so a relayed frame's
+               number counts for its sensor, not the repeater
+    20261018 - the windows are whole minutes, so each is always as long as it says
+
+    The hub's LoRa module cannot receive while it transmits, so every reply makes
+    the hub deaf for the reply's time on air.  The meter adds up the estimated time
+    on air (tpp_LoRa::timeOnAirUS) of the frames heard and sent, in one minute
+    buckets, and reports for the last 1, 10 and 60 whole minutes (the minute under
+    way is left out until it is over; before the hub has run that long, the minutes
+    it has run):
+
+        util    percent of the time the channel carried a frame the hub heard or sent
+        deaf    percent of the time the hub was transmitting
+        rx, tx  frames heard and sent
+        lost    frames missing from the sensors' "m: N" message numbers
+        inTX    how many of the lost frames were probably sent while the hub was transmitting
+
+    A lost frame overlapped a transmission if it started during the transmission or
+    less than one frame time before it.  The meter does not know when a lost frame was
+    sent, so inTX is the number lost times the fraction of the gap that was vulnerable
+    in this way.  The hub's replies to the sensor itself are left out, as that sensor
+    is waiting for the reply and not sending.
+
+    When deaf or inTX grows, the site needs a second hub or a faster SF.
+*/
+
+#ifndef tpp_AirtimeMeter_h
+#define tpp_AirtimeMeter_h
+
+#include "tpp_LoRaGlobals.h"
+
+#define TPP_AIRTIME_BUCKET_MS 60000UL     // one bucket per minute
+#define TPP_AIRTIME_BUCKETS 61            // an hour of whole minutes, and the one under way
+#define TPP_AIRTIME_MAX_SENSORS 16        // sensors followed for message gaps; the oldest is dropped
+#define TPP_AIRTIME_MAX_GAP 1000          // a larger jump in message number is taken as a sensor reboot
+#define TPP_AIRTIME_REPORT_MS 60000UL     // how often the report is updated and printed
+
+class tpp_AirtimeMeter
+{
+private:
+    struct Bucket {
+        unsigned long minute;     // millis() / TPP_AIRTIME_BUCKET_MS this bucket holds
+        unsigned long rxUS;
+        unsigned long txUS;
+        unsigned int rxFrames;
+        unsigned int txFrames;
+        unsigned int lost;
+        float lostInTX;
+    };
+
+    struct Sensor {
+        int deviceNum;
+        int lastSeq;              // 0 if this slot is not in use
+        unsigned long lastMS;
+        uint64_t deafUSAtLast;    // deafUS when the last frame arrived, plus replies to this sensor since
+        unsigned long txAtLast;   // txCount likewise
+    };
+
+    Bucket buckets[TPP_AIRTIME_BUCKETS];
+    Sensor sensors[TPP_AIRTIME_MAX_SENSORS];
+    uint64_t deafUS = 0;          // all transmit airtime since boot
+    unsigned long txCount = 0;
+    unsigned long lastReportMS = 0;
+
+    Bucket& currentBucket();
+    Sensor* findSensor(int deviceNum, bool add);
+    String window(int minutes);
+
+public:
+    void begin();
+
+    // a frame was heard, as received (a relayed frame with its wrapping); airtimeUS from
+    // LoRa.timeOnAirUS(payload.length())
+    void addReceived(unsigned long airtimeUS);
+
+    // the sensor's frame in it, for the gaps in its "m: N"; for a relayed frame the sensor's
+    // address and the unwrapped payload.  airtimeUS is that payload's time on air
+    void addSequence(int deviceNum, const String& payload, unsigned long airtimeUS);
+
+    // a frame was sent to toAddress
+    void addTransmitted(int toAddress, unsigned long airtimeUS);
+
+    // updates report, and prints it, every TPP_AIRTIME_REPORT_MS. Call from loop()
+    void process();
+
+    // the message number a sensor puts in its payload as "m: N"; -1 if there is none
+    static int sequenceOf(const String& payload);
+
+    // "1m: util 2.3% deaf 1.0% rx 4 tx 4 lost 0 inTX 0.0 | 10m: ... | 60m: ..."
+    String report;
+};
+
+#endif
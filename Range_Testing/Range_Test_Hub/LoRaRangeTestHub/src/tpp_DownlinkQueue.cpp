@@ -0,0 +1,160 @@
+/*
+    tpp_DownlinkQueue.cpp - settings waiting to go to sensors in the hub's acks
+    created by Bob Glicksman and Jim Schrempp
+    as part of Team Practical Projects (tpp)
+
+    20261018 - first version
+*/
+
+#include "tpp_DownlinkQueue.h"
+
+tpp_DownlinkQueue::Entry* tpp_DownlinkQueue::find(unsigned int address) {
+    for (int i = 0; i < TPP_DOWNLINK_MAX; i++) {
+        if (entries[i].used && entries[i].address == address) {
+            return &entries[i];
+        }
+    }
+    return nullptr;
+}
+
+String tpp_DownlinkQueue::settingsText(const Entry& e) {
+    String text = "";
+    for (int k = 0; k < TPP_LORA_CONFIG_KEY_COUNT; k++) {
+        if (e.values[k] < 0) {
+            continue;
+        }
+        if (text.length()) {
+            text += ',';
+        }
+        text += tpp_LoRaConfigKeys[k].key;
+        text += '=';
+        text += String((long) e.values[k]);
+    }
+    return text;
+}
+
+int tpp_DownlinkQueue::add(unsigned int address, const String& settings) {
+    int32_t values[TPP_LORA_CONFIG_KEY_COUNT];
+    for (int k = 0; k < TPP_LORA_CONFIG_KEY_COUNT; k++) {
+        values[k] = -1;
+    }
+
+    // "<key>=<value>" separated by commas, every one valid or none are taken
+    const char* p = settings.c_str();
+    bool any = false;
+    while (*p) {
+        int k = 0;
+        while (k < TPP_LORA_CONFIG_KEY_COUNT && tpp_LoRaConfigKeys[k].key != *p) {
+            k++;
+        }
+        if (k == TPP_LORA_CONFIG_KEY_COUNT || p[1] != '=' || p[2] < '0' || p[2] > '9') {
+            return -1;
+        }
+        p += 2;
+        long value = 0;
+        while (*p >= '0' && *p <= '9' && value <= 65535) {
+            value = value * 10 + (*p++ - '0');
+        }
+        if (value < tpp_LoRaConfigKeys[k].low || value > tpp_LoRaConfigKeys[k].high || (*p && *p != ',')) {
+            return -1;
+        }
+        values[k] = value;
+        any = true;
+        if (*p == ',') {
+            p++;
+        }
+    }
+    if (!any) {
+        return -1;
+    }
+
+    Entry* e = find(address);
+    if (!e) {
+        for (int i = 0; i < TPP_DOWNLINK_MAX && !e; i++) {
+            if (!entries[i].used) {
+                e = &entries[i];
+            }
+        }
+        if (!e) {
+            return -2;
+        }
+        e->used = true;
+        e->address = address;
+        for (int k = 0; k < TPP_LORA_CONFIG_KEY_COUNT; k++) {
+            e->values[k] = -1;
+        }
+        count++;
+    }
+    for (int k = 0; k < TPP_LORA_CONFIG_KEY_COUNT; k++) {
+        if (values[k] >= 0) {
+            e->values[k] = values[k];
+        }
+    }
+    e->id = nextId++;
+    if (nextId == 0) {
+        nextId = 1;
+    }
+    e->sends = 0;
+    return e->id;
+}
+
+bool tpp_DownlinkQueue::cancel(unsigned int address) {
+    Entry* e = find(address);
+    if (!e) {
+        return false;
+    }
+    e->used = false;
+    count--;
+    return true;
+}
+
+String tpp_DownlinkQueue::fieldFor(unsigned int address) {
+    Entry* e = find(address);
+    if (!e) {
+        return "";
+    }
+    e->sends++;
+    return TPP_LORA_CONFIG_FIELD + String(e->id) + " " + settingsText(*e);
+}
+
+String tpp_DownlinkQueue::confirm(unsigned int address, const String& payload) {
+    Entry* e = find(address);
+    if (!e) {
+        return "";
+    }
+    int at = payload.indexOf(TPP_LORA_CONFIG_FIELD);
+    if (at < 0) {
+        return "";
+    }
+    unsigned int id = 0;
+    for (unsigned int i = at + strlen(TPP_LORA_CONFIG_FIELD); i < payload.length(); i++) {
+        char c = payload.charAt(i);
+        if (c < '0' || c > '9') {
+            break;
+        }
+        id = id * 10 + (c - '0');
+    }
+    if (id != e->id) {
+        return "";     // an older set; the newer one is still waiting
+    }
+    String text = settingsText(*e);
+    e->used = false;
+    count--;
+    confirmed++;
+    return text;
+}
+
+String tpp_DownlinkQueue::summary() {
+    String text = "";
+    for (int i = 0; i < TPP_DOWNLINK_MAX; i++) {
+        const Entry& e = entries[i];
+        if (!e.used) {
+            continue;
+        }
+        if (text.length()) {
+            text += ';';
+        }
+        text += String(e.address) + ":" + String(e.id) + " " + settingsText(e) + " sent " + String(e.sends);
+    }
+    return text;
+}
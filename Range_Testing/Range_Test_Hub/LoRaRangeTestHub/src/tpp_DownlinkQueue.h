@@ -0,0 +1,72 @@
+/*
+    tpp_DownlinkQueue.h - settings waiting to go to sensors in the hub's acks
+    created by Bob Glicksman and Jim Schrempp
+    as part of Team Practical Projects (tpp)
+
+    20261018 - first version
+
+    A sensor only listens for a few seconds after it sends, for the ack.  Settings for
+    it (the keys in tpp_LoRaConfigKeys: heartbeat hours, retries, ack
+    wait, LEDs) wait here until its next frame and then go in the ack:
+
+        TESTOK c: <id> <key>=<value>,<key>=<value>...
+
+    The sensor applies and saves them, and puts " c: <id>" in its next frame; then they
+    are forgotten here.  Until that happens every ack to the sensor carries them again,
+    so a lost ack or a lost confirmation only delays them.  The sensor never listens any
+    longer than it did, so this costs it nothing.  Frames that are not acked, such as
+    heartbeats, can not carry settings; a sensor that only sends heartbeats gets them
+    at its next trip.
+
+    Settings added for a sensor that already has some waiting are merged, the newer
+    value of a key winning, and get a new id.  The queue is in RAM; settings not yet
+    delivered are lost if the hub restarts.
+*/
+
+#ifndef tpp_DownlinkQueue_h
+#define tpp_DownlinkQueue_h
+
+#include "tpp_LoRaGlobals.h"
+#include "tpp_LoRa.h"
+
+#define TPP_DOWNLINK_MAX 16         // sensors with settings waiting
+
+class tpp_DownlinkQueue
+{
+private:
+    struct Entry {
+        bool used = false;
+        uint16_t address;
+        uint16_t id;
+        uint16_t sends;             // acks that have carried these settings
+        int32_t values[TPP_LORA_CONFIG_KEY_COUNT];  // -1: not set
+    };
+    Entry entries[TPP_DOWNLINK_MAX];
+    uint16_t nextId = 1;
+
+    Entry* find(unsigned int address);
+    String settingsText(const Entry& e);
+
+public:
+    // queues "<key>=<value>,..." for a sensor.  Returns the id, -1 if a setting is
+    // not valid, -2 if the queue is full
+    int add(unsigned int address, const String& settings);
+
+    // forgets the settings waiting for a sensor; false if there were none
+    bool cancel(unsigned int address);
+
+    // " c: <id> <settings>" for the next ack to this sensor, "" if nothing is waiting
+    String fieldFor(unsigned int address);
+
+    // a frame from the sensor: if it confirms the settings waiting they are forgotten
+    // and returned as text, otherwise ""
+    String confirm(unsigned int address, const String& payload);
+
+    // "<address>:<id> <settings> sent <n>;..."
+    String summary();
+
+    int count = 0;
+    unsigned long confirmed = 0;
+};
+
+#endif
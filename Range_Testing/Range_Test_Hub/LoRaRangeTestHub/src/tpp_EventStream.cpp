@@ -0,0 +1,171 @@
+/*
+    tpp_EventStream.cpp - pushes hub events to subscribers on the local network
+    created by Bob Glicksman and Jim Schrempp
+    as part of Team Practical Projects (tpp)
+
+    20261018 - first version
+    20261018 - listens once the network is up, so begin() does not need it
+*/
+
+#include "tpp_EventStream.h"
+
+void tpp_EventStream::begin(int portNumber, const String& helloText) {
+    port = portNumber;
+    hello = helloText;
+    for (int i = 0; i < TPP_STREAM_MAX_CLIENTS; i++) {
+        clients[i].used = false;
+    }
+    server = new TCPServer(port);
+    listening = false;
+}
+
+// Time.now() only has seconds, so the ms come from millis() since the second was seen to
+// change.  Called every loop, so that is within a loop of the real change
+void tpp_EventStream::tick() {
+    if (!Time.isValid()) {
+        return;
+    }
+    time_t now = Time.now();
+    if (now != lastSecond) {
+        clockKnown = lastSecond != 0;       // the first second seen may have started long ago
+        lastSecond = now;
+        secondStartMS = millis();
+    }
+}
+
+String tpp_EventStream::unixMS() {
+    tick();
+    if (!clockKnown) {
+        return "0";
+    }
+    unsigned long ms = millis() - secondStartMS;
+    if (ms > 999) {
+        ms = 999;
+    }
+    String text = String((unsigned long) lastSecond);
+    if (ms < 100) {
+        text += '0';
+    }
+    if (ms < 10) {
+        text += '0';
+    }
+    return text + String(ms);
+}
+
+String tpp_EventStream::record(uint32_t recordSeq, char kind, int deviceNum, const String& payload, int SNR, int RSSI) {
+    String body = String((unsigned long) recordSeq) + "," + unixMS() + "," + String(kind) + "," + String(deviceNum)
+        + "," + String(SNR) + "," + String(RSSI) + ",";
+    body += payload.substring(0, TPP_STREAM_MAX_BODY - body.length());
+    return body;
+}
+
+// false if it does not fit
+bool tpp_EventStream::enqueue(Client& c, const String& body) {
+    unsigned int length = body.length();
+    if (c.count + 2 + length > TPP_STREAM_QUEUE_BYTES) {
+        return false;
+    }
+    unsigned int tail = (c.head + c.count) % TPP_STREAM_QUEUE_BYTES;
+    c.queue[tail] = length >> 8;
+    tail = (tail + 1) % TPP_STREAM_QUEUE_BYTES;
+    c.queue[tail] = length & 0xFF;
+    tail = (tail + 1) % TPP_STREAM_QUEUE_BYTES;
+    const char* p = body.c_str();
+    for (unsigned int i = 0; i < length; i++) {
+        c.queue[tail] = p[i];
+        tail = (tail + 1) % TPP_STREAM_QUEUE_BYTES;
+    }
+    c.count += 2 + length;
+    return true;
+}
+
+void tpp_EventStream::drop(Client& c, const char* why) {
+    DEBUG_SERIAL.println(String("stream subscriber ") + why);
+    c.socket.stop();
+    c.used = false;
+    clientCount--;
+}
+
+void tpp_EventStream::add(char kind, int deviceNum, const String& payload, int SNR, int RSSI) {
+    if (!server) {
+        return;
+    }
+    seq++;
+    if (clientCount == 0) {
+        return;
+    }
+    String body = record(seq, kind, deviceNum, payload, SNR, RSSI);
+    for (int i = 0; i < TPP_STREAM_MAX_CLIENTS; i++) {
+        if (clients[i].used && !enqueue(clients[i], body)) {
+            dropped++;
+            drop(clients[i], "too slow, dropped");
+        }
+    }
+}
+
+void tpp_EventStream::process() {
+    if (!server) {
+        return;
+    }
+    if (!listening) {
+        // the hub starts without waiting for the network; a server begun before it is up does not listen
+        if (!WiFi.ready()) {
+            return;
+        }
+        listening = server->begin();
+        if (!listening) {
+            return;         // tried again next time
+        }
+        DEBUG_SERIAL.println("event stream on " + WiFi.localIP().toString() + ":" + String(port));
+    }
+    tick();
+
+    TCPClient incoming = server->available();
+    if (incoming.connected()) {
+        int free = -1;
+        for (int i = 0; i < TPP_STREAM_MAX_CLIENTS; i++) {
+            if (!clients[i].used) {
+                free = i;
+                break;
+            }
+        }
+        if (free < 0) {
+            incoming.stop();
+        } else {
+            Client& c = clients[free];
+            c.used = true;
+            c.socket = incoming;
+            c.head = 0;
+            c.count = 0;
+            clientCount++;
+            enqueue(c, record(seq, TPP_STREAM_KIND_HELLO, 0, hello, 0, 0));
+            DEBUG_SERIAL.println("stream subscriber " + String(free) + " connected");
+        }
+    }
+
+    for (int i = 0; i < TPP_STREAM_MAX_CLIENTS; i++) {
+        Client& c = clients[i];
+        if (!c.used) {
+            continue;
+        }
+        if (!c.socket.connected()) {
+            drop(c, "gone");
+            continue;
+        }
+        while (c.socket.available() > 0) {
+            c.socket.read();                // subscribers have nothing to say
+        }
+        while (c.count > 0) {
+            unsigned int chunk = TPP_STREAM_QUEUE_BYTES - c.head;
+            if (chunk > c.count) {
+                chunk = c.count;
+            }
+            int sent = (int) c.socket.write(c.queue + c.head, chunk, 0);
+            if (sent <= 0) {
+                break;                      // socket full; try again next time
+            }
+            c.head = (c.head + sent) % TPP_STREAM_QUEUE_BYTES;
+            c.count -= sent;
+        }
+    }
+}
@@ -0,0 +1,72 @@
+/*
+    tpp_EventStream.h - pushes hub events to subscribers on the local network
+    created by Bob Glicksman and Jim Schrempp
+    as part of Team Practical Projects (tpp)
+
+    20261018 - first version
+    20261018 - listens once the network is up, so begin() does not need it
+
+    Announcement clients (the Clip Play App, a PC) no longer have to go through the
+    cloud to hear about a trip.  The hub listens on a TCP port and sends every
+    subscriber each record as it is made, in the format of tpp_EventStreamFormat.h.
+    Frames are added as soon as they are received and sent straight away, so a
+    subscriber on the same network has them within a few milliseconds.
+
+    Each subscriber has its own queue of TPP_STREAM_QUEUE_BYTES.  Writes never wait:
+    what the socket does not take stays queued for the next process().  A subscriber
+    whose queue would overflow is disconnected, so one slow client can not hold up
+    the hub or the others.
+*/
+
+#ifndef tpp_EventStream_h
+#define tpp_EventStream_h
+
+#include "tpp_LoRaGlobals.h"
+#include "tpp_EventStreamFormat.h"
+
+#define TPP_STREAM_MAX_CLIENTS 4
+
+class tpp_EventStream
+{
+private:
+    struct Client {
+        bool used;
+        TCPClient socket;
+        uint8_t queue[TPP_STREAM_QUEUE_BYTES];
+        uint16_t head;              // first byte not yet sent
+        uint16_t count;             // bytes waiting
+    };
+
+    TCPServer* server = nullptr;
+    int port = 0;
+    bool listening = false;
+    Client clients[TPP_STREAM_MAX_CLIENTS];
+    uint32_t seq = 0;
+    String hello;
+    time_t lastSecond = 0;          // the clock's second, and millis() when it started
+    unsigned long secondStartMS = 0;
+    bool clockKnown = false;        // a change of second has been seen
+
+    void tick();
+    String unixMS();
+    String record(uint32_t recordSeq, char kind, int deviceNum, const String& payload, int SNR, int RSSI);
+    bool enqueue(Client& c, const String& body);
+    void drop(Client& c, const char* why);
+
+public:
+    // listens from the first process() with the network up; helloText is the payload of
+    // the hello record
+    void begin(int portNumber, const String& helloText);
+
+    // a record for every subscriber; see tpp_EventStreamFormat.h for kind
+    void add(char kind, int deviceNum, const String& payload, int SNR, int RSSI);
+
+    // takes new subscribers and sends what is queued. Call from loop(), and after add()
+    // when the record should go at once
+    void process();
+
+    int clientCount = 0;
+    unsigned long dropped = 0;      // subscribers disconnected for falling behind
+};
+
+#endif
@@ -0,0 +1,43 @@
+/*
+    tpp_EventStreamFormat.h - the records the hub pushes to LAN subscribers (tpp_EventStream)
+    created by Bob Glicksman and Jim Schrempp
+    as part of Team Practical Projects (tpp)
+
+    20261018 - version 1 of the format
+
+    This file has no Particle dependencies so host tools can include it.  The
+    subscriber in Host_Tools/hub_stream reads this format.  Change both together.
+
+    A subscriber opens a TCP connection to the hub's EVENT_STREAM_PORT and only
+    reads.  Each record is
+
+        <length><body>
+
+        length      2 bytes, high byte first: the number of bytes in body
+        body        <seq>,<unixMS>,<kind>,<deviceNum>,<SNR>,<RSSI>,<payload>
+        seq         counts up by one for every record the hub makes, from 1 at boot.  A
+                    subscriber that sees a jump has missed records
+        unixMS      hub time of the record, Unix ms; 0 if the hub's clock is not set yet
+        kind        TPP_STREAM_KIND_FRAME for a frame as it was received, before the
+                    hub answers or logs it; TPP_STREAM_KIND_HELLO; or one of the
+                    TPP_HUBLOG_CODE_ (tpp_HubLogFormat.h) for records the hub makes
+                    itself, such as Sensor_Missing
+        payload     as received, last so it may contain commas
+
+    The first record on every connection is a hello whose seq is that of the last
+    record made before the connection, and whose payload is "hub <version>".
+
+    A subscriber that falls TPP_STREAM_QUEUE_BYTES behind is disconnected; it can
+    connect again and will see a jump in seq.
+*/
+
+#ifndef tpp_EventStreamFormat_h
+#define tpp_EventStreamFormat_h
+
+#define TPP_STREAM_VERSION 1
+#define TPP_STREAM_KIND_FRAME 'f'
+#define TPP_STREAM_KIND_HELLO 'h'
+#define TPP_STREAM_MAX_BODY 400         // bytes; a 240 byte payload and the fields
+#define TPP_STREAM_QUEUE_BYTES 4096     // per subscriber, in the hub
+
+#endif
@@ -0,0 +1,144 @@
+/*
+    tpp_HubBenchmark.cpp - hub side of the sensor's BENCHMARK_MODE
+    created by Bob Glicksman and Jim Schrempp
+    as part of Team Practical Projects (tpp)
+
+    20261018 - first version
+*/
+
+#include "tpp_HubBenchmark.h"
+
+void tpp_HubBenchmark::begin() {
+    for (int i = 0; i < TPP_BENCH_MAX_RUNS; i++) {
+        runs[i] = Run();
+        runs[i].active = false;
+    }
+}
+
+// the run for this sensor; a new one if it has none (ending the oldest if all are in use)
+tpp_HubBenchmark::Run* tpp_HubBenchmark::findRun(int deviceNum) {
+    Run* free = NULL;
+    Run* oldest = &runs[0];
+    for (int i = 0; i < TPP_BENCH_MAX_RUNS; i++) {
+        if (runs[i].active && runs[i].deviceNum == deviceNum) {
+            return &runs[i];
+        }
+        if (!runs[i].active && !free) {
+            free = &runs[i];
+        }
+        if ((long) (runs[i].lastMS - oldest->lastMS) < 0) {
+            oldest = &runs[i];
+        }
+    }
+    if (!free) {
+        finish(*oldest);
+        free = oldest;
+    }
+    *free = Run();
+    free->active = true;
+    free->deviceNum = deviceNum;
+    free->lastSeq = 0;
+    free->minSNR = 99;
+    free->firstMS = millis();
+    return free;
+}
+
+// the number after "name" in the payload; -1 if it is not there
+int tpp_HubBenchmark::field(const String& payload, const char* name) {
+    int at = payload.indexOf(name);
+    if (at < 0) {
+        return -1;
+    }
+    return payload.substring(at + strlen(name)).toInt();
+}
+
+bool tpp_HubBenchmark::add(int deviceNum, const String& payload, int SNR, int RSSI) {
+
+    if (payload.indexOf(" s: ") >= 0) {
+        // the sensor's own results, sent after its last message
+        DEBUG_SERIAL.println("benchmark, sensor " + String(deviceNum) + " reports:" + payload.substring(payload.indexOf(" s: ") + 3));
+        return false;
+    }
+
+    int seq = field(payload, " m: ");
+    Run* run = findRun(deviceNum);
+    if (seq <= run->lastSeq && run->received > 0) {
+        if (seq == run->lastSeq) {
+            run->duplicates++;
+            return run->ackRequested;   // our TESTOK was lost; send it again
+        }
+        // the sensor started a new run
+        finish(*run);
+        run = findRun(deviceNum);
+    }
+
+    run->expected = field(payload, " n: ");
+    run->ackRequested = field(payload, " a: ") == 1;
+    run->received++;
+    run->lastSeq = seq;
+    run->lastMS = millis();
+    run->sumSNR += SNR;
+    run->sumRSSI += RSSI;
+    if (SNR < run->minSNR) {
+        run->minSNR = SNR;
+    }
+    if (run->expected > 0 && seq >= run->expected && !run->ackRequested) {
+        finish(*run);
+    }
+    return run->ackRequested;
+}
+
+void tpp_HubBenchmark::ackSent(int deviceNum, int errRtn) {
+    for (int i = 0; i < TPP_BENCH_MAX_RUNS; i++) {
+        Run& run = runs[i];
+        if (run.active && run.deviceNum == deviceNum) {
+            if (errRtn == 0) {
+                run.acksSent++;
+            } else {
+                run.ackFailures++;
+            }
+            if (run.expected > 0 && run.lastSeq >= run.expected) {
+                finish(run);   // the last message of the run has been answered
+            }
+            return;
+        }
+    }
+}
+
+void tpp_HubBenchmark::process() {
+    for (int i = 0; i < TPP_BENCH_MAX_RUNS; i++) {
+        if (runs[i].active && millis() - runs[i].lastMS > TPP_BENCH_IDLE_MS) {
+            finish(runs[i]);
+        }
+    }
+}
+
+void tpp_HubBenchmark::finish(Run& run) {
+
+    if (!run.active) {
+        return;
+    }
+    run.active = false;
+
+    unsigned long elapsedMS = run.lastMS - run.firstMS;
+    int expected = run.expected > 0 ? run.expected : run.lastSeq;
+    String summary = "benchmark, sensor " + String(run.deviceNum) + ": received " + String(run.received)
+        + " of " + String(expected);
+    if (expected > 0) {
+        summary += " (" + String(100.0 * run.received / expected, 1) + "%)";
+    }
+    if (elapsedMS > 0 && run.received > 1) {
+        summary += ", " + String(1000.0 * (run.received - 1) / elapsedMS, 2) + " messages/s";
+    }
+    summary += ", duplicates " + String(run.duplicates);
+    if (run.ackRequested) {
+        summary += ", TESTOK sent " + String(run.acksSent) + " failed " + String(run.ackFailures);
+    } else {
+        summary += ", no acks";
+    }
+    if (run.received > 0) {
+        summary += ", SNR mean " + String((float) run.sumSNR / run.received, 1) + " min " + String(run.minSNR)
+            + ", RSSI mean " + String((float) run.sumRSSI / run.received, 1);
+    }
+    DEBUG_SERIAL.println(summary);
+}
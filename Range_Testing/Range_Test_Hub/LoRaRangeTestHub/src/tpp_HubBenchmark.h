@@ -0,0 +1,68 @@
+/*
+    tpp_HubBenchmark.h - hub side of the sensor's BENCHMARK_MODE
+    created by Bob Glicksman and Jim Schrempp
+    as part of Team Practical Projects (tpp)
+
+    20261018 - first version
+
+    A sensor built with BENCHMARK_MODE 1 sends messages that start with
+    TPP_LORA_MSG_BENCHMARK:
+
+        B m: <message number> n: <messages in the run> a: <1 if it wants TESTOK back> xxxx...
+
+    padded to the benchmark payload size, and at the end of the run its own results:
+
+        B s: <summary text>
+
+    The hub counts the messages of each sensor's run and prints a summary when the
+    last message arrives, or TPP_BENCH_IDLE_MS after the last one it heard.
+    Benchmark messages are not logged to the cloud.
+*/
+
+#ifndef tpp_HubBenchmark_h
+#define tpp_HubBenchmark_h
+
+#include "tpp_LoRaGlobals.h"
+
+#define TPP_BENCH_MAX_RUNS 4          // sensors benchmarking at the same time
+#define TPP_BENCH_IDLE_MS 10000UL     // a run with no messages for this long is over
+
+class tpp_HubBenchmark
+{
+private:
+    struct Run {
+        int deviceNum;
+        bool active;
+        bool ackRequested;
+        int expected;             // n: from the messages
+        int received;
+        int duplicates;
+        int lastSeq;
+        int acksSent;
+        int ackFailures;
+        unsigned long firstMS;
+        unsigned long lastMS;
+        long sumSNR;
+        long sumRSSI;
+        int minSNR;
+    };
+    Run runs[TPP_BENCH_MAX_RUNS];
+
+    Run* findRun(int deviceNum);
+    void finish(Run& run);
+    static int field(const String& payload, const char* name);
+
+public:
+    void begin();
+
+    // a benchmark message was received. Returns true if the sensor wants TESTOK back
+    bool add(int deviceNum, const String& payload, int SNR, int RSSI);
+
+    // the reply to the last message was sent (errRtn from LoRa.transmitMessage)
+    void ackSent(int deviceNum, int errRtn);
+
+    // ends runs that have gone quiet. Call from loop()
+    void process();
+};
+
+#endif
@@ -0,0 +1,120 @@
+/*
+    tpp_HubLog.cpp - batches hub log records and publishes them to the Particle cloud
+    created by Bob Glicksman and Jim Schrempp
+    as part of Team Practical Projects (tpp)
+
+    20261018 - first version
+    20261018 a batch that fails to publish is kept and sent again later
+*/
+
+#include "tpp_HubLog.h"
+
+static const char hexDigits[] = "0123456789ABCDEF";
+
+void tpp_HubLog::begin(const String& name) {
+    eventName = name;
+    batch.reserve(TPP_HUBLOG_MAX_DATA + 100);
+    batch = "";
+    recordCount = 0;
+}
+
+void tpp_HubLog::add(char code, int deviceNum, const String& payload, int SNR, int RSSI) {
+
+    // build the record without the time, then see if it fits
+    String record;
+    record.reserve(payload.length() + 24);
+    record += code;
+    record += ',';
+    record += deviceNum;
+    record += ',';
+    record += SNR;
+    record += ',';
+    record += RSSI;
+    record += ',';
+    for (unsigned int i = 0; i < payload.length(); i++) {
+        char c = payload.charAt(i);
+        if (tpp_hubLogNeedsEscape(c)) {
+            record += '%';
+            record += hexDigits[(c >> 4) & 0x0F];
+            record += hexDigits[c & 0x0F];
+        } else {
+            record += c;
+        }
+    }
+
+    if (recordCount > 0 && batch.length() + record.length() + 12 > TPP_HUBLOG_MAX_DATA) {
+        close();
+    }
+
+    if (recordCount == 0) {
+        firstRecordMS = millis();
+        batch = TPP_HUBLOG_VERSION;
+        batch += '|';
+        batch += Time.isValid() ? (long) Time.now() : 0L;
+        batch += '|';
+    } else {
+        batch += ';';
+    }
+    batch += millis() - firstRecordMS;
+    batch += ',';
+    batch += record;
+    recordCount++;
+}
+
+void tpp_HubLog::process() {
+    // while batches wait, the open one keeps filling rather than taking a queue slot
+    if (recordCount > 0 && waitingCount == 0 && millis() - firstRecordMS >= TPP_HUBLOG_MAX_AGE_MS) {
+        close();
+    }
+    if (waitingCount > 0 && (long) (millis() - nextPublishMS) >= 0) {
+        publishOldest();
+    }
+}
+
+void tpp_HubLog::flush() {
+    close();
+    while (waitingCount > 0 && (long) (millis() - nextPublishMS) >= 0 && publishOldest()) {
+    }
+}
+
+void tpp_HubLog::close() {
+    if (recordCount == 0) {
+        return;
+    }
+    if (waitingCount == TPP_HUBLOG_QUEUE_BATCHES) {
+        DEBUG_SERIAL.println("cloudLogging queue full, dropped: " + waiting[waitingFirst]);
+        recordsDropped += waitingRecords[waitingFirst];
+        waitingFirst = (waitingFirst + 1) % TPP_HUBLOG_QUEUE_BATCHES;
+        waitingCount--;
+    }
+    int slot = (waitingFirst + waitingCount) % TPP_HUBLOG_QUEUE_BATCHES;
+    waiting[slot] = batch;
+    waitingRecords[slot] = recordCount;
+    waitingCount++;
+    batch = "";
+    recordCount = 0;
+}
+
+bool tpp_HubLog::publishOldest() {
+    const String& data = waiting[waitingFirst];
+    DEBUG_SERIAL.println("cloudLogging:" + data);
+    bool rtn = Particle.connected() && Particle.publish(eventName, data, PRIVATE);
+    DEBUG_SERIAL.println("cloudLogging return: " + String(rtn));
+
+    if (!rtn) {
+        // keep it and wait longer each time
+        publishFailures++;
+        nextPublishMS = millis() + retryMS;
+        retryMS = min(retryMS * 2, TPP_HUBLOG_RETRY_MAX_MS);
+        return false;
+    }
+    recordsPublished += waitingRecords[waitingFirst];
+    eventsPublished++;
+    bytesPublished += data.length();
+    waiting[waitingFirst] = "";
+    waitingFirst = (waitingFirst + 1) % TPP_HUBLOG_QUEUE_BATCHES;
+    waitingCount--;
+    nextPublishMS = millis() + TPP_HUBLOG_PUBLISH_INTERVAL_MS;
+    retryMS = TPP_HUBLOG_RETRY_MS;
+    return true;
+}
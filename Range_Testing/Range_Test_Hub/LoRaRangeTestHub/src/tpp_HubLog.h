@@ -0,0 +1,76 @@
+/*
+    tpp_HubLog.h - batches hub log records and publishes them to the Particle cloud
+    created by Bob Glicksman and Jim Schrempp
+    as part of Team Practical Projects (tpp)
+
+    20261018 - first version
+    20261018 a batch that fails to publish is kept and sent again later
+
+    Records are encoded as described in tpp_HubLogFormat.h.  Several records go
+    in one event: a batch is closed when the next record would not fit or
+    TPP_HUBLOG_MAX_AGE_MS after its first record, whichever comes first.  Closed
+    batches wait in a queue and are published oldest first, no more than one each
+    TPP_HUBLOG_PUBLISH_INTERVAL_MS, which keeps the hub within the Particle limit of
+    about one publish per second.
+
+    When a publish fails (cloud down, or over the limit) the batch stays at the front
+    of the queue and is tried again after TPP_HUBLOG_RETRY_MS, doubling up to
+    TPP_HUBLOG_RETRY_MAX_MS.  Meanwhile new records fill the open batch, which is closed
+    only when full, so a queue slot holds as many records as it can.  Only when the
+    queue is full is the oldest batch dropped.
+*/
+
+#ifndef tpp_HubLog_h
+#define tpp_HubLog_h
+
+#include "tpp_LoRaGlobals.h"
+#include "tpp_HubLogFormat.h"
+
+#define TPP_HUBLOG_QUEUE_BATCHES 8          // closed batches kept while publishes fail; about 1 KB each
+#define TPP_HUBLOG_PUBLISH_INTERVAL_MS 1000
+#define TPP_HUBLOG_RETRY_MS 2000UL          // first wait after a failed publish
+#define TPP_HUBLOG_RETRY_MAX_MS 60000UL
+
+class tpp_HubLog
+{
+private:
+    String eventName;
+    String batch;
+    unsigned long firstRecordMS = 0;
+    int recordCount = 0;
+
+    // closed batches, oldest at waitingFirst
+    String waiting[TPP_HUBLOG_QUEUE_BATCHES];
+    int waitingRecords[TPP_HUBLOG_QUEUE_BATCHES];
+    int waitingFirst = 0;
+    int waitingCount = 0;
+    unsigned long nextPublishMS = 0;
+    unsigned long retryMS = TPP_HUBLOG_RETRY_MS;
+
+    void close();           // moves the batch to the queue
+    bool publishOldest();   // true if it was published
+
+public:
+    // eventName is the Particle event the batches are published as
+    void begin(const String& name);
+
+    // add a record to the batch; closes the batch first if the record will not fit
+    void add(char code, int deviceNum, const String& payload, int SNR, int RSSI);
+
+    // closes the batch if it is old enough and publishes the oldest closed batch when
+    // it is due. Call from loop()
+    void process();
+
+    // close the batch now, if it has any records, and publish the oldest waiting batch
+    // if it is due
+    void flush();
+
+    // statistics
+    unsigned long recordsPublished = 0;
+    unsigned long eventsPublished = 0;
+    unsigned long bytesPublished = 0;
+    unsigned long publishFailures = 0;
+    unsigned long recordsDropped = 0;   // in batches dropped from a full queue
+};
+
+#endif
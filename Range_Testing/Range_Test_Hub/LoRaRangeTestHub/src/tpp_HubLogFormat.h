@@ -0,0 +1,112 @@
+/*
+    tpp_HubLogFormat.h - the compact record format the hub publishes as LoRaHubLogging events
+    created by Bob Glicksman and Jim Schrempp
+    as part of Team Practical Projects (tpp)
+
+    20261018 - version 1 of the format
+
+    This file has no Particle dependencies so host tools can include it.  A decoder
+    for host tools is in Host_Tools/common/tpp_HubLogDecode.h and one for the Google
+    sheet is in GoogleAppScript.js.  Change all three together.
+
+    Event data, version 1:
+
+        1|<baseTime>|<record>;<record>;...
+
+        baseTime    Unix time in seconds when the first record was added; 0 if the hub's
+                    clock was not set yet
+        record      <dtMS>,<code>,<deviceNum>,<SNR>,<RSSI>,<payload>
+        dtMS        milliseconds after the first record (the first record is 0)
+        code        one character, see the TPP_HUBLOG_CODE_ table below
+        deviceNum   LoRa address of the sender
+        SNR, RSSI   as reported by the hub's LoRa module
+        payload     the sensor payload, last so it may contain commas.  '%', ';', '|'
+                    and control characters are sent as %XX (hex)
+
+    Every field is in a fixed order and always present, so a record is one split
+    on ';' and five on ','.  The old format,
+        message=TESTOK|deviceNum=6|payload=G m: 5|SNRhub1=11|RSSIHub1=-40
+    took 69 bytes; the same record is "0,A,6,11,-40,G m: 5", 19 bytes.
+*/
+
+#ifndef tpp_HubLogFormat_h
+#define tpp_HubLogFormat_h
+
+#define TPP_HUBLOG_VERSION '1'
+#define TPP_HUBLOG_SCHEMA "1|baseTime|dtMS,code,deviceNum,SNR,RSSI,payload;..."
+
+#define TPP_HUBLOG_MAX_DATA 1000     // bytes; Particle limit on event data is 1024
+#define TPP_HUBLOG_MAX_AGE_MS 1000   // publish a batch no later than this after its first record
+
+// message codes.  The names are what the old format sent in message=
+#define TPP_HUBLOG_CODE_ACK 'A'           // TESTOK sent to the sensor
+#define TPP_HUBLOG_CODE_NOPE 'N'          // unknown message; NOPE sent
+#define TPP_HUBLOG_CODE_ACK_FAILED 'F'    // sending TESTOK failed
+#define TPP_HUBLOG_CODE_SIMULATED 'S'     // from the SimSensor cloud function
+#define TPP_HUBLOG_CODE_MISSING 'M'       // nothing heard from the sensor for too long (tpp_SensorRegistry)
+#define TPP_HUBLOG_CODE_BACK 'R'          // a missing sensor was heard again
+#define TPP_HUBLOG_CODE_HEARTBEAT 'H'     // heartbeat from a sensor (TPP_LORA_MSG_HEARTBEAT); not answered
+#define TPP_HUBLOG_CODE_HELP 'E'          // help button pressed (TPP_LORA_MSG_HELP); acked
+#define TPP_HUBLOG_CODE_AUTH_FAILED 'X'   // refused: bad tag, replayed or unsigned (tpp_Auth); not answered
+#define TPP_HUBLOG_CODE_CONFIGURED 'C'    // the sensor confirmed settings sent in an ack (tpp_DownlinkQueue)
+#define TPP_HUBLOG_CODE_LORA_RECOVERY 'L' // the hub's LoRa module stopped working and was recovered, or not (tpp_LoRaSupervisor)
+
+struct tpp_HubLogCodeName {
+    char code;
+    const char* name;
+};
+
+const tpp_HubLogCodeName tpp_hubLogCodeNames[] = {
+    {TPP_HUBLOG_CODE_ACK, "TESTOK"},
+    {TPP_HUBLOG_CODE_NOPE, "NOPE"},
+    {TPP_HUBLOG_CODE_ACK_FAILED, "Send of TESTOK failed"},
+    {TPP_HUBLOG_CODE_SIMULATED, "Simulated_Sensor"},
+    {TPP_HUBLOG_CODE_MISSING, "Sensor_Missing"},
+    {TPP_HUBLOG_CODE_BACK, "Sensor_Back"},
+    {TPP_HUBLOG_CODE_HEARTBEAT, "Heartbeat"},
+    {TPP_HUBLOG_CODE_HELP, "Help_Button"},
+    {TPP_HUBLOG_CODE_AUTH_FAILED, "Auth_Failed"},
+    {TPP_HUBLOG_CODE_CONFIGURED, "Config_Applied"},
+    {TPP_HUBLOG_CODE_LORA_RECOVERY, "LoRa_Recovery"},
+};
+
+// true for records of a frame a sensor sent, false for records the hub makes itself and
+// for frames it refused
+inline bool tpp_hubLogIsSensorFrame(char code) {
+    return code != TPP_HUBLOG_CODE_SIMULATED && code != TPP_HUBLOG_CODE_MISSING && code != TPP_HUBLOG_CODE_BACK
+        && code != TPP_HUBLOG_CODE_AUTH_FAILED && code != TPP_HUBLOG_CODE_CONFIGURED
+        && code != TPP_HUBLOG_CODE_LORA_RECOVERY;
+}
+
+// the message name for a code, "?" if unknown
+inline const char* tpp_hubLogCodeName(char code) {
+    for (unsigned int i = 0; i < sizeof(tpp_hubLogCodeNames) / sizeof(tpp_hubLogCodeNames[0]); i++) {
+        if (tpp_hubLogCodeNames[i].code == code) {
+            return tpp_hubLogCodeNames[i].name;
+        }
+    }
+    return "?";
+}
+
+// the code for a message name, 0 if unknown
+inline char tpp_hubLogCodeFromName(const char* name) {
+    for (unsigned int i = 0; i < sizeof(tpp_hubLogCodeNames) / sizeof(tpp_hubLogCodeNames[0]); i++) {
+        const char* a = tpp_hubLogCodeNames[i].name;
+        const char* b = name;
+        while (*a && *a == *b) {
+            a++;
+            b++;
+        }
+        if (*a == 0 && *b == 0) {
+            return tpp_hubLogCodeNames[i].code;
+        }
+    }
+    return 0;
+}
+
+// true if this payload character must be sent as %XX
+inline bool tpp_hubLogNeedsEscape(char c) {
+    return c == '%' || c == ';' || c == '|' || (unsigned char) c < 0x20 || c == 0x7F;
+}
+
+#endif
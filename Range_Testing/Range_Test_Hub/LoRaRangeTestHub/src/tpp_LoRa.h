@@ -6,6 +6,20 @@
     20241212 - version 2. works on Particle Photon 2
     version 2.1 removed version as a #define
     20241222 added setAddress
+    20261018 added configIfNeeded; saves a fingerprint of the settings in EEPROM
+    20261018 begin() finds the module's baud rate and switches to TPP_LORA_MAX_BAUD
+    20261018 responses are read a line at a time; waitForData() idle sleeps the ATmega328
+    20261018 added timeOnAirUS
+    20261018 added radio profiles and setProfile for benchmarks
+    20261018 added the broadcast ack message and isAckFor
+    20261018 added the heartbeat message
+    20261018 added the help button message
+    20261018 added the config field and keys for settings sent in acks
+    20261018 added the repeater messages
+    20261018 added ping for the hub's supervisor
+    20261018 the radio profile is part of the saved fingerprint; configIfNeeded takes it
+    20261018 the radio profile is no longer one of the config keys
+    20261018 the relay duplicate window is here, and the least ack wait comes from it
 
 */
 /*
@@ -23,6 +37,15 @@
 #define TPP_LORA_HUB_ADDRESS 57248   // arbitrary  0 - 65535
 
 #define TPP_LORA_MSG_GATE_SENSOR "G" // message from the sensor to the hub
+#define TPP_LORA_MSG_BENCHMARK "B"   // benchmark message from the sensor to the hub (BENCHMARK_MODE)
+#define TPP_LORA_MSG_HEARTBEAT "H"   // sensor to hub: still here (HEARTBEAT_HOURS); not answered
+#define TPP_LORA_MSG_HELP "E"        // sensor to hub: help button pressed; acked like a gate message
+#define TPP_LORA_MSG_ACKS "A"        // hub to all sensors: acks as ",address:message number" pairs
+#define TPP_LORA_MSG_RELAY "R"       // repeater towards the hub: a sensor's frame and its path (tpp_Relay.h)
+#define TPP_LORA_MSG_RELAY_DOWN "D"  // hub towards a repeater: the answer to a relayed frame (tpp_Relay.h)
+#define TPP_LORA_BROADCAST_ADDRESS 0 // frames sent to address 0 are received by every module
+#define TPP_LORA_CONFIG_FIELD " c: " // hub to sensor after TESTOK: " c: <id> <key>=<value>,..." settings to apply;
+                                     // sensor to hub in its next frame: " c: <id>", they were applied
 
 #define LoRa_NETWORK_ID 18
 #define LoRa_CRFOP 22             // default 22; range 1-22; 22 is max power
@@ -38,6 +61,56 @@
 
 #define LoRa_PREAMBLE 12         // 12 max unless network number is 18; 
 
+#define LoRa_BAND 915000000      // 915 MHz for the US
+
+// radio profiles for benchmarks: spreading factor, bandwidth, coding rate, preamble.
+// Profile 0 is the settings above.  The RYLR998 allows SF 10 and 11 only at wider bandwidths.
+#define TPP_LORA_PROFILE_COUNT 5
+const uint8_t tpp_LoRaProfiles[TPP_LORA_PROFILE_COUNT][4] = {
+    {LoRa_SPREADING_FACTOR, LoRa_BANDWIDTH, LoRa_CODING_RATE, LoRa_PREAMBLE},
+    {7, 7, 1, 12},      // SF7 125 kHz
+    {9, 7, 1, 12},      // SF9 125 kHz
+    {7, 9, 1, 12},      // SF7 500 kHz, fastest
+    {11, 9, 1, 12},     // SF11 500 kHz
+};
+
+// relayed frames (tpp_Relay): copies of a frame within TPP_LORA_RELAY_DUPLICATE_MS are dropped,
+// and an ack coming back through TPP_RELAY_MAX_HOPS repeaters takes up to TPP_LORA_RELAY_ACK_MS
+// (four 70 byte frames at profile 0, and the modules' turnarounds).  A sensor waiting less than
+// the two added up would send again a frame that is still a copy, or before the ack could come
+#define TPP_LORA_RELAY_DUPLICATE_MS 3000
+#define TPP_LORA_RELAY_ACK_MS 2000
+#define TPP_LORA_MIN_ACK_WAIT_MS (TPP_LORA_RELAY_DUPLICATE_MS + TPP_LORA_RELAY_ACK_MS)
+
+// settings the hub can send a sensor in TPP_LORA_CONFIG_FIELD, and the values allowed.  Not the
+// radio profile: a sensor that changed it would no longer hear the hub, and never confirm it
+#define TPP_LORA_CONFIG_KEY_COUNT 4
+struct tpp_LoRaConfigKey {
+    char key;
+    uint16_t low;
+    uint16_t high;
+};
+const tpp_LoRaConfigKey tpp_LoRaConfigKeys[TPP_LORA_CONFIG_KEY_COUNT] = {
+    {'h', 0, 145},                          // heartbeat hours, 0 for none
+    {'r', 0, 5},                            // times a frame is sent again when no ack comes
+    {'t', TPP_LORA_MIN_ACK_WAIT_MS, 10000}, // ms to wait for an ack
+    {'l', 0, 1},                            // 1: blink the result of each frame on the LEDs
+};
+
+#define TPP_LORA_EEPROM_CONFIG_ADDRESS 0    // EEPROM location of the saved configuration record (about 20 bytes)
+#define TPP_LORA_EEPROM_BAUD_ADDRESS 32     // EEPROM location of the saved baud rate record (8 bytes)
+
+#define TPP_LORA_PROBE_TIMEOUT_MS 250   // time to wait for +OK when looking for the module's baud rate
+#define TPP_LORA_BAUD_VERIFY_COUNT 3    // a new baud rate must answer this many AT commands in a row
+#define TPP_LORA_COMMAND_TIMEOUT_MS 5000  // time to wait for +OK/+ERR after a command
+#define TPP_LORA_LINE_TIMEOUT_MS 200      // time to wait for the rest of a line once it has started
+
+#define TPP_LORA_FRAME_OVERHEAD_BYTES 0   // bytes the module adds to each frame's payload (address etc.);
+                                          // not documented by REYAX, so airtime estimates are a lower bound
+
+// CRC-16/CCITT of a block of bytes. Used for the EEPROM records.
+uint16_t tpp_crc16(const uint8_t* data, unsigned int length, uint16_t crc = 0xFFFF);
+
 // class for the LoRa module
 class tpp_LoRa
 {
@@ -49,11 +122,45 @@ private:
 
     String LoRaStringBuffer;
     int isLoRaAwake = true; // true = awake, false = asleep
+    unsigned int commandCount = 0; // number of AT commands sent since boot
+
+    // settings last applied to the LoRa module, saved in EEPROM
+    struct ConfigRecord {
+        uint16_t magic;
+        uint16_t uidHash;       // detects a different LoRa module in the socket
+        uint16_t networkID;
+        uint16_t deviceAddress;
+        uint8_t spreadingFactor;
+        uint8_t bandwidth;
+        uint8_t codingRate;
+        uint8_t preamble;
+        uint8_t CRFOP;
+        uint8_t profile;        // tpp_LoRaProfiles entry the four above came from
+        uint32_t band;
+        uint16_t fingerprint;   // CRC of all of the above
+    };
+    void fillConfigRecord(ConfigRecord& record, int deviceAddress, int profile);
+
+    // baud rate last used with the LoRa module, saved in EEPROM
+    struct BaudRecord {
+        uint16_t magic;
+        uint16_t crc;
+        uint32_t baudRate;
+    };
+    bool probeBaud(long baudRate);   // true if the module answers AT with +OK at this rate
+    bool findBaud();                 // probe the supported rates; true if the module was found
+    bool switchBaud(long baudRate);  // AT+IPR to the new rate and verify it
 
     // function to send AT commands to the LoRa module
-    // returns 0 if successful, 1 if error, -1 if no response
+    // returns 0 if successful, 1 if error, 3 if no response within timeoutMS
     // prints message and result to the serial monitor
-    int sendCommand(const String& command);
+    int sendCommand(const String& command, unsigned long timeoutMS = TPP_LORA_COMMAND_TIMEOUT_MS);
+
+    // read one line from the LoRa module into receivedData, without the CR LF.
+    // returns 0 if successful, 3 if the line did not arrive within timeoutMS
+    int readLine(unsigned long timeoutMS);
+
+    String pendingReceive;  // a +RCV line that arrived while waiting for a command response
 
     void debugPrint(const String& message);
     void debugPrintNoHeader(const String& message);
@@ -61,19 +168,47 @@ private:
 
 public:
     // Do some class initialization stuff
-    // and test communication to the LoRa
+    // and test communication to the LoRa.
+    // Finds the baud rate the module is using (trying the saved rate first), then
+    // switches the module to the fastest rate this host handles, TPP_LORA_MAX_BAUD.
+    // The rate that works is saved in EEPROM.
     int begin();
     
     // set just the device address
     bool setAddress(unsigned int deviceAddress);
 
     // Initialize the LoRa module with settings found in the tpp_LoRa.h file
+    // Every setting is written. Returns true if error.
     bool configDevice(int devAddress);
 
+    // Initialize the LoRa module with settings found in the tpp_LoRa.h file and the
+    // radio parameters of tpp_LoRaProfiles[profile], but only write the settings that
+    // differ from what is in the module. If the fingerprint saved in EEPROM matches,
+    // only the UID is read back and nothing is written.
+    // forceFull = true writes every setting regardless of the fingerprint.
+    // Returns 0 if successful, otherwise error code
+    int configIfNeeded(int deviceAddress, bool forceFull = false, int profile = 0);
+
+    // Switch the radio to one of tpp_LoRaProfiles (both ends must use the same one)
+    // after configIfNeeded().  The fingerprint is saved with the new profile, so a
+    // configIfNeeded() with the same profile at the next boot writes nothing.
+    // Returns 0 if successful, 1 if error
+    int setProfile(int profile);
+
+    // AT, to see whether the module still answers, at the baud rate in use.  A message
+    // from another device that arrives meanwhile is kept for checkForReceivedMessage().
+    // Returns 0 if it answered +OK, 1 if error, 3 if no response within timeoutMS
+    int ping(unsigned long timeoutMS);
+
     // Read current settings and print them to the serial monitor
     //  If error then return false
     bool readSettings(); 
 
+    // wait until the LoRa module sends something or timeoutMS passes.
+    // On the ATmega328 the CPU idle sleeps until the UART receive interrupt
+    // (or the millis() timer tick) wakes it.  Returns true if data is available.
+    bool waitForData(unsigned long timeoutMS);
+
     // check for a received message from the LoRa module. status in receivedMessageState
     // if successful, the received data is stored in the receivedData variable
     // and other class variables. If not, the class variables are set to default
@@ -85,9 +220,17 @@ public:
     // XXX NOTE: when I changed this to an int for the address, the ATmega328 code broke
     // XXX so I changed it back to a string. I don't know why yet.
     int transmitMessage(long int toAddress, const String& message);
+
+    // estimated time on air, in microseconds, of a frame with this many payload bytes
+    // at the current settings (SX1262 formula: explicit header, CRC on)
+    unsigned long timeOnAirUS(unsigned int payloadLength);
     // xxx add number or retries and a string refernce for the response
     // xxx we need to discuss this
 
+    // true if payload is a TPP_LORA_MSG_ACKS frame with an entry for this module's
+    // address and message number seq
+    bool isAckFor(const String& payload, int seq);
+
     // function puts LoRa to sleep. LoRa will awaken when sent
     // a command.  Returns 0 if successful, 1 if error
     int sleep();
@@ -110,8 +253,11 @@ public:
     int LoRaCodingRate;
     int LoRaPreamble;  
     int LoRaCRFOP;
+    long LoRaBand;
+    long LoRaBaudRate = 0;  // baud rate in use between this host and the LoRa module
     int LoRaDeviceAddress;
     int ReceivedDeviceAddress;
+    int configCommandCount = 0; // AT commands sent by the last configIfNeeded()
 
 };
 
@@ -0,0 +1,185 @@
+/*
+    tpp_LoRaSupervisor.cpp - notices when the hub's LoRa module stops working and brings it back
+    created by Bob Glicksman and Jim Schrempp
+    as part of Team Practical Projects (tpp)
+
+    20261018 - first version
+*/
+
+#include "tpp_LoRaSupervisor.h"
+
+static const char* stageNames[] = {"", "resync", "config", "reset", "power"};
+
+void tpp_LoRaSupervisor::begin(tpp_LoRa* module, int hubAddress, int radioProfile, int resetPinNumber,
+        int powerPinNumber, unsigned long silenceLimitMS, tpp_SupervisorReportFn reportFn) {
+    lora = module;
+    address = hubAddress;
+    profile = radioProfile;
+    resetPin = resetPinNumber;
+    powerPin = powerPinNumber;
+    silenceMS = silenceLimitMS;
+    report = reportFn;
+    if (resetPin >= 0) {
+        pinMode(resetPin, INPUT);       // RST has its own pull up; only pulled low to reset
+    }
+    if (powerPin >= 0) {
+        pinMode(powerPin, OUTPUT);
+        digitalWrite(powerPin, HIGH);
+    }
+    lastGoodMS = millis();
+    summarize();
+}
+
+void tpp_LoRaSupervisor::commandResult(int rtn) {
+    if (rtn == 0) {
+        lastGoodMS = millis();
+    } else {
+        suspect = true;
+    }
+}
+
+void tpp_LoRaSupervisor::heard() {
+    lastGoodMS = lastHeardMS = millis();
+    deafStage = TPP_SUPERVISOR_STAGE_CONFIG;
+}
+
+void tpp_LoRaSupervisor::failed() {
+    if (state == WORKING) {
+        lastGoodMS = millis();
+        detect("did not start", TPP_SUPERVISOR_STAGE_RESYNC);
+    }
+}
+
+void tpp_LoRaSupervisor::deaf() {
+    deafPending = true;
+}
+
+bool tpp_LoRaSupervisor::answers() {
+    for (int i = 0; i < TPP_SUPERVISOR_PING_TRIES; i++) {
+        if (lora->ping(TPP_SUPERVISOR_PING_TIMEOUT_MS) == 0) {
+            lastGoodMS = millis();
+            return true;
+        }
+    }
+    return false;
+}
+
+bool tpp_LoRaSupervisor::configure() {
+    return lora->configIfNeeded(address, true, profile) == 0;
+}
+
+bool tpp_LoRaSupervisor::runStage(int stage) {
+    switch (stage) {
+        case TPP_SUPERVISOR_STAGE_RESYNC:
+            return answers() || (lora->begin() == 0 && answers());
+        case TPP_SUPERVISOR_STAGE_CONFIG:
+            return configure() && answers();
+        case TPP_SUPERVISOR_STAGE_RESET:
+            if (resetPin < 0) {
+                return false;
+            }
+            pinMode(resetPin, OUTPUT);
+            digitalWrite(resetPin, LOW);
+            delay(TPP_SUPERVISOR_RESET_PULSE_MS);
+            pinMode(resetPin, INPUT);
+            delay(TPP_SUPERVISOR_BOOT_MS);
+            return lora->begin() == 0 && configure() && answers();
+        case TPP_SUPERVISOR_STAGE_POWER:
+            if (powerPin < 0) {
+                return false;
+            }
+            digitalWrite(powerPin, LOW);
+            delay(TPP_SUPERVISOR_POWER_OFF_MS);
+            digitalWrite(powerPin, HIGH);
+            delay(TPP_SUPERVISOR_BOOT_MS);
+            return lora->begin() == 0 && configure() && answers();
+    }
+    return false;
+}
+
+void tpp_LoRaSupervisor::detect(const char* why, int stage) {
+    state = RECOVERING;
+    detectedMS = millis();
+    lastDetectMS = detectedMS - lastGoodMS;
+    cause = why;
+    firstStage = stage;
+    retryMS = TPP_SUPERVISOR_RETRY_MS;
+}
+
+void tpp_LoRaSupervisor::recover() {
+    String text = String(cause) + ", detect " + String(lastDetectMS) + " ms, ";
+    for (int stage = firstStage; stage <= TPP_SUPERVISOR_STAGE_POWER; stage++) {
+        if (!runStage(stage)) {
+            continue;
+        }
+        unsigned long now = millis();
+        state = WORKING;
+        suspect = false;
+        recoveries++;
+        lastStage = stage;
+        lastRecoverMS = now - detectedMS;
+        if (lastHeardMS != 0) {
+            lastHeardMS = now;          // the silence starts again
+        }
+        // still deaf next time, before anything is heard: go further
+        int lastAvailable = powerPin >= 0 ? TPP_SUPERVISOR_STAGE_POWER
+            : resetPin >= 0 ? TPP_SUPERVISOR_STAGE_RESET : TPP_SUPERVISOR_STAGE_CONFIG;
+        if (stage >= TPP_SUPERVISOR_STAGE_CONFIG && stage < lastAvailable) {
+            deafStage = stage + 1;
+        }
+        text += "stage " + String(stage) + " " + stageNames[stage] + ", recover " + String(lastRecoverMS) + " ms";
+        summarize();
+        status += "; last: " + text;
+        if (report) {
+            report(true, text);
+        }
+        return;
+    }
+
+    state = FAILED;
+    failures++;
+    retryAtMS = millis() + retryMS;
+    text += "no stage worked for " + String(millis() - detectedMS) + " ms, trying again in "
+        + String(retryMS / 1000) + " s";
+    retryMS = min(retryMS * 2, TPP_SUPERVISOR_RETRY_MAX_MS);
+    summarize();
+    status += "; " + text;
+    if (report) {
+        report(false, text);
+    }
+}
+
+void tpp_LoRaSupervisor::summarize() {
+    status = state == WORKING ? "working" : state == RECOVERING ? "recovering" : "failed";
+    status += ", " + String(recoveries) + " recoveries, " + String(failures) + " failures";
+}
+
+void tpp_LoRaSupervisor::process() {
+    unsigned long now = millis();
+    switch (state) {
+        case WORKING:
+            if (deafPending || (silenceMS != 0 && lastHeardMS != 0 && now - lastHeardMS > silenceMS)) {
+                deafPending = false;
+                lastGoodMS = lastHeardMS;   // it was last known to work when it last received
+                detect("deaf", deafStage);
+            } else if (suspect || now - lastGoodMS > TPP_SUPERVISOR_IDLE_PROBE_MS) {
+                suspect = false;
+                if (!answers()) {
+                    detect("no answer", TPP_SUPERVISOR_STAGE_RESYNC);
+                }
+            }
+            break;
+        case RECOVERING:
+            break;
+        case FAILED:
+            if ((long) (now - retryAtMS) < 0) {
+                return;
+            }
+            state = RECOVERING;
+            firstStage = TPP_SUPERVISOR_STAGE_RESYNC;
+            break;
+    }
+    if (state == RECOVERING) {
+        recover();
+    }
+}
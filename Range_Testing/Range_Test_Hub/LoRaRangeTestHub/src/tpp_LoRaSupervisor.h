@@ -0,0 +1,132 @@
+/*
+    tpp_LoRaSupervisor.h - notices when the hub's LoRa module stops working and brings it back
+    created by Bob Glicksman and Jim Schrempp
+    as part of Team Practical Projects (tpp)
+
+    20261018 - first version
+
+    A RYLR998 can stop answering on its serial port (brown out, a line garbled at the
+    wrong moment) or answer but stop receiving.  Either way the hub used to blink in
+    setup() or carry on deaf until someone power cycled it.  This watches for:
+
+        no answer   a command the hub sent failed or a received line could not be read
+                    (commandResult), or nothing at all has passed between the hub and
+                    the module for TPP_SUPERVISOR_IDLE_PROBE_MS.  Then AT is sent
+                    (tpp_LoRa::ping) up to TPP_SUPERVISOR_PING_TRIES times; if none
+                    is answered the module is wedged.
+        deafness    the module answers, but every sensor the registry watches has gone
+                    missing (deaf), or with silenceMS set nothing has been received for
+                    that long after something was.
+
+    and recovers in stages, each checked with AT before the next is tried:
+
+        1 resync    AT again, and if there is no answer tpp_LoRa::begin(), which looks
+                    for the module's baud rate
+        2 config    every setting written again (configIfNeeded, forced), and the radio
+                    profile
+        3 reset     the module's RST pulled low through resetPin, then begin() and config
+        4 power     the module's supply switched off and on through powerPin (HIGH is
+                    on), then begin() and config
+
+    Stages 3 and 4 are skipped when their pin is -1.  Deafness starts at stage 2, and at
+    a later stage each time it comes back before anything has been heard.  When every
+    stage fails, they are tried again after TPP_SUPERVISOR_RETRY_MS, doubling up to
+    TPP_SUPERVISOR_RETRY_MAX_MS.
+
+    Each episode is reported with the time to detect, from the last moment the module
+    was known to work to the moment it was found wedged, and the time to recover, from
+    then until a stage worked.  Recovery blocks loop() while it runs: a few seconds for
+    each stage, more when begin() has to look through the baud rates.
+*/
+
+#ifndef tpp_LoRaSupervisor_h
+#define tpp_LoRaSupervisor_h
+
+#include "tpp_LoRaGlobals.h"
+#include "tpp_LoRa.h"
+
+#define TPP_SUPERVISOR_IDLE_PROBE_MS 15000      // AT after this long with nothing from the module
+#define TPP_SUPERVISOR_PING_TIMEOUT_MS 1000     // longer than the +OK of an AT+SEND can take
+#define TPP_SUPERVISOR_PING_TRIES 2
+#define TPP_SUPERVISOR_RESET_PULSE_MS 100
+#define TPP_SUPERVISOR_POWER_OFF_MS 1000
+#define TPP_SUPERVISOR_BOOT_MS 1500             // for the module to start after a reset or power on
+#define TPP_SUPERVISOR_RETRY_MS 30000UL
+#define TPP_SUPERVISOR_RETRY_MAX_MS 600000UL
+
+#define TPP_SUPERVISOR_STAGE_RESYNC 1
+#define TPP_SUPERVISOR_STAGE_CONFIG 2
+#define TPP_SUPERVISOR_STAGE_RESET 3
+#define TPP_SUPERVISOR_STAGE_POWER 4
+
+// called when an episode ends: recovered true and what it took, or false when every stage
+// failed and they will be tried again
+typedef void (*tpp_SupervisorReportFn)(bool recovered, const String& text);
+
+class tpp_LoRaSupervisor
+{
+private:
+    enum State { WORKING, RECOVERING, FAILED };
+    State state = WORKING;
+    tpp_LoRa* lora = nullptr;
+    int address = 0;
+    int profile = 0;
+    int resetPin = -1;
+    int powerPin = -1;
+    unsigned long silenceMS = 0;
+    tpp_SupervisorReportFn report = nullptr;
+
+    bool suspect = false;               // a command failed; check with AT
+    bool deafPending = false;
+    int deafStage = TPP_SUPERVISOR_STAGE_CONFIG;  // where the next deafness starts
+    unsigned long lastGoodMS = 0;       // the module last answered or received
+    unsigned long lastHeardMS = 0;      // the last frame received
+    unsigned long detectedMS = 0;
+    unsigned long retryMS = TPP_SUPERVISOR_RETRY_MS;
+    unsigned long retryAtMS = 0;
+    int firstStage = TPP_SUPERVISOR_STAGE_RESYNC;
+    const char* cause = "";
+
+    bool answers();
+    bool configure();
+    bool runStage(int stage);
+    void detect(const char* why, int stage);
+    void recover();
+    void summarize();
+
+public:
+    // the module, the hub's address and radio profile to configure it with, the pins
+    // wired to its RST and power switch (-1 if not), silence before a deaf module is
+    // suspected (0: only when every watched sensor is missing) and where episodes go
+    void begin(tpp_LoRa* module, int hubAddress, int radioProfile, int resetPinNumber,
+        int powerPinNumber, unsigned long silenceLimitMS, tpp_SupervisorReportFn reportFn);
+
+    // the result of a command the hub sent the module (0 is success), or -1 for a
+    // received line that could not be read
+    void commandResult(int rtn);
+
+    // a frame was received
+    void heard();
+
+    // the module did not start; recovery begins at the next process()
+    void failed();
+
+    // every sensor the registry watches has gone missing
+    void deaf();
+
+    // checks and recovers as needed. Call from loop()
+    void process();
+
+    // false while the module is being recovered or could not be
+    bool working() { return state == WORKING; }
+
+    // "working, 2 recoveries, 0 failures; last: no answer, detect 15210 ms, stage 1 resync, recover 310 ms"
+    String status = "";
+    unsigned long recoveries = 0;
+    unsigned long failures = 0;         // times every stage failed
+    unsigned long lastDetectMS = 0;
+    unsigned long lastRecoverMS = 0;
+    int lastStage = 0;
+};
+
+#endif
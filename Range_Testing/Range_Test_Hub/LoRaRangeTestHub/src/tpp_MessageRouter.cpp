@@ -0,0 +1,72 @@
+/*
+    tpp_MessageRouter.cpp - sends each received frame to the handler for its message type
+    created by Bob Glicksman and Jim Schrempp
+    as part of Team Practical Projects (tpp)
+
+    20261018 - first version
+*/
+
+#include "tpp_MessageRouter.h"
+#include "tpp_AirtimeMeter.h"
+
+tpp_MessageRouter::tpp_MessageRouter() {
+    for (int i = 0; i < TPP_ROUTER_TYPES; i++) {
+        handlers[i] = nullptr;
+        counts[i] = 0;
+    }
+}
+
+int tpp_MessageRouter::add(char type, tpp_FrameHandler handler) {
+    if (type <= ' ' || type >= 0x7F || handlers[(int) type] != nullptr) {
+        return -1;
+    }
+    handlers[(int) type] = handler;
+    return 0;
+}
+
+void tpp_MessageRouter::setUnknown(tpp_FrameHandler handler) {
+    unknownHandler = handler;
+}
+
+char tpp_MessageRouter::typeOf(const String& payload) {
+    if (payload.length() == 0) {
+        return 0;
+    }
+    char type = payload.charAt(0);
+    if (type <= ' ' || type >= 0x7F) {
+        return 0;
+    }
+    if (payload.length() > 1 && payload.charAt(1) != ' ') {
+        return 0;
+    }
+    return type;
+}
+
+tpp_FrameResult tpp_MessageRouter::route(long address, const String& payload, int SNR, int RSSI) {
+    char type = typeOf(payload);
+    tpp_FrameHandler handler = type ? handlers[(int) type] : nullptr;
+    if (handler) {
+        counts[(int) type]++;
+    } else {
+        type = 0;
+        unknownCount++;
+        handler = unknownHandler;
+    }
+    tpp_Frame frame = {type, address, payload, tpp_AirtimeMeter::sequenceOf(payload), SNR, RSSI};
+    if (!handler) {
+        tpp_FrameResult nothing = {0, false, ""};
+        return nothing;
+    }
+    return handler(frame);
+}
+
+String tpp_MessageRouter::counters() {
+    String text = "";
+    for (int i = 0; i < TPP_ROUTER_TYPES; i++) {
+        if (handlers[i] != nullptr) {
+            text += String((char) i) + ":" + String(counts[i]) + ",";
+        }
+    }
+    text += "?:" + String(unknownCount);
+    return text;
+}
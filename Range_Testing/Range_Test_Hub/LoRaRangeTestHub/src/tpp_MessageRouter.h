@@ -0,0 +1,74 @@
+/*
+    tpp_MessageRouter.h - sends each received frame to the handler for its message type
+    created by Bob Glicksman and Jim Schrempp
+    as part of Team Practical Projects (tpp)
+
+    20261018 - first version
+
+    The message type is the first byte of the payload (TPP_LORA_MSG_ in tpp_LoRa.h),
+    and it must be followed by a space or be the whole payload.  "G m: 5" is a gate
+    frame; "Gxyz", " G m: 5" and "HELLO G" are not anything.  The handler is found by
+    indexing a table with that byte, so routing costs the same however many types
+    there are.  Frames with no handler, or not in the form above, go to the unknown
+    handler.
+
+    A handler gets the frame already taken apart and returns what to log and what
+    to send back; the caller does the logging and sending.  Frames of each type
+    are counted.
+*/
+
+#ifndef tpp_MessageRouter_h
+#define tpp_MessageRouter_h
+
+#include "tpp_LoRaGlobals.h"
+
+#define TPP_ROUTER_TYPES 128      // one table entry for each 7 bit character
+
+// a received frame, taken apart
+struct tpp_Frame {
+    char type;              // the first byte of the payload
+    long address;           // sender
+    const String& payload;
+    int seq;                // the " m: " message number, -1 if none
+    int SNR;
+    int RSSI;
+};
+
+// what a handler wants done with a frame
+struct tpp_FrameResult {
+    char logCode;           // TPP_HUBLOG_CODE_, 0 to log nothing
+    bool ack;               // acknowledge it (TESTOK, or held for a broadcast ack frame)
+    String reply;           // send this to the sensor, if not empty
+};
+
+typedef tpp_FrameResult (*tpp_FrameHandler)(const tpp_Frame& frame);
+
+class tpp_MessageRouter
+{
+private:
+    tpp_FrameHandler handlers[TPP_ROUTER_TYPES];
+    unsigned long counts[TPP_ROUTER_TYPES];
+    tpp_FrameHandler unknownHandler = nullptr;
+    unsigned long unknownCount = 0;
+
+public:
+    tpp_MessageRouter();
+
+    // the handler for frames whose payload starts with type; returns -1 if type is not
+    // a printable character or already has a handler
+    int add(char type, tpp_FrameHandler handler);
+
+    // the handler for everything else
+    void setUnknown(tpp_FrameHandler handler);
+
+    // the frame's type, or 0 if it has none
+    static char typeOf(const String& payload);
+
+    // takes the frame apart and calls its handler
+    tpp_FrameResult route(long address, const String& payload, int SNR, int RSSI);
+
+    // frames of each type so far, e.g. "G:120,H:4,?:1"; ? is unknown
+    String counters();
+};
+
+#endif
@@ -0,0 +1,168 @@
+/*
+    tpp_Relay.cpp - frames passed on by repeaters, between far sensors and the hub
+    created by Bob Glicksman and Jim Schrempp
+    as part of Team Practical Projects (tpp)
+
+    20261018 - first version
+*/
+
+#include "tpp_Relay.h"
+
+// reads an unsigned number at p; returns false if there is none
+static bool readNumber(const char*& p, long& value) {
+    if (*p < '0' || *p > '9') {
+        return false;
+    }
+    value = 0;
+    while (*p >= '0' && *p <= '9' && value <= 65535) {
+        value = value * 10 + (*p++ - '0');
+    }
+    return value <= 65535;
+}
+
+// "<type> <address>," at the start of frame; p is left after the comma
+static bool readHeader(const String& frame, char type, long& address, const char*& p) {
+    p = frame.c_str();
+    if (p[0] != type || p[1] != ' ') {
+        return false;
+    }
+    p += 2;
+    return readNumber(p, address) && *p++ == ',';
+}
+
+bool tpp_Relay::wrapUp(long address, int hops, const String& path, const String& payload, String& frame) {
+    frame = TPP_LORA_MSG_RELAY " ";
+    frame += address;
+    frame += ',';
+    frame += hops;
+    frame += ',';
+    frame += path;
+    frame += ';';
+    frame += payload;
+    return frame.length() <= TPP_RELAY_MAX_FRAME;
+}
+
+bool tpp_Relay::unwrapUp(const String& frame, long& address, int& hops, String& path, String& payload) {
+    const char* p;
+    long value;
+    if (!readHeader(frame, TPP_LORA_MSG_RELAY[0], address, p) || !readNumber(p, value) || *p++ != ',') {
+        return false;
+    }
+    hops = value;
+    const char* end = strchr(p, ';');
+    if (!end) {
+        return false;
+    }
+    int start = p - frame.c_str();
+    path = frame.substring(start, end - frame.c_str());
+    payload = frame.substring(end + 1 - frame.c_str());
+    return true;
+}
+
+bool tpp_Relay::wrapDown(long address, const String& route, const String& payload, String& frame) {
+    frame = TPP_LORA_MSG_RELAY_DOWN " ";
+    frame += address;
+    frame += ',';
+    frame += route;
+    frame += ';';
+    frame += payload;
+    return frame.length() <= TPP_RELAY_MAX_FRAME;
+}
+
+bool tpp_Relay::unwrapDown(const String& frame, long& address, String& route, String& payload) {
+    const char* p;
+    if (!readHeader(frame, TPP_LORA_MSG_RELAY_DOWN[0], address, p)) {
+        return false;
+    }
+    const char* end = strchr(p, ';');
+    if (!end) {
+        return false;
+    }
+    route = frame.substring(p - frame.c_str(), end - frame.c_str());
+    payload = frame.substring(end + 1 - frame.c_str());
+    return true;
+}
+
+bool tpp_Relay::routeBack(const String& path, long& via, String& route) {
+    // the repeaters of the path, nearest the sensor first
+    long repeaters[TPP_RELAY_MAX_HOPS];
+    int count = 0;
+    const char* p = path.c_str();
+    while (*p) {
+        if (count == TPP_RELAY_MAX_HOPS || !readNumber(p, repeaters[count])) {
+            return false;
+        }
+        count++;
+        while (*p && *p != '/') {
+            p++;                // the SNR and RSSI
+        }
+        if (*p == '/') {
+            p++;
+        }
+    }
+    if (count == 0) {
+        return false;
+    }
+
+    // the one nearest the hub gets the answer; the rest are the route, in reverse
+    via = repeaters[count - 1];
+    route = "";
+    for (int i = count - 2; i >= 0; i--) {
+        if (route.length()) {
+            route += '/';
+        }
+        route += repeaters[i];
+    }
+    return true;
+}
+
+bool tpp_Relay::duplicate(long address, const String& payload, bool relayed) {
+    uint16_t crc = tpp_crc16((const uint8_t*) payload.c_str(), payload.length());
+    unsigned long now = millis();
+    bool found = false;
+    for (int i = 0; i < TPP_RELAY_RECENT; i++) {
+        Recent& r = recent[i];
+        if (r.used && r.address == address && r.crc == crc && now - r.ms < TPP_RELAY_DUPLICATE_MS) {
+            found = relayed || r.relayed;
+            if (found) {
+                break;
+            }
+        }
+    }
+    if (found) {
+        duplicates++;
+        return true;
+    }
+    Recent& r = recent[nextRecent];
+    nextRecent = (nextRecent + 1) % TPP_RELAY_RECENT;
+    r.used = true;
+    r.relayed = relayed;
+    r.answered = false;
+    r.address = address;
+    r.crc = crc;
+    r.ms = now;
+    return false;
+}
+
+void tpp_Relay::markAnswered(long address, const String& payload) {
+    uint16_t crc = tpp_crc16((const uint8_t*) payload.c_str(), payload.length());
+    for (int n = 1; n <= TPP_RELAY_RECENT; n++) {
+        Recent& r = recent[(nextRecent + TPP_RELAY_RECENT - n) % TPP_RELAY_RECENT];    // newest first
+        if (r.used && r.address == address && r.crc == crc) {
+            r.answered = true;
+            return;
+        }
+    }
+}
+
+bool tpp_Relay::answered(long address, const String& payload) {
+    uint16_t crc = tpp_crc16((const uint8_t*) payload.c_str(), payload.length());
+    unsigned long now = millis();
+    for (int i = 0; i < TPP_RELAY_RECENT; i++) {
+        Recent& r = recent[i];
+        if (r.used && r.answered && r.address == address && r.crc == crc && now - r.ms < TPP_RELAY_DUPLICATE_MS) {
+            return true;
+        }
+    }
+    return false;
+}
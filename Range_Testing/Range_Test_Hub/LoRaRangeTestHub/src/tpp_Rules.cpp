@@ -0,0 +1,304 @@
+/*
+    tpp_Rules.cpp - local rules: outputs driven by the hub as soon as a frame arrives
+    created by Bob Glicksman and Jim Schrempp
+    as part of Team Practical Projects (tpp)
+
+    20261018 - first version
+*/
+
+#include "tpp_Rules.h"
+
+#if HAL_PLATFORM_FILESYSTEM
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#define TPP_RULES_MAX_SOURCE 1024
+
+// digits at p, not past end; false if there are none
+static bool readNumber(const char*& p, const char* end, long& value) {
+    const char* start = p;
+    value = 0;
+    while (p < end && *p >= '0' && *p <= '9' && p - start < 9) {
+        value = value * 10 + (*p - '0');
+        p++;
+    }
+    return p > start;
+}
+
+// HHMM as minutes of the day, -1 if not a time
+static int readTime(const char*& p, const char* end) {
+    const char* start = p;
+    long hhmm;
+    if (!readNumber(p, end, hhmm) || p - start != 4 || hhmm / 100 > 23 || hhmm % 100 > 59) {
+        return -1;
+    }
+    return (hhmm / 100) * 60 + hhmm % 100;
+}
+
+void tpp_Rules::begin(uint32_t reservedPinMask) {
+    reservedPins = reservedPinMask;
+    table.count = 0;
+    table.stepCount = 0;
+    table.textLength = 0;
+    for (int i = 0; i < TPP_RULES_MAX_OUTPUTS; i++) {
+        outputs[i].pin = -1;
+    }
+    load();
+}
+
+// one rule into scratch; false if it is not valid
+bool tpp_Rules::compileRule(const char* text, int length) {
+    const char* p = text;
+    const char* end = text + length;
+    while (p < end && *p == ' ') {
+        p++;
+    }
+    if (scratch.count >= TPP_RULES_MAX) {
+        return false;
+    }
+    Rule& r = scratch.rules[scratch.count];
+    long value;
+
+    // addresses
+    if (p < end && *p == '*') {
+        r.addressLow = 0;
+        r.addressHigh = 65535;
+        p++;
+    } else {
+        if (!readNumber(p, end, value) || value > 65535) {
+            return false;
+        }
+        r.addressLow = r.addressHigh = value;
+        if (p < end && *p == '-') {
+            p++;
+            if (!readNumber(p, end, value) || value > 65535 || value < r.addressLow) {
+                return false;
+            }
+            r.addressHigh = value;
+        }
+    }
+    if (p >= end || *p++ != ',') {
+        return false;
+    }
+
+    // type
+    if (p >= end || *p <= ' ' || *p >= 0x7F || *p == ',') {
+        return false;
+    }
+    r.type = *p == '*' ? 0 : *p;
+    p++;
+    if (p >= end || *p++ != ',') {
+        return false;
+    }
+
+    // window
+    if (p < end && *p == '*') {
+        r.fromMinute = r.toMinute = -1;
+        p++;
+    } else {
+        r.fromMinute = readTime(p, end);
+        if (r.fromMinute < 0 || p >= end || *p++ != '-') {
+            return false;
+        }
+        r.toMinute = readTime(p, end);
+        if (r.toMinute < 0) {
+            return false;
+        }
+    }
+    if (p >= end || *p++ != ',' || p >= end) {
+        return false;
+    }
+
+    // action
+    char action = *p++;
+    if (action == 'S') {
+        int textLength = end - p;
+        if (scratch.textLength + textLength + 1 > TPP_RULES_MAX_TEXT) {
+            return false;
+        }
+        r.action = ACTION_SERIAL;
+        r.firstStep = scratch.textLength;
+        memcpy(scratch.text + scratch.textLength, p, textLength);
+        scratch.textLength += textLength;
+        scratch.text[scratch.textLength++] = 0;
+    } else if (action == 'P' || action == 'B') {
+        if (p < end && *p == 'D') {
+            p++;
+        }
+        if (!readNumber(p, end, value) || value > TPP_RULES_MAX_PIN || (reservedPins & (1UL << value))) {
+            return false;
+        }
+        r.action = ACTION_PIN;
+        r.pin = value;
+        r.firstStep = scratch.stepCount;
+        r.stepCount = 0;
+        while (p < end && *p == '/') {
+            p++;
+            if (!readNumber(p, end, value) || value > 65535 || scratch.stepCount >= TPP_RULES_MAX_STEPS) {
+                return false;
+            }
+            scratch.steps[scratch.stepCount++] = value;
+            r.stepCount++;
+        }
+        if (r.stepCount == 0 || (action == 'P' && r.stepCount != 1) || p != end) {
+            return false;
+        }
+    } else {
+        return false;
+    }
+    scratch.count++;
+    return true;
+}
+
+int tpp_Rules::set(const String& text) {
+    if (text.length() > TPP_RULES_MAX_SOURCE) {
+        return -1;
+    }
+    scratch.count = 0;
+    scratch.stepCount = 0;
+    scratch.textLength = 0;
+    const char* p = text.c_str();
+    int number = 0;
+    while (*p) {
+        const char* end = strchr(p, ';');
+        if (!end) {
+            end = p + strlen(p);
+        }
+        number++;
+        if (end > p && !compileRule(p, end - p)) {
+            return -number;
+        }
+        p = *end ? end + 1 : end;
+    }
+
+    // stop what is playing, then use the new table
+    for (int i = 0; i < TPP_RULES_MAX_OUTPUTS; i++) {
+        if (outputs[i].pin >= 0) {
+            digitalWrite(outputs[i].pin, LOW);
+            outputs[i].pin = -1;
+        }
+    }
+    table = scratch;
+    for (int i = 0; i < table.count; i++) {
+        if (table.rules[i].action == ACTION_PIN) {
+            pinMode(table.rules[i].pin, OUTPUT);
+            digitalWrite(table.rules[i].pin, LOW);
+        }
+    }
+    if (source != text) {
+        source = text;
+        save();
+    }
+    return table.count;
+}
+
+int tpp_Rules::apply(int address, char type, const String& payload) {
+    int minute = -1;
+    if (Time.isValid()) {
+        minute = (Time.local() % 86400) / 60;
+    }
+    int count = 0;
+    for (int i = 0; i < table.count; i++) {
+        const Rule& r = table.rules[i];
+        if (address < r.addressLow || address > r.addressHigh || (r.type && r.type != type)) {
+            continue;
+        }
+        if (r.fromMinute >= 0) {
+            if (minute < 0) {
+                continue;
+            }
+            bool inside = r.fromMinute <= r.toMinute ? minute >= r.fromMinute && minute < r.toMinute
+                : minute >= r.fromMinute || minute < r.toMinute;
+            if (!inside) {
+                continue;
+            }
+        }
+        if (r.action == ACTION_PIN) {
+            start(r);
+        } else {
+            DEBUG_SERIAL.println("rule " + String(i + 1) + ": " + String(address) + " " + payload + " "
+                + String(table.text + r.firstStep));
+        }
+        count++;
+    }
+    fired += count;
+    return count;
+}
+
+void tpp_Rules::start(const Rule& rule) {
+    int free = -1;
+    for (int i = 0; i < TPP_RULES_MAX_OUTPUTS; i++) {
+        if (outputs[i].pin == rule.pin) {
+            free = i;
+            break;
+        }
+        if (free < 0 && outputs[i].pin < 0) {
+            free = i;
+        }
+    }
+    if (free < 0) {
+        return;     // all outputs busy
+    }
+    Output& o = outputs[free];
+    o.pin = rule.pin;
+    o.steps = table.steps + rule.firstStep;
+    o.stepCount = rule.stepCount;
+    o.step = 0;
+    o.stepStartMS = millis();
+    digitalWrite(o.pin, HIGH);
+}
+
+void tpp_Rules::process() {
+    unsigned long now = millis();
+    for (int i = 0; i < TPP_RULES_MAX_OUTPUTS; i++) {
+        Output& o = outputs[i];
+        if (o.pin < 0 || now - o.stepStartMS < o.steps[o.step]) {
+            continue;
+        }
+        o.step++;
+        o.stepStartMS = now;
+        if (o.step >= o.stepCount) {
+            digitalWrite(o.pin, LOW);
+            o.pin = -1;
+        } else {
+            digitalWrite(o.pin, (o.step % 2) == 0 ? HIGH : LOW);
+        }
+    }
+}
+
+void tpp_Rules::load() {
+#if HAL_PLATFORM_FILESYSTEM
+    int fd = open(TPP_RULES_FILE, O_RDONLY);
+    if (fd < 0) {
+        return;
+    }
+    char text[TPP_RULES_MAX_SOURCE + 1];
+    int length = read(fd, text, TPP_RULES_MAX_SOURCE);
+    close(fd);
+    if (length <= 0) {
+        return;
+    }
+    text[length] = 0;
+    source = text;      // so set() does not write it back
+    int rtn = set(source);
+    if (rtn < 0) {
+        source = "";
+    }
+    DEBUG_SERIAL.println("rules loaded: " + String(rtn));
+#endif
+}
+
+void tpp_Rules::save() {
+#if HAL_PLATFORM_FILESYSTEM
+    int fd = open(TPP_RULES_FILE ".new", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return;
+    }
+    bool good = write(fd, source.c_str(), source.length()) == (int) source.length();
+    close(fd);
+    if (good) {
+        rename(TPP_RULES_FILE ".new", TPP_RULES_FILE);
+    }
+#endif
+}
@@ -0,0 +1,109 @@
+/*
+    tpp_Rules.h - local rules: outputs driven by the hub as soon as a frame arrives
+    created by Bob Glicksman and Jim Schrempp
+    as part of Team Practical Projects (tpp)
+
+    20261018 - first version
+
+    A trip reported through the cloud takes seconds to reach anyone and does nothing
+    when the internet is down.  Rules run in the hub right after a frame is received,
+    before any cloud work, and drive a pin (relay, light), play a buzzer pattern or
+    print a line on the USB serial port.
+
+    Rules are text, one or more separated by ';':
+
+        <addresses>,<type>,<window>,<action>
+
+        addresses   *, an address, or a range low-high
+        type        *, or a message type character (G gate, E help button, H heartbeat ...)
+        window      *, or local time HHMM-HHMM; 2200-0600 wraps past midnight
+        action      P<pin>/<ms>             pin high for ms
+                    B<pin>/<on>/<off>/<on>...   buzzer: pin high, low, high ... for each ms
+                    S<text>                 "rule <n>: <address> <payload> <text>" on the USB serial port
+
+    e.g.  12000-12007,E,*,B6/200/100/200/100/600;12001,G,2200-0600,P5/60000;*,G,*,Sgate
+
+    The text is compiled to a table of fixed size records when it is set; a bad rule
+    leaves the old table in place.  A frame is checked against every rule, TPP_RULES_MAX
+    at most, so it costs a few microseconds.  Outputs are timed in process(), nothing
+    waits.  A pin already playing starts again from the beginning.  Rules with a window
+    do not fire until the hub's clock is set.
+
+    On devices with a file system the text is saved to TPP_RULES_FILE and loaded at
+    begin(), so rules work after a reboot with no cloud connection.
+*/
+
+#ifndef tpp_Rules_h
+#define tpp_Rules_h
+
+#include "tpp_LoRaGlobals.h"
+
+#define TPP_RULES_MAX 32
+#define TPP_RULES_MAX_STEPS 128         // buzzer and pulse times, all rules together
+#define TPP_RULES_MAX_TEXT 256          // S action texts, all rules together
+#define TPP_RULES_MAX_OUTPUTS 8         // pins playing at the same time
+#define TPP_RULES_MAX_PIN 19            // D0 - D19
+#define TPP_RULES_FILE "/tpp_rules.txt"
+
+class tpp_Rules
+{
+private:
+    enum {ACTION_PIN, ACTION_SERIAL};
+
+    struct Rule {
+        uint16_t addressLow;
+        uint16_t addressHigh;
+        int16_t fromMinute;         // -1: any time
+        int16_t toMinute;
+        char type;                  // 0: any
+        uint8_t action;
+        uint8_t pin;
+        uint8_t stepCount;
+        uint16_t firstStep;         // into steps, or into text for ACTION_SERIAL
+    };
+
+    struct Table {
+        Rule rules[TPP_RULES_MAX];
+        int count;
+        uint16_t steps[TPP_RULES_MAX_STEPS];
+        int stepCount;
+        char text[TPP_RULES_MAX_TEXT];
+        int textLength;
+    };
+
+    struct Output {
+        int pin;                    // -1: free
+        const uint16_t* steps;
+        int stepCount;
+        int step;
+        unsigned long stepStartMS;
+    };
+
+    Table table;
+    Table scratch;                  // compiled into, then copied over table
+    Output outputs[TPP_RULES_MAX_OUTPUTS];
+    uint32_t reservedPins = 0;
+
+    bool compileRule(const char* text, int length);
+    void start(const Rule& rule);
+    void load();
+    void save();
+
+public:
+    // loads the saved rules; pins in reservedPinMask (bit n for Dn) can not be used
+    void begin(uint32_t reservedPinMask);
+
+    // replaces the rules.  Returns the number of rules, or -n if rule n (from 1) is bad
+    int set(const String& text);
+
+    // runs the rules for a frame; returns the number that fired
+    int apply(int address, char type, const String& payload);
+
+    // times the outputs. Call from loop()
+    void process();
+
+    String source = "";             // the rules as set
+    unsigned long fired = 0;
+};
+
+#endif
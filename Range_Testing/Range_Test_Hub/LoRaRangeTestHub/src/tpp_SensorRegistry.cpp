@@ -0,0 +1,381 @@
+/*
+    tpp_SensorRegistry.cpp - the sensors the hub has heard, and which of them have gone silent
+    created by Bob Glicksman and Jim Schrempp
+    as part of Team Practical Projects (tpp)
+
+    20261018 - first version
+*/
+
+#include "tpp_SensorRegistry.h"
+
+#if HAL_PLATFORM_FILESYSTEM
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#define TPP_REGISTRY_FILE_MAGIC_1 0x31525054UL  // "TPR1", records without the auth fields
+#define TPP_REGISTRY_FILE_MAGIC 0x32525054UL    // "TPR2"
+
+// the record saved for each sensor
+struct tpp_SensorRecord {
+    uint16_t address;
+    uint8_t missing;
+    uint8_t unused;
+    uint32_t intervalS;
+    uint32_t lastHeard;
+    uint32_t authCounter;       // TPR2
+    uint32_t authSeen;
+};
+#define TPP_REGISTRY_RECORD_1_SIZE 12
+
+void tpp_SensorRegistry::begin(tpp_SensorReportFn reportFn, unsigned long defaultSeconds) {
+    report = reportFn;
+    defaultIntervalS = defaultSeconds;
+    count = 0;
+    missingCount = 0;
+    savedCount = -1;
+    for (int i = 0; i < TPP_REGISTRY_HASH_SIZE; i++) {
+        hashTable[i] = -1;
+    }
+    for (int i = 0; i < TPP_REGISTRY_WHEEL_SLOTS; i++) {
+        wheel[i] = -1;
+    }
+    wheelTime = Time.isValid() ? Time.now() : 0;
+    load();
+    lastSaveMS = millis();
+}
+
+int tpp_SensorRegistry::find(int address) {
+    unsigned int h = ((uint32_t) address * 2654435761UL) >> 8;
+    for (int probe = 0; probe < TPP_REGISTRY_HASH_SIZE; probe++) {
+        int i = hashTable[(h + probe) & (TPP_REGISTRY_HASH_SIZE - 1)];
+        if (i < 0) {
+            return -1;
+        }
+        if (sensors[i].address == address) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// a new entry; -1 if the registry is full
+int tpp_SensorRegistry::add(int address) {
+    if (count >= TPP_REGISTRY_MAX_SENSORS) {
+        return -1;
+    }
+    unsigned int h = ((uint32_t) address * 2654435761UL) >> 8;
+    int probe = 0;
+    while (hashTable[(h + probe) & (TPP_REGISTRY_HASH_SIZE - 1)] >= 0) {
+        probe++;
+    }
+    int i = count++;
+    hashTable[(h + probe) & (TPP_REGISTRY_HASH_SIZE - 1)] = i;
+    Sensor& s = sensors[i];
+    s.address = address;
+    s.missing = false;
+    s.intervalS = defaultIntervalS;
+    s.lastHeard = 0;
+    s.deadline = 0;
+    s.slot = -1;
+    s.next = -1;
+    s.prev = -1;
+    s.authCounter = 0;
+    s.authSeen = 0;
+    return i;
+}
+
+// link into the slot of its deadline; a deadline already past goes in the next second's slot
+void tpp_SensorRegistry::schedule(int i) {
+    Sensor& s = sensors[i];
+    if (s.intervalS == 0 || s.missing || s.lastHeard == 0 || wheelTime == 0) {
+        return;     // wheelTime 0: the clock is not known yet; process() schedules everything then
+    }
+    s.deadline = s.lastHeard + s.intervalS * TPP_REGISTRY_MISSED_BEATS + TPP_REGISTRY_GRACE_S;
+    uint32_t at = s.deadline > wheelTime ? s.deadline : wheelTime + 1;
+    int slot = at & (TPP_REGISTRY_WHEEL_SLOTS - 1);
+    s.slot = slot;
+    s.prev = -1;
+    s.next = wheel[slot];
+    if (s.next >= 0) {
+        sensors[s.next].prev = i;
+    }
+    wheel[slot] = i;
+}
+
+void tpp_SensorRegistry::unschedule(int i) {
+    Sensor& s = sensors[i];
+    if (s.deadline == 0) {
+        return;
+    }
+    if (s.prev >= 0) {
+        sensors[s.prev].next = s.next;
+    } else {
+        wheel[s.slot] = s.next;
+    }
+    if (s.next >= 0) {
+        sensors[s.next].prev = s.prev;
+    }
+    s.next = -1;
+    s.prev = -1;
+    s.deadline = 0;
+}
+
+// the sensors in this second's slot whose deadline has come; later rounds stay linked
+void tpp_SensorRegistry::expire(uint32_t second) {
+    int i = wheel[second & (TPP_REGISTRY_WHEEL_SLOTS - 1)];
+    while (i >= 0) {
+        int next = sensors[i].next;
+        if (sensors[i].deadline <= second) {
+            check(i, second);
+        }
+        i = next;
+    }
+}
+
+void tpp_SensorRegistry::check(int i, uint32_t now) {
+    Sensor& s = sensors[i];
+    unschedule(i);
+    s.missing = true;
+    missingCount++;
+    dirty = true;
+    if (report) {
+        report(s.address, true, now - s.lastHeard);
+    }
+}
+
+void tpp_SensorRegistry::heard(int address, const String& payload) {
+    if (!Time.isValid()) {
+        return;
+    }
+    uint32_t now = Time.now();
+    int i = find(address);
+    if (i < 0) {
+        i = add(address);
+        if (i < 0) {
+            return;
+        }
+    }
+    Sensor& s = sensors[i];
+    int at = payload.indexOf(" h: ");
+    if (at >= 0) {
+        long hours = payload.substring(at + 4).toInt();
+        if (hours > 0) {
+            s.intervalS = hours * 3600UL;
+        }
+    }
+    if (s.missing) {
+        s.missing = false;
+        missingCount--;
+        if (report) {
+            report(address, false, now - s.lastHeard);
+        }
+    }
+    unschedule(i);
+    s.lastHeard = now;
+    schedule(i);
+    dirty = true;
+}
+
+int tpp_SensorRegistry::setInterval(int address, unsigned long seconds) {
+    int i = find(address);
+    if (i < 0) {
+        i = add(address);
+        if (i < 0) {
+            return 1;
+        }
+        sensors[i].lastHeard = Time.isValid() ? Time.now() : 0;   // watched from now
+    }
+    Sensor& s = sensors[i];
+    unschedule(i);
+    s.intervalS = seconds;
+    if (seconds == 0 && s.missing) {
+        s.missing = false;
+        missingCount--;
+    }
+    schedule(i);
+    dirty = true;
+    return 0;
+}
+
+int tpp_SensorRegistry::acceptCounter(int address, uint32_t counter) {
+    int i = find(address);
+    if (i < 0) {
+        i = add(address);
+        if (i < 0) {
+            return 1;
+        }
+    }
+    Sensor& s = sensors[i];
+    if (s.authSeen == 0 || counter > s.authCounter) {
+        uint32_t ahead = s.authSeen == 0 ? TPP_REGISTRY_REPLAY_WINDOW : counter - s.authCounter;
+        s.authSeen = ahead >= TPP_REGISTRY_REPLAY_WINDOW ? 1 : (s.authSeen << ahead) | 1;
+        s.authCounter = counter;
+    } else {
+        uint32_t behind = s.authCounter - counter;
+        if (behind >= TPP_REGISTRY_REPLAY_WINDOW || (s.authSeen & (1UL << behind))) {
+            return -1;
+        }
+        s.authSeen |= 1UL << behind;
+    }
+    // not left for the next periodic save: after a reboot this frame could be replayed
+    saveSensor(i);
+    return 0;
+}
+
+void tpp_SensorRegistry::process() {
+    if (!Time.isValid()) {
+        return;
+    }
+    uint32_t now = Time.now();
+    if (wheelTime == 0) {
+        // first time the clock is known: schedule what was loaded at begin()
+        wheelTime = now;
+        for (int i = 0; i < count; i++) {
+            schedule(i);
+        }
+    } else if (now < wheelTime) {
+        wheelTime = now;    // the clock was set back
+    }
+    if (now - wheelTime > TPP_REGISTRY_WHEEL_SLOTS) {
+        // a long gap (or the clock jumped ahead): look at every sensor once
+        for (int i = 0; i < count; i++) {
+            if (sensors[i].deadline && sensors[i].deadline <= now) {
+                check(i, now);
+            }
+        }
+    } else {
+        while (wheelTime < now) {
+            wheelTime++;
+            expire(wheelTime);
+        }
+    }
+    wheelTime = now;
+
+    if (dirty && millis() - lastSaveMS > TPP_REGISTRY_SAVE_MS) {
+        save();
+    }
+}
+
+int tpp_SensorRegistry::watchedCount() {
+    int watched = 0;
+    for (int i = 0; i < count; i++) {
+        watched += sensors[i].intervalS != 0;
+    }
+    return watched;
+}
+
+String tpp_SensorRegistry::summary() {
+    String text = String(count) + " sensors, " + String(watchedCount()) + " watched, " + String(missingCount) + " missing";
+    if (missingCount) {
+        text += ":";
+        for (int i = 0; i < count && text.length() < 600; i++) {
+            if (sensors[i].missing) {
+                text += " " + String(sensors[i].address);
+            }
+        }
+    }
+    return text;
+}
+
+void tpp_SensorRegistry::load() {
+#if HAL_PLATFORM_FILESYSTEM
+    int fd = open(TPP_REGISTRY_FILE, O_RDONLY);
+    if (fd < 0) {
+        return;
+    }
+    uint32_t header[2];
+    bool current = false;
+    if (read(fd, header, sizeof(header)) == sizeof(header)
+            && ((current = header[0] == TPP_REGISTRY_FILE_MAGIC) || header[0] == TPP_REGISTRY_FILE_MAGIC_1)) {
+        tpp_SensorRecord r = {};
+        int size = current ? sizeof(r) : TPP_REGISTRY_RECORD_1_SIZE;
+        bool inPlace = current;     // each sensor's index is its place in the file
+        for (uint32_t n = 0; n < header[1] && read(fd, &r, size) == size; n++) {
+            int i = find(r.address) >= 0 ? -1 : add(r.address);
+            if (i < 0) {
+                inPlace = false;
+                continue;
+            }
+            Sensor& s = sensors[i];
+            s.intervalS = r.intervalS;
+            s.lastHeard = r.lastHeard;
+            s.missing = r.missing != 0;
+            s.authCounter = r.authCounter;
+            s.authSeen = r.authSeen;
+            missingCount += s.missing;
+            schedule(i);
+        }
+        savedCount = inPlace && (uint32_t) count == header[1] ? count : -1;
+    }
+    close(fd);
+    DEBUG_SERIAL.println("sensor registry loaded: " + summary());
+#endif
+}
+
+void tpp_SensorRegistry::save() {
+    dirty = false;
+    lastSaveMS = millis();
+#if HAL_PLATFORM_FILESYSTEM
+    // write a new file and rename it over the old one, so a reset part way leaves the old file
+    int fd = open(TPP_REGISTRY_FILE ".new", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return;
+    }
+    uint32_t header[2] = {TPP_REGISTRY_FILE_MAGIC, (uint32_t) count};
+    bool good = write(fd, header, sizeof(header)) == sizeof(header);
+    for (int i = 0; i < count && good; i++) {
+        tpp_SensorRecord r;
+        r.address = sensors[i].address;
+        r.missing = sensors[i].missing;
+        r.unused = 0;
+        r.intervalS = sensors[i].intervalS;
+        r.lastHeard = sensors[i].lastHeard;
+        r.authCounter = sensors[i].authCounter;
+        r.authSeen = sensors[i].authSeen;
+        good = write(fd, &r, sizeof(r)) == sizeof(r);
+    }
+    close(fd);
+    if (good) {
+        rename(TPP_REGISTRY_FILE ".new", TPP_REGISTRY_FILE);
+        savedCount = count;
+    } else {
+        dirty = true;   // try again next time
+    }
+#endif
+}
+
+// one sensor's record, over its old one in the file, or added at the end (and the count in
+// the header) if it is the next new sensor; otherwise the whole file
+void tpp_SensorRegistry::saveSensor(int i) {
+#if HAL_PLATFORM_FILESYSTEM
+    if (savedCount < 0 || i > savedCount) {
+        save();
+        return;
+    }
+    int fd = open(TPP_REGISTRY_FILE, O_WRONLY);
+    if (fd < 0) {
+        save();
+        return;
+    }
+    tpp_SensorRecord r;
+    r.address = sensors[i].address;
+    r.missing = sensors[i].missing;
+    r.unused = 0;
+    r.intervalS = sensors[i].intervalS;
+    r.lastHeard = sensors[i].lastHeard;
+    r.authCounter = sensors[i].authCounter;
+    r.authSeen = sensors[i].authSeen;
+    off_t at = 2 * sizeof(uint32_t) + i * sizeof(r);
+    bool good = lseek(fd, at, SEEK_SET) == at && write(fd, &r, sizeof(r)) == sizeof(r);
+    if (good && i == savedCount) {
+        uint32_t header[2] = {TPP_REGISTRY_FILE_MAGIC, (uint32_t) savedCount + 1};
+        good = lseek(fd, 0, SEEK_SET) == 0 && write(fd, header, sizeof(header)) == sizeof(header);
+        savedCount += good;
+    }
+    close(fd);
+    if (!good) {
+        save();
+    }
+#endif
+}
@@ -0,0 +1,124 @@
+/*
+    tpp_SensorRegistry.h - the sensors the hub has heard, and which of them have gone silent
+    created by Bob Glicksman and Jim Schrempp
+    as part of Team Practical Projects (tpp)
+
+    20261018 - first version
+    20261018 - replay window for authenticated frames (tpp_Auth)
+    20261018 - watchedCount(), for the LoRa supervisor
+    20261018 - begin() no longer needs the clock set
+    20261018 - saved at once when a signed frame is accepted
+    20261018 - that save writes only the sensor's own record
+
+    One entry per LoRa address: when it was last heard and how often it is expected
+    to be heard.  The interval comes from " h: <hours>" in a sensor's frames (the
+    heartbeat period, see the sensor's HEARTBEAT_HOURS), from the SensorInterval cloud
+    function, or from the default given to begin(); 0 means the sensor is not watched.
+
+    A sensor is missing when nothing has been heard from it for TPP_REGISTRY_MISSED_BEATS
+    intervals plus TPP_REGISTRY_GRACE_S.  The report function is called once when it goes
+    missing and once when it is heard again.
+
+    Deadlines are kept in a hashed timer wheel of TPP_REGISTRY_WHEEL_SLOTS one second
+    slots: a sensor is linked into the slot of (deadline % slots) and each second only
+    that slot's list is looked at, so the work per second does not grow with the number
+    of sensors until there are many more sensors than slots.  Hearing a sensor moves it
+    to its new slot, also without a search.  Addresses are found through an open
+    addressing hash table.
+
+    For sensors that sign their frames (tpp_Auth) each entry also keeps the highest
+    frame counter accepted and a bit for each of the TPP_REGISTRY_REPLAY_WINDOW counters
+    below it, so a frame is accepted once and a frame from further back not at all.
+
+    On devices with a file system (P2, Photon 2) the entries are saved to
+    TPP_REGISTRY_FILE at most every TPP_REGISTRY_SAVE_MS when something changed, and
+    loaded at begin(), so a reboot keeps what the hub knew.  Accepting a signed frame
+    saves at once, since a frame accepted after the last save would otherwise be accepted
+    again after a reboot, but only that sensor's record is written, in its place in the
+    file or at its end.  Times are Unix seconds, so until the hub's clock is set nothing
+    is recorded or checked; the sensors loaded at begin() are scheduled by the first
+    process() after it is.
+*/
+
+#ifndef tpp_SensorRegistry_h
+#define tpp_SensorRegistry_h
+
+#include "tpp_LoRaGlobals.h"
+
+#define TPP_REGISTRY_MAX_SENSORS 2048
+#define TPP_REGISTRY_HASH_SIZE 4096        // power of two, at least twice TPP_REGISTRY_MAX_SENSORS
+#define TPP_REGISTRY_WHEEL_SLOTS 512       // power of two
+#define TPP_REGISTRY_MISSED_BEATS 2        // intervals without a frame before a sensor is missing
+#define TPP_REGISTRY_GRACE_S 900           // on top, for heartbeat jitter and retries
+#define TPP_REGISTRY_SAVE_MS 300000UL      // flash wear: save at most every 5 minutes
+#define TPP_REGISTRY_FILE "/tpp_sensors.dat"
+#define TPP_REGISTRY_REPLAY_WINDOW 32      // bits in Sensor.authSeen
+
+// called when a sensor goes missing (missing true) and when it is heard again
+typedef void (*tpp_SensorReportFn)(int address, bool missing, unsigned long silentSeconds);
+
+class tpp_SensorRegistry
+{
+private:
+    struct Sensor {
+        uint16_t address;
+        bool missing;
+        uint32_t intervalS;       // 0: not watched
+        uint32_t lastHeard;       // Unix seconds
+        uint32_t deadline;        // Unix seconds; 0 when not in the wheel
+        int16_t slot;             // wheel slot it is linked into
+        int16_t next;             // rest of the slot's list
+        int16_t prev;
+        uint32_t authCounter;     // highest frame counter accepted
+        uint32_t authSeen;        // bit n: authCounter - n was accepted; 0 before the first
+    };
+    Sensor sensors[TPP_REGISTRY_MAX_SENSORS];
+    int16_t hashTable[TPP_REGISTRY_HASH_SIZE];    // index into sensors, -1 if empty
+    int16_t wheel[TPP_REGISTRY_WHEEL_SLOTS];      // first sensor of each slot, -1 if empty
+    uint32_t wheelTime = 0;                       // the last second processed
+    uint32_t defaultIntervalS = 0;
+    tpp_SensorReportFn report = NULL;
+    bool dirty = false;
+    unsigned long lastSaveMS = 0;
+    int savedCount = -1;          // sensors in the file, each at its index; -1: the file must be written whole
+
+    int find(int address);
+    int add(int address);
+    void schedule(int i);
+    void unschedule(int i);
+    void check(int i, uint32_t now);
+    void expire(uint32_t second);
+    void load();
+    void save();
+    void saveSensor(int i);
+
+public:
+    // default interval for sensors that do not say theirs, in seconds (0: not watched)
+    void begin(tpp_SensorReportFn reportFn, unsigned long defaultSeconds);
+
+    // a frame came from this address
+    void heard(int address, const String& payload);
+
+    // expected interval for a sensor, in seconds; 0 stops watching it. Adds the sensor if new.
+    // Returns 0, or 1 if the registry is full
+    int setInterval(int address, unsigned long seconds);
+
+    // a signed frame from this address carried this counter.  Returns 0 if it is new (and
+    // saves the registry), -1 if it was seen before or is too far behind, 1 if the
+    // registry is full (not checked)
+    int acceptCounter(int address, uint32_t counter);
+
+    // runs the timer wheel up to now and saves if due. Call from loop()
+    void process();
+
+    // "12 sensors, 5 watched, 1 missing: 6"
+    String summary();
+
+    // sensors with an interval
+    int watchedCount();
+
+    int count = 0;
+    int missingCount = 0;
+};
+
+#endif
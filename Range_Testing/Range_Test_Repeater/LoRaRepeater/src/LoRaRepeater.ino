@@ -0,0 +1,277 @@
+/*
+ * Project LoRaRepeater
+ * Author: Bob Glicksman and Jim Schrempp
+ * Date: 10/18/2026
+ *
+ * Description:  A store and forward repeater for sensors the hub can not hear.  It runs on
+ *  a Particle Photon 2 or an ATmega328 with the same LoRa module (RYLR998) wiring as the
+ *  sensor, on a mains supply: the LoRa module is never put to sleep.
+ *
+ *  Today the only way to reach a far sensor is a higher spreading factor or more power, and
+ *  a higher SF costs every sensor airtime.  With a repeater placed between the hub and the
+ *  far sensors, those sensors can use a faster profile too.
+ *
+ *  A sensor served by the repeater has the repeater's address as its SEND_TO_ADDRESS
+ *  (sensor version 2.20).  Frames from the addresses in RELAY_FROM are wrapped (tpp_Relay.h)
+ *  with the sensor's address, a hop count and the path so far, to which this repeater adds
+ *  its address and the SNR and RSSI it heard the frame at, and sent on to SEND_TO_ADDRESS:
+ *  the hub, or the next repeater towards it.  A frame that is already wrapped, from a
+ *  repeater further out that is in RELAY_FROM, just gets this repeater added to its path,
+ *  unless it has passed TPP_RELAY_MAX_HOPS repeaters.  The hub (version 4.3) sends its
+ *  answer back along the path; the last repeater gives it to the sensor.
+ *
+ *  Frames wait in two bounded queues (tpp_ForwardQueue), one each way, and answers go first
+ *  since the sensor is only listening for a few seconds.  A frame that finds its queue full
+ *  is dropped, and so is a copy of a frame already passed on within TPP_RELAY_DUPLICATE_MS
+ *  (heard straight from the sensor and through another repeater).  The counts are printed
+ *  every REPORT_EVERY_MS on the P2's USB serial port.  The green LED is lit while a frame
+ *  is sent.
+ *
+ *  Every repeater of a network must use the same radio profile as the hub; a sensor behind
+ *  a repeater still has to use the profile the repeater uses.
+ *
+ * version 1.0; 10/18/2026
+ */
+
+#include "tpp_LoRaGlobals.h"
+
+#include "tpp_LoRa.h" // include the LoRa class
+#include "tpp_Relay.h"
+#include "tpp_ForwardQueue.h"
+
+#define REPEATER_ADDRESS 201 // this repeater's LoRa address; the SEND_TO_ADDRESS of the sensors it serves
+#define SEND_TO_ADDRESS TPP_LORA_HUB_ADDRESS // the hub, or the next repeater towards it
+#define RELAY_FROM {13, 14} // sensors, and repeaters further out, whose frames are passed on
+#define FORCE_LORA_REPROGRAM 0 // set to 1 to write every LoRa setting at boot, ignoring the EEPROM fingerprint
+#define REPORT_EVERY_MS 60000 // counts printed this often (P2)
+
+// The following system directives are to disregard WiFi for Particle devices.  Not needed for Arduino.
+#if PARTICLEPHOTON
+    SYSTEM_MODE(SEMI_AUTOMATIC);
+    SYSTEM_THREAD(ENABLED);
+#endif
+
+#define VERSION 1.0
+
+tpp_LoRa LoRa; // create an instance of the LoRa class
+tpp_Relay mgRelay;
+
+const long mgRelayFrom[] = RELAY_FROM;
+
+tpp_ForwardQueue mgUp;      // towards the hub
+tpp_ForwardQueue mgDown;    // towards the sensors
+
+struct {
+    unsigned long sentUp;
+    unsigned long sentDown;
+    unsigned long tooLong;          // would not fit in a LoRa frame once wrapped
+    unsigned long tooManyHops;
+    unsigned long notRelayed;       // from an address not in RELAY_FROM, or not valid
+    unsigned long sendErrors;
+    unsigned long receiveErrors;
+} mgCounts;
+
+String mgTemp;
+
+// all debug prints through here so it can be disabled when ATmega328 is used
+void debugPrintln(const String message) {
+    #if PARTICLEPHOTON
+        DEBUG_SERIAL.println(message);
+    #endif
+}
+
+// blinkLED(): blinks the indicated LED "times" number of times
+void blinkLED(int ledpin, int number, int delayTimeMS) {
+    digitalWrite(ledpin, LOW);
+    delay(100);
+    for(int i = 0; i < number; i++) {
+        digitalWrite(ledpin, HIGH);
+        delay(delayTimeMS);
+        digitalWrite(ledpin, LOW);
+        delay(delayTimeMS);
+    }
+    return;
+} // end of blinkLED()
+
+// sends the oldest frame of a queue; returns as LoRa.transmitMessage()
+int sendNext(tpp_ForwardQueue& queue) {
+    digitalWrite(GRN_LED_PIN, HIGH);
+    int errRtn = LoRa.transmitMessage(queue.nextAddress(), queue.nextFrame());
+    digitalWrite(GRN_LED_PIN, LOW);
+    queue.remove();
+    if (errRtn != 0) {
+        mgCounts.sendErrors++;
+        blinkLED(RED_LED_PIN, 1, 100);
+    }
+    return errRtn;
+}
+
+bool isRelayedFor(long address) {
+    for (unsigned int i = 0; i < sizeof(mgRelayFrom) / sizeof(mgRelayFrom[0]); i++) {
+        if (mgRelayFrom[i] == address) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// a frame from a sensor, or from a repeater further out: wrapped or added to, towards the hub
+void passUp(long from, const String& payload) {
+    long sensor = from;
+    int hops = 0;
+    String path = "";
+    String inner = payload;
+    if (payload.startsWith(F(TPP_LORA_MSG_RELAY " "))
+            && !tpp_Relay::unwrapUp(payload, sensor, hops, path, inner)) {
+        mgCounts.notRelayed++;
+        return;
+    }
+    if (hops >= TPP_RELAY_MAX_HOPS) {
+        mgCounts.tooManyHops++;
+        return;
+    }
+    if (mgRelay.duplicate(sensor, inner, true)) {
+        debugPrintln(F("copy of a frame already passed on"));
+        return;
+    }
+    if (path.length()) {
+        path += '/';
+    }
+    path += REPEATER_ADDRESS;
+    path += ':';
+    path += LoRa.SNR;
+    path += ':';
+    path += LoRa.RSSI;
+    String frame;
+    if (!tpp_Relay::wrapUp(sensor, hops + 1, path, inner, frame)) {
+        mgCounts.tooLong++;
+        return;
+    }
+    mgUp.add(SEND_TO_ADDRESS, frame);
+}
+
+// the hub's answer to a relayed frame: to the sensor, or to the next repeater on its route
+void passDown(const String& payload) {
+    long sensor;
+    String route;
+    String inner;
+    if (!tpp_Relay::unwrapDown(payload, sensor, route, inner)) {
+        mgCounts.notRelayed++;
+        return;
+    }
+    if (route.length() == 0) {
+        mgDown.add(sensor, inner);
+        return;
+    }
+    int slash = route.indexOf('/');
+    long next = route.substring(0, slash < 0 ? route.length() : slash).toInt();
+    String frame;
+    if (!tpp_Relay::wrapDown(sensor, slash < 0 ? String("") : route.substring(slash + 1), inner, frame)) {
+        mgCounts.tooLong++;
+        return;
+    }
+    mgDown.add(next, frame);
+}
+
+// the counts so far
+void report() {
+    static unsigned long lastReportMS = 0;
+    if (millis() - lastReportMS < REPORT_EVERY_MS) {
+        return;
+    }
+    lastReportMS = millis();
+    mgTemp = F("up ");
+    mgTemp += mgCounts.sentUp;
+    mgTemp += F(" down ");
+    mgTemp += mgCounts.sentDown;
+    mgTemp += F(" queue full ");
+    mgTemp += mgUp.dropped;
+    mgTemp += '/';
+    mgTemp += mgDown.dropped;
+    mgTemp += F(" duplicates ");
+    mgTemp += mgRelay.duplicates;
+    mgTemp += F(" too long ");
+    mgTemp += mgCounts.tooLong;
+    mgTemp += F(" too many hops ");
+    mgTemp += mgCounts.tooManyHops;
+    mgTemp += F(" not relayed ");
+    mgTemp += mgCounts.notRelayed;
+    mgTemp += F(" errors ");
+    mgTemp += mgCounts.sendErrors;
+    mgTemp += '/';
+    mgTemp += mgCounts.receiveErrors;
+    debugPrintln(mgTemp);
+}
+
+void setup() {
+
+    pinMode(GRN_LED_PIN, OUTPUT);
+    pinMode(RED_LED_PIN, OUTPUT);
+    digitalWrite(GRN_LED_PIN, HIGH);
+    digitalWrite(RED_LED_PIN, HIGH);
+
+    mgTemp.reserve(120);
+
+    #if PARTICLEPHOTON
+        DEBUG_SERIAL.begin(115200); // the USB serial port
+        waitFor(DEBUG_SERIAL.isConnected, 15000);
+    #else
+        // ATMega328 has only one serial port, so no debug serial port
+    #endif
+
+    // nobody may be there to press reset, so keep trying
+    int err;
+    while ((err = LoRa.begin()) != 0 || (err = LoRa.configIfNeeded(REPEATER_ADDRESS, FORCE_LORA_REPROGRAM)) != 0) {
+        debugPrintln("LoRa module error " + String(err) + ", trying again");
+        blinkLED(RED_LED_PIN, 10, 150);
+        delay(5000);
+    }
+
+    mgTemp = F("Repeater version ");
+    mgTemp += String(VERSION);
+    mgTemp += F(", address ");
+    mgTemp += REPEATER_ADDRESS;
+    mgTemp += F(", sending to ");
+    mgTemp += SEND_TO_ADDRESS;
+    debugPrintln(mgTemp);
+
+    digitalWrite(GRN_LED_PIN, LOW);
+    digitalWrite(RED_LED_PIN, LOW);
+
+} // end of setup()
+
+void loop() {
+
+    LoRa.checkForReceivedMessage();
+    switch (LoRa.receivedMessageState) {
+        case -1: // error
+            mgCounts.receiveErrors++;
+            break;
+        case 0: // no message
+            break;
+        case 1: // message received
+            long from = LoRa.ReceivedDeviceAddress;
+            if (from == SEND_TO_ADDRESS && LoRa.payload.startsWith(F(TPP_LORA_MSG_RELAY_DOWN " "))) {
+                passDown(LoRa.payload);
+            } else if (isRelayedFor(from)) {
+                passUp(from, LoRa.payload);
+            } else {
+                mgCounts.notRelayed++;
+            }
+            break;
+    }
+
+    // one frame each pass, answers first: the sensor waiting for one gives up after ACK_WAIT_MS
+    if (mgDown.count) {
+        if (sendNext(mgDown) == 0) {
+            mgCounts.sentDown++;
+        }
+    } else if (mgUp.count) {
+        if (sendNext(mgUp) == 0) {
+            mgCounts.sentUp++;
+        }
+    }
+
+    report();
+
+} // end of loop()
@@ -0,0 +1,30 @@
+/*
+    tpp_ForwardQueue.cpp - frames waiting for the repeater to send them on
+    created by Bob Glicksman and Jim Schrempp
+    as part of Team Practical Projects (tpp)
+
+    20261018 - first version
+*/
+
+#include "tpp_ForwardQueue.h"
+
+bool tpp_ForwardQueue::add(long toAddress, const String& frame) {
+    if (count == TPP_FORWARD_QUEUE_SIZE) {
+        dropped++;
+        return false;
+    }
+    int i = (first + count) % TPP_FORWARD_QUEUE_SIZE;
+    toAddresses[i] = toAddress;
+    frames[i] = frame;
+    count++;
+    return true;
+}
+
+void tpp_ForwardQueue::remove() {
+    if (count == 0) {
+        return;
+    }
+    frames[first] = "";     // gives the memory back
+    first = (first + 1) % TPP_FORWARD_QUEUE_SIZE;
+    count--;
+}
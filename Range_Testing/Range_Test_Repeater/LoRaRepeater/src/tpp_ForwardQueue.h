@@ -0,0 +1,43 @@
+/*
+    tpp_ForwardQueue.h - frames waiting for the repeater to send them on
+    created by Bob Glicksman and Jim Schrempp
+    as part of Team Practical Projects (tpp)
+
+    20261018 - first version
+
+    The repeater receives while it is still sending what it received before, so each
+    frame it is to pass on waits here with the address it goes to, oldest first.  The
+    queue has a fixed number of places; a frame that finds them all taken is dropped
+    and counted, so a burst can not use up the ATmega328's RAM.
+*/
+
+#ifndef tpp_ForwardQueue_h
+#define tpp_ForwardQueue_h
+
+#include "tpp_LoRaGlobals.h"
+
+#define TPP_FORWARD_QUEUE_SIZE (PARTICLEPHOTON ? 8 : 2)    // frames; each may be up to 240 bytes
+
+class tpp_ForwardQueue
+{
+private:
+    long toAddresses[TPP_FORWARD_QUEUE_SIZE];
+    String frames[TPP_FORWARD_QUEUE_SIZE];
+    int first = 0;
+
+public:
+    // adds a frame for an address; false if the queue is full and it was dropped
+    bool add(long toAddress, const String& frame);
+
+    // the oldest frame and its address; only when count > 0
+    long nextAddress() { return toAddresses[first]; }
+    const String& nextFrame() { return frames[first]; }
+
+    // forgets the oldest frame, sent or not
+    void remove();
+
+    int count = 0;
+    unsigned long dropped = 0;      // the queue was full
+};
+
+#endif
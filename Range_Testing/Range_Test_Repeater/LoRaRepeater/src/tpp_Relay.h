@@ -0,0 +1,97 @@
+/*
+    tpp_Relay.h - frames passed on by repeaters, between far sensors and the hub
+    created by Bob Glicksman and Jim Schrempp
+    as part of Team Practical Projects (tpp)
+
+    20261018 - first version
+    20261018 - a relayed copy of a frame already answered is answered again, through its route
+
+    A sensor the hub can not hear sends to a repeater's address instead of the hub's
+    (the sensor's SEND_TO_ADDRESS).  The repeater (Range_Test_Repeater) wraps the frame
+    and sends it on towards the hub, to the hub or to another repeater:
+
+        R <sensor>,<hops>,<path>;<sensor's payload>
+
+    hops        repeaters the frame has passed through
+    path        one "<repeater>:<SNR>:<RSSI>" for each of them, separated by '/', the
+                one nearest the sensor first, with the signal it heard the frame at
+
+    The hub takes the frame apart and handles the sensor's payload as if it had come
+    straight from the sensor; the path is logged with it.  Its answer goes back along
+    the path, the other way:
+
+        D <sensor>,<route>;<hub's payload>
+
+    route       the repeaters still to pass through, separated by '/'; the one that
+                finds it empty sends the hub's payload to the sensor
+
+    A frame can reach the hub by more than one way, straight and through a repeater or
+    through two repeaters.  Only the first copy is used: copies of the same payload
+    from the same sensor within TPP_RELAY_DUPLICATE_MS are dropped, at the hub and at
+    every repeater.  That is shorter than a sensor waits for its ack (the least 't'
+    the hub can set is TPP_LORA_MIN_ACK_WAIT_MS), so a frame the sensor sends again
+    because no ack came is passed on.  The hub answers a relayed copy of a frame it
+    has already answered once more, back along the copy's path: the sensor may not
+    have heard the first answer, which went the first copy's way.  The file is the
+    same in the hub and the repeater.
+*/
+
+#ifndef tpp_Relay_h
+#define tpp_Relay_h
+
+#include "tpp_LoRaGlobals.h"
+#include "tpp_LoRa.h"                   // TPP_LORA_MSG_RELAY and TPP_LORA_MSG_RELAY_DOWN
+
+#define TPP_RELAY_PATH_FIELD " r: "     // the path of a relayed frame, added when the hub logs it
+#define TPP_RELAY_MAX_HOPS 3            // a frame that has passed this many repeaters is not passed on; see TPP_LORA_RELAY_ACK_MS
+#define TPP_RELAY_MAX_FRAME 240         // RYLR998 payload limit
+#define TPP_RELAY_DUPLICATE_MS TPP_LORA_RELAY_DUPLICATE_MS   // in tpp_LoRa.h, for the sensors' ack wait
+#define TPP_RELAY_RECENT 16             // frames remembered for duplicate checks
+
+class tpp_Relay
+{
+private:
+    struct Recent {
+        bool used = false;
+        bool relayed;
+        bool answered;
+        uint16_t address;
+        uint16_t crc;                   // of the payload
+        unsigned long ms;
+    };
+    Recent recent[TPP_RELAY_RECENT];
+    int nextRecent = 0;
+
+public:
+    // "R <address>,<hops>,<path>;<payload>" in frame.  Returns false if it would be too long
+    static bool wrapUp(long address, int hops, const String& path, const String& payload, String& frame);
+
+    // takes an R frame apart.  Returns false if it is not one
+    static bool unwrapUp(const String& frame, long& address, int& hops, String& path, String& payload);
+
+    // "D <address>,<route>;<payload>" in frame.  Returns false if it would be too long
+    static bool wrapDown(long address, const String& route, const String& payload, String& frame);
+
+    // takes a D frame apart.  Returns false if it is not one
+    static bool unwrapDown(const String& frame, long& address, String& route, String& payload);
+
+    // the way back along a path: the repeater the answer is sent to in via, and the
+    // route for the rest.  Returns false if the path is empty or not valid
+    static bool routeBack(const String& path, long& via, String& route);
+
+    // true if the same payload from this address was seen within TPP_RELAY_DUPLICATE_MS
+    // and either copy was relayed; it is remembered either way.  A sensor's frames that
+    // all come straight to the hub are never duplicates, whatever they contain
+    bool duplicate(long address, const String& payload, bool relayed);
+
+    // the last frame remembered from this address, with this payload, was answered
+    void markAnswered(long address, const String& payload);
+
+    // true if a frame with this payload from this address within TPP_RELAY_DUPLICATE_MS
+    // was answered
+    bool answered(long address, const String& payload);
+
+    unsigned long duplicates = 0;
+};
+
+#endif
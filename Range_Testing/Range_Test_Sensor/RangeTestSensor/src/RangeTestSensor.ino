@@ -23,12 +23,11 @@
  * 
  * The tester is assigned any device number and the hub is assigned device number 57248, as defined
     in tpp_LoRa.h   (it can be any arbitrary number in the range  0 - 65535).  The network
- *  number used for testing is 18 and the baud rate to/from the LoRa modem is 38400 to be 
-    compatible with the ATmega328.  Otherwise,
- *  the default LoRa module values are used.  NOTE:  the sensor code does not set up these
- *  values if run on an ATmega.  The LoRa modules can be set up using a PC and an FTDI USB-serial
-    board. If the LoRa module is already set to 38400 baud, then they can be further configured
-    by connecting one to a Particle Photon 2 sensor. LoRa modules can also be set up using 
+ *  number used for testing is 18.  The baud rate to/from the LoRa modem is found at boot and
+    switched to TPP_LORA_MAX_BAUD (38400 on the ATmega328, 115200 on the P2).  Otherwise,
+ *  the default LoRa module values are used.  NOTE:  the sensor code sets up these values at boot
+ *  but only writes the ones that differ.  The LoRa modules can be set up using a PC and an FTDI USB-serial
+    board, or further configured by connecting one to a Particle Photon 2 sensor. LoRa modules can also be set up using 
     the Particle Photon 2 hub. 
  * 
  *  The software senses the falling (P2) or rising (ATmega) signal from the pressing of 
@@ -52,14 +51,67 @@
     v 2.8 #define to not wait for hub response
     v 2.9 msg to hub starts with the character defined in TPP_LORA_MSG_GATE_SENSOR
     v 2.10 added pinSetDriveStrength for P2
+    v 2.11 setup calls configIfNeeded instead of setAddress. The LoRa module is only written
+           when the settings fingerprint in EEPROM does not match (FORCE_LORA_REPROGRAM overrides)
+    v 2.12 waits for the hub response with LoRa.waitForData(), which idle sleeps the ATmega328
+    v 2.13 BENCHMARK_MODE replaces CONTINUOUS_TEST_MODE: a run of BENCHMARK_MESSAGES at a set rate,
+           payload size and radio profile, with or without acks, then a summary of messages/s,
+           ack ratio, round trip min/median/p99 and time in each wake phase. The summary is 
+           printed (P2) and sent to the hub, which prints its own summary too.
+    v 2.14 trip to ack latency: the button interrupt, TX complete and ack times go in power of two
+           histograms (tpp_LatencyHistogram) that stay in RAM through sleep. Every LATENCY_REPORT_EVERY
+           messages the counts ride along in the payload as " L: " (trip to ack) and " T: " (trip to
+           TX complete). On the P2, send 'L' on the USB serial port to print them.
+    v 2.15 trips go in a timestamped queue (tpp_EventQueue) instead of a single flag, so trips during
+           an exchange with the hub are no longer dropped. Trips within EVENT_COALESCE_MS of the first,
+           or that came during an exchange, go in one frame: " e: " lists how many ms before the
+           frame each trip happened, and " d: " counts trips the queue had no room for.
+    v 2.16 a broadcast ack frame from the hub (ACK_AGGREGATION) that lists this sensor's address and
+           message number counts as TESTOK; one that does not is ignored and the wait goes on.
+    v 2.17 HEARTBEAT_HOURS: the ATmega328 also wakes on the watchdog timer (tpp_Heartbeat) and, when
+           no frame has been sent for that many hours, sends "H m: <n> h: <hours> w: <watchdog wake ups>
+           a: <ms awake for the last heartbeat>" without waiting for an answer. The first heartbeat
+           after boot is offset by the address so sensors do not send together after a power cut.
+    v 2.18 AUTH_FRAMES: every frame ends with " k: <counter>,<tag>" (tpp_Auth), a 32 bit MAC
+           and a counter kept in EEPROM, so the hub (AUTH_MODE) can refuse forged and replayed
+           frames.  The benchmark summary has the mean time spent signing, in us.
+    v 2.19 settings from the hub: a TESTOK may carry " c: <id> <key>=<value>,..." (hub tpp_DownlinkQueue)
+           for heartbeat hours, retries, ack wait and result LEDs.  They are checked,
+           used at once and kept in EEPROM (tpp_SensorConfig), replacing the #define defaults below,
+           and the next frame carries " c: <id>" so the hub knows.  No extra listening is done.
+           FRAME_RETRIES: a frame with no ack is sent again, with a new auth field.
+    v 2.20 SEND_TO_ADDRESS: frames go to this address, the hub's or, for a sensor the hub can not
+           hear, a repeater's (Range_Test_Repeater), which passes them on and brings back the ack.
  */
 
 #include "tpp_LoRaGlobals.h"
 
 #include "tpp_LoRa.h" // include the LoRa class
-
-#define CONTINUOUS_TEST_MODE 0 // set to 1 to enable continuous testing
+#include "tpp_LatencyHistogram.h"
+#include "tpp_EventQueue.h"
+#include "tpp_Heartbeat.h"
+#include "tpp_Auth.h"
+#include "tpp_SensorConfig.h"
+
+#define BENCHMARK_MODE 0 // set to 1 to send a benchmark run instead of waiting for the button
+#define BENCHMARK_MESSAGES 200 // length of the run
+#define BENCHMARK_INTERVAL_MS 250 // start of one message to the start of the next; 0 for as fast as possible
+#define BENCHMARK_PAYLOAD_BYTES 24 // benchmark messages are padded to this length
+#define BENCHMARK_PROFILE 0 // radio profile, see tpp_LoRaProfiles in tpp_LoRa.h; the hub must use the same one
+#define BENCHMARK_ACK_REQUIRED 1 // 1: wait for TESTOK after each message; 0: fire and forget
 #define WAIT_FOR_RESPONSE_FROM_HUB 1 // set ot 0 to disable waiting for a response from the hub
+#define FORCE_LORA_REPROGRAM 0 // set to 1 to write every LoRa setting at boot, ignoring the EEPROM fingerprint
+#define LATENCY_REPORT_EVERY 100 // put the latency histograms in every 100th message; 0 for never
+#define EVENT_COALESCE_MS 300 // wait this long after a trip for more trips to send in the same frame
+#define EVENT_DEBOUNCE_MS 50 // button/contact edges closer together than this are one trip
+#define HEARTBEAT_HOURS 0 // send a heartbeat when nothing has been sent for this many hours; 0 for none
+#define AUTH_FRAMES 0 // 1: sign every frame (tpp_Auth); the hub's AUTH_MODE must not be 0
+#define FRAME_RETRIES 0 // times a frame is sent again when no ack comes
+#define ACK_WAIT_MS 5000 // how long to wait for the hub's ack; at least TPP_LORA_MIN_ACK_WAIT_MS through a repeater
+#define RESULT_LEDS 1 // 1: blink the result of each frame on the LEDs; 0 to save power
+#define SEND_TO_ADDRESS TPP_LORA_HUB_ADDRESS // or the address of the repeater that passes this sensor's frames on
+// the hub can change HEARTBEAT_HOURS, FRAME_RETRIES, ACK_WAIT_MS and RESULT_LEDS (tpp_SensorConfig);
+// once it has, the saved values are used instead of these
 
 // The following system directives are to disregard WiFi for Particle devices.  Not needed for Arduino.
 #if PARTICLEPHOTON
@@ -73,7 +125,7 @@
     #include <avr/sleep.h>  // the official avr sleep library
 #endif
 
-#define VERSION 2.10
+#define VERSION 2.20
 #define STATION_NUM 0 // housekeeping; not used ini the code
 
 #define LORA_TRIP_SENSOR_ADDRESS_BASE 5 // the base address of the trip sensor type
@@ -88,10 +140,35 @@ tpp_LoRa LoRa; // create an instance of the LoRa class
 int mglastRSSI = 0;
 int mglastSNR = 0;
 bool mgFatalError = false;
-volatile bool mgButtonPressed = false;  // set true in the ISR_buttonPressed() function
+tpp_EventQueue mgEvents;                // trips from ISR_wakeAndSend() waiting to be sent
+unsigned long mgEventMS[TPP_EVENT_QUEUE_SIZE];  // the trips in the frame being sent
+unsigned long mgTripMS = 0;             // millis() of the oldest trip in the frame being sent
+unsigned long mgTransmitDoneMS = 0;     // millis() when the LoRa module accepted the message
+tpp_LatencyHistogram mgTripToAck;       // button interrupt to TESTOK received
+tpp_LatencyHistogram mgTripToTransmit;  // button interrupt to the message sent (wake and AT+SEND)
+tpp_Heartbeat mgHeartbeat;              // watchdog wake ups and the heartbeat interval
+tpp_Auth mgAuth;                        // frame signing, see AUTH_FRAMES
+tpp_SensorConfig mgConfig;              // settings from the hub, or the #define defaults
+unsigned int mgUnsignedLength = 0;      // of mgpayload before signPayload(), for sending it again
+unsigned int mgDeviceAddress = 0;
 String mgpayload;
 String mgTemp;
 
+// benchmark results; see BENCHMARK_MODE
+#define BENCHMARK_RTT_SAMPLES (BENCHMARK_MODE ? (PARTICLEPHOTON ? 1000 : 64) : 1) // the last round trips are kept
+enum {PHASE_WAKE, PHASE_TRANSMIT, PHASE_WAIT_FOR_ACK, PHASE_SLEEP, PHASE_COUNT};
+struct BenchmarkStats {
+    bool done;
+    int sent;
+    int acked;
+    int sendErrors;
+    unsigned long startMS;
+    unsigned long transmitMS;   // when the current message was handed to the LoRa module
+    unsigned long phaseStartUS;
+    unsigned long phaseUS[PHASE_COUNT];
+    uint16_t rttMS[BENCHMARK_RTT_SAMPLES];
+} mgBenchmark;
+
 // all debug prints through here so it can be disabled when ATmega328 is used
 void debugPrintln(const String message) {
     #if PARTICLEPHOTON
@@ -143,15 +220,208 @@ void blinkLEDsOnBoot() {
     return;
 }
 
+// the latency histograms as "n 120 p50/p90/p99 255/511/1023 ms counts 0.0.0.4.80.30.6"
+void appendLatency(String& text, tpp_LatencyHistogram& histogram) {
+    text += F("n ");
+    text += histogram.count();
+    text += F(" p50/p90/p99 ");
+    text += histogram.percentile(50);
+    text += F("/");
+    text += histogram.percentile(90);
+    text += F("/");
+    text += histogram.percentile(99);
+    text += F(" ms counts ");
+    histogram.appendCounts(text);
+}
+
+void printLatency() {
+    mgTemp = F("trip to ack: ");
+    appendLatency(mgTemp, mgTripToAck);
+    debugPrintln(mgTemp);
+    mgTemp = F("trip to transmit: ");
+    appendLatency(mgTemp, mgTripToTransmit);
+    debugPrintln(mgTemp);
+}
+
+// blink to show the result of a message, unless benchmarking or the LEDs are off
+void blinkResult(int ledpin, int number, int delayTimeMS) {
+    if (!BENCHMARK_MODE && mgConfig.get('l')) {
+        blinkLED(ledpin, number, delayTimeMS);
+    }
+}
+
+// add the time since the last call to a wake phase of the benchmark
+void benchmarkPhase(int phase) {
+    if (BENCHMARK_MODE) {
+        unsigned long now = micros();
+        mgBenchmark.phaseUS[phase] += now - mgBenchmark.phaseStartUS;
+        mgBenchmark.phaseStartUS = now;
+    }
+}
+
+// wait until it is time for the next benchmark message
+void benchmarkWaitForNextMessage(int msgNum) {
+    if (msgNum == 0) {
+        mgBenchmark.startMS = millis();
+        return;
+    }
+    unsigned long dueMS = mgBenchmark.startMS + (unsigned long) msgNum * BENCHMARK_INTERVAL_MS;
+    long waitMS = (long) (dueMS - millis());
+    if (waitMS > 0) {
+        delay(waitMS);
+    }
+}
+
+void benchmarkAck() {
+    unsigned long rtt = millis() - mgBenchmark.transmitMS;
+    mgBenchmark.rttMS[mgBenchmark.acked % BENCHMARK_RTT_SAMPLES] = rtt > 65535 ? 65535 : rtt;
+    mgBenchmark.acked++;
+}
+
+// print the results of the run and send them to the hub
+void benchmarkSummary() {
+
+    unsigned long elapsedMS = millis() - mgBenchmark.startMS;
+    int samples = mgBenchmark.acked < BENCHMARK_RTT_SAMPLES ? mgBenchmark.acked : BENCHMARK_RTT_SAMPLES;
+    uint16_t* rtt = mgBenchmark.rttMS;
+    for (int i = 1; i < samples; i++) {   // insertion sort; at most a few hundred values
+        uint16_t v = rtt[i];
+        int j = i - 1;
+        while (j >= 0 && rtt[j] > v) {
+            rtt[j + 1] = rtt[j];
+            j--;
+        }
+        rtt[j + 1] = v;
+    }
+
+    mgpayload = TPP_LORA_MSG_BENCHMARK;
+    mgpayload += F(" s: sent ");
+    mgpayload += mgBenchmark.sent;
+    mgpayload += F(" err ");
+    mgpayload += mgBenchmark.sendErrors;
+    mgpayload += F(" ");
+    mgpayload += String(elapsedMS ? 1000.0 * mgBenchmark.sent / elapsedMS : 0.0, 2);
+    mgpayload += F("/s");
+    if (BENCHMARK_ACK_REQUIRED) {
+        mgpayload += F(" acked ");
+        mgpayload += String(mgBenchmark.sent ? 100.0 * mgBenchmark.acked / mgBenchmark.sent : 0.0, 1);
+        mgpayload += F("% rtt ");
+        if (samples > 0) {
+            mgpayload += rtt[0];
+            mgpayload += F("/");
+            mgpayload += rtt[samples / 2];
+            mgpayload += F("/");
+            mgpayload += rtt[(samples * 99 + 99) / 100 - 1];
+            mgpayload += F(" ms");
+        } else {
+            mgpayload += F("none");
+        }
+    }
+    // mean time per message in each phase
+    mgpayload += F(" wake/tx/ack/sleep ");
+    for (int phase = 0; phase < PHASE_COUNT; phase++) {
+        if (phase) {
+            mgpayload += F("/");
+        }
+        mgpayload += mgBenchmark.sent ? mgBenchmark.phaseUS[phase] / 1000UL / mgBenchmark.sent : 0;
+    }
+    mgpayload += F(" ms");
+    if (AUTH_FRAMES) {
+        mgpayload += F(" sign ");
+        mgpayload += mgBenchmark.sent ? mgAuth.busyUS / mgBenchmark.sent : 0;
+        mgpayload += F(" us");
+    }
+
+    debugPrintln(F("\n\r----- benchmark done ----------"));
+    mgTemp = F("profile ");
+    mgTemp += BENCHMARK_PROFILE;
+    mgTemp += F(", ");
+    mgTemp += BENCHMARK_PAYLOAD_BYTES;
+    mgTemp += F(" bytes every ");
+    mgTemp += BENCHMARK_INTERVAL_MS;
+    mgTemp += F(" ms");
+    debugPrintln(mgTemp);
+    debugPrintln(mgpayload);
+
+    LoRa.wake();
+    signPayload();
+    LoRa.transmitMessage(SEND_TO_ADDRESS, mgpayload);
+    LoRa.sleep();
+    mgBenchmark.done = true;
+}
+
+// adds the auth field to mgpayload when AUTH_FRAMES is on
+void signPayload() {
+    mgUnsignedLength = mgpayload.length();
+    if (AUTH_FRAMES && mgAuth.sign(mgDeviceAddress, mgpayload) != 0) {
+        debugPrintln(F("frame too long to sign"));
+    }
+}
+
+// mgpayload again after no ack came, with a new auth field since the hub refuses a counter twice
+int resendPayload() {
+    mgpayload.remove(mgUnsignedLength);
+    signPayload();
+    return LoRa.transmitMessage(SEND_TO_ADDRESS, mgpayload);
+}
+
+// settings the hub put in its ack, if any; those that change how the sensor runs are used now
+void takeSettings() {
+    uint16_t hours = mgConfig.get('h');
+    long id = mgConfig.take(LoRa.payload, AUTH_FRAMES ? &mgAuth : nullptr, mgDeviceAddress);
+    if (id == 0) {
+        return;
+    }
+    if (id < 0) {
+        debugPrintln(F("settings from the hub refused"));
+        return;
+    }
+    mgTemp = F("settings from the hub, id ");
+    mgTemp += id;
+    debugPrintln(mgTemp);
+    if (mgConfig.get('h') != hours) {
+        mgHeartbeat.begin(mgConfig.get('h'), mgDeviceAddress);
+    }
+}
+
+// a heartbeat frame; no answer is expected, so the LoRa module goes straight back to sleep
+void sendHeartbeat(int& msgNum) {
+    unsigned long startMS = millis();
+    mgHeartbeat.restart();
+    msgNum++;
+    mgpayload = TPP_LORA_MSG_HEARTBEAT;
+    mgpayload += F(" m: ");
+    mgpayload += msgNum;
+    mgpayload += F(" h: ");
+    mgpayload += mgHeartbeat.hours;
+    mgpayload += F(" w: ");
+    mgpayload += mgHeartbeat.wakeups;
+    mgpayload += F(" a: ");
+    mgpayload += mgHeartbeat.awakeMS;
+    mgHeartbeat.wakeups = 0;
+    mgConfig.appendConfirm(mgpayload);
+    int errRtn = LoRa.wake();
+    if (errRtn == 0) {
+        signPayload();
+        errRtn = LoRa.transmitMessage(SEND_TO_ADDRESS, mgpayload);
+    }
+    LoRa.sleep();
+    if (errRtn) {
+        blinkLEDsOnERROR(8, errRtn);
+    }
+    debugPrintln(mgpayload);
+    mgHeartbeat.awakeMS = millis() - startMS;
+}
+
 void ISR_wakeAndSend() {
     #if (PARTICLEPHOTON)
         // nothing special to do
     #else
         // ATMega328
         sleep_disable();  // cancel sleep mode for now
-        detachInterrupt(digitalPinToInterrupt(BUTTON_PIN));  // preclude more interrupts due to bounce, or other
+        // the interrupt stays attached so trips during an exchange are queued; bounce is filtered in the queue
     #endif
-    mgButtonPressed = true;
+    mgEvents.push(millis(), EVENT_DEBOUNCE_MS);
 }
 
 void setup() {
@@ -214,18 +484,32 @@ void setup() {
     pinMode(ADR2_PIN, INPUT);
     pinMode(ADR1_PIN, INPUT);
 
-    err = LoRa.setAddress(deviceAddress);
+    mgDeviceAddress = deviceAddress;
+    if (AUTH_FRAMES) {
+        const uint8_t key[16] = TPP_AUTH_KEY;
+        mgAuth.begin(key);
+        mgAuth.beginCounter();
+    }
+    const uint16_t configDefaults[TPP_LORA_CONFIG_KEY_COUNT] =     // the order of tpp_LoRaConfigKeys
+        {HEARTBEAT_HOURS, FRAME_RETRIES, ACK_WAIT_MS, RESULT_LEDS};
+    mgConfig.begin(configDefaults);
+
+    // only writes to the LoRa module when the address or settings have changed since last boot
+    int profile = BENCHMARK_MODE ? BENCHMARK_PROFILE : 0;
+    err = LoRa.configIfNeeded(deviceAddress, FORCE_LORA_REPROGRAM, profile);
     if (err) {
         mgFatalError = true;
         blinkLEDsOnERROR(13,err);
     }
-    
+
     if (!mgFatalError) {
         int errRtn = LoRa.sleep(); // put the LoRa module to sleep
         errRtn = errRtn; // to avoid a warning
         
         blinkLEDsOnBoot();
 
+        mgHeartbeat.begin(BENCHMARK_MODE ? 0 : mgConfig.get('h'), deviceAddress);
+
         digitalWrite(GRN_LED_PIN, LOW);
         digitalWrite(RED_LED_PIN, LOW);
     }
@@ -239,6 +523,7 @@ void loop() {
     static bool awaitingResponse = false; // when waiting for a response from the hub
     static unsigned long startTime = 0;
     static int msgNum = 0;
+    static int retriesLeft = 0;
     bool needToSleep = false;
 
     // if fatal error then 
@@ -251,15 +536,28 @@ void loop() {
         } 
     }
            
-    if (CONTINUOUS_TEST_MODE) {
-        if (!awaitingResponse) {
-            delay(100);
-            mgButtonPressed = true;
+    if (BENCHMARK_MODE && !awaitingResponse) {
+        if (mgBenchmark.done) {
+            delay(10);
+            return;
         }
+        if (msgNum >= BENCHMARK_MESSAGES) {
+            benchmarkSummary();
+            return;
+        }
+        benchmarkWaitForNextMessage(msgNum);
+        mgEvents.push(millis(), 0);
     }
 
-    #if (PARTICLEPHOTON)
-        // nothing special to do
+    #if PARTICLEPHOTON
+        // 'L' on the USB serial port prints the latency histograms
+        if (DEBUG_SERIAL.available() && DEBUG_SERIAL.read() == 'L') {
+            printLatency();
+        }
+    #endif
+
+    #if (PARTICLEPHOTON || BENCHMARK_MODE)
+        // nothing special to do; a benchmark does not wait for the button
     #else
         // ATMega328
 
@@ -273,34 +571,87 @@ void loop() {
 
         noInterrupts(); // disable interrupts until we actually go to sleep.
         attachInterrupt(digitalPinToInterrupt(BUTTON_PIN), ISR_wakeAndSend, FALLING); // ready the wakeup interrupt
-        EIFR = bit(INTF0);  // clear flag for interrupt 0
-
-        // turn off brown-out enable in software
-        // BODS must be set to one and and BODSE must be set to zero within 4 clock cycles
-        MCUCR = bit(BODS) | bit (BODSE);
-        // the BODS bit is automatically cleared after 3 clock cycles
-        MCUCR = bit(BODS);
-
-        interrupts(); // enable interrupts just before sleeping
-        sleep_cpu();
-
-        //  everything should now be in deep sleep.
-        // Interrupt 0 wakes up the ATmega328 - send the message and go back to sleep
+        if (mgEvents.waiting() == 0) {
+            EIFR = bit(INTF0);  // clear flag for interrupt 0
+
+            // turn off brown-out enable in software
+            // BODS must be set to one and and BODSE must be set to zero within 4 clock cycles
+            MCUCR = bit(BODS) | bit (BODSE);
+            // the BODS bit is automatically cleared after 3 clock cycles
+            MCUCR = bit(BODS);
+
+            interrupts(); // enable interrupts just before sleeping
+            sleep_cpu();
+
+            //  everything should now be in deep sleep.
+            // Interrupt 0 wakes up the ATmega328 - send the message and go back to sleep.
+            // The watchdog (HEARTBEAT_HOURS) also wakes it; with no trip waiting, loop() just
+            // checks whether a heartbeat is due and comes back here.
+        } else {
+            // trips are waiting for the coalescing window; stay awake
+            sleep_disable();
+            interrupts();
+        }
     #endif
  
-     // test for button to be pressed and no transmission in progress
-     if(mgButtonPressed && !awaitingResponse) { // button press detected 
+    if (!awaitingResponse && mgEvents.waiting() == 0 && mgHeartbeat.due()) {
+        sendHeartbeat(msgNum);
+    }
+
+    // send the waiting trips once the coalescing window has passed and no transmission is in progress
+    unsigned long coalesceMS = BENCHMARK_MODE ? 0 : EVENT_COALESCE_MS;
+    bool sendNow = !awaitingResponse && mgEvents.ready(coalesceMS);
+    if (!awaitingResponse && !sendNow && mgEvents.waiting() > 0) {
+        // in the coalescing window
+        #if PARTICLEPHOTON
+            delay(5);
+        #else
+            // Idle sleep until the window ends, as in LoRa.waitForData(): the millis() tick
+            // wakes the CPU every 1.024 ms to check, and a trip's interrupt wakes it too.
+            set_sleep_mode(SLEEP_MODE_IDLE);
+            while (!mgEvents.ready(coalesceMS)) {
+                noInterrupts();
+                sleep_enable();
+                interrupts();  // the instruction after sei always runs, so no interrupt is missed
+                sleep_cpu();
+                sleep_disable();
+            }
+        #endif
+        sendNow = mgEvents.ready(coalesceMS);
+    }
+    if (sendNow) {
+        int dropped = 0;
+        int trips = mgEvents.take(mgEventMS, dropped);
+        mgTripMS = mgEventMS[0];
         digitalWrite(GRN_LED_PIN, HIGH);
-        debugPrintln(F("\n\r----- button press ----------"));
+        if (!BENCHMARK_MODE) {
+            debugPrintln(F("\n\r----- button press ----------"));
+        }
+        mgBenchmark.phaseStartUS = micros();
         int errRtn = LoRa.wake();
         if (errRtn) {
             blinkLEDsOnERROR(2,errRtn);
         }
+        benchmarkPhase(PHASE_WAKE);
         msgNum++;
-        mgpayload = TPP_LORA_MSG_GATE_SENSOR;
-        mgpayload += F(" m: ");
-        mgpayload += msgNum;
-        switch (msgNum) {
+        if (BENCHMARK_MODE) {
+            mgpayload = TPP_LORA_MSG_BENCHMARK;
+            mgpayload += F(" m: ");
+            mgpayload += msgNum;
+            mgpayload += F(" n: ");
+            mgpayload += BENCHMARK_MESSAGES;
+            mgpayload += F(" a: ");
+            mgpayload += BENCHMARK_ACK_REQUIRED;
+            mgpayload += F(" ");
+            while (mgpayload.length() < BENCHMARK_PAYLOAD_BYTES) {
+                mgpayload += 'x';
+            }
+        } else {
+            mgpayload = TPP_LORA_MSG_GATE_SENSOR;
+            mgpayload += F(" m: ");
+            mgpayload += msgNum;
+        }
+        switch (BENCHMARK_MODE ? 0 : msgNum) {
             case 1:
                 mgpayload += F(" uid: ");
                 mgpayload += LoRa.UID;
@@ -320,26 +671,72 @@ void loop() {
 
                 break;
         }
-        errRtn = LoRa.transmitMessage(TPP_LORA_HUB_ADDRESS, mgpayload); /// send the address as an int 
-        if (errRtn != 0) {
-            blinkLEDsOnERROR(7,errRtn);
+        if (trips > 1 || dropped > 0) {
+            unsigned long now = millis();
+            mgpayload += F(" e: ");
+            for (int i = 0; i < trips; i++) {
+                if (i) {
+                    mgpayload += F(",");
+                }
+                mgpayload += now - mgEventMS[i];
+            }
+            if (dropped > 0) {
+                mgpayload += F(" d: ");
+                mgpayload += dropped;
+            }
         }
-        mgButtonPressed = false;
+        if (!BENCHMARK_MODE && LATENCY_REPORT_EVERY && msgNum % LATENCY_REPORT_EVERY == 0) {
+            mgpayload += F(" L: ");
+            mgTripToAck.appendCounts(mgpayload);
+            mgpayload += F(" T: ");
+            mgTripToTransmit.appendCounts(mgpayload);
+        }
+        mgConfig.appendConfirm(mgpayload);
+        signPayload();
+        retriesLeft = BENCHMARK_MODE ? 0 : mgConfig.get('r');
+        mgBenchmark.transmitMS = millis();
+        errRtn = LoRa.transmitMessage(SEND_TO_ADDRESS, mgpayload); /// send the address as an int 
+        benchmarkPhase(PHASE_TRANSMIT);
+        mgTransmitDoneMS = millis();
         awaitingResponse = true;  
+        if (errRtn != 0) {
+            if (!BENCHMARK_MODE) {
+                blinkLEDsOnERROR(7,errRtn);
+            }
+            mgBenchmark.sendErrors++;
+            awaitingResponse = false;
+            needToSleep = true;
+        } else {
+            mgBenchmark.sent++;
+            mgTripToTransmit.add(mgTransmitDoneMS - mgTripMS);
+            mgHeartbeat.restart();
+        }
         startTime = millis();
         digitalWrite(GRN_LED_PIN, LOW);
     }
 
-    if (WAIT_FOR_RESPONSE_FROM_HUB == 0) {
+    if (BENCHMARK_MODE ? !BENCHMARK_ACK_REQUIRED : WAIT_FOR_RESPONSE_FROM_HUB == 0) {
         awaitingResponse = false;
         needToSleep = true;
     }
 
     while(awaitingResponse) {
 
-        if (millis() - startTime > 5000 ) { // wait 5 seconds for a response from the hub
+        if (millis() - startTime > mgConfig.get('t') && retriesLeft > 0) {
+            retriesLeft--;
+            debugPrintln(F("no response, sending again"));
+            startTime = millis();
+            if (resendPayload() != 0) {
+                awaitingResponse = false;
+                blinkResult(RED_LED_PIN, 7, 250);
+                debugPrintln(F("error sending again"));
+                needToSleep = true;
+                break;
+            }
+        }
+        if (millis() - startTime > mgConfig.get('t')) { // wait ACK_WAIT_MS for a response from the hub
             awaitingResponse = false;  // timed out
-            blinkLED(RED_LED_PIN, 1, 250);
+            blinkResult(RED_LED_PIN, 1, 250);
             debugPrintln(F("timeout waiting for hub response"));
             needToSleep = true;
         }
@@ -348,38 +745,58 @@ void loop() {
         switch (LoRa.receivedMessageState) {
             case -1: // error
                 awaitingResponse = false;  // error
-                blinkLED(RED_LED_PIN, 7, 250);
+                blinkResult(RED_LED_PIN, 7, 250);
                 debugPrintln(F("error while waiting for response"));
                 needToSleep = true;
                 break;
             case 0: // no message
-                delay(5); // wait a little while before checking again
+                LoRa.waitForData(50); // sleep until data arrives, then check again
                 break;
             case 1: // message received
-                mgTemp = F("received data = ");
-                mgTemp += LoRa.receivedData;
-                debugPrintln(mgTemp);
+                if (!BENCHMARK_MODE) {
+                    mgTemp = F("received data = ");
+                    mgTemp += LoRa.receivedData;
+                    debugPrintln(mgTemp);
+                }
                 mglastRSSI = LoRa.RSSI;
                 mglastSNR = LoRa.SNR;
 
+                // a broadcast ack frame for other sensors: keep waiting for ours
+                bool ackedInBroadcast = LoRa.isAckFor(LoRa.payload, msgNum);
+                if (LoRa.payload.startsWith(F(TPP_LORA_MSG_ACKS ",")) && !ackedInBroadcast) {
+                    break;
+                }
+
                 // test for received data from the hub (denoted by "+RCV")
                 int rcvIndex = LoRa.receivedData.indexOf(F("+RCV"));
                 if(rcvIndex >= 0) { // will be -1 of "+RCV" not in the string
                     
                     awaitingResponse = false; // we got a response
-                    debugPrintln(F("response received"));
                     int testokIndex = LoRa.receivedData.indexOf(F("TESTOK"));
-                    if (testokIndex >= 0) {
+                    bool acked = testokIndex >= 0 || ackedInBroadcast;
+                    if (acked) {
+                        mgTripToAck.add(millis() - mgTripMS);
+                        if (!BENCHMARK_MODE) {
+                            takeSettings();
+                        }
+                    }
+                    if (BENCHMARK_MODE) {
+                        if (acked) {
+                            benchmarkAck();
+                        }
+                    } else if (acked) {
+                        debugPrintln(F("response received"));
                         debugPrintln(F("response is TESTOK"));
-                        blinkLED(GRN_LED_PIN, 3, 150);
+                        blinkResult(GRN_LED_PIN, 3, 150);
                     } else {
+                        debugPrintln(F("response received"));
                         int nopeIndex = LoRa.receivedData.indexOf(F("NOPE"));
                         if (nopeIndex >= 0) {
                             debugPrintln(F("response is NOPE"));
-                            blinkLED(GRN_LED_PIN, 4, 250);
+                            blinkResult(GRN_LED_PIN, 4, 250);
                         } else {
                             debugPrintln(F("response is unrecognized"));
-                            blinkLED(RED_LED_PIN, 5, 250);
+                            blinkResult(RED_LED_PIN, 5, 250);
                         }
                     }
                 } 
@@ -389,6 +806,7 @@ void loop() {
         } // end of switch(LoRa.receivedMessageState)
 
     } // end of while(awaitingResponse)
+    benchmarkPhase(PHASE_WAIT_FOR_ACK);
 
     if (needToSleep) {
         int errRtn = LoRa.sleep(); // put the LoRa module to sleep
@@ -396,6 +814,7 @@ void loop() {
             blinkLEDsOnERROR(9, errRtn);
         }
         needToSleep = false;
+        benchmarkPhase(PHASE_SLEEP);
     }
 
 } // end of loop()
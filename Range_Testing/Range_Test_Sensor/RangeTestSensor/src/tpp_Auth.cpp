@@ -0,0 +1,155 @@
+/*
+    tpp_Auth.cpp - message authentication codes and counters for sensor frames
+    created by Bob Glicksman and Jim Schrempp
+    as part of Team Practical Projects (tpp)
+
+    20261018 - first version
+*/
+
+#include "tpp_Auth.h"
+
+#if !PARTICLEPHOTON
+    #include <EEPROM.h>
+#endif
+
+#define ROTL(x, b) (uint32_t) (((x) << (b)) | ((x) >> (32 - (b))))
+
+// multiply by x in GF(2^128), for the Chaskey subkeys
+static void times2(uint32_t out[4], const uint32_t in[4]) {
+    out[3] = (in[3] << 1) | (in[2] >> 31);
+    out[2] = (in[2] << 1) | (in[1] >> 31);
+    out[1] = (in[1] << 1) | (in[0] >> 31);
+    out[0] = (in[0] << 1) ^ ((in[3] >> 31) ? 0x87 : 0);
+}
+
+// 16 bytes as four little endian words, xored into v
+static void xorBlock(uint32_t v[4], const uint8_t block[16]) {
+    for (int i = 0; i < 4; i++) {
+        v[i] ^= (uint32_t) block[4 * i] | ((uint32_t) block[4 * i + 1] << 8)
+            | ((uint32_t) block[4 * i + 2] << 16) | ((uint32_t) block[4 * i + 3] << 24);
+    }
+}
+
+void tpp_Auth::permute(uint32_t v[4]) {
+    for (int round = 0; round < TPP_AUTH_ROUNDS; round++) {
+        v[0] += v[1]; v[1] = ROTL(v[1], 5);  v[1] ^= v[0]; v[0] = ROTL(v[0], 16);
+        v[2] += v[3]; v[3] = ROTL(v[3], 8);  v[3] ^= v[2];
+        v[0] += v[3]; v[3] = ROTL(v[3], 13); v[3] ^= v[0];
+        v[2] += v[1]; v[1] = ROTL(v[1], 7);  v[1] ^= v[2]; v[2] = ROTL(v[2], 16);
+    }
+}
+
+void tpp_Auth::begin(const uint8_t key[16]) {
+    for (int i = 0; i < 4; i++) {
+        k[i] = 0;
+    }
+    xorBlock(k, key);
+    times2(k1, k);
+    times2(k2, k1);
+}
+
+uint32_t tpp_Auth::mac(unsigned int address, const char* text, unsigned int length) {
+    uint32_t v[4] = {k[0], k[1], k[2], k[3]};
+    uint8_t block[16];
+    unsigned int total = length + 2;
+    unsigned int fill = 0;
+    for (unsigned int n = 0; n < total; n++) {
+        block[fill++] = n == 0 ? (uint8_t) (address >> 8) : n == 1 ? (uint8_t) address : (uint8_t) text[n - 2];
+        if (fill == 16 && n + 1 < total) {
+            xorBlock(v, block);
+            permute(v);
+            fill = 0;
+        }
+    }
+
+    // the last block: a full one is finished with k1, a short one is padded with 0x01 0x00... and k2
+    const uint32_t* last = k1;
+    if (fill < 16) {
+        block[fill++] = 0x01;
+        while (fill < 16) {
+            block[fill++] = 0;
+        }
+        last = k2;
+    }
+    xorBlock(v, block);
+    for (int i = 0; i < 4; i++) {
+        v[i] ^= last[i];
+    }
+    permute(v);
+    return v[0] ^ last[0];
+}
+
+void tpp_Auth::beginCounter() {
+    uint32_t highest = 0;
+    counterSlot = -1;
+    for (int i = 0; i < TPP_AUTH_EEPROM_SLOTS; i++) {
+        uint32_t saved;
+        EEPROM.get(TPP_AUTH_EEPROM_ADDRESS + 4 * i, saved);
+        if (saved != 0xFFFFFFFFUL && (counterSlot < 0 || saved > highest)) {   // erased EEPROM reads 0xFF
+            highest = saved;
+            counterSlot = i;
+        }
+    }
+    nextCounter = highest;
+    counterLimit = highest;
+}
+
+int tpp_Auth::sign(unsigned int address, String& payload) {
+    if (payload.length() + TPP_AUTH_MAX_CHARS > TPP_AUTH_MAX_FRAME) {
+        return -1;
+    }
+    unsigned long startUS = micros();
+    if (nextCounter >= counterLimit) {
+        // reserve the next block before using any of it
+        counterLimit = nextCounter + TPP_AUTH_COUNTER_BLOCK;
+        counterSlot = (counterSlot + 1) % TPP_AUTH_EEPROM_SLOTS;
+        EEPROM.put(TPP_AUTH_EEPROM_ADDRESS + 4 * counterSlot, counterLimit);
+    }
+    payload += TPP_AUTH_FIELD;
+    payload += (unsigned long) nextCounter++;
+    payload += ',';
+    uint32_t tag = mac(address, payload.c_str(), payload.length());
+    for (int shift = 28; shift >= 0; shift -= 4) {
+        payload += "0123456789abcdef"[(tag >> shift) & 0xF];
+    }
+    busyUS += micros() - startUS;
+    return 0;
+}
+
+int tpp_Auth::verify(unsigned int address, String& payload, uint32_t& counter) {
+    unsigned long startUS = micros();
+    int at = payload.lastIndexOf(TPP_AUTH_FIELD);
+    if (at < 0) {
+        return -1;
+    }
+    int digits = at + strlen(TPP_AUTH_FIELD);
+    int comma = payload.indexOf(',', digits);
+    if (comma <= digits || comma - digits > 10 || (int) payload.length() != comma + 1 + TPP_AUTH_TAG_CHARS) {
+        return -1;
+    }
+    uint32_t value = 0;
+    for (int i = digits; i < comma; i++) {
+        char c = payload.charAt(i);
+        if (c < '0' || c > '9') {
+            return -1;
+        }
+        value = value * 10 + (c - '0');
+    }
+    uint32_t tag = 0;
+    for (int i = comma + 1; i < (int) payload.length(); i++) {
+        char c = payload.charAt(i);
+        int nibble = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+        if (nibble < 0) {
+            return -2;
+        }
+        tag = (tag << 4) | nibble;
+    }
+    uint32_t expected = mac(address, payload.c_str(), comma + 1);
+    busyUS += micros() - startUS;
+    if (tag != expected) {
+        return -2;
+    }
+    counter = value;
+    payload.remove(at);
+    return 0;
+}
@@ -0,0 +1,86 @@
+/*
+    tpp_Auth.h - message authentication codes and counters for sensor frames
+    created by Bob Glicksman and Jim Schrempp
+    as part of Team Practical Projects (tpp)
+
+    20261018 - first version
+
+    Anything on our network ID can send a "G" frame to the hub.  With authentication
+    on, the sensor ends each frame with
+
+        <payload> k: <counter>,<tag>
+
+    counter     goes up by one for every frame, and never goes back, even across resets
+    tag         8 hex digits: the first 32 bits of the Chaskey-12 (Chaskey-LTS) MAC of
+                the sender's address (2 bytes, high first) and the frame up to and
+                including the comma
+
+    The hub recomputes the tag with the same key and keeps, for each sensor, the highest
+    counter seen and which of the 32 below it have been seen (tpp_SensorRegistry), so a
+    recorded frame sent again is refused.  Chaskey was designed for 8, 16 and 32 bit
+    microcontrollers: 128 bit key, 32 bit additions, rotations and xors, no tables.  The
+    tag is truncated to 32 bits; a forger gets one guess per frame on the air.
+
+    The counter is kept in EEPROM without writing it for every frame: the sensor writes
+    the counter TPP_AUTH_COUNTER_BLOCK ahead and uses up to it, so a reset skips at most
+    that many counters.  The writes go round TPP_AUTH_EEPROM_SLOTS slots; the highest
+    value is the current one.  With the ATmega328's 100,000 writes per cell that is
+    100,000 * 8 * 16, about 12 million frames.
+
+    One key for the whole network, TPP_AUTH_KEY below.  Change it for your own
+    installation, in both the hub's and the sensor's copy of this file.
+*/
+
+#ifndef tpp_Auth_h
+#define tpp_Auth_h
+
+#include "tpp_LoRaGlobals.h"
+
+// 16 bytes; the hub and every sensor must have the same key
+#define TPP_AUTH_KEY {0x54, 0x50, 0x50, 0x2D, 0x4C, 0x6F, 0x52, 0x61, \
+                      0x2D, 0x63, 0x68, 0x61, 0x6E, 0x67, 0x65, 0x21}
+
+#define TPP_AUTH_FIELD " k: "
+#define TPP_AUTH_TAG_CHARS 8
+#define TPP_AUTH_MAX_CHARS 23               // " k: 4294967295,12345678"
+#define TPP_AUTH_ROUNDS 12                  // Chaskey-LTS
+#define TPP_AUTH_MAX_FRAME 240              // RYLR998 payload limit
+
+#define TPP_AUTH_EEPROM_ADDRESS 64          // after tpp_LoRa's records
+#define TPP_AUTH_EEPROM_SLOTS 8             // 4 bytes each
+#define TPP_AUTH_COUNTER_BLOCK 16           // counters reserved by each EEPROM write
+
+class tpp_Auth
+{
+private:
+    uint32_t k[4];
+    uint32_t k1[4];
+    uint32_t k2[4];
+    uint32_t nextCounter = 0;
+    uint32_t counterLimit = 0;          // the counter saved in EEPROM; nextCounter must stay below it
+    int counterSlot = -1;
+
+    static void permute(uint32_t v[4]);
+
+public:
+    // sets the key and works out the subkeys
+    void begin(const uint8_t key[16]);
+
+    // the 32 bit tag of the address and the text
+    uint32_t mac(unsigned int address, const char* text, unsigned int length);
+
+    // sensor: finds the counter saved in EEPROM
+    void beginCounter();
+
+    // sensor: appends " k: <counter>,<tag>".  Returns 0, or -1 if the frame would be too long
+    int sign(unsigned int address, String& payload);
+
+    // hub: checks the tag and takes the auth field off the payload.  Returns 0 with counter
+    // set, -1 if there is no auth field, -2 if the tag is wrong
+    int verify(unsigned int address, String& payload, uint32_t& counter);
+
+    // micros() spent in sign() or verify() so far
+    unsigned long busyUS = 0;
+};
+
+#endif
@@ -0,0 +1,45 @@
+/*
+    tpp_EventQueue.cpp - timestamped sensor trips waiting to be sent to the hub
+    created by Bob Glicksman and Jim Schrempp
+    as part of Team Practical Projects (tpp)
+
+    20261018 - first version
+*/
+
+#include "tpp_EventQueue.h"
+
+void tpp_EventQueue::push(unsigned long nowMS, unsigned long debounceMS) {
+    if (anyPushed && nowMS - lastMS < debounceMS) {
+        return;   // contact bounce
+    }
+    anyPushed = true;
+    lastMS = nowMS;
+    if (count >= TPP_EVENT_QUEUE_SIZE) {
+        if (dropped < 255) {
+            dropped++;
+        }
+        return;
+    }
+    times[count] = nowMS;
+    count++;
+}
+
+bool tpp_EventQueue::ready(unsigned long windowMS) {
+    noInterrupts();
+    bool isReady = count > 0 && (count >= TPP_EVENT_QUEUE_SIZE || millis() - times[0] >= windowMS);
+    interrupts();
+    return isReady;
+}
+
+int tpp_EventQueue::take(unsigned long* out, int& droppedOut) {
+    noInterrupts();
+    int n = count;
+    for (int i = 0; i < n; i++) {
+        out[i] = times[i];
+    }
+    droppedOut = dropped;
+    count = 0;
+    dropped = 0;
+    interrupts();
+    return n;
+}
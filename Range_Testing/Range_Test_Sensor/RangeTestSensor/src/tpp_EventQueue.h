@@ -0,0 +1,46 @@
+/*
+    tpp_EventQueue.h - timestamped sensor trips waiting to be sent to the hub
+    created by Bob Glicksman and Jim Schrempp
+    as part of Team Practical Projects (tpp)
+
+    20261018 - first version
+
+    The button/contact interrupt adds the millis() of each trip.  loop() takes every
+    waiting trip at once and sends them in one frame, so trips that come during an
+    exchange with the hub, or within the coalescing window, are not lost and cost
+    no extra transmission.  Edges closer together than the debounce time are one trip.
+    If the queue is full, further trips are only counted.
+*/
+
+#ifndef tpp_EventQueue_h
+#define tpp_EventQueue_h
+
+#include "tpp_LoRaGlobals.h"
+
+#define TPP_EVENT_QUEUE_SIZE 8
+
+class tpp_EventQueue
+{
+private:
+    volatile unsigned long times[TPP_EVENT_QUEUE_SIZE];
+    volatile uint8_t count = 0;
+    volatile uint8_t dropped = 0;
+    volatile unsigned long lastMS = 0;   // the last trip pushed, for the debounce
+    volatile bool anyPushed = false;
+
+public:
+    // add a trip at nowMS; ignored if within debounceMS of the last one. Safe to call from an ISR
+    void push(unsigned long nowMS, unsigned long debounceMS);
+
+    // number of trips waiting
+    int waiting() { return count; }
+
+    // true if there are trips and the oldest is at least windowMS old, or the queue is full
+    bool ready(unsigned long windowMS);
+
+    // move the waiting trips, oldest first, into out (TPP_EVENT_QUEUE_SIZE long) and empty the queue.
+    // Returns how many; droppedOut is set to the trips that did not fit
+    int take(unsigned long* out, int& droppedOut);
+};
+
+#endif
@@ -0,0 +1,84 @@
+/*
+    tpp_Heartbeat.cpp - periodic "still here" frames from a sensor that sleeps until its contact trips
+    created by Bob Glicksman and Jim Schrempp
+    as part of Team Practical Projects (tpp)
+
+    20261018 - first version
+    20261018 - begin(0) stops the watchdog
+*/
+
+#include "tpp_Heartbeat.h"
+
+#if !PARTICLEPHOTON
+#include <avr/wdt.h>
+#include <avr/sleep.h>
+
+ISR(WDT_vect) {
+    tpp_Heartbeat::periods++;
+    sleep_disable();
+}
+#endif
+
+volatile uint16_t tpp_Heartbeat::periods = 0;
+
+void tpp_Heartbeat::begin(unsigned int beatHours, unsigned int address) {
+    if (beatHours > TPP_HEARTBEAT_MAX_HOURS) {
+        beatHours = TPP_HEARTBEAT_MAX_HOURS;
+    }
+    hours = beatHours;
+    if (hours == 0) {
+        // also when turned off from the hub (h=0): no more watchdog wake ups
+        noInterrupts();
+        periods = 0;
+        #if !PARTICLEPHOTON
+            wdt_reset();
+            MCUSR &= ~bit(WDRF);
+            WDTCSR = bit(WDCE) | bit(WDE);              // timed sequence
+            WDTCSR = 0;                                 // no interrupt, no reset
+        #endif
+        interrupts();
+        return;
+    }
+    periodsPerBeat = (uint16_t) (hours * 3600000UL / TPP_HEARTBEAT_PERIOD_MS);
+
+    // the first heartbeat somewhere in the interval, the same place every boot for this address
+    uint16_t offset = (uint16_t) ((address * 40503UL) % periodsPerBeat);
+    beatAt = offset ? offset : periodsPerBeat;
+    periods = 0;
+    lastBeatMS = millis() - (periodsPerBeat - beatAt) * TPP_HEARTBEAT_PERIOD_MS;
+
+    #if !PARTICLEPHOTON
+        noInterrupts();
+        wdt_reset();
+        MCUSR &= ~bit(WDRF);
+        WDTCSR = bit(WDCE) | bit(WDE);                  // timed sequence to change the prescaler
+        WDTCSR = bit(WDIE) | bit(WDP3) | bit(WDP0);     // interrupt only, 8 s
+        interrupts();
+    #endif
+}
+
+bool tpp_Heartbeat::due() {
+    if (hours == 0) {
+        return false;
+    }
+    #if PARTICLEPHOTON
+        return millis() - lastBeatMS >= periodsPerBeat * TPP_HEARTBEAT_PERIOD_MS;
+    #else
+        noInterrupts();
+        uint16_t now = periods;
+        interrupts();
+        return now >= beatAt;
+    #endif
+}
+
+void tpp_Heartbeat::restart() {
+    if (hours == 0) {
+        return;
+    }
+    noInterrupts();
+    wakeups += periods;
+    periods = 0;
+    interrupts();
+    beatAt = periodsPerBeat;
+    lastBeatMS = millis();
+}
@@ -0,0 +1,58 @@
+/*
+    tpp_Heartbeat.h - periodic "still here" frames from a sensor that sleeps until its contact trips
+    created by Bob Glicksman and Jim Schrempp
+    as part of Team Practical Projects (tpp)
+
+    20261018 - first version
+
+    On the ATmega328 the watchdog timer runs in interrupt mode (no reset) with its
+    longest period, about 8 seconds, and wakes the chip from power down.  The interrupt
+    only counts; no Arduino timer runs while asleep.  After the count for the heartbeat
+    interval, due() is true and the sensor sends a heartbeat frame.  The watchdog's own
+    oscillator is only good to about 10%, which the hub's missing-sensor grace allows for.
+    On the Photon millis() is used instead.
+
+    The first heartbeat after boot comes at an offset within the interval taken from
+    the sensor's address, so sensors that all start when the power comes back do not
+    all send at once.  Any frame the sensor sends starts the interval again, so a
+    busy sensor sends no heartbeats.
+
+    Each watchdog wake up costs the chip its start up time (set by the fuses) and a
+    few instructions; wakeups counts them and awakeMS is the time spent sending the
+    last heartbeat, so the sensor can report what heartbeats cost it.
+*/
+
+#ifndef tpp_Heartbeat_h
+#define tpp_Heartbeat_h
+
+#include "tpp_LoRaGlobals.h"
+
+#define TPP_HEARTBEAT_PERIOD_MS 8000UL     // watchdog interrupt period (WDP3 | WDP0)
+#define TPP_HEARTBEAT_MAX_HOURS 145        // the period count is 16 bits
+
+class tpp_Heartbeat
+{
+private:
+    uint16_t periodsPerBeat = 0;
+    uint16_t beatAt = 0;              // periods count at which the next heartbeat is due
+    unsigned long lastBeatMS = 0;     // Photon
+
+public:
+    // watchdog periods counted by the interrupt since the last heartbeat or frame
+    static volatile uint16_t periods;
+
+    // starts the watchdog; hours 0 turns heartbeats off and stops it
+    void begin(unsigned int hours, unsigned int address);
+
+    // true when a heartbeat should be sent
+    bool due();
+
+    // a frame (heartbeat or trip) was sent; the next heartbeat is a full interval from now
+    void restart();
+
+    unsigned int hours = 0;
+    unsigned long wakeups = 0;        // watchdog wake ups since the last heartbeat
+    unsigned long awakeMS = 0;        // time spent sending the last heartbeat
+};
+
+#endif
@@ -0,0 +1,63 @@
+/*
+    tpp_LatencyHistogram.cpp - fixed size histogram of times in milliseconds, power of two buckets
+    created by Bob Glicksman and Jim Schrempp
+    as part of Team Practical Projects (tpp)
+
+    20261018 - first version
+*/
+
+#include "tpp_LatencyHistogram.h"
+
+void tpp_LatencyHistogram::clear() {
+    for (int i = 0; i < TPP_LATENCY_BUCKETS; i++) {
+        counts[i] = 0;
+    }
+}
+
+void tpp_LatencyHistogram::add(unsigned long ms) {
+    int bucket = 0;
+    while (ms > 1 && bucket < TPP_LATENCY_BUCKETS - 1) {
+        ms >>= 1;
+        bucket++;
+    }
+    if (counts[bucket] < 0xFFFF) {
+        counts[bucket]++;
+    }
+}
+
+unsigned long tpp_LatencyHistogram::count() {
+    unsigned long total = 0;
+    for (int i = 0; i < TPP_LATENCY_BUCKETS; i++) {
+        total += counts[i];
+    }
+    return total;
+}
+
+unsigned long tpp_LatencyHistogram::percentile(int percent) {
+    unsigned long total = count();
+    if (total == 0) {
+        return 0;
+    }
+    unsigned long target = (total * percent + 99) / 100;
+    unsigned long sum = 0;
+    for (int i = 0; i < TPP_LATENCY_BUCKETS; i++) {
+        sum += counts[i];
+        if (sum >= target && counts[i]) {
+            return (2UL << i) - 1;
+        }
+    }
+    return (2UL << (TPP_LATENCY_BUCKETS - 1)) - 1;
+}
+
+void tpp_LatencyHistogram::appendCounts(String& text) {
+    int last = TPP_LATENCY_BUCKETS - 1;
+    while (last > 0 && counts[last] == 0) {
+        last--;
+    }
+    for (int i = 0; i <= last; i++) {
+        if (i) {
+            text += '.';
+        }
+        text += counts[i];
+    }
+}
@@ -0,0 +1,42 @@
+/*
+    tpp_LatencyHistogram.h - fixed size histogram of times in milliseconds, power of two buckets
+    created by Bob Glicksman and Jim Schrempp
+    as part of Team Practical Projects (tpp)
+
+    20261018 - first version
+
+    Bucket 0 counts 0 - 1 ms, bucket k counts 2^k to 2^(k+1) - 1 ms, and the last
+    bucket everything from 2^(TPP_LATENCY_BUCKETS-1) ms up.  32 bytes of RAM, which
+    the ATmega328 keeps through power down sleep.  Counts stop at 65535.
+*/
+
+#ifndef tpp_LatencyHistogram_h
+#define tpp_LatencyHistogram_h
+
+#include "tpp_LoRaGlobals.h"
+
+#define TPP_LATENCY_BUCKETS 16    // up to 32 seconds
+
+class tpp_LatencyHistogram
+{
+private:
+    uint16_t counts[TPP_LATENCY_BUCKETS];
+
+public:
+    tpp_LatencyHistogram() { clear(); }
+
+    void clear();
+
+    void add(unsigned long ms);
+
+    // number of times added (up to 65535 per bucket)
+    unsigned long count();
+
+    // upper edge in ms of the bucket the percentile (0 - 100) falls in; 0 if empty
+    unsigned long percentile(int percent);
+
+    // appends the counts, "." between them and without trailing zero buckets, e.g. "0.0.3.12.40.7"
+    void appendCounts(String& text);
+};
+
+#endif
@@ -8,11 +8,29 @@
     v 2.2 removed version as a #define
     20241218 works on AMmega328 
     20241222 added setAddress
+    20250114 added CRFOP parameter to header file
+    20261018 added configIfNeeded; configDevice now calls it with forceFull
+    20261018 begin() negotiates the baud rate with the module
+    20261018 sendCommand and checkForReceivedMessage read whole lines instead of
+             waiting a fixed 100 ms; waits idle sleep on the ATmega328
+    20261018 added ping; sendCommand takes a timeout
+    20261018 a received payload is taken by its length, so it may have commas in it
 
 */
 
 #include "tpp_LoRa.h"
 
+#if !PARTICLEPHOTON
+    #include <EEPROM.h>
+    #include <avr/sleep.h>
+#endif
+
+#define TPP_LORA_CONFIG_MAGIC 0x4C32  // "L2"; change when the ConfigRecord layout changes
+#define TPP_LORA_BAUD_MAGIC 0x4231    // "B1"
+
+// baud rates supported by the RYLR998, fastest first
+const long tpp_LoRaBaudRates[] = {115200, 57600, 38400, 28800, 19200, 9600, 4800};
+const int tpp_LoRaBaudRateCount = sizeof(tpp_LoRaBaudRates) / sizeof(tpp_LoRaBaudRates[0]);
 
 #define TPP_LORA_DEBUG 0  // Do NOT enable this for ATmega328
 
@@ -20,22 +38,25 @@ bool mg_LoRaBusy = false;
 
 String tempString; 
 
+// define the parameter as const String& to avoid copying the string
+// which important on the ATmega328
 void tpp_LoRa::debugPrintln(const String& message) {
     #if TPP_LORA_DEBUG
-        tempString = F("tpp_LoRa: ");
-        tempString += message;
-        DEBUG_SERIAL.println(tempString);
+        String msg = "tpp_LoRa: "; // if we don't declare a string here the println fails
+        msg += message;
+        DEBUG_SERIAL.println(msg);
     #endif
 }
 void tpp_LoRa::debugPrintNoHeader(const String& message){
     #if TPP_LORA_DEBUG
-        DEBUG_SERIAL.print(message);
+        String msg  = message;
+        DEBUG_SERIAL.println(msg);
     #endif
 }
 void tpp_LoRa::debugPrint(const String& message){
     #if TPP_LORA_DEBUG
-        tempString = message;
-        DEBUG_SERIAL.println(tempString);
+        String msg  = message;
+        DEBUG_SERIAL.print(msg);
     #endif
 }
 
@@ -47,9 +68,25 @@ void tpp_LoRa::clearConfigVariables() {
     LoRaDeviceAddress = 0;
     LoRaNetworkID = 0;
     LoRaPreamble = 0;
+    LoRaBand = 0;
     UID = "";
 }  
 
+// CRC-16/CCITT, bitwise to keep the code small on the ATmega328
+uint16_t tpp_crc16(const uint8_t* data, unsigned int length, uint16_t crc) {
+    for (unsigned int i = 0; i < length; i++) {
+        crc ^= (uint16_t)data[i] << 8;
+        for (int bit = 0; bit < 8; bit++) {
+            if (crc & 0x8000) {
+                crc = (crc << 1) ^ 0x1021;
+            } else {
+                crc = crc << 1;
+            }
+        }
+    }
+    return crc;
+}
+
 
 void tpp_LoRa::clearClassVariables() {
     LoRaStringBuffer = "";
@@ -70,24 +107,137 @@ int tpp_LoRa::begin() {
     payload.reserve(75);
     tempString.reserve(50);
 
-    LORA_SERIAL.begin(38400);
-    LORA_SERIAL.setTimeout(10);
+    debugPrintln(F("Start LoRa initialization")); // so this AFTER tempString is reserved
 
-    // check that LoRa is ready
-    LoRaStringBuffer = F("AT");
-    int errRtn = sendCommand(LoRaStringBuffer);
-    if(errRtn) {
-        delay(1000);
-        errRtn = sendCommand(LoRaStringBuffer);
-        if(errRtn) { // try again for photon 1
-            return errRtn;
-        } 
+    // try the baud rate that worked last time, then look for the module
+    BaudRecord saved;
+    EEPROM.get(TPP_LORA_EEPROM_BAUD_ADDRESS, saved);
+    long savedBaudRate = 0;
+    if (saved.magic == TPP_LORA_BAUD_MAGIC 
+            && saved.crc == tpp_crc16((const uint8_t*) &saved.baudRate, sizeof(saved.baudRate))) {
+        savedBaudRate = saved.baudRate;
+    }
+
+    if (savedBaudRate != 0 && probeBaud(savedBaudRate)) {
+        LoRaBaudRate = savedBaudRate;
+    } else if (!findBaud()) {
+        delay(1000);   // try again for photon 1; the module may still be booting
+        if (!findBaud()) {
+            debugPrintln(F("No response from LoRa at any baud rate"));
+            return 3;
+        }
+    }
+
+    // move to the fastest rate this host handles. If the module does not
+    // work there, step down; the rate the module was found at is the last resort.
+    long foundBaudRate = LoRaBaudRate;
+    for (int i = 0; i < tpp_LoRaBaudRateCount; i++) {
+        long rate = tpp_LoRaBaudRates[i];
+        if (rate > TPP_LORA_MAX_BAUD) {
+            continue;
+        }
+        if (rate == LoRaBaudRate || (rate < foundBaudRate && foundBaudRate <= TPP_LORA_MAX_BAUD)) {
+            break;
+        }
+        if (switchBaud(rate)) {
+            break;
+        }
+        if (LoRaBaudRate == 0) {
+            debugPrintln(F("LoRa lost while changing baud rate"));
+            return 3;
+        }
+    }
+
+    if (LoRaBaudRate != savedBaudRate) {
+        saved.magic = TPP_LORA_BAUD_MAGIC;
+        saved.baudRate = LoRaBaudRate;
+        saved.crc = tpp_crc16((const uint8_t*) &saved.baudRate, sizeof(saved.baudRate));
+        EEPROM.put(TPP_LORA_EEPROM_BAUD_ADDRESS, saved);
     }
 
+    tempString = F("LoRa baud rate ");
+    tempString += LoRaBaudRate;
+    debugPrintln(tempString);
+
     isLoRaAwake = true;
     return 0;
 
 }
+
+// open the serial port at baudRate and send AT. 
+// rtn true if +OK came back within TPP_LORA_PROBE_TIMEOUT_MS
+bool tpp_LoRa::probeBaud(long baudRate) {
+
+    LORA_SERIAL.end();
+    LORA_SERIAL.begin(baudRate);
+    LORA_SERIAL.setTimeout(10);
+    while (LORA_SERIAL.available()) {
+        LORA_SERIAL.read();  // throw away anything left from the previous rate
+    }
+
+    LORA_SERIAL.println(F("AT"));
+    commandCount++;
+
+    // at the wrong rate the module sends back garbage or +ERR, so look for +OK itself
+    receivedData = "";
+    unsigned long startTimeMS = millis();
+    while (millis() - startTimeMS < TPP_LORA_PROBE_TIMEOUT_MS) {
+        if (LORA_SERIAL.available()) {
+            char c = LORA_SERIAL.read();
+            if (c == '\n') {
+                if (receivedData.indexOf(F("+OK")) >= 0) {
+                    return true;
+                }
+                receivedData = "";
+            } else if (receivedData.length() < 20) {
+                receivedData += c;
+            }
+        }
+    }
+    return false;
+}
+
+// try every supported baud rate until the module answers
+// rtn true if found; LoRaBaudRate is set to the rate
+bool tpp_LoRa::findBaud() {
+    for (int i = 0; i < tpp_LoRaBaudRateCount; i++) {
+        if (probeBaud(tpp_LoRaBaudRates[i])) {
+            LoRaBaudRate = tpp_LoRaBaudRates[i];
+            return true;
+        }
+    }
+    LoRaBaudRate = 0;
+    return false;
+}
+
+// tell the module to use a new baud rate, follow it, and check that the link works.
+// rtn true if successful. If not, the module is found again and LoRaBaudRate
+// is set to the rate it answered at (0 if it could not be found).
+bool tpp_LoRa::switchBaud(long baudRate) {
+
+    tempString = F("trying baud rate ");
+    tempString += baudRate;
+    debugPrintln(tempString);
+
+    LoRaStringBuffer = F("AT+IPR=");
+    LoRaStringBuffer += baudRate;
+    if (sendCommand(LoRaStringBuffer) != 0) {
+        return false;  // module refused the rate; still at the old one
+    }
+
+    bool worked = true;
+    for (int i = 0; i < TPP_LORA_BAUD_VERIFY_COUNT && worked; i++) {
+        worked = probeBaud(baudRate);
+    }
+    if (worked) {
+        LoRaBaudRate = baudRate;
+        return true;
+    }
+
+    findBaud();
+    return false;
+}
+
 // set just the device address
 // rtn True if failure
 bool tpp_LoRa::setAddress(unsigned int deviceAddress) {
@@ -108,66 +258,193 @@ bool tpp_LoRa::setAddress(unsigned int deviceAddress) {
     return 0;
 }
 
-// Configure the LoRa module with settings 
+// Configure the LoRa module with every setting
 // rtn True if failure
 bool tpp_LoRa::configDevice(int deviceAddress) {
+    return configIfNeeded(deviceAddress, true) != 0;
+}
 
-    if(wake() != 0) {
-        return true;
+// the settings this code wants in the LoRa module
+void tpp_LoRa::fillConfigRecord(ConfigRecord& record, int deviceAddress, int profile) {
+    memset(&record, 0, sizeof(record));     // padding too, since it is in the CRC
+    record.magic = TPP_LORA_CONFIG_MAGIC;
+    record.uidHash = tpp_crc16((const uint8_t*) UID.c_str(), UID.length());
+    record.networkID = LoRa_NETWORK_ID;
+    record.deviceAddress = deviceAddress;
+    record.spreadingFactor = tpp_LoRaProfiles[profile][0];
+    record.bandwidth = tpp_LoRaProfiles[profile][1];
+    record.codingRate = tpp_LoRaProfiles[profile][2];
+    record.preamble = tpp_LoRaProfiles[profile][3];
+    record.CRFOP = LoRa_CRFOP;
+    record.profile = profile;
+    record.band = LoRa_BAND;
+    record.fingerprint = tpp_crc16((const uint8_t*) &record, sizeof(record) - sizeof(record.fingerprint));
+}
+
+// Configure the LoRa module, writing only the settings that differ.
+// The module keeps its settings through a power cycle, so on most boots
+// the fingerprint in EEPROM matches and only AT+UID? is sent.
+// rtn 0 if successful, otherwise error code
+int tpp_LoRa::configIfNeeded(int deviceAddress, bool forceFull, int profile) {
+
+    if (profile < 0 || profile >= TPP_LORA_PROFILE_COUNT) {
+        return 1;
+    }
+    int errRtn = wake();
+    if(errRtn != 0) {
+        return errRtn;
     }
 
     debugPrintln(F("Start LoRa configuration"));
+    unsigned int startCommandCount = commandCount;
 
-    clearConfigVariables();
+    // the one read back: the UID tells us this is the module we configured last time
+    errRtn = sendCommand(F("AT+UID?"));
+    if(errRtn != 0) {
+        debugPrintln(F("error reading UID"));
+        return errRtn;
+    }
+    UID = receivedData.substring(5, receivedData.length());
+    UID.trim();
+
+    ConfigRecord wanted;
+    fillConfigRecord(wanted, deviceAddress, profile);
+
+    bool haveCurrent = false;   // true when the LoRa* class variables hold the module's settings
+    if (!forceFull) {
+        ConfigRecord saved;
+        EEPROM.get(TPP_LORA_EEPROM_CONFIG_ADDRESS, saved);
+        if (saved.magic == TPP_LORA_CONFIG_MAGIC && saved.fingerprint == wanted.fingerprint) {
+            debugPrintln(F("LoRa configuration fingerprint matches"));
+            LoRaNetworkID = wanted.networkID;
+            LoRaDeviceAddress = wanted.deviceAddress;
+            LoRaSpreadingFactor = wanted.spreadingFactor;
+            LoRaBandwidth = wanted.bandwidth;
+            LoRaCodingRate = wanted.codingRate;
+            LoRaPreamble = wanted.preamble;
+            LoRaCRFOP = wanted.CRFOP;
+            LoRaBand = wanted.band;
+            configCommandCount = commandCount - startCommandCount;
+            return 0;
+        }
+        // something changed; find out what is actually in the module
+        if (readSettings()) {
+            return 1;
+        }
+        haveCurrent = true;
+    }
 
-    LoRaStringBuffer = F("AT+NETWORKID=");
-    LoRaStringBuffer += LoRa_NETWORK_ID;
-    if(sendCommand(LoRaStringBuffer) != 0) {
-        debugPrintln(F("Network ID not set"));
-        return true;
+    if (!haveCurrent || LoRaNetworkID != LoRa_NETWORK_ID) {
+        LoRaStringBuffer = F("AT+NETWORKID=");
+        LoRaStringBuffer += LoRa_NETWORK_ID;
+        if(sendCommand(LoRaStringBuffer) != 0) {
+            debugPrintln(F("Network ID not set"));
+            return 1;
+        }
     }
 
-    LoRaStringBuffer = F("AT+ADDRESS=");
-    LoRaStringBuffer += deviceAddress;
-    if(sendCommand(LoRaStringBuffer) != 0) {   // xxx should this be &lorastirngbuffer;
-        debugPrintln(F("Device number not set"));
-        return true;
-    } 
-        
-    LoRaStringBuffer = F("AT+PARAMETER=");
-    LoRaStringBuffer += LoRa_SPREADING_FACTOR;
-    LoRaStringBuffer += F(",");
-    LoRaStringBuffer += LoRa_BANDWIDTH;
-    LoRaStringBuffer += F(",");
-    LoRaStringBuffer += LoRa_CODING_RATE;
-    LoRaStringBuffer += F(",");
-    LoRaStringBuffer += LoRa_PREAMBLE;
-    if(sendCommand(LoRaStringBuffer) != 0) {
-        debugPrintln(F("Parameters not set"));
-        return true;
-    } 
+    if (!haveCurrent || LoRaDeviceAddress != deviceAddress) {
+        LoRaStringBuffer = F("AT+ADDRESS=");
+        LoRaStringBuffer += deviceAddress;
+        if(sendCommand(LoRaStringBuffer) != 0) {
+            debugPrintln(F("Device number not set"));
+            return 1;
+        }
+    }
 
-    LoRaStringBuffer = F("AT+MODE=0");
-    if (sendCommand(LoRaStringBuffer) != 0) {
-        debugPrintln(F("Tranciever mode not set"));
-        return true;
-    } 
+    if (!haveCurrent || LoRaSpreadingFactor != wanted.spreadingFactor || LoRaBandwidth != wanted.bandwidth
+            || LoRaCodingRate != wanted.codingRate || LoRaPreamble != wanted.preamble) {
+        LoRaStringBuffer = F("AT+PARAMETER=");
+        LoRaStringBuffer += wanted.spreadingFactor;
+        LoRaStringBuffer += F(",");
+        LoRaStringBuffer += wanted.bandwidth;
+        LoRaStringBuffer += F(",");
+        LoRaStringBuffer += wanted.codingRate;
+        LoRaStringBuffer += F(",");
+        LoRaStringBuffer += wanted.preamble;
+        if(sendCommand(LoRaStringBuffer) != 0) {
+            debugPrintln(F("Parameters not set"));
+            return 1;
+        }
+    }
 
-    LoRaStringBuffer = F("AT+BAND=915000000");
-    if (sendCommand(LoRaStringBuffer) != 0) {
-        debugPrintln(F("Band not set"));
-        return true;
-    } 
+    if (!haveCurrent) {
+        // the mode is not saved in the fingerprint; only force it on a full configuration
+        LoRaStringBuffer = F("AT+MODE=0");
+        if (sendCommand(LoRaStringBuffer) != 0) {
+            debugPrintln(F("Tranciever mode not set"));
+            return 1;
+        }
+    }
+
+    if (!haveCurrent || LoRaBand != LoRa_BAND) {
+        LoRaStringBuffer = F("AT+BAND=");
+        LoRaStringBuffer += LoRa_BAND;
+        if (sendCommand(LoRaStringBuffer) != 0) {
+            debugPrintln(F("Band not set"));
+            return 1;
+        }
+    }
+
+    if (!haveCurrent || LoRaCRFOP != LoRa_CRFOP) {
+        LoRaStringBuffer = F("AT+CRFOP=");
+        LoRaStringBuffer += LoRa_CRFOP;
+        if (sendCommand(LoRaStringBuffer) != 0) {
+            debugPrintln(F("Power not set"));
+            return 1;
+        }
+    }
+
+    LoRaNetworkID = wanted.networkID;
+    LoRaDeviceAddress = wanted.deviceAddress;
+    LoRaSpreadingFactor = wanted.spreadingFactor;
+    LoRaBandwidth = wanted.bandwidth;
+    LoRaCodingRate = wanted.codingRate;
+    LoRaPreamble = wanted.preamble;
+    LoRaCRFOP = wanted.CRFOP;
+    LoRaBand = wanted.band;
+
+    EEPROM.put(TPP_LORA_EEPROM_CONFIG_ADDRESS, wanted);
+    configCommandCount = commandCount - startCommandCount;
 
-    LoRaStringBuffer = F("AT+CRFOP=22");
-    if (sendCommand(LoRaStringBuffer) != 0) {
-        debugPrintln(F("Power not set"));
-        return true;
-    } 
-    
     debugPrintln(F("LoRa module is initialized"));
 
-    return false;
+    return 0;
+
+}
+
+int tpp_LoRa::setProfile(int profile) {
+
+    if (profile < 0 || profile >= TPP_LORA_PROFILE_COUNT) {
+        return 1;
+    }
+    if (wake() != 0) {
+        return 1;
+    }
+
+    const uint8_t* p = tpp_LoRaProfiles[profile];
+    LoRaStringBuffer = F("AT+PARAMETER=");
+    LoRaStringBuffer += p[0];
+    LoRaStringBuffer += F(",");
+    LoRaStringBuffer += p[1];
+    LoRaStringBuffer += F(",");
+    LoRaStringBuffer += p[2];
+    LoRaStringBuffer += F(",");
+    LoRaStringBuffer += p[3];
+    if (sendCommand(LoRaStringBuffer) != 0) {
+        debugPrintln(F("Parameters not set"));
+        return 1;
+    }
+    LoRaSpreadingFactor = p[0];
+    LoRaBandwidth = p[1];
+    LoRaCodingRate = p[2];
+    LoRaPreamble = p[3];
+
+    // the module keeps AT+PARAMETER across power cycles; record that it now has this profile
+    ConfigRecord record;
+    fillConfigRecord(record, LoRaDeviceAddress, profile);
+    EEPROM.put(TPP_LORA_EEPROM_CONFIG_ADDRESS, record);
+    return 0;
 
 }
 
@@ -226,6 +503,13 @@ bool tpp_LoRa::readSettings() {
         LoRaPreamble = receivedData.substring(thirdComma + 1,receivedData.length()).toInt();
     }
 
+    if(sendCommand(F("AT+BAND?")) != 0) {
+        debugPrintln(F("error reading band"));
+        return true;
+    } else {
+        LoRaBand = receivedData.substring(6, receivedData.length()).toInt();
+    }
+
     return false;
 }
 
@@ -278,10 +562,67 @@ int tpp_LoRa::wake(){
     }
 };
 
+// wait until the LoRa module sends something or timeoutMS passes
+// rtn true if data is available
+bool tpp_LoRa::waitForData(unsigned long timeoutMS) {
+
+    unsigned long startTimeMS = millis();
+    while (!LORA_SERIAL.available()) {
+        if (millis() - startTimeMS >= timeoutMS) {
+            return false;
+        }
+        #if PARTICLEPHOTON
+            delay(1);
+        #else
+            // Idle sleep stops the CPU but leaves the UART and timer 0 running. The
+            // RX complete interrupt wakes us for data; the millis() tick every 1.024 ms
+            // wakes us to check the deadline.
+            set_sleep_mode(SLEEP_MODE_IDLE);
+            noInterrupts();
+            if (!LORA_SERIAL.available()) {
+                sleep_enable();
+                interrupts();  // the instruction after sei always runs, so no interrupt is missed
+                sleep_cpu();
+                sleep_disable();
+            }
+            interrupts();
+        #endif
+    }
+    return true;
+}
+
+// read one line from the LoRa module into receivedData
+// rtn 0 if successful, 3 if timed out
+int tpp_LoRa::readLine(unsigned long timeoutMS) {
+
+    receivedData = "";
+    unsigned long startTimeMS = millis();
+    while (true) {
+        unsigned long elapsedMS = millis() - startTimeMS;
+        if (elapsedMS >= timeoutMS || !waitForData(timeoutMS - elapsedMS)) {
+            return 3;
+        }
+        char c = LORA_SERIAL.read();
+        if (c == '\n') {
+            receivedData.trim();
+            if (receivedData.length() > 0) {
+                return 0;
+            }
+        } else if (receivedData.length() < 250) {
+            receivedData += c;
+        }
+        if (receivedData.length() == 1) {
+            // the line has started; the rest follows at the baud rate
+            startTimeMS = millis();
+            timeoutMS = TPP_LORA_LINE_TIMEOUT_MS;
+        }
+    }
+}
+
 // function to send AT commands to the LoRa module
 // returns 0 if successful, error code if not
 // prints message and result to the serial monitor
-int tpp_LoRa::sendCommand(const String& command) {
+int tpp_LoRa::sendCommand(const String& command, unsigned long timeoutMS) {
 
     // DO NOT check for wake here. This is called by wake and sleep
     // and will cause a recursive loop.
@@ -293,48 +634,52 @@ int tpp_LoRa::sendCommand(const String& command) {
     mg_LoRaBusy = true;
 
     int retcode = 0;
-    unsigned long timeoutMS = 15000; // xxx see below - do we still need this?
+
+    // throw away anything left over (e.g. the noise after waking from sleep),
+    // but keep a message from another device for checkForReceivedMessage()
+    while (LORA_SERIAL.available()) {
+        if (readLine(TPP_LORA_LINE_TIMEOUT_MS) == 0 && receivedData.startsWith(F("+RCV"))) {
+            pendingReceive = receivedData;
+        }
+    }
     receivedData = "";
 
     tempString = F("cmd: ");
     tempString += command;
     debugPrintln(tempString);
     LORA_SERIAL.println(command);
+    commandCount++;
     
-    // wait for data available, which should be +OK or +ERR
-    unsigned long starttimeMS = millis();  // xxx do we still need this timeout now that we use the
-                                          // xxx timeout in the serial port? Is this a good safety?
-    int dataAvailable = 0;
-    // delay(100);
-    do {
-        dataAvailable = LORA_SERIAL.available();
-        delay(10);
-    } while ((dataAvailable == 0) && ( millis() - starttimeMS < timeoutMS)) ;
-    
-
-    delay(100); // wait for the full response  //xxx we might not need this any more
+    // wait for the response, which should be +OK, +ERR or the value asked for.
+    // A message from another device can arrive first; save it and keep waiting.
+    unsigned long startTimeMS = millis();
+    retcode = 3;
+    while (true) {
+        unsigned long elapsedMS = millis() - startTimeMS;   // read once, so the remainder can not wrap
+        if (elapsedMS >= timeoutMS) {
+            break;
+        }
+        retcode = readLine(timeoutMS - elapsedMS);
+        if (retcode == 0 && receivedData.startsWith(F("+RCV"))) {
+            pendingReceive = receivedData;
+            receivedData = "";
+            retcode = 3;
+        }
+        if (retcode == 0) {
+            break;
+        }
+    }
 
     // Get the response if there is one
-    if(dataAvailable > 0) {
+    if(retcode == 0) {
 
-        receivedData = LORA_SERIAL.readString();
-        // received data has a newline at the end
-        receivedData.trim();
         tempString = F("received data = ");
         tempString += receivedData;
         debugPrintln(tempString);
         int errIndex = receivedData.indexOf(F("+ERR"));
         if(errIndex >= 0) {
-            debugPrintln(F("LoRa error"));
+            debugPrintln(F("LoRa returned +ERR"));
             retcode = 1;
-        } else { 
-            //int rcvIndex = receivedData.indexOf(F("+OK"));
-            //if (rcvIndex == 0) {
-                retcode = 0;
-            //} else {
-                // unknown string from LoRa
-              //  retcode = 2;
-            //}
         }
     } else {
         debugPrintln(F("No response from LoRa"));
@@ -347,6 +692,11 @@ int tpp_LoRa::sendCommand(const String& command) {
 // function to transmit a message to another LoRa device
 // returns 0 if successful, 1 if error, -1 if no response
 // prints message and result to the serial monitor
+int tpp_LoRa::ping(unsigned long timeoutMS) {
+    return sendCommand(F("AT"), timeoutMS);
+}
+
+
 int tpp_LoRa::transmitMessage(long int toAddress, const String& message){
 
     if(wake() != 0) {
@@ -366,6 +716,58 @@ int tpp_LoRa::transmitMessage(long int toAddress, const String& message){
 }
 
 
+unsigned long tpp_LoRa::timeOnAirUS(unsigned int payloadLength) {
+
+    // AT+PARAMETER bandwidth codes 0 - 9
+    static const unsigned long bandwidthHz[] = {7800, 10400, 15600, 20800, 31250, 41700, 62500,
+        125000, 250000, 500000};
+
+    // the settings read from the module, or the tpp_LoRa.h values if it has not been configured yet
+    bool known = LoRaSpreadingFactor != 0;
+    int bandwidth = known ? LoRaBandwidth : LoRa_BANDWIDTH;
+    int sf = known ? LoRaSpreadingFactor : LoRa_SPREADING_FACTOR;
+    int cr = known ? LoRaCodingRate : LoRa_CODING_RATE;
+    int preamble = known ? LoRaPreamble : LoRa_PREAMBLE;
+    if (bandwidth < 0 || bandwidth > 9) {
+        bandwidth = LoRa_BANDWIDTH;
+    }
+
+    unsigned long symbolUS = (unsigned long) (((uint64_t) 1 << sf) * 1000000UL / bandwidthHz[bandwidth]);
+    int lowDataRate = symbolUS > 16000 ? 1 : 0;  // low data rate optimization, on for symbols over 16 ms
+
+    long bits = 8L * (payloadLength + TPP_LORA_FRAME_OVERHEAD_BYTES) - 4L * sf + 28 + 16;
+    long perBlock = 4L * (sf - 2 * lowDataRate);
+    long blocks = bits > 0 ? (bits + perBlock - 1) / perBlock : 0;
+    unsigned long payloadSymbols = 8 + blocks * (cr + 4);
+
+    // the preamble is sent as preamble + 4.25 symbols
+    return (4UL * preamble + 17) * symbolUS / 4 + payloadSymbols * symbolUS;
+
+}
+
+
+bool tpp_LoRa::isAckFor(const String& payload, int seq) {
+
+    if (!payload.startsWith(TPP_LORA_MSG_ACKS ",")) {
+        return false;
+    }
+    String entry = F(",");
+    entry += LoRaDeviceAddress;
+    entry += F(":");
+    entry += seq;
+    int at = payload.indexOf(entry);
+    while (at >= 0) {
+        unsigned int end = at + entry.length();
+        if (end == payload.length() || payload.charAt(end) == ',') {
+            return true;
+        }
+        at = payload.indexOf(entry, at + 1);
+    }
+    return false;
+
+}
+
+
 // If there is data on Serial1 then read it and parse it into the class variables. 
 // Set receivedMessageState to 1 if successful, 0 if no message, -1 if error
 // If there is no data on Serial1 then clear the class variables.
@@ -385,13 +787,25 @@ void tpp_LoRa::checkForReceivedMessage() {
 
     clearClassVariables();
 
-    if(LORA_SERIAL.available()) { // data is in the Serial1 buffer
+    bool haveLine = false;
+    if (pendingReceive.length() > 0) {
+        // arrived while a command was waiting for its response
+        receivedData = pendingReceive;
+        pendingReceive = "";
+        haveLine = true;
+    } else if(LORA_SERIAL.available()) { // data is in the Serial1 buffer
+        if (readLine(TPP_LORA_LINE_TIMEOUT_MS) != 0) {
+            debugPrintln(F("incomplete line from LoRa"));
+            receivedMessageState = -1;
+            mg_LoRaBusy = false;
+            return;
+        }
+        haveLine = true;
+    }
+
+    if(haveLine) {
 
         debugPrintln(F("\n\r--------------------"));
-        delay(100); // wait a bit for the complete message to have been received
-        receivedData = LORA_SERIAL.readString();
-        // received data has a newline at the end
-        receivedData.trim();
         tempString = F("received data = ");
         tempString += receivedData;
         debugPrintln(tempString);
@@ -411,52 +825,32 @@ void tpp_LoRa::checkForReceivedMessage() {
                 debugPrintln(F("received data is not +RCV"));
                 receivedMessageState = -1;
             } else {
-                // find the commas in received data
-                unsigned int commas[5];
-                bool commaCountError = false;   
-
-                // find first comma
-                for(unsigned int i = 0; i < receivedData.length(); i++) {
-                    if(receivedData.charAt(i) == ',') {   
-                        commas[0] = i;
-                        break;
-                    }
-                }
+                // +RCV=<address>,<length>,<payload>,<RSSI>,<SNR>; the payload may have commas
+                // in it, so it is taken by its length
+                int addressEnd = receivedData.indexOf(',');
+                int lengthEnd = addressEnd < 0 ? -1 : receivedData.indexOf(',', addressEnd + 1);
+                int payloadLength = lengthEnd < 0 ? -1 : receivedData.substring(addressEnd + 1, lengthEnd).toInt();
+                int payloadEnd = lengthEnd + 1 + payloadLength;
+                int rssiEnd = payloadLength < 0 ? -1 : receivedData.indexOf(',', payloadEnd + 1);
 
-                // find other commas from the end to the front
-                int commaCount = 5;
-                for(unsigned int i = receivedData.length()-1; i >= commas[0]; i--) {
-                    if(receivedData.charAt(i) == ',') {
-                        commaCount--;
-                        if (commaCount < 1) {
-                            // should never happen
-                            debugPrintln(F("ERROR: received data from sensor has weird comma count"));
-                            break;
-                            commaCountError = true;
-                        }   
-                        commas[commaCount] = i;
-                    }
-                }
-                
-                if (commaCountError) {
+                if (rssiEnd < 0 || receivedData.charAt(payloadEnd) != ',') {
 
                     // error in the received data
-                    debugPrintln(F("ERROR: received data from sensor has odd comma count"));
+                    debugPrintln(F("ERROR: received data from sensor is not address,length,payload,RSSI,SNR"));
 
                     receivedMessageState = -1;
 
                 } else {
                     
                     // create substrings from received data
-                    ReceivedDeviceAddress = receivedData.substring(5, commas[0]).toInt();  // skip the "+RCV="
-                    //charCount = receivedData.substring(commas[1] + 1, commas[2]);
-                    payload = receivedData.substring(commas[2] + 1, commas[3]);
-                    RSSI = receivedData.substring(commas[3] + 1, commas[4]).toInt();
-                    SNR = receivedData.substring(commas[4] + 1, receivedData.length()).toInt(); 
+                    ReceivedDeviceAddress = receivedData.substring(5, addressEnd).toInt();  // skip the "+RCV="
+                    payload = receivedData.substring(lengthEnd + 1, payloadEnd);
+                    RSSI = receivedData.substring(payloadEnd + 1, rssiEnd).toInt();
+                    SNR = receivedData.substring(rssiEnd + 1, receivedData.length()).toInt(); 
 
                     receivedMessageState = 1;
 
-                } // end of if (commaCount != 4) 
+                }
             } // end of if(receivedData.indexOf("+RCV") < 0)
         } // end of if ((receivedData.indexOf("+OK") == 0) && receivedData.length() == 5)
 
@@ -19,6 +19,7 @@
     #include "Particle.h"
     #define LORA_SERIAL Serial1
     #define DEBUG_SERIAL Serial
+    #define TPP_LORA_MAX_BAUD 115200  // fastest LoRa baud rate this host handles reliably
     // CONSTANTS 
     const int BUTTON_PIN = D10;   // the pushbutton is on digital pin 2 which is ATMega328 chip pin 4
     const int GRN_LED_PIN = D2;  // the Green LED is on digital pin 7 which is the P2 onboard LED
@@ -31,6 +32,7 @@
     #include "arduino.h" 
     // ATMega328 has only one serial port, so no debug serial port
     #define LORA_SERIAL Serial
+    #define TPP_LORA_MAX_BAUD 38400  // 8 MHz clock: 57600 and 115200 have 2 - 3.5% baud error
     // CONSTANTS  
     const int BUTTON_PIN = 2;   // Interrupt 0 is Arduino pin 2 is chip pin 4, external pullup with schmitt trigger is used.
     const int GRN_LED_PIN = 9;  // the Green LED is on digital pin 9 which is chip pin 15
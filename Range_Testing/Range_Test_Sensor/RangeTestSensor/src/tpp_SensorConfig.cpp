@@ -0,0 +1,122 @@
+/*
+    tpp_SensorConfig.cpp - settings the hub sends a sensor in its acks, kept in EEPROM
+    created by Bob Glicksman and Jim Schrempp
+    as part of Team Practical Projects (tpp)
+
+    20261018 - first version
+*/
+
+#include "tpp_SensorConfig.h"
+
+#if !PARTICLEPHOTON
+    #include <EEPROM.h>
+#endif
+
+void tpp_SensorConfig::begin(const uint16_t defaults[TPP_LORA_CONFIG_KEY_COUNT]) {
+    Saved saved;
+    EEPROM.get(TPP_CONFIG_EEPROM_ADDRESS, saved);
+    bool good = saved.magic == TPP_CONFIG_MAGIC
+        && saved.crc == tpp_crc16((const uint8_t*) &saved, sizeof(saved) - sizeof(saved.crc));
+    for (int k = 0; k < TPP_LORA_CONFIG_KEY_COUNT; k++) {
+        values[k] = good ? saved.values[k] : defaults[k];
+    }
+}
+
+uint16_t tpp_SensorConfig::get(char key) {
+    for (int k = 0; k < TPP_LORA_CONFIG_KEY_COUNT; k++) {
+        if (tpp_LoRaConfigKeys[k].key == key) {
+            return values[k];
+        }
+    }
+    return 0;
+}
+
+void tpp_SensorConfig::save() {
+    Saved saved;
+    saved.magic = TPP_CONFIG_MAGIC;
+    for (int k = 0; k < TPP_LORA_CONFIG_KEY_COUNT; k++) {
+        saved.values[k] = values[k];
+    }
+    saved.crc = tpp_crc16((const uint8_t*) &saved, sizeof(saved) - sizeof(saved.crc));
+    EEPROM.put(TPP_CONFIG_EEPROM_ADDRESS, saved);     // only bytes that differ are written
+}
+
+long tpp_SensorConfig::take(const String& payload, tpp_Auth* auth, unsigned int address) {
+    int at = payload.indexOf(F(TPP_LORA_CONFIG_FIELD));
+    if (at < 0) {
+        return 0;
+    }
+    const char* start = payload.c_str() + at;
+    const char* p = start + strlen(TPP_LORA_CONFIG_FIELD);
+    unsigned long id = 0;
+    while (*p >= '0' && *p <= '9') {
+        id = id * 10 + (*p++ - '0');
+    }
+    if (id == 0 || *p++ != ' ') {
+        return -1;
+    }
+
+    // the settings end at the tag, if there is one
+    const char* end = strchr(p, ' ');
+    if (auth) {
+        if (!end || strlen(end + 1) != TPP_AUTH_TAG_CHARS) {
+            return -1;
+        }
+        uint32_t tag = 0;
+        for (const char* t = end + 1; *t; t++) {
+            int nibble = *t >= '0' && *t <= '9' ? *t - '0' : *t >= 'a' && *t <= 'f' ? *t - 'a' + 10 : -1;
+            if (nibble < 0) {
+                return -1;
+            }
+            tag = (tag << 4) | nibble;
+        }
+        if (tag != auth->mac(address, start, end - start)) {
+            return -1;
+        }
+    }
+    if (!end) {
+        end = p + strlen(p);
+    }
+
+    // every value is checked before any is used
+    uint16_t newValues[TPP_LORA_CONFIG_KEY_COUNT];
+    for (int k = 0; k < TPP_LORA_CONFIG_KEY_COUNT; k++) {
+        newValues[k] = values[k];
+    }
+    while (p < end) {
+        int k = 0;
+        while (k < TPP_LORA_CONFIG_KEY_COUNT && tpp_LoRaConfigKeys[k].key != *p) {
+            k++;
+        }
+        if (k == TPP_LORA_CONFIG_KEY_COUNT || p + 2 >= end || p[1] != '=') {
+            return -1;
+        }
+        p += 2;
+        unsigned long value = 0;
+        while (p < end && *p >= '0' && *p <= '9' && value <= 65535) {
+            value = value * 10 + (*p++ - '0');
+        }
+        if (value < tpp_LoRaConfigKeys[k].low || value > tpp_LoRaConfigKeys[k].high) {
+            return -1;
+        }
+        newValues[k] = value;
+        if (p < end && *p++ != ',') {
+            return -1;
+        }
+    }
+    for (int k = 0; k < TPP_LORA_CONFIG_KEY_COUNT; k++) {
+        values[k] = newValues[k];
+    }
+    save();
+    confirmId = id;
+    return id;
+}
+
+void tpp_SensorConfig::appendConfirm(String& payload) {
+    if (confirmId == 0) {
+        return;
+    }
+    payload += F(TPP_LORA_CONFIG_FIELD);
+    payload += confirmId;
+    confirmId = 0;
+}
@@ -0,0 +1,62 @@
+/*
+    tpp_SensorConfig.h - settings the hub sends a sensor in its acks, kept in EEPROM
+    created by Bob Glicksman and Jim Schrempp
+    as part of Team Practical Projects (tpp)
+
+    20261018 - first version
+
+    The hub (tpp_DownlinkQueue) puts settings waiting for this sensor after the TESTOK:
+
+        TESTOK c: <id> <key>=<value>,<key>=<value>... [<tag>]
+
+    with the keys of tpp_LoRaConfigKeys in tpp_LoRa.h.  take() checks each value against
+    the range there, keeps it and saves the settings in EEPROM, so they outlive a reset
+    and replace the #define defaults from then on.  The id goes back to the hub as
+    " c: <id>" in the next frame the sensor sends, from appendConfirm().  The same
+    settings may arrive again if that frame is lost; taking them again does no harm.
+
+    When an auth object is given (AUTH_FRAMES), the settings must end with the hub's
+    8 hex character tag over " c: <id> <settings>" and this sensor's address, or they
+    are ignored.  The tag stops anyone else changing the settings, but not an old ack
+    being sent again.
+*/
+
+#ifndef tpp_SensorConfig_h
+#define tpp_SensorConfig_h
+
+#include "tpp_LoRaGlobals.h"
+#include "tpp_LoRa.h"
+#include "tpp_Auth.h"
+
+#define TPP_CONFIG_EEPROM_ADDRESS 128       // after tpp_Auth's counter slots
+#define TPP_CONFIG_MAGIC 0x7C02            // 0x7C01 had the radio profile as a key
+
+class tpp_SensorConfig
+{
+private:
+    struct Saved {
+        uint16_t magic;
+        uint16_t values[TPP_LORA_CONFIG_KEY_COUNT];
+        uint16_t crc;
+    };
+    uint16_t values[TPP_LORA_CONFIG_KEY_COUNT];
+    unsigned long confirmId = 0;    // to send to the hub in the next frame
+
+    void save();
+
+public:
+    // the saved settings, or these defaults (in the order of tpp_LoRaConfigKeys) if none are saved
+    void begin(const uint16_t defaults[TPP_LORA_CONFIG_KEY_COUNT]);
+
+    // the value of one key of tpp_LoRaConfigKeys
+    uint16_t get(char key);
+
+    // applies the settings in an ack from the hub.  Returns the id, 0 if the ack has
+    // none, -1 if they are not valid or their tag is wrong.  auth may be nullptr
+    long take(const String& payload, tpp_Auth* auth, unsigned int address);
+
+    // adds " c: <id>" to a frame if settings were taken since the last one
+    void appendConfirm(String& payload);
+};
+
+#endif